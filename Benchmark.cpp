@@ -0,0 +1,269 @@
+#include "Benchmark.h"
+#include "Timer.h"
+#include "Log.h"
+#include "StringBuilder.h"
+#include "Mem.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+START_CB
+
+//=========================================================================================
+
+BenchmarkOptions::BenchmarkOptions() :
+	warmupSeconds(0.1),
+	sampleSeconds(0.01),
+	numSamples(21),
+	coldCache(false),
+	bytesPerCall(0)
+{
+}
+
+// out of line so the compiler has to assume it reads ptr :
+void Benchmark_UseCharPointer(char const volatile * ptr)
+{
+	(void)ptr;
+}
+
+//=========================================================================================
+
+// bigger than any last level cache we run on ; allocated once , so trashing doesn't
+//	also time the allocator like TrashTheCache does
+#define BENCHMARK_TRASH_BYTES	(64*1024*1024)
+
+static char * s_trashBuffer = NULL;
+
+void Benchmark_TrashCache()
+{
+	if ( s_trashBuffer == NULL )
+		s_trashBuffer = (char *) CBALLOC(BENCHMARK_TRASH_BYTES);
+
+	// one write per cache line dirties every line , so they also get evicted from the
+	//	levels below
+	char volatile * mem = s_trashBuffer;
+	for(int i=0;i<BENCHMARK_TRASH_BYTES;i+=64)
+		mem[i] = (char)i;
+}
+
+static uint64 Benchmark_TimeOnce(fp_benchmark * func,void * context,int64 iterations,bool coldCache)
+{
+	if ( coldCache )
+		Benchmark_TrashCache();
+
+	uint64 t1 = Timer::rdtscSerializedBegin();
+	(*func)(context,iterations);
+	uint64 t2 = Timer::rdtscSerializedEnd();
+	return t2 - t1;
+}
+
+// median of sorted values
+static double Benchmark_Median(const vector<double> & sorted)
+{
+	int n = sorted.size32();
+	if ( n == 0 )
+		return 0.0;
+	if ( n & 1 )
+		return sorted[n/2];
+	return 0.5 * ( sorted[n/2-1] + sorted[n/2] );
+}
+
+bool Benchmark_Run(BenchmarkResult * pResult,const char * name,fp_benchmark * func,void * context,
+					const BenchmarkOptions & options)
+{
+	ZERO_PTR(pResult);
+	strncpy(pResult->name,name,sizeof(pResult->name)-1);
+	pResult->coldCache = options.coldCache;
+	pResult->bytesPerCall = options.bytesPerCall;
+
+	if ( func == NULL )
+		return false;
+
+	const double secondsPerTick = Timer::GetSecondsPerTick();
+
+	// the serialized pair itself costs something ; measure it so it can be taken off
+	uint64 overhead = (uint64)-1;
+	for LOOP(i,64)
+	{
+		uint64 t1 = Timer::rdtscSerializedBegin();
+		uint64 t2 = Timer::rdtscSerializedEnd();
+		overhead = MIN(overhead,t2-t1);
+	}
+
+	// warmup :
+	uint64 warmupTicks = (uint64)( options.warmupSeconds / secondsPerTick );
+	uint64 spent = 0;
+	do
+	{
+		spent += Benchmark_TimeOnce(func,context,1,false);
+	} while ( spent < warmupTicks );
+
+	// calibrate : double until one sample is long enough
+	int64 iterations = 1;
+	if ( ! options.coldCache )
+	{
+		uint64 targetTicks = (uint64)( options.sampleSeconds / secondsPerTick );
+		for(;;)
+		{
+			uint64 ticks = Benchmark_TimeOnce(func,context,iterations,false);
+			if ( ticks >= targetTicks || iterations >= (((int64)1)<<40) )
+				break;
+
+			// jump most of the way there when we have a usable measurement :
+			if ( ticks > 100*overhead )
+			{
+				double scale = (double)targetTicks / (double)ticks;
+				int64 next = (int64)( iterations * MIN(scale * 1.1,10.0) );
+				iterations = MAX(next,iterations*2);
+			}
+			else
+			{
+				iterations *= 2;
+			}
+		}
+	}
+
+	int numSamples = MAX(options.numSamples,1);
+	vector<double> perCall;
+	perCall.reserve(numSamples);
+
+	double sum = 0.0;
+	for LOOP(s,numSamples)
+	{
+		uint64 ticks = Benchmark_TimeOnce(func,context,iterations,options.coldCache);
+		ticks = ( ticks > overhead ) ? ticks - overhead : 0;
+		double nanos = (double)ticks * secondsPerTick * 1e9 / (double)iterations;
+		perCall.push_back(nanos);
+		sum += nanos;
+	}
+
+	std::sort(perCall.begin(),perCall.end());
+	double median = Benchmark_Median(perCall);
+
+	vector<double> deviations;
+	deviations.resize(perCall.size());
+	for LOOPVEC(i,perCall)
+	{
+		double d = perCall[i] - median;
+		deviations[i] = ( d < 0.0 ) ? -d : d;
+	}
+	std::sort(deviations.begin(),deviations.end());
+
+	pResult->iterations = iterations;
+	pResult->numSamples = numSamples;
+	pResult->minNanos = perCall[0];
+	pResult->medianNanos = median;
+	pResult->madNanos = Benchmark_Median(deviations);
+	pResult->meanNanos = sum / numSamples;
+	return true;
+}
+
+//=========================================================================================
+
+struct BenchmarkEntry
+{
+	const char *	name;
+	fp_benchmark *	func;
+	void *			context;
+};
+
+// a pointer so registering from cinit doesn't depend on construction order :
+static vector<BenchmarkEntry> * s_benchmarks = NULL;
+
+void Benchmark_Register(const char * name,fp_benchmark * func,void * context)
+{
+	if ( s_benchmarks == NULL )
+		s_benchmarks = new vector<BenchmarkEntry>;
+
+	BenchmarkEntry e = { name, func, context };
+	s_benchmarks->push_back(e);
+}
+
+void Benchmark_RunAll(vector<BenchmarkResult> * pResults,const char * filter,
+					const BenchmarkOptions & options)
+{
+	if ( s_benchmarks == NULL )
+		return;
+
+	const vector<BenchmarkEntry> & benchmarks = *s_benchmarks;
+	for LOOPVEC(i,benchmarks)
+	{
+		const BenchmarkEntry & e = benchmarks[i];
+		if ( filter && ! strstr(e.name,filter) )
+			continue;
+
+		BenchmarkResult r;
+		if ( Benchmark_Run(&r,e.name,e.func,e.context,options) )
+			pResults->push_back(r);
+	}
+}
+
+//=========================================================================================
+
+static double Benchmark_MBPerSecond(const BenchmarkResult & r)
+{
+	if ( r.bytesPerCall <= 0 || r.medianNanos <= 0.0 )
+		return 0.0;
+	// bytes per nano = GB/s ; *1000 for MB/s
+	return (double)r.bytesPerCall / r.medianNanos * 1000.0;
+}
+
+void Benchmark_Log(const vector<BenchmarkResult> & results)
+{
+	for LOOPVEC(i,results)
+	{
+		const BenchmarkResult & r = results[i];
+		StringBuilder sb;
+		sb.CatPrintf("%-32s : %12.2f ns min | %12.2f ns median +- %.2f | %I64d x %d%s",
+			r.name,r.minNanos,r.medianNanos,r.madNanos,r.iterations,r.numSamples,
+			r.coldCache ? " cold" : "");
+		if ( r.bytesPerCall > 0 )
+			sb.CatPrintf(" | %.2f MB/s",Benchmark_MBPerSecond(r));
+		sb.Append("\n");
+		lprintf("%s",sb.ToString().CStr());
+	}
+}
+
+bool Benchmark_WriteCSV(const char * fileName,const vector<BenchmarkResult> & results)
+{
+	StringBuilder sb;
+	sb.Append("name,iterations,samples,cold,min_ns,median_ns,mad_ns,mean_ns,mb_per_s\n");
+	for LOOPVEC(i,results)
+	{
+		const BenchmarkResult & r = results[i];
+		// names are identifiers ; quote them anyway in case of commas
+		sb.CatPrintf("\"%s\",%I64d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			r.name,r.iterations,r.numSamples,r.coldCache ? 1 : 0,
+			r.minNanos,r.medianNanos,r.madNanos,r.meanNanos,Benchmark_MBPerSecond(r));
+	}
+	return sb.WriteTextFile(fileName);
+}
+
+bool Benchmark_WriteJSON(const char * fileName,const vector<BenchmarkResult> & results)
+{
+	StringBuilder sb;
+	sb.CatPrintf("{\"mhz\":%d,\"invariant_tsc\":%s,\"benchmarks\":[",
+		Timer::GetMHZ(),Timer::HasInvariantTSC() ? "true" : "false");
+	for LOOPVEC(i,results)
+	{
+		const BenchmarkResult & r = results[i];
+		if ( i > 0 )
+			sb.Append(',');
+		sb.Append("\n{\"name\":");
+		sb.AppendJSONString(r.name);
+		sb.CatPrintf(",\"iterations\":%I64d,\"samples\":%d,\"cold\":%s",
+			r.iterations,r.numSamples,r.coldCache ? "true" : "false");
+		sb.CatPrintf(",\"min_ns\":%.3f,\"median_ns\":%.3f,\"mad_ns\":%.3f,\"mean_ns\":%.3f",
+			r.minNanos,r.medianNanos,r.madNanos,r.meanNanos);
+		if ( r.bytesPerCall > 0 )
+			sb.CatPrintf(",\"bytes_per_call\":%I64d,\"mb_per_s\":%.3f",r.bytesPerCall,Benchmark_MBPerSecond(r));
+		sb.Append('}');
+	}
+	sb.Append("\n]}\n");
+	return sb.WriteTextFile(fileName);
+}
+
+//=========================================================================================
+
+END_CB
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "Base.h"
+#include "vector.h"
+
+/**
+
+Benchmark : microbenchmark harness ; the portable big brother of GetMinFuncTicks
+
+a benchmark is a function that runs its body "iterations" times :
+
+	static void Bench_VecPush(void * context,int64 iterations)
+	{
+		for(int64 i=0;i<iterations;i++)
+		{
+			vector<int> v;
+			for LOOP(j,100) v.push_back(j);
+			DoNotOptimize(v.data());
+		}
+	}
+
+	BenchmarkResult r;
+	Benchmark_Run(&r,"vec.push100",Bench_VecPush,NULL);
+
+Run warms up , doubles the iteration count until one sample takes options.sampleSeconds ,
+	then takes numSamples samples and reports per-call min , median and MAD
+	(median absolute deviation ; a spread that a few preempted samples don't blow up)
+	compare medians across runs , and only believe a difference that's a few MADs wide
+
+coldCache trashes the cache before every call ; the iteration count is then always 1 ,
+	so it's only meaningful for calls that are a lot more than the timer overhead
+
+times are in Timer ticks (serialized rdtsc) converted to nanos
+
+CB_BENCHMARK(name) { body } registers a benchmark at cinit for Benchmark_RunAll
+	registrations in a static lib only link if something references their file ,
+	so put them in the benchmark executable : bench/Benchmarks.cpp is the standard set ,
+	built as cblib_bench with cmake -DCBLIB_BUILD_BENCHMARKS=ON
+
+**/
+
+START_CB
+
+//-------------------------------------------------------------------------------------------
+// barriers : keep the optimizer from deleting the work you're timing
+
+void Benchmark_UseCharPointer(char const volatile * ptr);
+
+#ifdef _MSC_VER
+
+// value escapes to a function the compiler can't see into
+template <typename T>
+inline void DoNotOptimize(const T & value)
+{
+	Benchmark_UseCharPointer(&reinterpret_cast<char const volatile &>(value));
+	_ReadWriteBarrier();
+}
+
+inline void ClobberMemory()
+{
+	_ReadWriteBarrier();
+}
+
+#else
+
+// value has to be materialized (in a register or memory) , and the asm might read any memory
+template <typename T>
+inline void DoNotOptimize(const T & value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// all pending stores must be done before this
+inline void ClobberMemory()
+{
+	asm volatile("" : : : "memory");
+}
+
+#endif
+
+//-------------------------------------------------------------------------------------------
+
+typedef void (fp_benchmark)(void * context,int64 iterations);
+
+struct BenchmarkOptions
+{
+	double	warmupSeconds;	// untimed runs first , to fault in pages and wake up the cpu
+	double	sampleSeconds;	// iterations per sample are grown until a sample takes this long
+	int		numSamples;
+	bool	coldCache;		// trash the cache before each call
+	int64	bytesPerCall;	// optional ; if > 0 , MB/s is reported
+
+	BenchmarkOptions();
+};
+
+struct BenchmarkResult
+{
+	char	name[64];
+	int64	iterations;		// calls per sample
+	int		numSamples;
+	bool	coldCache;
+	int64	bytesPerCall;
+
+	// per call , in nanos :
+	double	minNanos;
+	double	medianNanos;
+	double	madNanos;
+	double	meanNanos;
+};
+
+bool Benchmark_Run(BenchmarkResult * pResult,const char * name,fp_benchmark * func,void * context,
+					const BenchmarkOptions & options = BenchmarkOptions());
+
+// touches more memory than any cache we'll see ; portable TrashTheCache
+void Benchmark_TrashCache();
+
+//-------------------------------------------------------------------------------------------
+// registry
+
+void Benchmark_Register(const char * name,fp_benchmark * func,void * context = NULL);
+
+// runs every registered benchmark whose name contains filter (NULL = all) , in registration order
+void Benchmark_RunAll(vector<BenchmarkResult> * pResults,const char * filter = NULL,
+					const BenchmarkOptions & options = BenchmarkOptions());
+
+struct BenchmarkRegistrar
+{
+	BenchmarkRegistrar(const char * name,fp_benchmark * func) { Benchmark_Register(name,func); }
+};
+
+#define CB_BENCHMARK(name) \
+	static void Benchmark_##name(void * context,int64 iterations); \
+	static NS_CB::BenchmarkRegistrar s_benchmarkRegistrar_##name(#name,Benchmark_##name); \
+	static void Benchmark_##name(void * context,int64 iterations)
+
+//-------------------------------------------------------------------------------------------
+// output
+
+void Benchmark_Log(const vector<BenchmarkResult> & results);
+// one row per result , with a header row
+bool Benchmark_WriteCSV(const char * fileName,const vector<BenchmarkResult> & results);
+// { "mhz":.. , "benchmarks":[ {..} , .. ] }
+bool Benchmark_WriteJSON(const char * fileName,const vector<BenchmarkResult> & results);
+
+END_CB
@@ -0,0 +1,23 @@
+#include "Bswap.h"
+
+START_CB
+
+void BswapArray16(uint16 * ptr,int count)
+{
+	for LOOP(i,count)
+		ptr[i] = Bswap16(ptr[i]);
+}
+
+void BswapArray32(uint32 * ptr,int count)
+{
+	for LOOP(i,count)
+		ptr[i] = Bswap32(ptr[i]);
+}
+
+void BswapArray64(uint64 * ptr,int count)
+{
+	for LOOP(i,count)
+		ptr[i] = Bswap64(ptr[i]);
+}
+
+END_CB
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Base.h"
+
+#ifdef _MSC_VER
+#include <stdlib.h> // _byteswap
+#endif
+
+/**
+
+Bswap : reverse the byte order of a value , for big endian file formats on little endian machines
+
+(not to be confused with ByteSwap(a,b) in Util.h , which exchanges two objects' bytes)
+
+**/
+
+START_CB
+
+inline uint16 Bswap16(const uint16 v)
+{
+	#ifdef _MSC_VER
+	return _byteswap_ushort(v);
+	#else
+	return __builtin_bswap16(v);
+	#endif
+}
+
+inline uint32 Bswap32(const uint32 v)
+{
+	#ifdef _MSC_VER
+	return _byteswap_ulong(v);
+	#else
+	return __builtin_bswap32(v);
+	#endif
+}
+
+inline uint64 Bswap64(const uint64 v)
+{
+	#ifdef _MSC_VER
+	return _byteswap_uint64(v);
+	#else
+	return __builtin_bswap64(v);
+	#endif
+}
+
+// in place , no aliasing ; simple loops the compiler turns into pshufb
+void BswapArray16(uint16 * ptr,int count);
+void BswapArray32(uint32 * ptr,int count);
+void BswapArray64(uint64 * ptr,int count);
+
+END_CB
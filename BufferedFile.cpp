@@ -0,0 +1,548 @@
+#include "BufferedFile.h"
+#include "Mem.h"
+#include "Log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+START_CB
+
+//=========================================================================================
+
+// O_DIRECT wants the buffer , the file offset and the length all on this :
+#define BUFFEREDFILE_ALIGN	4096
+
+BufferedFileOptions::BufferedFileOptions() :
+	bufferBytes(1<<20),
+	direct(false),
+	sequential(false)
+{
+}
+
+//=========================================================================================
+// raw positioned IO ; loops over short counts
+// returns the number of bytes done , which is < count on eof or error
+
+#ifdef _WIN32
+
+static int BufferedFile_RawRead(int fd,int64 pos,void * into,int count)
+{
+	if ( _lseeki64(fd,pos,SEEK_SET) != pos )
+		return 0;
+
+	char * ptr = (char *)into;
+	int done = 0;
+	while ( done < count )
+	{
+		int got = _read(fd,ptr+done,count-done);
+		if ( got <= 0 )
+			break;
+		done += got;
+	}
+	return done;
+}
+
+static int BufferedFile_RawWrite(int fd,int64 pos,const void * from,int count)
+{
+	if ( _lseeki64(fd,pos,SEEK_SET) != pos )
+		return 0;
+
+	const char * ptr = (const char *)from;
+	int done = 0;
+	while ( done < count )
+	{
+		int put = _write(fd,ptr+done,count-done);
+		if ( put <= 0 )
+			break;
+		done += put;
+	}
+	return done;
+}
+
+#else
+
+static int BufferedFile_RawRead(int fd,int64 pos,void * into,int count)
+{
+	char * ptr = (char *)into;
+	int done = 0;
+	while ( done < count )
+	{
+		ssize_t got = pread(fd,ptr+done,count-done,(off_t)(pos+done));
+		if ( got < 0 && errno == EINTR )
+			continue;
+		if ( got <= 0 )
+			break;
+		done += (int)got;
+	}
+	return done;
+}
+
+static int BufferedFile_RawWrite(int fd,int64 pos,const void * from,int count)
+{
+	const char * ptr = (const char *)from;
+	int done = 0;
+	while ( done < count )
+	{
+		ssize_t put = pwrite(fd,ptr+done,count-done,(off_t)(pos+done));
+		if ( put < 0 && errno == EINTR )
+			continue;
+		if ( put <= 0 )
+			break;
+		done += (int)put;
+	}
+	return done;
+}
+
+#endif
+
+//=========================================================================================
+
+BufferedFile::BufferedFile() :
+	m_fd(-1),
+	m_alloc(NULL),
+	m_buffer(NULL),
+	m_bufferBytes(0),
+	m_ptr(NULL),
+	m_end(NULL),
+	m_bufferPos(0),
+	m_reading(false),
+	m_eof(false),
+	m_direct(false)
+{
+}
+
+BufferedFile::~BufferedFile()
+{
+	Close();
+}
+
+bool BufferedFile::Open(const char * name,const char * access,const BufferedFileOptions & options)
+{
+	Close();
+
+	const char mode = access[0];
+	if ( mode != 'r' && mode != 'w' && mode != 'a' )
+	{
+		lprintf("BufferedFile : bad access (%s)\n",access);
+		return false;
+	}
+
+	m_reading = ( mode == 'r' );
+	bool wantDirect = options.direct;
+
+	#ifdef _WIN32
+
+	int flags = _O_BINARY;
+	if ( m_reading )
+		flags |= _O_RDONLY;
+	else
+		flags |= _O_WRONLY | _O_CREAT | ( mode == 'w' ? _O_TRUNC : 0 );
+	if ( options.sequential )
+		flags |= _O_SEQUENTIAL;
+
+	m_fd = _open(name,flags,_S_IREAD|_S_IWRITE);
+	if ( m_fd < 0 )
+		return false;
+
+	// no O_DIRECT through the CRT
+	wantDirect = false;
+
+	#else
+
+	// not O_APPEND ; Linux pwrite ignores the offset on O_APPEND files , so "ab" just starts at the end
+	int flags = O_CLOEXEC;
+	if ( m_reading )
+		flags |= O_RDONLY;
+	else
+		flags |= O_WRONLY | O_CREAT | ( mode == 'w' ? O_TRUNC : 0 );
+
+	#ifdef O_DIRECT
+	if ( wantDirect )
+	{
+		m_fd = open(name,flags|O_DIRECT,0644);
+		// some file systems (tmpfs) refuse O_DIRECT ; fall back to buffered
+		if ( m_fd < 0 && errno == EINVAL )
+			wantDirect = false;
+	}
+	#else
+	wantDirect = false;
+	#endif
+
+	if ( m_fd < 0 )
+		m_fd = open(name,flags,0644);
+	if ( m_fd < 0 )
+		return false;
+
+	#ifdef POSIX_FADV_SEQUENTIAL
+	if ( options.sequential )
+		posix_fadvise(m_fd,0,0,POSIX_FADV_SEQUENTIAL);
+	#endif
+
+	#endif // _WIN32
+
+	m_direct = wantDirect;
+	m_eof = false;
+	m_name = String(name);
+
+	int bytes = MAX(options.bufferBytes,BUFFEREDFILE_ALIGN);
+	bytes = (bytes + BUFFEREDFILE_ALIGN-1) & ~(BUFFEREDFILE_ALIGN-1);
+	m_bufferBytes = bytes;
+	m_alloc = (uint8 *) CBALLOC(bytes + BUFFEREDFILE_ALIGN);
+	m_buffer = (uint8 *)( ((intptr_t)m_alloc + BUFFEREDFILE_ALIGN-1) & ~((intptr_t)BUFFEREDFILE_ALIGN-1) );
+
+	m_bufferPos = 0;
+	m_ptr = m_buffer;
+	if ( m_reading )
+	{
+		m_end = m_buffer;
+	}
+	else
+	{
+		m_end = m_buffer + m_bufferBytes;
+		if ( mode == 'a' )
+			m_bufferPos = GetFileSize();
+	}
+
+	return true;
+}
+
+void BufferedFile::Close()
+{
+	if ( m_fd >= 0 )
+	{
+		if ( ! m_reading )
+			FlushBuffer();
+
+		#ifdef _WIN32
+		_close(m_fd);
+		#else
+		close(m_fd);
+		#endif
+	}
+
+	if ( m_alloc )
+		CBFREE(m_alloc);
+
+	m_fd = -1;
+	m_alloc = NULL;
+	m_buffer = NULL;
+	m_bufferBytes = 0;
+	m_ptr = NULL;
+	m_end = NULL;
+	m_bufferPos = 0;
+	m_eof = false;
+	m_direct = false;
+}
+
+void BufferedFile::SetDirect(bool on)
+{
+	if ( on == m_direct )
+		return;
+
+	#if !defined(_WIN32) && defined(O_DIRECT)
+	int flags = fcntl(m_fd,F_GETFL);
+	if ( flags == -1 )
+		return;
+	flags = on ? ( flags | O_DIRECT ) : ( flags & ~O_DIRECT );
+	if ( fcntl(m_fd,F_SETFL,flags) == -1 )
+		return;
+	#endif
+
+	m_direct = on;
+}
+
+//=========================================================================================
+// write side
+
+void BufferedFile::FlushBuffer()
+{
+	ASSERT( ! m_reading );
+	int len = (int)( m_ptr - m_buffer );
+	if ( len == 0 )
+		return;
+
+	// a partial block (the tail of the file , or after a seek) can't go through O_DIRECT ;
+	//	drop it for the rest of this file rather than read-modify-write
+	if ( m_direct && ( ( len | m_bufferPos ) & (BUFFEREDFILE_ALIGN-1) ) )
+		SetDirect(false);
+
+	int put = BufferedFile_RawWrite(m_fd,m_bufferPos,m_buffer,len);
+	if ( put != len )
+		lprintf("BufferedFile : write failed (%s)\n",m_name.CStr());
+
+	m_bufferPos += len;
+	m_ptr = m_buffer;
+}
+
+void BufferedFile::Flush()
+{
+	if ( m_fd >= 0 && ! m_reading )
+		FlushBuffer();
+}
+
+void BufferedFile::WriteSlow(const void * bits,int count)
+{
+	ASSERT( ! m_reading );
+	const uint8 * from = (const uint8 *)bits;
+
+	while ( count > 0 )
+	{
+		// big writes from an empty buffer skip the copy :
+		if ( m_ptr == m_buffer && count >= m_bufferBytes && ! m_direct )
+		{
+			int put = BufferedFile_RawWrite(m_fd,m_bufferPos,from,count);
+			if ( put != count )
+				lprintf("BufferedFile : write failed (%s)\n",m_name.CStr());
+			m_bufferPos += count;
+			return;
+		}
+
+		int n = MIN(count,(int)(m_end - m_ptr));
+		memcpy(m_ptr,from,n);
+		m_ptr += n;
+		from += n;
+		count -= n;
+
+		if ( m_ptr == m_end )
+			FlushBuffer();
+	}
+}
+
+//=========================================================================================
+// read side
+
+bool BufferedFile::FillBuffer()
+{
+	ASSERT( m_reading );
+	int got = BufferedFile_RawRead(m_fd,m_bufferPos,m_buffer,m_bufferBytes);
+	m_ptr = m_buffer;
+	m_end = m_buffer + got;
+	if ( got == 0 )
+	{
+		m_eof = true;
+		return false;
+	}
+	return true;
+}
+
+void BufferedFile::ReadSlow(void * bits,int count)
+{
+	ASSERT( m_reading );
+	uint8 * into = (uint8 *)bits;
+
+	int avail = (int)( m_end - m_ptr );
+	memcpy(into,m_ptr,avail);
+	m_ptr += avail;
+	into += avail;
+	count -= avail;
+
+	while ( count > 0 && ! m_eof )
+	{
+		// the buffer is used up ; step past it
+		m_bufferPos += m_end - m_buffer;
+		m_ptr = m_end = m_buffer;
+
+		// big reads go straight into the caller's memory :
+		if ( count >= m_bufferBytes && ! m_direct )
+		{
+			int got = BufferedFile_RawRead(m_fd,m_bufferPos,into,count);
+			m_bufferPos += got;
+			into += got;
+			count -= got;
+			if ( count > 0 )
+				m_eof = true;
+			break;
+		}
+
+		if ( ! FillBuffer() )
+			break;
+
+		int n = MIN(count,(int)(m_end - m_ptr));
+		memcpy(into,m_ptr,n);
+		m_ptr += n;
+		into += n;
+		count -= n;
+	}
+
+	if ( count > 0 )
+	{
+		memset(into,0,count);
+		m_eof = true;
+	}
+}
+
+//=========================================================================================
+
+int64 BufferedFile::GetFileSize()
+{
+	if ( m_fd < 0 )
+		return 0;
+
+	if ( ! m_reading )
+		FlushBuffer();
+
+	#ifdef _WIN32
+	return _filelengthi64(m_fd);
+	#else
+	struct stat st;
+	if ( fstat(m_fd,&st) != 0 )
+		return 0;
+	return st.st_size;
+	#endif
+}
+
+void BufferedFile::Seek(int64 offset, int origin)
+{
+	if ( origin == SEEK_CUR )
+		offset += Tell();
+	else if ( origin == SEEK_END )
+		offset += GetFileSize();
+
+	if ( offset < 0 )
+		offset = 0;
+
+	if ( ! m_reading )
+	{
+		FlushBuffer();
+		m_bufferPos = offset;
+		return;
+	}
+
+	m_eof = false;
+
+	// inside what we already have ?
+	if ( offset >= m_bufferPos && offset <= m_bufferPos + (m_end - m_buffer) )
+	{
+		m_ptr = m_buffer + (offset - m_bufferPos);
+		return;
+	}
+
+	// refill from the block holding offset ; aligned so O_DIRECT still works
+	int64 aligned = offset & ~((int64)BUFFEREDFILE_ALIGN-1);
+	m_bufferPos = aligned;
+	FillBuffer();
+
+	// seeking past the end leaves us at the end ; the next read gets zeros
+	int64 skip = MIN(offset - aligned,(int64)(m_end - m_buffer));
+	m_ptr = m_buffer + skip;
+	if ( offset - aligned > skip )
+		m_eof = true;
+}
+
+//=========================================================================================
+
+void BufferedFile::Get16Array(uint16 * into,int count)
+{
+	Read(into,count*(int)sizeof(uint16));
+	BswapArray16(into,count);
+}
+
+void BufferedFile::Get32Array(uint32 * into,int count)
+{
+	Read(into,count*(int)sizeof(uint32));
+	BswapArray32(into,count);
+}
+
+void BufferedFile::Get64Array(uint64 * into,int count)
+{
+	Read(into,count*(int)sizeof(uint64));
+	BswapArray64(into,count);
+}
+
+// swap in pieces through a stack chunk ; the source is const
+
+#define BUFFEREDFILE_SWAP_CHUNK	1024
+
+void BufferedFile::Put16Array(const uint16 * from,int count)
+{
+	uint16 chunk[BUFFEREDFILE_SWAP_CHUNK];
+	while ( count > 0 )
+	{
+		int n = MIN(count,BUFFEREDFILE_SWAP_CHUNK);
+		for LOOP(i,n)
+			chunk[i] = Bswap16(from[i]);
+		Write(chunk,n*(int)sizeof(uint16));
+		from += n;
+		count -= n;
+	}
+}
+
+void BufferedFile::Put32Array(const uint32 * from,int count)
+{
+	uint32 chunk[BUFFEREDFILE_SWAP_CHUNK];
+	while ( count > 0 )
+	{
+		int n = MIN(count,BUFFEREDFILE_SWAP_CHUNK);
+		for LOOP(i,n)
+			chunk[i] = Bswap32(from[i]);
+		Write(chunk,n*(int)sizeof(uint32));
+		from += n;
+		count -= n;
+	}
+}
+
+void BufferedFile::Put64Array(const uint64 * from,int count)
+{
+	uint64 chunk[BUFFEREDFILE_SWAP_CHUNK];
+	while ( count > 0 )
+	{
+		int n = MIN(count,BUFFEREDFILE_SWAP_CHUNK);
+		for LOOP(i,n)
+			chunk[i] = Bswap64(from[i]);
+		Write(chunk,n*(int)sizeof(uint64));
+		from += n;
+		count -= n;
+	}
+}
+
+//=========================================================================================
+
+int BufferedFile::ReadCString(char * into,int maxSize)
+{
+	int len = (int) Get32();
+	if ( len >= maxSize )
+	{
+		FAIL("String too big in ReadCString");
+		return 0;
+	}
+	Read(into,len);
+	into[len] = 0;
+	return len;
+}
+
+void BufferedFile::WriteCString(const char * str)
+{
+	int len = (int) strlen(str);
+	Put32( (uint32) len );
+	Write(str,len);
+}
+
+void BufferedFile::WriteString(const String & str)
+{
+	int len = str.Length();
+	Put32( (uint32) len );
+	Write(str.CStr(),len);
+}
+
+String BufferedFile::ReadString()
+{
+	String ret;
+	int len = (int) Get32();
+	char * ptr = ret.WriteableCStr(len+1);
+	Read(ptr,len);
+	ptr[len] = 0;
+	ret.Truncate(len);
+	return ret;
+}
+
+END_CB
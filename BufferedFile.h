@@ -0,0 +1,242 @@
+#pragma once
+
+#include "Base.h"
+#include "String.h"
+#include "Bswap.h"
+#include <string.h>
+#include <stdio.h>
+
+/**
+
+BufferedFile : binary file IO with its own big buffer , for when File (stdio) is too slow
+
+it's a drop-in for File in serialization code ; same Put8/Get8 .. Put64/Get64 (big endian) ,
+	Read/Write , IO() , Read/WriteCString , ReadString/WriteString
+	so code templated on the stream type switches by changing the type
+
+the differences :
+	the buffer is ours , so Get8/Put8 and friends are inline pointer bumps , no FILE lock
+	Get32/Put32 on the fast path is one unaligned load/store + bswap , not four calls
+	Get16Array/Get32Array/Get64Array (and GetArray<T>) read a whole run then bswap it in a loop
+		the compiler can vectorize
+	big Reads and Writes skip the buffer and go straight to the file
+
+options :
+	direct : O_DIRECT on Linux ; the page cache is bypassed , all IO is whole aligned blocks
+		through the buffer (ignored on Windows)
+	sequential : tell the OS we'll read front to back so it reads ahead more
+		(posix_fadvise on posix , _O_SEQUENTIAL on Windows)
+
+not thread safe ; one stream per thread
+reading past the end gives zeros and sets IsEOF
+
+**/
+
+START_CB
+
+//-------------------------------------------------------------------------------------------
+
+struct BufferedFileOptions
+{
+	int		bufferBytes;	// rounded up to 4k
+	bool	direct;
+	bool	sequential;
+
+	BufferedFileOptions();
+};
+
+class BufferedFile
+{
+public:
+	BufferedFile();
+	~BufferedFile();
+
+	// access is "rb" , "wb" or "ab" ; no "+" modes
+	bool Open(const char * name,const char * access,const BufferedFileOptions & options = BufferedFileOptions());
+	void Close();
+
+	const String & GetNameString() const { return m_name; }
+	const char * GetName() const { return m_name.CStr(); }
+
+	bool IsOpen() const { return m_fd >= 0; }
+	bool IsReading() const { return m_reading; }
+	bool IsEOF() const { return m_eof; }
+
+	// writes the buffer out ; no fsync
+	void Flush();
+
+	int64 Tell() const { return m_bufferPos + (m_ptr - m_buffer); }
+	int64 GetFileSize();
+	void Seek(int64 offset, int origin = SEEK_SET);
+
+	//----------------------------------------------------
+
+	void Write(const void * bits,const int count)
+	{
+		if ( m_end - m_ptr >= count )
+		{
+			memcpy(m_ptr,bits,count);
+			m_ptr += count;
+		}
+		else
+		{
+			WriteSlow(bits,count);
+		}
+	}
+
+	void Read(void * bits,const int count)
+	{
+		if ( m_end - m_ptr >= count )
+		{
+			memcpy(bits,m_ptr,count);
+			m_ptr += count;
+		}
+		else
+		{
+			ReadSlow(bits,count);
+		}
+	}
+
+	// IO reads or writes depending on the mode it was opened in
+	void IO(void * bits,const int count)
+	{
+		if ( m_reading )
+			Read(bits,count);
+		else
+			Write(bits,count);
+	}
+
+	// DANGEROUS IO() : straight binary IO of arbitrary types; use IOZ for classes!
+	template <typename T>
+	void IO(T & t)
+	{
+		if ( m_reading )
+			Read(&t,sizeof(t));
+		else
+			Write(&t,sizeof(t));
+	}
+
+	//----------------------------------------------------
+	// big endian , like File
+
+	void Put8(const uint8 val)
+	{
+		if ( m_ptr < m_end )
+			*m_ptr++ = val;
+		else
+			WriteSlow(&val,1);
+	}
+
+	uint8 Get8()
+	{
+		if ( m_ptr < m_end )
+			return *m_ptr++;
+		uint8 val;
+		ReadSlow(&val,1);
+		return val;
+	}
+
+	// the file is big endian , we're little endian :
+	void Put16(const uint16 val) { PutRaw(Bswap16(val)); }
+	void Put32(const uint32 val) { PutRaw(Bswap32(val)); }
+	void Put64(const uint64 val) { PutRaw(Bswap64(val)); }
+
+	uint16 Get16() { return Bswap16(GetRaw<uint16>()); }
+	uint32 Get32() { return Bswap32(GetRaw<uint32>()); }
+	uint64 Get64() { return Bswap64(GetRaw<uint64>()); }
+
+	//----------------------------------------------------
+	// bulk big endian
+
+	void Get16Array(uint16 * into,int count);
+	void Get32Array(uint32 * into,int count);
+	void Get64Array(uint64 * into,int count);
+	void Put16Array(const uint16 * from,int count);
+	void Put32Array(const uint32 * from,int count);
+	void Put64Array(const uint64 * from,int count);
+
+	// for any plain 1,2,4 or 8 byte type (ints , floats) :
+	template <typename T>
+	void GetArray(T * into,int count)
+	{
+		COMPILER_ASSERT( sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8 );
+		if ( sizeof(T) == 1 ) Read(into,count);
+		else if ( sizeof(T) == 2 ) Get16Array((uint16 *)into,count);
+		else if ( sizeof(T) == 4 ) Get32Array((uint32 *)into,count);
+		else Get64Array((uint64 *)into,count);
+	}
+
+	template <typename T>
+	void PutArray(const T * from,int count)
+	{
+		COMPILER_ASSERT( sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8 );
+		if ( sizeof(T) == 1 ) Write(from,count);
+		else if ( sizeof(T) == 2 ) Put16Array((const uint16 *)from,count);
+		else if ( sizeof(T) == 4 ) Put32Array((const uint32 *)from,count);
+		else Put64Array((const uint64 *)from,count);
+	}
+
+	//----------------------------------------------------
+
+	// ReadString returns the length of the string, NOT the # of bytes read
+	int ReadCString(char * into,int maxSize);
+	void WriteCString(const char * str);
+	void WriteString(const String & str);
+	String ReadString();
+
+	//----------------------------------------------------
+private:
+
+	// raw file-order bytes ; PutN/GetN do the swaps
+	template <typename T>
+	void PutRaw(const T val)
+	{
+		if ( m_end - m_ptr >= (ptrdiff_t)sizeof(T) )
+		{
+			memcpy(m_ptr,&val,sizeof(T));
+			m_ptr += sizeof(T);
+		}
+		else
+		{
+			WriteSlow(&val,sizeof(T));
+		}
+	}
+
+	template <typename T>
+	T GetRaw()
+	{
+		T val;
+		if ( m_end - m_ptr >= (ptrdiff_t)sizeof(T) )
+		{
+			memcpy(&val,m_ptr,sizeof(T));
+			m_ptr += sizeof(T);
+		}
+		else
+		{
+			ReadSlow(&val,sizeof(T));
+		}
+		return val;
+	}
+
+	void WriteSlow(const void * bits,int count);
+	void ReadSlow(void * bits,int count);
+	bool FillBuffer();
+	void FlushBuffer();
+	void SetDirect(bool on);
+
+	int		m_fd;
+	uint8 *	m_alloc;
+	uint8 *	m_buffer;	// aligned
+	int		m_bufferBytes;
+	uint8 *	m_ptr;
+	uint8 *	m_end;		// reading : end of the valid data ; writing : end of the buffer
+	int64	m_bufferPos; // file offset of m_buffer[0]
+	bool	m_reading;
+	bool	m_eof;
+	bool	m_direct;
+	String	m_name;
+
+	FORBID_CLASS_STANDARDS(BufferedFile);
+};
+
+END_CB
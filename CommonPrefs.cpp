@@ -192,7 +192,7 @@ void PrefBlock_Reader_test()
 	PrefBlock b2(&writer);
 	PrefIO( b2, me );
 
-	//const String & out = writer.GetBuffer();
+	//const StringBuilder & out = writer.GetBuffer();
 
 	MyStruct2 me2;
 	me2.str = "test";
@@ -203,7 +203,7 @@ void PrefBlock_Reader_test()
 	b2.IO("me2",&me2);
 	//PrefIO(b2,me2);
 	
-	reader.Read( writer.GetBuffer().CStr() );
+	reader.Read( writer.GetBuffer().ToString().CStr() );
 
 	MyStruct2 me2out;
 	//PrefIO(b1,me2out);
@@ -50,7 +50,7 @@ inline void ReadFromText<COLORREF>(COLORREF * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<COLORREF>(const COLORREF & val, String * pInto)
+inline void WriteToText<COLORREF>(const COLORREF & val, StringBuilder * pInto)
 {
 	WriteToTextULHex((uint32)val,pInto);
 }
@@ -62,7 +62,7 @@ inline void ReadFromText<RGBQUAD>(RGBQUAD * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<RGBQUAD>(const RGBQUAD & val, String * pInto)
+inline void WriteToText<RGBQUAD>(const RGBQUAD & val, StringBuilder * pInto)
 {
 	WriteToTextULHex(*((uint32 *)&val),pInto);
 }
@@ -0,0 +1,524 @@
+#include "ContentCache.h"
+#include "MemMapFile.h"
+#include "FileEnum.h"
+#include "FileUtil.h"
+#include "Hashes.h"
+#include "Log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include "Win32Util.h"
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#include <sys/utime.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+#include <time.h>
+
+START_CB
+
+//=========================================================================================
+
+ContentKey ContentKey_Hash64(const void * data,int size)
+{
+	return ContentKey( StrongHash64((const uint8 *)data,size) );
+}
+
+ContentKey ContentKey_Hash128(const void * data,int size)
+{
+	return ContentKey( StrongHash64((const uint8 *)data,size,0x9E3779B97F4A7C15ULL),
+						StrongHash64((const uint8 *)data,size) );
+}
+
+ContentKey ContentKey_Combine(const ContentKey & key,const void * data,int size)
+{
+	// seed with the old key so the order things are combined in matters
+	const uint64 lo = StrongHash64((const uint8 *)data,size,key.lo);
+	if ( key.hi == 0 )
+		return ContentKey(lo);
+	const uint64 hi = StrongHash64((const uint8 *)data,size,key.hi ^ (key.lo * 0xC2B2AE3D27D4EB4FULL));
+	return ContentKey(hi,lo);
+}
+
+//=========================================================================================
+// file system bits
+
+static bool ContentCache_MkDir(const char * name)
+{
+	#ifdef _WIN32
+	return _mkdir(name) == 0 || errno == EEXIST;
+	#else
+	return mkdir(name,0777) == 0 || errno == EEXIST;
+	#endif
+}
+
+// replaces to if it exists
+static bool ContentCache_Rename(const char * fm,const char * to)
+{
+	#ifdef _WIN32
+	return !! MoveFileExA(fm,to,MOVEFILE_REPLACE_EXISTING);
+	#else
+	return rename(fm,to) == 0;
+	#endif
+}
+
+static void ContentCache_Touch(const char * name)
+{
+	#ifdef _WIN32
+	_utime(name,NULL);
+	#else
+	utime(name,NULL);
+	#endif
+}
+
+// makes a new file in tmpDir that nobody else has open ; fills *pName
+//	exclusive create , so threads & processes sharing the dir can't collide
+static FILE * ContentCache_CreateTemp(const String & tmpDir,String * pName)
+{
+	#ifdef _WIN32
+	static volatile LONG s_counter = 0;
+	for LOOP(tries,100)
+	{
+		pName->Printf("%s/%d_%d_%d.tmp",tmpDir.CStr(),(int)_getpid(),(int)GetCurrentThreadId(),
+			(int)InterlockedIncrement(&s_counter));
+		int fd = _open(pName->CStr(),_O_CREAT|_O_EXCL|_O_WRONLY|_O_BINARY,_S_IREAD|_S_IWRITE);
+		if ( fd >= 0 )
+			return _fdopen(fd,"wb");
+		if ( errno != EEXIST )
+			return NULL;
+	}
+	return NULL;
+	#else
+	*pName = tmpDir;
+	*pName += "/blob_XXXXXX";
+	// mkstemp fills in the X's in place
+	int fd = mkstemp(pName->WriteableCStr(pName->Length()+1));
+	pName->FixLength();
+	if ( fd < 0 )
+		return NULL;
+	FILE * fp = fdopen(fd,"wb");
+	if ( ! fp )
+		close(fd);
+	return fp;
+	#endif
+}
+
+// seconds since 1970 , 0 if it's not there
+static time_t ContentCache_GetModTime(const char * name)
+{
+	#ifdef _WIN32
+	struct _stat64 st;
+	if ( _stat64(name,&st) != 0 )
+		return 0;
+	#else
+	struct stat st;
+	if ( stat(name,&st) != 0 )
+		return 0;
+	#endif
+	return st.st_mtime;
+}
+
+// temp files this old are from a writer that died , not one still writing :
+static const int c_staleTempSeconds = 60*60;
+
+static const char c_hexDigits[] = "0123456789abcdef";
+
+static void ContentCache_PutHex(char * into,uint64 val)
+{
+	for(int i=15;i>=0;i--)
+	{
+		into[i] = c_hexDigits[val & 0xF];
+		val >>= 4;
+	}
+}
+
+static bool ContentCache_GetHex(const char * from,uint64 * pVal)
+{
+	uint64 val = 0;
+	for LOOP(i,16)
+	{
+		const char c = from[i];
+		int d;
+		if ( c >= '0' && c <= '9' ) d = c - '0';
+		else if ( c >= 'a' && c <= 'f' ) d = c - 'a' + 10;
+		else return false;
+		val = (val<<4) | d;
+	}
+	*pVal = val;
+	return true;
+}
+
+// "<32 hex>.blob"
+static bool ContentCache_ParseName(const char * name,ContentKey * pKey)
+{
+	if ( strlen(name) != 32 + 5 || strcmp(name+32,".blob") != 0 )
+		return false;
+	return ContentCache_GetHex(name,&pKey->hi) && ContentCache_GetHex(name+16,&pKey->lo);
+}
+
+//=========================================================================================
+
+ContentCache::ContentCache() :
+	m_budgetBytes(0),
+	m_totalBytes(0),
+	m_useClock(0)
+{
+}
+
+ContentCache::~ContentCache()
+{
+	Close();
+}
+
+String ContentCache::GetBlobPath(const ContentKey & key) const
+{
+	// dir/xx/<hi><lo>.blob ; xx from lo so 64 bit keys (hi = 0) spread out too
+	char name[3 + 32 + 6];
+	name[0] = c_hexDigits[(key.lo>>4) & 0xF];
+	name[1] = c_hexDigits[key.lo & 0xF];
+	name[2] = '/';
+	ContentCache_PutHex(name+3,key.hi);
+	ContentCache_PutHex(name+3+16,key.lo);
+	strcpy(name+3+32,".blob");
+
+	String path(m_dir);
+	path += '/';
+	path += name;
+	return path;
+}
+
+struct ContentCacheEntryFile
+{
+	ContentKey	key;
+	int64		size;
+	int64		modTime;
+};
+
+static bool ContentCacheEntryFile_OlderThan(const ContentCacheEntryFile & a,const ContentCacheEntryFile & b)
+{
+	return a.modTime < b.modTime;
+}
+
+bool ContentCache::Open(const char * dir,int64 budgetBytes)
+{
+	Close();
+
+	m_dir = dir;
+	while ( m_dir.Length() > 1 && ( LastChar(m_dir) == '/' || LastChar(m_dir) == '\\' ) )
+		m_dir.Truncate(m_dir.Length()-1);
+
+	String tmpDir(m_dir);
+	tmpDir += "/tmp";
+	if ( ! ContentCache_MkDir(m_dir.CStr()) || ! ContentCache_MkDir(tmpDir.CStr()) )
+	{
+		lprintf("ContentCache : couldn't make %s\n",m_dir.CStr());
+		m_dir.Clear();
+		return false;
+	}
+
+	m_budgetBytes = budgetBytes;
+	m_totalBytes = 0;
+
+	// crashed writers leave temps behind ; they don't count against the budget , so clean them
+	{
+		FileEnumOptions tmpOptions;
+		tmpOptions.recurse = false;
+		FileEnumTable tmpTable;
+		EnumFilesFast(tmpDir.CStr(),&tmpTable,tmpOptions);
+		const time_t now = time(NULL);
+		for LOOP(i,tmpTable.size32())
+		{
+			const char * path = tmpTable.GetPath(i);
+			const time_t modTime = ContentCache_GetModTime(path);
+			if ( modTime != 0 && now - modTime > c_staleTempSeconds )
+				remove(path);
+		}
+	}
+
+	// index what's there ; mod times only give the LRU order , then it's our clock
+	FileEnumOptions options;
+	options.wantStat = true;
+	FileEnumTable table;
+	EnumFilesFast(m_dir.CStr(),&table,options);
+
+	vector<ContentCacheEntryFile> files;
+	files.reserve(table.size32());
+	for LOOP(i,table.size32())
+	{
+		const FileEnumEntry & e = table[i];
+		const char * path = table.GetPath(i);
+		const char * name = path + e.pathLen;
+		while ( name > path && name[-1] != '/' && name[-1] != '\\' )
+			name--;
+
+		ContentCacheEntryFile f;
+		if ( ! ContentCache_ParseName(name,&f.key) )
+			continue;
+		f.size = e.size;
+		f.modTime = e.modTime;
+		files.push_back(f);
+	}
+	std::sort(files.begin(),files.end(),ContentCacheEntryFile_OlderThan);
+
+	for LOOPVEC(i,files)
+	{
+		if ( Find(files[i].key) )
+			continue;
+		Entry * entry = Add(files[i].key,files[i].size);
+		entry->lastUse = ++m_useClock;
+	}
+
+	Evict();
+	return true;
+}
+
+void ContentCache::Close()
+{
+	m_dir.Clear();
+	m_entries.clear();
+	m_totalBytes = 0;
+	m_useClock = 0;
+}
+
+static bool ContentCacheEntry_KeyLess(const ContentKey & lhs,const ContentKey & rhs)
+{
+	return lhs < rhs;
+}
+
+ContentCache::Entry * ContentCache::Find(const ContentKey & key)
+{
+	// binary search on the sorted vector
+	int lo = 0;
+	int hi = m_entries.size32();
+	while ( lo < hi )
+	{
+		const int mid = (lo + hi) >> 1;
+		if ( ContentCacheEntry_KeyLess(m_entries[mid].key,key) )
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ( lo < m_entries.size32() && m_entries[lo].key == key )
+		return &m_entries[lo];
+	return NULL;
+}
+
+ContentCache::Entry * ContentCache::Add(const ContentKey & key,int64 size)
+{
+	int index = 0;
+	int hi = m_entries.size32();
+	while ( index < hi )
+	{
+		const int mid = (index + hi) >> 1;
+		if ( ContentCacheEntry_KeyLess(m_entries[mid].key,key) )
+			index = mid + 1;
+		else
+			hi = mid;
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.size = size;
+	entry.lastUse = ++m_useClock;
+	m_entries.insert(m_entries.begin() + index,entry);
+
+	m_totalBytes += size;
+	return &m_entries[index];
+}
+
+void ContentCache::Touch(Entry * entry)
+{
+	entry->lastUse = ++m_useClock;
+	ContentCache_Touch( GetBlobPath(entry->key).CStr() );
+}
+
+void ContentCache::Drop(Entry * entry)
+{
+	m_totalBytes -= entry->size;
+	m_entries.erase(m_entries.begin() + (entry - &m_entries[0]));
+}
+
+bool ContentCache::Has(const ContentKey & key)
+{
+	if ( Find(key) )
+		return true;
+
+	// another process may have put it
+	return IsOpen() && FileExists( GetBlobPath(key).CStr() );
+}
+
+bool ContentCache::Get(const ContentKey & key,MemoryMappedFile * pInto)
+{
+	pInto->Close();
+	if ( ! IsOpen() )
+		return false;
+
+	const String path = GetBlobPath(key);
+	if ( ! pInto->OpenMapping(path.CStr()) )
+	{
+		// evicted behind our back ?
+		Entry * entry = Find(key);
+		if ( entry )
+			Drop(entry);
+		return false;
+	}
+
+	Entry * entry = Find(key);
+	if ( ! entry )
+		entry = Add(key,pInto->m_size);
+	Touch(entry);
+	return true;
+}
+
+bool ContentCache::Put(const ContentKey & key,const void * data,int64 size)
+{
+	if ( ! IsOpen() || size <= 0 )
+		return false;
+
+	const String path = GetBlobPath(key);
+
+	// same key is same content , nothing to write
+	Entry * existing = Find(key);
+	if ( existing && FileExists(path.CStr()) )
+	{
+		Touch(existing);
+		return true;
+	}
+
+	// the subdir might not be there yet
+	String subDir(path);
+	subDir.Truncate(m_dir.Length() + 3);
+	ContentCache_MkDir(subDir.CStr());
+
+	String tmpDir(m_dir);
+	tmpDir += "/tmp";
+	String temp;
+	FILE * fp = ContentCache_CreateTemp(tmpDir,&temp);
+	if ( ! fp )
+	{
+		lprintf("ContentCache : couldn't make a temp file in %s\n",tmpDir.CStr());
+		return false;
+	}
+
+	bool ok = fwrite(data,1,(size_t)size,fp) == (size_t)size;
+	ok = ok && fflush(fp) == 0;
+	// on disk before the rename makes it visible , or a crash can leave an empty blob
+	#ifdef _WIN32
+	ok = ok && _commit(_fileno(fp)) == 0;
+	#else
+	ok = ok && fsync(fileno(fp)) == 0;
+	#endif
+	ok = ( fclose(fp) == 0 ) && ok;
+
+	if ( ok )
+		ok = ContentCache_Rename(temp.CStr(),path.CStr());
+
+	if ( ! ok )
+	{
+		remove(temp.CStr());
+		lprintf("ContentCache : couldn't write %s\n",path.CStr());
+		return false;
+	}
+
+	Entry * entry = Find(key);
+	if ( entry )
+	{
+		m_totalBytes += size - entry->size;
+		entry->size = size;
+		entry->lastUse = ++m_useClock;
+	}
+	else
+	{
+		Add(key,size);
+	}
+
+	Evict();
+	return true;
+}
+
+bool ContentCache::Remove(const ContentKey & key)
+{
+	if ( ! IsOpen() )
+		return false;
+
+	Entry * entry = Find(key);
+	if ( entry )
+		Drop(entry);
+	return remove( GetBlobPath(key).CStr() ) == 0;
+}
+
+struct ContentCacheLRU
+{
+	int64		lastUse;
+	int			index;	// in m_entries
+};
+
+static bool ContentCacheLRU_OlderThan(const ContentCacheLRU & a,const ContentCacheLRU & b)
+{
+	return a.lastUse < b.lastUse;
+}
+
+void ContentCache::Evict()
+{
+	if ( m_totalBytes <= m_budgetBytes )
+		return;
+
+	// go down to 7/8 of the budget so we don't evict on every Put
+	const int64 target = m_budgetBytes - m_budgetBytes/8;
+
+	vector<ContentCacheLRU> order;
+	order.resize(m_entries.size32());
+	for LOOPVEC(i,m_entries)
+	{
+		order[i].lastUse = m_entries[i].lastUse;
+		order[i].index = i;
+	}
+	std::sort(order.begin(),order.end(),ContentCacheLRU_OlderThan);
+
+	// victims get size -1 , then m_entries is compacted in one pass
+	//	(erasing them one at a time is quadratic on a big cache)
+	int numVictims = 0;
+	for LOOPVEC(i,order)
+	{
+		if ( m_totalBytes <= target )
+			break;
+
+		Entry & entry = m_entries[ order[i].index ];
+
+		// another instance or process may have deleted it already ; that's as good as us doing it
+		//	anything else (it's mapped , on Windows) means it stays , and stays counted
+		if ( remove( GetBlobPath(entry.key).CStr() ) != 0 && errno != ENOENT )
+			continue;
+
+		m_totalBytes -= entry.size;
+		entry.size = -1;
+		numVictims++;
+	}
+
+	if ( numVictims == 0 )
+		return;
+
+	int to = 0;
+	for LOOPVEC(i,m_entries)
+	{
+		if ( m_entries[i].size < 0 )
+			continue;
+		if ( to != i )
+			m_entries[to] = m_entries[i];
+		to++;
+	}
+	m_entries.resize(to);
+}
+
+END_CB
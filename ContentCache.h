@@ -0,0 +1,119 @@
+#pragma once
+
+#include "Base.h"
+#include "String.h"
+#include "vector.h"
+
+/**
+
+ContentCache : a directory of blobs named by the hash of whatever made them
+
+use it to memoize expensive work ; hash the inputs and the parameters into a ContentKey ,
+	Get it , and if it's not there compute it and Put it :
+
+	ContentKey key = ContentKey_Hash128(srcPixels,srcBytes);
+	key = ContentKey_Combine(key,&params,sizeof(params));
+	MemoryMappedFile mmf;
+	if ( ! cache.Get(key,&mmf) )
+	{
+		... make it ...
+		cache.Put(key,result,resultBytes);
+	}
+
+blobs are dir/xx/<key in hex>.blob
+	Put writes a (uniquely created) temp file in dir/tmp , then renames it into place , so readers never see a
+		partial blob , and several processes can share one cache (same content either way)
+	Get maps the blob read only with MemoryMappedFile
+	a hit bumps the blob's mod time , so the LRU order survives between runs
+	when the total goes over the budget the least recently used blobs are deleted
+		(one being mapped on Windows can't be , so it's skipped)
+	the total is this instance's view of the dir : what it indexed at Open plus what it
+		has Put or Got since ; blobs other instances add don't count until they're touched here ,
+		so with several instances on one dir the dir can go over the budget by their share
+
+not thread safe ; give each thread its own ContentCache on the same dir
+
+**/
+
+START_CB
+
+struct MemoryMappedFile;
+
+//-------------------------------------------------------------------------------------------
+
+struct ContentKey
+{
+	uint64	hi;		// 0 for a 64 bit key
+	uint64	lo;
+
+	ContentKey() : hi(0), lo(0) { }
+	explicit ContentKey(uint64 hash64) : hi(0), lo(hash64) { }
+	ContentKey(uint64 _hi,uint64 _lo) : hi(_hi), lo(_lo) { }
+
+	bool operator == (const ContentKey & rhs) const { return hi == rhs.hi && lo == rhs.lo; }
+	bool operator != (const ContentKey & rhs) const { return ! (*this == rhs); }
+	bool operator < (const ContentKey & rhs) const { return hi < rhs.hi || ( hi == rhs.hi && lo < rhs.lo ); }
+};
+
+// StrongHash64 of the bytes
+ContentKey ContentKey_Hash64(const void * data,int size);
+// two independently seeded StrongHash64s
+ContentKey ContentKey_Hash128(const void * data,int size);
+// fold more inputs into a key ; a 64 bit key stays 64 bit
+ContentKey ContentKey_Combine(const ContentKey & key,const void * data,int size);
+
+//-------------------------------------------------------------------------------------------
+
+class ContentCache
+{
+public:
+	ContentCache();
+	~ContentCache();
+
+	// creates dir if needed and indexes the blobs already in it
+	bool Open(const char * dir,int64 budgetBytes);
+	void Close();
+
+	bool IsOpen() const { return ! m_dir.IsEmpty(); }
+
+	bool Has(const ContentKey & key);
+
+	// maps the blob read only ; false on a miss
+	bool Get(const ContentKey & key,MemoryMappedFile * pInto);
+
+	// size must be > 0 ; may evict
+	bool Put(const ContentKey & key,const void * data,int64 size);
+
+	bool Remove(const ContentKey & key);
+
+	// delete least recently used blobs until the total is under the budget
+	void Evict();
+
+	int64 GetTotalBytes() const { return m_totalBytes; }
+	int GetNumBlobs() const { return m_entries.size32(); }
+
+	String GetBlobPath(const ContentKey & key) const;
+
+private:
+	struct Entry
+	{
+		ContentKey	key;
+		int64		size;
+		int64		lastUse;
+	};
+
+	Entry * Find(const ContentKey & key);
+	Entry * Add(const ContentKey & key,int64 size);
+	void Touch(Entry * entry);
+	void Drop(Entry * entry);
+
+	String			m_dir;
+	int64			m_budgetBytes;
+	int64			m_totalBytes;
+	int64			m_useClock;
+	vector<Entry>	m_entries;	// sorted by key
+
+	FORBID_CLASS_STANDARDS(ContentCache);
+};
+
+END_CB
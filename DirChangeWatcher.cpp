@@ -1,16 +1,251 @@
+#include "DirChangeWatcher.h"
+#include "hash_table.h"
+#include "Hashes.h"
+#include "StrUtil.h"
+#include "Timer.h"
+#include "Mem.h"
+#include "Log.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <ctype.h>
+
+#ifdef _WIN32
 #include "inc.h"
 #include "Win32Util.h"
 #include "File.h"
 #include "vector.h"
 #include "conio.h"
-#include <stdlib.h>
 #include <direct.h>
-#include <stdio.h>
-#include <time.h>
-#include "DirChangeWatcher.h"
+#else
+#include "FileEnum.h"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#endif
 
 START_CB
 
+const int c_dirChangeDefaultCoalesceMillis = 100;
+
+const char * c_dirChangeActionStrings[] = 
+{
+	"null   ",
+	"add    ",
+	"remove ",
+	"modify ",
+	"oldname",
+	"newname",
+	"rescan "
+};
+
+bool DirChangePathsMatch(const char * path1,const char * path2)
+{
+	for(;;)
+	{
+		char c1 = *path1++;
+		char c2 = *path2++;
+		if ( c1 == '\\' ) c1 = '/';
+		if ( c2 == '\\' ) c2 = '/';
+		#ifdef _WIN32
+		c1 = (char) tolower(c1);
+		c2 = (char) tolower(c2);
+		#endif
+		if ( c1 != c2 )
+			return false;
+		if ( c1 == 0 )
+			return true;
+	}
+}
+
+//=====================================================================================================================================
+// path interning : every path is stored once , in chunks that never move
+
+typedef hash_table<intptr_t,int,hash_table_ops_intptr_t> t_dirChangeHash;
+
+class DirChangePathTable
+{
+public:
+	DirChangePathTable() : m_chunk(NULL), m_chunkUsed(0), m_chunkSize(0)
+	{
+		// id 0 is never handed out
+		m_paths.push_back(NULL);
+		m_lengths.push_back(0);
+	}
+	~DirChangePathTable()
+	{
+		for LOOPVEC(i,m_chunks)
+			CBFREE(m_chunks[i]);
+	}
+
+	uint32 Intern(const char * path,int len)
+	{
+		// 0 and 1 are the empty & deleted keys ; on a hash collision just probe the next key
+		intptr_t key = (intptr_t) StrongHash64((const uint8 *)path,len);
+		for(;;)
+		{
+			if ( key == 0 || key == 1 )
+				key += 2;
+
+			t_dirChangeHash::entry_ptrc ep = m_byHash.find(key);
+			if ( ! ep )
+				break;
+
+			int id = ep->data();
+			if ( m_lengths[id] == len && memcmp(m_paths[id],path,len) == 0 )
+				return (uint32) id;
+			key++;
+		}
+
+		char * copy = ArenaAlloc(len+1);
+		memcpy(copy,path,len);
+		copy[len] = 0;
+
+		int id = m_paths.size32();
+		m_paths.push_back(copy);
+		m_lengths.push_back(len);
+		m_byHash.insert(key,id);
+		return (uint32) id;
+	}
+
+	const char * GetPath(uint32 id) const { return m_paths[id]; }
+
+private:
+	char * ArenaAlloc(int size)
+	{
+		if ( m_chunkUsed + size > m_chunkSize )
+		{
+			m_chunkSize = MAX(size,64*1024);
+			m_chunk = (char *) CBALLOC(m_chunkSize);
+			m_chunks.push_back(m_chunk);
+			m_chunkUsed = 0;
+		}
+		char * ret = m_chunk + m_chunkUsed;
+		m_chunkUsed += size;
+		return ret;
+	}
+
+	vector<char *>			m_chunks;
+	char *					m_chunk;
+	int						m_chunkUsed;
+	int						m_chunkSize;
+	vector<const char *>	m_paths;	// [id]
+	vector<int>				m_lengths;	// [id]
+	t_dirChangeHash			m_byHash;	// hash -> id
+
+	FORBID_CLASS_STANDARDS(DirChangePathTable);
+};
+
+//=====================================================================================================================================
+// coalescing : the same action again on a path merges into that path's newest record ,
+//	and records are handed out once their path has been quiet for the coalesce time
+
+struct DirChangePending
+{
+	DirChangeRecord	rec;
+	uint64			lastMillis;
+};
+
+class DirChangeCoalescer
+{
+public:
+	DirChangeCoalescer() { }
+
+	void Add(const char * path,uint32 pathId,uint32 action)
+	{
+		const uint64 now = Timer::GetMillis64();
+
+		// pathIds start at 1 , so +1 keeps clear of the reserved keys
+		const intptr_t key = (intptr_t)pathId + 1;
+		t_dirChangeHash::entry_ptrc ep = m_latest.find(key);
+		if ( ep )
+		{
+			DirChangePending & latest = m_pending[ep->data()];
+			if ( latest.rec.action == action )
+			{
+				latest.lastMillis = now;
+				latest.rec.time = time(NULL);
+				return;
+			}
+			ep->change_data(m_pending.size32());
+		}
+		else
+		{
+			m_latest.insert(key,m_pending.size32());
+		}
+
+		m_pending.push_back();
+		DirChangePending & p = m_pending.back();
+		p.rec.path = path;
+		p.rec.pathId = pathId;
+		p.rec.action = action;
+		p.rec.time = time(NULL);
+		p.lastMillis = now;
+	}
+
+	// returns if any
+	bool Take(vector<DirChangeRecord> * pInto,int settleMillis)
+	{
+		if ( m_pending.empty() )
+			return false;
+
+		const uint64 now = Timer::GetMillis64();
+
+		int kept = 0;
+		bool any = false;
+		for LOOPVEC(i,m_pending)
+		{
+			if ( now - m_pending[i].lastMillis >= (uint64)settleMillis )
+			{
+				pInto->push_back(m_pending[i].rec);
+				any = true;
+			}
+			else
+			{
+				m_pending[kept++] = m_pending[i];
+			}
+		}
+
+		if ( any )
+		{
+			m_pending.resize(kept);
+
+			// later records overwrite earlier ones , so each path maps to its newest
+			m_latest.clear();
+			for LOOPVEC(i,m_pending)
+			{
+				const intptr_t key = (intptr_t)m_pending[i].rec.pathId + 1;
+				t_dirChangeHash::entry_ptrc ep = m_latest.find(key);
+				if ( ep )
+					ep->change_data(i);
+				else
+					m_latest.insert(key,i);
+			}
+		}
+
+		return any;
+	}
+
+	// returns if any
+	bool Clear()
+	{
+		if ( m_pending.empty() )
+			return false;
+		m_pending.clear();
+		m_latest.clear();
+		return true;
+	}
+
+private:
+	vector<DirChangePending>	m_pending;
+	t_dirChangeHash				m_latest;	// pathId+1 -> index in m_pending
+
+	FORBID_CLASS_STANDARDS(DirChangeCoalescer);
+};
+
+#ifdef _WIN32
+
 /*
 
 FILE_NOTIFY_CHANGE_FILE_NAME Any file name change in the watched directory or subtree causes a change notification wait operation to return. Changes include renaming, creating, or deleting a file. 
@@ -53,24 +288,6 @@ struct DirInfo
 	CHAR        lpBuffer[MAX_BUFFER];
 };
 
-/*
-#define FILE_ACTION_ADDED                   0x00000001   
-#define FILE_ACTION_REMOVED                 0x00000002   
-#define FILE_ACTION_MODIFIED                0x00000003   
-#define FILE_ACTION_RENAMED_OLD_NAME        0x00000004   
-#define FILE_ACTION_RENAMED_NEW_NAME        0x00000005   
-*/
-
-const char * c_dirChangeActionStrings[] = 
-{
-	"null   ",
-	"add    ",
-	"remove ",
-	"modify ",
-	"oldname",
-	"newname"
-};
-
 /*
 FILE_ACTION_ADDED The file was added to the directory. 
 FILE_ACTION_REMOVED The file was removed from the directory. 
@@ -90,7 +307,8 @@ public:
 		m_threadKillRequested(false),
 		m_hCompPort(0),
 		m_hThread(0),
-		m_notifyFlags(0)
+		m_notifyFlags(0),
+		m_coalesceMillis(c_dirChangeDefaultCoalesceMillis)
 	{
 	}
 	~DirChangeWatcherImpl()
@@ -105,6 +323,7 @@ public:
 
 	bool GetDirChanges(cb::vector<DirChangeRecord> * pInto );
 	bool GetDirChangesDiscard();
+	void SetCoalesceMillis(int millis);
 
 	bool StartWatchingDirs(const char ** dirsToWatch,const int numDirs,DWORD notifyFlags);
 	void Stop();
@@ -119,7 +338,9 @@ private:
     HANDLE					m_hCompPort;
     HANDLE					m_hThread;
 	CriticalSection			m_pendingCS;
-	vector<DirChangeRecord>	m_pending;
+	DirChangePathTable		m_paths;
+	DirChangeCoalescer		m_pending;
+	int						m_coalesceMillis;
 	bool m_threadKillRequested;
 	
 	FORBID_CLASS_STANDARDS(DirChangeWatcherImpl);
@@ -129,10 +350,8 @@ private:
 
 void DirChangeWatcherImpl::AddCommand(const char * path, DWORD action)
 {
-	m_pending.push_back();
-	cb::strncpy(m_pending.back().path,path,sizeof(m_pending.back().path));
-	m_pending.back().action = action;
-	m_pending.back().time = time(NULL);
+	uint32 id = m_paths.Intern(path,strlen32(path));
+	m_pending.Add(m_paths.GetPath(id),id,action);
 }
 
 /**********************************************************************
@@ -185,50 +404,22 @@ void DirChangeWatcherImpl::CheckChangedFile( DirInfo *lpdi, PFILE_NOTIFY_INFORMA
 bool DirChangeWatcherImpl::GetDirChanges(cb::vector<DirChangeRecord> * pInto )
 {
 	UseCriticalSection usecs(m_pendingCS);
-	
-	if ( m_pending.empty() )
-	{
-		return false;
-	}
-
-	/*
-	File myLog;
-	
-	if ( myLog.Open(g_myLogPath,"ab") )
-	{	
-		for(int i=0;i<g_pending.size();i++)
-		{
-			// asctime puts a \n on it
-			char * timestr = asctime( localtime( &m_pending[i].time ) );
-			fprintf(myLog.Get(),"%s : %s : %s",
-				c_dirChangeActionStrings[ m_pending[i].action ],
-				m_pending[i].path,
-				timestr);
-		}
-	
-		myLog.Close();
-	}
-	*/
-
-	pInto->appendv(m_pending);
 
-	m_pending.clear();	
-
-	return true;
+	return m_pending.Take(pInto,m_coalesceMillis);
 }
 
 bool DirChangeWatcherImpl::GetDirChangesDiscard()
 {
 	UseCriticalSection usecs(m_pendingCS);
-	
-	if ( m_pending.empty() )
-	{
-		return false;
-	}
 
-	m_pending.clear();	
+	return m_pending.Clear();
+}
 
-	return true;
+void DirChangeWatcherImpl::SetCoalesceMillis(int millis)
+{
+	UseCriticalSection usecs(m_pendingCS);
+
+	m_coalesceMillis = MAX(millis,0);
 }
 
 /**********************************************************************
@@ -323,9 +514,21 @@ bool DirChangeWatcherImpl::GetDirChangesDiscard()
 				//ZLOGLASTERROR("ReadDirectoryChangesW failed!");
             }
         }
-        else
+        else if ( di )
         {
-			// @@ ? maybe an error, not a completion
+			// 0 bytes means our buffer overflowed and the changes were thrown away
+			{
+				UseCriticalSection usecs(watcher->m_pendingCS);
+				watcher->AddCommand(di->lpszDirName,DIR_CHANGE_ACTION_OVERFLOW);
+			}
+
+            ReadDirectoryChangesW( di->hDir,di->lpBuffer,
+                                   MAX_BUFFER,
+                                   TRUE,
+                                   watcher->m_notifyFlags,
+                                   &di->dwBufLength,
+                                   &di->Overlapped,
+                                   NULL);
         }
 	}
 
@@ -369,9 +572,6 @@ void DirChangeWatcherImpl::Stop()
 
 bool DirChangeWatcherImpl::StartWatchingDirs(const char ** dirsToWatch,const int numDirs,DWORD notifyFlags)
 {
-	// this is just an optimization (theoretically)
-	m_pending.reserve(256);
-	
 	// I use &back() in the loop so make sure the vector never relocates :
 	m_dirs.reserve(numDirs);
 
@@ -464,6 +664,324 @@ bool DirChangeWatcherImpl::StartWatchingDirs(const char ** dirsToWatch,const int
 	return true;
 }
 
+#else // _WIN32
+
+//=====================================================================================================================================
+// inotify
+
+// IN_CLOSE_WRITE and IN_MODIFY both come out as modify , and merge
+const uint32 c_dirChangeDefaultNotifyFlags =
+	IN_CREATE|
+	IN_DELETE|
+	IN_MODIFY|
+	IN_CLOSE_WRITE|
+	IN_MOVED_FROM|
+	IN_MOVED_TO|
+//	IN_ATTRIB|
+//	IN_ACCESS|
+	0;
+
+// we need these to keep the watches in step with the tree , whatever the caller asked for :
+#define DIRCHANGE_TREE_FLAGS	(IN_CREATE|IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_ONLYDIR)
+
+class DirChangeWatcherImpl : public DirChangeWatcher
+{
+public:
+
+	DirChangeWatcherImpl() :
+		m_fd(-1),
+		m_notifyFlags(0),
+		m_coalesceMillis(c_dirChangeDefaultCoalesceMillis)
+	{
+		pthread_mutex_init(&m_lock,NULL);
+	}
+	~DirChangeWatcherImpl()
+	{
+		Stop();
+		pthread_mutex_destroy(&m_lock);
+	}
+
+	bool GetDirChanges(cb::vector<DirChangeRecord> * pInto );
+	bool GetDirChangesDiscard();
+	void SetCoalesceMillis(int millis);
+
+	bool StartWatchingDirs(const char ** dirsToWatch,const int numDirs,uint32 notifyFlags);
+	void Stop();
+
+private:
+
+	void ReadEvents();
+	void HandleEvent(const struct inotify_event * ev);
+	void AddRecord(const char * path,uint32 action);
+	bool AddWatch(const char * dir);
+	bool AddWatchTree(const char * dir,bool reportContents);
+	void RemoveWatchesUnder(const char * dir);
+
+	int						m_fd;
+	uint32					m_notifyFlags;
+	vector<String>			m_roots;
+	vector<String>			m_watchPaths;	// [wd] -> dir ; empty if wd isn't ours (any more)
+	pthread_mutex_t			m_lock;
+	DirChangePathTable		m_paths;
+	DirChangeCoalescer		m_pending;
+	int						m_coalesceMillis;
+
+	FORBID_CLASS_STANDARDS(DirChangeWatcherImpl);
+};
+
+//---------------------------------------------------------------
+
+void DirChangeWatcherImpl::AddRecord(const char * path,uint32 action)
+{
+	uint32 id = m_paths.Intern(path,strlen32(path));
+	m_pending.Add(m_paths.GetPath(id),id,action);
+}
+
+bool DirChangeWatcherImpl::AddWatch(const char * dir)
+{
+	int wd = inotify_add_watch(m_fd,dir,m_notifyFlags|DIRCHANGE_TREE_FLAGS);
+	if ( wd < 0 )
+	{
+		if ( errno == ENOSPC )
+			lprintf("DirChangeWatcher : out of inotify watches (fs.inotify.max_user_watches) at %s\n",dir);
+		return false;
+	}
+
+	if ( wd >= m_watchPaths.size32() )
+		m_watchPaths.resize(wd+1);
+	// an inode we already watch gives back its old wd ; this updates the path after a move
+	m_watchPaths[wd] = dir;
+	return true;
+}
+
+// watch dir and every dir under it ; reportContents for a dir that just appeared ,
+//	whatever got into it before the watch was on would be missed otherwise
+bool DirChangeWatcherImpl::AddWatchTree(const char * dir,bool reportContents)
+{
+	if ( ! AddWatch(dir) )
+		return false;
+
+	FileEnumOptions options;
+	options.recurse = true;
+	options.wantDirs = true;
+	if ( reportContents )
+		options.numThreads = 1;
+
+	FileEnumTable table;
+	EnumFilesFast(dir,&table,options);
+
+	for LOOP(i,table.size32())
+	{
+		if ( table[i].isDir )
+			AddWatch(table.GetPath(i));
+		if ( reportContents )
+			AddRecord(table.GetPath(i),FILE_ACTION_ADDED);
+	}
+	return true;
+}
+
+// a dir moved away ; its watches would report stale paths
+//	if it moved somewhere we watch , the MOVED_TO puts them back with the new paths
+void DirChangeWatcherImpl::RemoveWatchesUnder(const char * dir)
+{
+	const int len = strlen32(dir);
+	for LOOPVEC(wd,m_watchPaths)
+	{
+		const String & path = m_watchPaths[wd];
+		if ( path.Length() < len || memcmp(path.CStr(),dir,len) != 0 )
+			continue;
+		if ( path.Length() > len && path.CStr()[len] != '/' )
+			continue;
+
+		inotify_rm_watch(m_fd,wd);
+		m_watchPaths[wd] = String();
+	}
+}
+
+void DirChangeWatcherImpl::HandleEvent(const struct inotify_event * ev)
+{
+	if ( ev->mask & IN_Q_OVERFLOW )
+	{
+		for LOOPVEC(i,m_roots)
+			AddRecord(m_roots[i].CStr(),DIR_CHANGE_ACTION_OVERFLOW);
+		return;
+	}
+
+	if ( ev->wd < 0 || ev->wd >= m_watchPaths.size32() || m_watchPaths[ev->wd].Length() == 0 )
+		return;
+
+	if ( ev->mask & IN_IGNORED )
+	{
+		// the watch is gone (dir deleted , or we removed it)
+		m_watchPaths[ev->wd] = String();
+		return;
+	}
+
+	// copy ; AddWatch can resize m_watchPaths
+	String dir = m_watchPaths[ev->wd];
+
+	if ( ev->len == 0 )
+	{
+		// about the watched dir itself ; the parent's watch reports it , unless it's a root
+		if ( ev->mask & IN_DELETE_SELF )
+		{
+			for LOOPVEC(i,m_roots)
+			{
+				if ( m_roots[i] == dir )
+					AddRecord(dir.CStr(),FILE_ACTION_REMOVED);
+			}
+		}
+		return;
+	}
+
+	String path(dir);
+	if ( path.CStr()[path.Length()-1] != '/' )
+		path += '/';
+	path += ev->name;
+
+	const bool isDir = ( ev->mask & IN_ISDIR ) != 0;
+	const uint32 asked = ev->mask & m_notifyFlags;
+
+	if ( ev->mask & IN_CREATE )
+	{
+		if ( asked )
+			AddRecord(path.CStr(),FILE_ACTION_ADDED);
+		if ( isDir )
+			AddWatchTree(path.CStr(),true);
+	}
+	else if ( ev->mask & IN_MOVED_FROM )
+	{
+		if ( isDir )
+			RemoveWatchesUnder(path.CStr());
+		if ( asked )
+			AddRecord(path.CStr(),FILE_ACTION_RENAMED_OLD_NAME);
+	}
+	else if ( ev->mask & IN_MOVED_TO )
+	{
+		if ( isDir )
+			AddWatchTree(path.CStr(),false);
+		if ( asked )
+			AddRecord(path.CStr(),FILE_ACTION_RENAMED_NEW_NAME);
+	}
+	else if ( ev->mask & IN_DELETE )
+	{
+		if ( asked )
+			AddRecord(path.CStr(),FILE_ACTION_REMOVED);
+	}
+	else if ( asked )
+	{
+		// IN_MODIFY , IN_CLOSE_WRITE , IN_ATTRIB , ...
+		AddRecord(path.CStr(),FILE_ACTION_MODIFIED);
+	}
+}
+
+// everything the kernel has queued ; the fd is non-blocking
+void DirChangeWatcherImpl::ReadEvents()
+{
+	if ( m_fd < 0 )
+		return;
+
+	// big enough for a lot of events per read ; aligned for inotify_event
+	uint64 buffer[64*1024/sizeof(uint64)];
+
+	for(;;)
+	{
+		ssize_t got = read(m_fd,buffer,sizeof(buffer));
+		if ( got < 0 && errno == EINTR )
+			continue;
+		if ( got <= 0 )
+			break;
+
+		const char * ptr = (const char *)buffer;
+		const char * end = ptr + got;
+		while ( ptr < end )
+		{
+			const struct inotify_event * ev = (const struct inotify_event *)ptr;
+			HandleEvent(ev);
+			ptr += sizeof(struct inotify_event) + ev->len;
+		}
+	}
+}
+
+bool DirChangeWatcherImpl::GetDirChanges(cb::vector<DirChangeRecord> * pInto )
+{
+	pthread_mutex_lock(&m_lock);
+	ReadEvents();
+	bool any = m_pending.Take(pInto,m_coalesceMillis);
+	pthread_mutex_unlock(&m_lock);
+	return any;
+}
+
+bool DirChangeWatcherImpl::GetDirChangesDiscard()
+{
+	pthread_mutex_lock(&m_lock);
+	ReadEvents();
+	bool any = m_pending.Clear();
+	pthread_mutex_unlock(&m_lock);
+	return any;
+}
+
+void DirChangeWatcherImpl::SetCoalesceMillis(int millis)
+{
+	pthread_mutex_lock(&m_lock);
+	m_coalesceMillis = MAX(millis,0);
+	pthread_mutex_unlock(&m_lock);
+}
+
+void DirChangeWatcherImpl::Stop()
+{
+	pthread_mutex_lock(&m_lock);
+	if ( m_fd >= 0 )
+	{
+		// closing drops every watch
+		close(m_fd);
+		m_fd = -1;
+	}
+	m_watchPaths.clear();
+	m_roots.clear();
+	pthread_mutex_unlock(&m_lock);
+}
+
+bool DirChangeWatcherImpl::StartWatchingDirs(const char ** dirsToWatch,const int numDirs,uint32 notifyFlags)
+{
+	m_fd = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+	if ( m_fd < 0 )
+	{
+		lprintf("inotify_init1 failed\n");
+		return false;
+	}
+
+	m_notifyFlags = notifyFlags;
+
+	for (int i=0;i<numDirs;i++)
+	{
+		String dir(dirsToWatch[i]);
+		// no trailing slash , so the paths we build match what EnumFilesFast makes
+		while ( dir.Length() > 1 && dir.CStr()[dir.Length()-1] == '/' )
+			dir.Truncate(dir.Length()-1);
+
+		if ( ! AddWatchTree(dir.CStr(),false) )
+		{
+			lprintf("inotify_add_watch failed on : %s\n",dirsToWatch[i]);
+			continue;
+		}
+
+		m_roots.push_back(dir);
+	}
+
+	if ( m_roots.empty() )
+	{
+		lprintf("StartWatchingDirs : no valid dirs\n");
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+#endif // _WIN32
+
 //=========================================================================================================
 // public exposure :
 
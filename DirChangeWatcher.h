@@ -1,32 +1,62 @@
 #pragma once
 
 #include "Base.h"
-#include "Sptr.h"
+#include "SPtr.h"
 #include "vector.h"
 #include "String.h"
+#include <time.h>
 
 START_CB
 
+/**
 
-/*
-#define FILE_ACTION_ADDED                   0x00000001   
-#define FILE_ACTION_REMOVED                 0x00000002   
-#define FILE_ACTION_MODIFIED                0x00000003   
-#define FILE_ACTION_RENAMED_OLD_NAME        0x00000004   
-#define FILE_ACTION_RENAMED_NEW_NAME        0x00000005   
-*/
+DirChangeWatcher : tells you when files under some dirs change
+
+Windows : ReadDirectoryChangesW on a completion port thread
+Linux : inotify , one watch per directory ; new subdirectories get watches as they appear
+	(and whatever was created in them before the watch went on is reported as added)
+	there's no thread ; GetDirChanges reads what the kernel has queued
+
+GetDirChanges never blocks ; it returns the batch of changes that have settled
+	repeats of the same action on the same path are merged into one record , and a record
+	is held until its path has been quiet for the coalesce time , so a save that's written
+	in pieces shows up once , after it's done
+	(a different action on the path starts a new record , so the order of what happened is kept)
+
+if the OS drops events (its buffer overflowed) you get a DIR_CHANGE_ACTION_OVERFLOW record
+	for the watched dir ; anything under it may have changed , so rescan
+
+**/
+
+#ifndef _WIN32
+// the Win32 action codes , so records mean the same thing everywhere :
+#define FILE_ACTION_ADDED                   0x00000001
+#define FILE_ACTION_REMOVED                 0x00000002
+#define FILE_ACTION_MODIFIED                0x00000003
+#define FILE_ACTION_RENAMED_OLD_NAME        0x00000004
+#define FILE_ACTION_RENAMED_NEW_NAME        0x00000005
+#endif
+
+#define DIR_CHANGE_ACTION_OVERFLOW			0x00000006
 
 struct DirChangeRecord
 {
-	// Command is added from the thread
-	char	path[_MAX_PATH];
-	uint32	action;
-	time_t	time;
+	// path is interned by the watcher : the same path always has the same pathId and pointer ,
+	//	and they stay valid for as long as the watcher does
+	const char *	path;
+	uint32			pathId;
+	uint32			action;
+	time_t			time;
 };
 
+// notify flags are FILE_NOTIFY_CHANGE_* on Windows , the inotify IN_* mask on Linux
 extern const uint32 c_dirChangeDefaultNotifyFlags;
+extern const int c_dirChangeDefaultCoalesceMillis;
 extern const char * c_dirChangeActionStrings[];
 
+// compare paths like the file system does : either slash , and no case on Windows
+bool DirChangePathsMatch(const char * path1,const char * path2);
+
 //-----------------------------------------------------
 
 SPtrFwd(DirChangeWatcher);
@@ -36,15 +66,18 @@ class DirChangeWatcher : public RefCounted
 public:
 	virtual ~DirChangeWatcher() { }
 
-	//returns if any
+	//returns if any ; never blocks
 	virtual bool GetDirChanges(cb::vector<DirChangeRecord> * pInto ) = 0;
 
-	// same as above but just discards the records
+	// same as above but just discards the records (settled or not)
 	virtual bool GetDirChangesDiscard() = 0;
-	
+
+	// 0 gives you every change as soon as it's seen (repeats are still merged)
+	virtual void SetCoalesceMillis(int millis) = 0;
+
 	// stop watching dirs
 	virtual void Stop() = 0;
-	
+
 protected:
 	DirChangeWatcher() { }
 };
@@ -0,0 +1,1480 @@
+#include "FastPrintf.h"
+#include "Threading.h"
+#include "Mem.h"
+#include "Log.h"
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+/**
+
+FastPrintf notes :
+
+the float path is Steele & White / Burger & Dybvig with a small fixed bignum
+	fixed-precision mode (%f,%e,%g) rounds half-to-even on the exact binary value, same as the CRT
+	free-format mode gives the shortest round trip digits
+
+the bignums are normally 2-3 words for values you'd put in a log, so this is cheap ;
+	huge exponents just mean more words, never a different answer
+
+**/
+
+START_CB
+
+//=======================================================================
+
+static const char c_digitPairs[201] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const uint32 c_pow10_32[10] =
+{
+	1,10,100,1000,10000,100000,1000000,10000000,100000000,1000000000
+};
+
+// precision cap for the exact float path ; more than this goes to the CRT
+static const int c_maxFloatPrec = 700;
+static const int c_maxFloatDigits = 780;
+
+//=======================================================================
+// output : counts everything, stores what fits
+
+struct FastPrintfOut
+{
+	char *	buf;
+	int		cap; // bufSize-1 , room for the null
+	int		len;
+
+	void Put(char c)
+	{
+		if ( len < cap ) buf[len] = c;
+		len++;
+	}
+
+	void Put(const char * s,int n)
+	{
+		if ( n <= 0 ) return;
+		int room = cap - len;
+		if ( room > 0 )
+			memcpy(buf+len,s, n < room ? n : room );
+		len += n;
+	}
+
+	void Fill(char c,int n)
+	{
+		if ( n <= 0 ) return;
+		int room = cap - len;
+		if ( room > 0 )
+			memset(buf+len,c, n < room ? n : room );
+		len += n;
+	}
+};
+
+enum EFastPrintfSize
+{
+	eFPSize_Default,
+	eFPSize_Char,		// hh
+	eFPSize_Short,		// h
+	eFPSize_Long,		// l
+	eFPSize_64,			// ll , I64 , j , q
+	eFPSize_Ptr,		// z , t , I
+	eFPSize_32,			// I32
+	eFPSize_LongDouble,	// L
+	eFPSize_Wide		// w
+};
+
+struct FastPrintfSpec
+{
+	bool	left,plus,space,alt,zero;
+	int		width;
+	int		prec;	// -1 = not given
+	EFastPrintfSize	size;
+	const char *	sizeText;
+	int		sizeTextLen;
+	char	conv;
+};
+
+static void EmitPadded(FastPrintfOut & out,const FastPrintfSpec & spec,
+						const char * prefix,int prefixLen,int numZeros,const char * body,int bodyLen)
+{
+	int total = prefixLen + numZeros + bodyLen;
+	int pad = spec.width > total ? spec.width - total : 0;
+	if ( spec.zero && ! spec.left )
+	{
+		numZeros += pad;
+		pad = 0;
+	}
+	if ( ! spec.left ) out.Fill(' ',pad);
+	out.Put(prefix,prefixLen);
+	out.Fill('0',numZeros);
+	out.Put(body,bodyLen);
+	if ( spec.left ) out.Fill(' ',pad);
+}
+
+//=======================================================================
+// integers
+
+// writes backwards ending at "end" ; returns the start
+static char * FormatDecimal(char * end,uint64 v)
+{
+	char * p = end;
+	while ( v > 0xFFFFFFFFULL )
+	{
+		uint32 r = (uint32)(v % 100);
+		v /= 100;
+		p -= 2;
+		memcpy(p,c_digitPairs + r*2,2);
+	}
+	uint32 v32 = (uint32)v;
+	while ( v32 >= 100 )
+	{
+		uint32 r = v32 % 100;
+		v32 /= 100;
+		p -= 2;
+		memcpy(p,c_digitPairs + r*2,2);
+	}
+	if ( v32 >= 10 )
+	{
+		p -= 2;
+		memcpy(p,c_digitPairs + v32*2,2);
+	}
+	else
+	{
+		*--p = (char)('0' + v32);
+	}
+	return p;
+}
+
+static void EmitInteger(FastPrintfOut & out,const FastPrintfSpec & specIn,uint64 mag,bool neg)
+{
+	FastPrintfSpec spec = specIn;
+	char tmp[32];
+	char * end = tmp + sizeof(tmp);
+	char * p;
+
+	switch(spec.conv)
+	{
+	case 'x':
+	case 'X':
+	{
+		const char * hex = ( spec.conv == 'x' ) ? "0123456789abcdef" : "0123456789ABCDEF";
+		p = end;
+		do { *--p = hex[mag&15]; mag >>= 4; } while(mag);
+		break;
+	}
+	case 'o':
+		p = end;
+		do { *--p = (char)('0' + (mag&7)); mag >>= 3; } while(mag);
+		break;
+	default:
+		p = FormatDecimal(end,mag);
+		break;
+	}
+
+	int digitsLen = (int)(end - p);
+	bool isZero = ( digitsLen == 1 && *p == '0' );
+	if ( spec.prec == 0 && isZero )
+		digitsLen = 0;
+
+	char prefix[2];
+	int prefixLen = 0;
+	if ( spec.conv == 'd' || spec.conv == 'i' )
+	{
+		if ( neg ) prefix[prefixLen++] = '-';
+		else if ( spec.plus ) prefix[prefixLen++] = '+';
+		else if ( spec.space ) prefix[prefixLen++] = ' ';
+	}
+	else if ( spec.alt && ( spec.conv == 'x' || spec.conv == 'X' ) && ! isZero )
+	{
+		prefix[prefixLen++] = '0';
+		prefix[prefixLen++] = spec.conv;
+	}
+
+	int numZeros = 0;
+	if ( spec.prec >= 0 )
+	{
+		// precision turns off the 0 flag
+		spec.zero = false;
+		if ( spec.prec > digitsLen )
+			numZeros = spec.prec - digitsLen;
+	}
+	if ( spec.conv == 'o' && spec.alt && numZeros == 0 && ( digitsLen == 0 || *p != '0' ) )
+		numZeros = 1;
+
+	EmitPadded(out,spec,prefix,prefixLen,numZeros,end-digitsLen,digitsLen);
+}
+
+//=======================================================================
+// bignum for the float path
+//	just enough ops for digit generation ; words are little endian
+
+struct FastPrintfBig
+{
+	enum { c_maxWords = 40 }; // 1280 bits ; worst case is denormals scaled by 10^324
+
+	int		n;
+	uint32	w[c_maxWords];
+
+	void Set(uint64 v)
+	{
+		w[0] = (uint32)v;
+		w[1] = (uint32)(v>>32);
+		n = w[1] ? 2 : ( w[0] ? 1 : 0 );
+	}
+
+	void MulSmall(uint32 m)
+	{
+		uint64 carry = 0;
+		for(int i=0;i<n;i++)
+		{
+			uint64 t = (uint64)w[i] * m + carry;
+			w[i] = (uint32)t;
+			carry = t>>32;
+		}
+		if ( carry )
+		{
+			ASSERT( n < c_maxWords );
+			w[n++] = (uint32)carry;
+		}
+	}
+
+	void MulPow10(int p)
+	{
+		while ( p >= 9 )
+		{
+			MulSmall(c_pow10_32[9]);
+			p -= 9;
+		}
+		if ( p > 0 )
+			MulSmall(c_pow10_32[p]);
+	}
+
+	void ShiftLeft(int bits)
+	{
+		if ( n == 0 ) return;
+		int words = bits>>5;
+		bits &= 31;
+		ASSERT( n + words + 1 <= c_maxWords );
+		if ( bits )
+		{
+			w[n] = 0;
+			for(int i=n;i>0;i--)
+				w[i] = (w[i]<<bits) | (w[i-1]>>(32-bits));
+			w[0] <<= bits;
+			n++;
+			if ( w[n-1] == 0 ) n--;
+		}
+		if ( words )
+		{
+			for(int i=n-1;i>=0;i--)
+				w[i+words] = w[i];
+			for(int i=0;i<words;i++)
+				w[i] = 0;
+			n += words;
+		}
+	}
+
+	void Add(const FastPrintfBig & b)
+	{
+		int m = MAX(n,b.n);
+		uint64 carry = 0;
+		for(int i=0;i<m;i++)
+		{
+			uint64 t = carry + ( i < n ? w[i] : 0 ) + ( i < b.n ? b.w[i] : 0 );
+			w[i] = (uint32)t;
+			carry = t>>32;
+		}
+		n = m;
+		if ( carry )
+		{
+			ASSERT( n < c_maxWords );
+			w[n++] = (uint32)carry;
+		}
+	}
+
+	// requires *this >= b
+	void Sub(const FastPrintfBig & b)
+	{
+		int64 borrow = 0;
+		for(int i=0;i<n;i++)
+		{
+			int64 t = (int64)w[i] - ( i < b.n ? b.w[i] : 0 ) - borrow;
+			borrow = ( t < 0 ) ? 1 : 0;
+			w[i] = (uint32)t;
+		}
+		while ( n > 0 && w[n-1] == 0 )
+			n--;
+	}
+
+	static int Compare(const FastPrintfBig & a,const FastPrintfBig & b)
+	{
+		if ( a.n != b.n ) return ( a.n < b.n ) ? -1 : 1;
+		for(int i=a.n-1;i>=0;i--)
+		{
+			if ( a.w[i] != b.w[i] ) return ( a.w[i] < b.w[i] ) ? -1 : 1;
+		}
+		return 0;
+	}
+
+	// r -= d*s , returns d ; only used when r < 10*s
+	int DivDigit(const FastPrintfBig & s)
+	{
+		int d = 0;
+		while ( Compare(*this,s) >= 0 )
+		{
+			Sub(s);
+			d++;
+		}
+		return d;
+	}
+};
+
+static int BitLength(uint64 v)
+{
+	int n = 0;
+	while ( v ) { n++; v >>= 1; }
+	return n;
+}
+
+// k such that 10^(k-1) <= v < 10^k , possibly one too low
+static int EstimateK(uint64 f,int e)
+{
+	int l = BitLength(f) + e;
+	return (int)floor( (l-1) * 0.30102999566398114 ) + 1;
+}
+
+// ScaledRound : round-half-even of f * 2^e * 10^p10 , 0 <= p10 <= 19
+//	exact 128 bit math ; returns false if the answer doesn't fit in 64 bits
+//	*pTrunc gets the value before rounding
+static bool ScaledRound(uint64 f,int e,int p10,uint64 * pRounded,uint64 * pTrunc)
+{
+	// 128 bit product f * 10^p10 :
+	uint64 m = 1;
+	for(int i=0;i<p10;i++) m *= 10;
+	uint64 aLo = f & 0xFFFFFFFF, aHi = f >> 32;
+	uint64 bLo = m & 0xFFFFFFFF, bHi = m >> 32;
+	uint64 ll = aLo*bLo, lh = aLo*bHi, hl = aHi*bLo, hh = aHi*bHi;
+	uint64 mid = (ll>>32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+	uint64 lo = (ll & 0xFFFFFFFF) | (mid<<32);
+	uint64 hi = hh + (lh>>32) + (hl>>32) + (mid>>32);
+
+	if ( e >= 0 )
+	{
+		if ( hi != 0 || e >= 64 || ( e > 0 && (lo >> (64-e)) != 0 ) )
+			return false;
+		*pRounded = *pTrunc = lo << e;
+		return true;
+	}
+
+	int sh = -e;
+	if ( sh >= 128 )
+	{
+		// f*10^p10 < 2^117 , so this is under one half
+		*pRounded = *pTrunc = 0;
+		return true;
+	}
+
+	uint64 q, remHi, remLo, halfHi, halfLo;
+	if ( sh == 64 )
+	{
+		q = hi;
+		remHi = 0; remLo = lo;
+		halfHi = 0; halfLo = 1ULL<<63;
+	}
+	else if ( sh > 64 )
+	{
+		q = hi >> (sh-64);
+		remHi = hi & ((1ULL<<(sh-64))-1); remLo = lo;
+		halfHi = 1ULL<<(sh-65); halfLo = 0;
+	}
+	else
+	{
+		if ( (hi >> sh) != 0 )
+			return false;
+		q = ( lo >> sh ) | ( sh ? ( hi << (64-sh) ) : 0 );
+		remHi = 0;
+		remLo = sh ? ( lo & ((1ULL<<sh)-1) ) : 0;
+		halfHi = 0;
+		halfLo = sh ? ( 1ULL<<(sh-1) ) : 0;
+	}
+
+	*pTrunc = q;
+	bool up = false;
+	if ( sh > 0 )
+	{
+		if ( remHi != halfHi ) up = remHi > halfHi;
+		else if ( remLo != halfLo ) up = remLo > halfLo;
+		else up = ( q & 1 ) != 0;
+	}
+	if ( up )
+	{
+		if ( q == ~0ULL ) return false;
+		q++;
+	}
+	*pRounded = q;
+	return true;
+}
+
+static int DigitsFromU64(char * digits,uint64 v)
+{
+	char tmp[24];
+	char * end = tmp + sizeof(tmp);
+	char * p = FormatDecimal(end,v);
+	int n = (int)(end - p);
+	memcpy(digits,p,n);
+	return n;
+}
+
+// DigitsFixedFast : the common case (modest exponent, prec <= 18) without bignums
+//	returns -1 to mean "use the slow path"
+static int DigitsFixedFast(uint64 f,int e,bool modeF,int prec,char * digits,int * pK)
+{
+	if ( prec > 18 )
+		return -1;
+
+	uint64 rounded,trunc;
+	if ( modeF )
+	{
+		if ( ! ScaledRound(f,e,prec,&rounded,&trunc) )
+			return -1;
+		if ( rounded == 0 )
+		{
+			*pK = 0;
+			return 0;
+		}
+		int n = DigitsFromU64(digits,rounded);
+		*pK = n - prec;
+		return n;
+	}
+
+	int P = prec+1;
+	uint64 pow10P = 1;
+	for(int i=0;i<P;i++) pow10P *= 10;
+
+	int k = EstimateK(f,e);
+	int p10 = P - k;
+	if ( p10 < 0 || p10 > 19 )
+		return -1;
+	if ( ! ScaledRound(f,e,p10,&rounded,&trunc) )
+		return -1;
+	if ( trunc >= pow10P )
+	{
+		// estimate was one low
+		k++;
+		p10--;
+		if ( p10 < 0 || ! ScaledRound(f,e,p10,&rounded,&trunc) )
+			return -1;
+	}
+	if ( rounded >= pow10P )
+	{
+		// 999 -> 1000
+		rounded = pow10P/10;
+		k++;
+	}
+	*pK = k;
+	return DigitsFromU64(digits,rounded);
+}
+
+// DigitsFixed : v = f * 2^e > 0
+//	modeF : digits down to the 10^-prec place ; else prec+1 significant digits
+//	v ~= 0.d0d1d2.. * 10^k
+// returns the digit count, or -1 if it's too long for us
+static int DigitsFixed(uint64 f,int e,bool modeF,int prec,char * digits,int * pK)
+{
+	int fast = DigitsFixedFast(f,e,modeF,prec,digits,pK);
+	if ( fast >= 0 )
+		return fast;
+
+	FastPrintfBig r,s;
+	r.Set(f);
+	s.Set(1);
+	if ( e >= 0 ) r.ShiftLeft(e);
+	else s.ShiftLeft(-e);
+
+	int k = EstimateK(f,e);
+	if ( k >= 0 ) s.MulPow10(k);
+	else r.MulPow10(-k);
+	if ( FastPrintfBig::Compare(r,s) >= 0 )
+	{
+		k++;
+		s.MulSmall(10);
+	}
+
+	int n = modeF ? k + prec : prec + 1;
+	if ( n > c_maxFloatDigits )
+		return -1;
+
+	*pK = k;
+	if ( n < 0 )
+		return 0; // less than half of the last place
+
+	for(int i=0;i<n;i++)
+	{
+		r.MulSmall(10);
+		digits[i] = (char)('0' + r.DivDigit(s));
+	}
+
+	// round on what's left : 2r vs s , ties to even
+	r.ShiftLeft(1);
+	int c = FastPrintfBig::Compare(r,s);
+	bool lastOdd = ( n > 0 ) && ( (digits[n-1]-'0') & 1 );
+	if ( c > 0 || ( c == 0 && lastOdd ) )
+	{
+		int i = n-1;
+		while ( i >= 0 && digits[i] == '9' )
+		{
+			digits[i] = '0';
+			i--;
+		}
+		if ( i >= 0 )
+		{
+			digits[i]++;
+		}
+		else
+		{
+			// 999 -> 1000 , or nothing -> one in the last place
+			digits[0] = '1';
+			for(int j=1;j<=n;j++)
+				digits[j] = '0';
+			*pK = k+1;
+			// in F mode the new leading place is one more digit before the cutoff
+			if ( modeF || n == 0 )
+				n++;
+		}
+	}
+	return n;
+}
+
+// DigitsShortest : Burger & Dybvig free format
+//	hiddenBit/minE describe the float type so the lower gap comes out right
+static int DigitsShortest(uint64 f,int e,uint64 hiddenBit,int minE,char * digits,int * pK)
+{
+	FastPrintfBig r,s,mp,mm,t;
+	bool even = ( f & 1 ) == 0;
+	bool unequal = ( f == hiddenBit && e > minE ); // the gap below is half the gap above
+
+	if ( e >= 0 )
+	{
+		r.Set(f); r.ShiftLeft(e + (unequal ? 2 : 1));
+		s.Set(unequal ? 4 : 2);
+		mp.Set(1); mp.ShiftLeft(unequal ? e+1 : e);
+		mm.Set(1); mm.ShiftLeft(e);
+	}
+	else
+	{
+		r.Set(f); r.ShiftLeft(unequal ? 2 : 1);
+		s.Set(1); s.ShiftLeft(unequal ? 2-e : 1-e);
+		mp.Set(unequal ? 2 : 1);
+		mm.Set(1);
+	}
+
+	int k = EstimateK(f,e);
+	if ( k >= 0 )
+	{
+		s.MulPow10(k);
+	}
+	else
+	{
+		r.MulPow10(-k);
+		mp.MulPow10(-k);
+		mm.MulPow10(-k);
+	}
+
+	for(;;)
+	{
+		t = r; t.Add(mp);
+		int c = FastPrintfBig::Compare(t,s);
+		if ( even ? c < 0 : c <= 0 )
+			break;
+		k++;
+		s.MulSmall(10);
+	}
+	*pK = k;
+
+	int n = 0;
+	for(;;)
+	{
+		r.MulSmall(10);
+		mp.MulSmall(10);
+		mm.MulSmall(10);
+		int d = r.DivDigit(s);
+
+		int cLow = FastPrintfBig::Compare(r,mm);
+		t = r; t.Add(mp);
+		int cHigh = FastPrintfBig::Compare(t,s);
+		bool lowOk  = even ? cLow <= 0 : cLow < 0;
+		bool highOk = even ? cHigh >= 0 : cHigh > 0;
+
+		if ( ! lowOk && ! highOk )
+		{
+			digits[n++] = (char)('0' + d);
+			continue;
+		}
+
+		if ( lowOk && highOk )
+		{
+			// either works ; take the nearer one
+			t = r; t.ShiftLeft(1);
+			int c = FastPrintfBig::Compare(t,s);
+			if ( c > 0 || ( c == 0 && (d&1) ) )
+				d++;
+		}
+		else if ( highOk )
+		{
+			d++;
+		}
+		digits[n++] = (char)('0' + d);
+		return n;
+	}
+}
+
+//=======================================================================
+// float layout
+
+struct FastPrintfDouble
+{
+	bool	neg;
+	bool	isNan,isInf,isZero;
+	uint64	f;
+	int		e;
+};
+
+static FastPrintfDouble SplitDouble(double d)
+{
+	FastPrintfDouble ret;
+	uint64 bits;
+	memcpy(&bits,&d,sizeof(bits));
+	ret.neg = ( bits >> 63 ) != 0;
+	int exp = (int)((bits >> 52) & 0x7FF);
+	uint64 mant = bits & ((1ULL<<52)-1);
+	ret.isNan = ( exp == 0x7FF && mant != 0 );
+	ret.isInf = ( exp == 0x7FF && mant == 0 );
+	ret.isZero = ( exp == 0 && mant == 0 );
+	if ( exp == 0 )
+	{
+		ret.f = mant;
+		ret.e = -1074;
+	}
+	else
+	{
+		ret.f = mant | (1ULL<<52);
+		ret.e = exp - 1075;
+	}
+	return ret;
+}
+
+// lay out 0.digits * 10^k as %f with prec places
+static int LayoutF(char * to,const char * digits,int n,int k,int prec,bool alt)
+{
+	char * p = to;
+	if ( k <= 0 )
+	{
+		*p++ = '0';
+	}
+	else
+	{
+		for(int i=0;i<k;i++)
+			*p++ = ( i < n ) ? digits[i] : '0';
+	}
+	if ( prec > 0 || alt )
+		*p++ = '.';
+	for(int j=0;j<prec;j++)
+	{
+		int idx = k + j;
+		*p++ = ( idx >= 0 && idx < n ) ? digits[idx] : '0';
+	}
+	return (int)(p - to);
+}
+
+static int LayoutExponent(char * p,int x,char eChar)
+{
+	char * start = p;
+	*p++ = eChar;
+	if ( x < 0 ) { *p++ = '-'; x = -x; }
+	else *p++ = '+';
+	char tmp[8];
+	char * end = tmp + sizeof(tmp);
+	char * s = FormatDecimal(end,(uint64)x);
+	if ( end - s < 2 ) *p++ = '0';
+	while ( s < end ) *p++ = *s++;
+	return (int)(p - start);
+}
+
+// lay out d0.d1d2..e+XX
+static int LayoutE(char * to,const char * digits,int n,int k,int prec,bool alt,char eChar)
+{
+	char * p = to;
+	*p++ = digits[0];
+	if ( prec > 0 || alt )
+		*p++ = '.';
+	for(int i=1;i<=prec;i++)
+		*p++ = ( i < n ) ? digits[i] : '0';
+	p += LayoutExponent(p,k-1,eChar);
+	return (int)(p - to);
+}
+
+// returns false if it wants the CRT to do it
+static bool EmitDouble(FastPrintfOut & out,const FastPrintfSpec & specIn,double value)
+{
+	FastPrintfSpec spec = specIn;
+	FastPrintfDouble v = SplitDouble(value);
+	bool upper = ( spec.conv == 'F' || spec.conv == 'E' || spec.conv == 'G' );
+
+	char prefix[1];
+	int prefixLen = 0;
+	if ( v.neg ) prefix[prefixLen++] = '-';
+	else if ( spec.plus ) prefix[prefixLen++] = '+';
+	else if ( spec.space ) prefix[prefixLen++] = ' ';
+
+	if ( v.isNan || v.isInf )
+	{
+		spec.zero = false;
+		const char * s = v.isNan ? ( upper ? "NAN" : "nan" ) : ( upper ? "INF" : "inf" );
+		EmitPadded(out,spec,prefix,prefixLen,0,s,3);
+		return true;
+	}
+
+	int prec = ( spec.prec < 0 ) ? 6 : spec.prec;
+	if ( prec > c_maxFloatPrec )
+		return false;
+
+	char digits[c_maxFloatDigits+2];
+	char body[c_maxFloatDigits+32];
+	int bodyLen = 0;
+	int n,k;
+	char lower = (char)( spec.conv | 0x20 );
+
+	if ( lower == 'f' )
+	{
+		if ( v.isZero ) { n = 0; k = 1; }
+		else if ( (n = DigitsFixed(v.f,v.e,true,prec,digits,&k)) < 0 ) return false;
+		bodyLen = LayoutF(body,digits,n,k,prec,spec.alt);
+	}
+	else if ( lower == 'e' )
+	{
+		if ( v.isZero ) { n = 1; k = 1; digits[0] = '0'; }
+		else if ( (n = DigitsFixed(v.f,v.e,false,prec,digits,&k)) < 0 ) return false;
+		bodyLen = LayoutE(body,digits,n,k,prec,spec.alt,upper ? 'E' : 'e');
+	}
+	else // g
+	{
+		int P = ( prec == 0 ) ? 1 : prec;
+		if ( v.isZero ) { n = 1; k = 1; digits[0] = '0'; }
+		else if ( (n = DigitsFixed(v.f,v.e,false,P-1,digits,&k)) < 0 ) return false;
+		int x = k-1;
+		bool useF = ( P > x && x >= -4 );
+		if ( useF )
+			bodyLen = LayoutF(body,digits,n,k,P-1-x,spec.alt);
+		else
+			bodyLen = LayoutE(body,digits,n,k,P-1,spec.alt,upper ? 'E' : 'e');
+
+		if ( ! spec.alt )
+		{
+			// strip trailing zeros in the fraction (and a bare '.')
+			int mantEnd = bodyLen;
+			if ( ! useF )
+			{
+				while ( body[mantEnd-1] != 'e' && body[mantEnd-1] != 'E' ) mantEnd--;
+				mantEnd--;
+			}
+			if ( memchr(body,'.',mantEnd) )
+			{
+				int cut = mantEnd;
+				while ( body[cut-1] == '0' ) cut--;
+				if ( body[cut-1] == '.' ) cut--;
+				memmove(body+cut,body+mantEnd,bodyLen-mantEnd);
+				bodyLen -= mantEnd - cut;
+			}
+		}
+	}
+
+	EmitPadded(out,spec,prefix,prefixLen,0,body,bodyLen);
+	return true;
+}
+
+//=======================================================================
+// anything we don't do ourselves goes to the CRT, one spec at a time
+
+static void EmitFallback(FastPrintfOut & out,const char * spec,...)
+{
+	char tmp[512];
+	va_list args;
+	va_start(args,spec);
+	int len = vsnprintf(tmp,sizeof(tmp),spec,args);
+	va_end(args);
+
+	if ( len < 0 )
+	{
+		// old CRT overflow : take what fit
+		tmp[sizeof(tmp)-1] = 0;
+		out.Put(tmp,(int)strlen(tmp));
+	}
+	else if ( len < (int)sizeof(tmp) )
+	{
+		out.Put(tmp,len);
+	}
+	else
+	{
+		// rare (big wide strings) ; ok to alloc here
+		char * big = (char *) CBALLOC(len+1);
+		va_start(args,spec);
+		vsnprintf(big,len+1,spec,args);
+		va_end(args);
+		out.Put(big,len);
+		CBFREE(big);
+	}
+}
+
+// rebuild the spec with the * values filled in
+static void MakeFallbackSpec(char * to,const FastPrintfSpec & spec)
+{
+	char * p = to;
+	*p++ = '%';
+	if ( spec.left ) *p++ = '-';
+	if ( spec.plus ) *p++ = '+';
+	if ( spec.space ) *p++ = ' ';
+	if ( spec.alt ) *p++ = '#';
+	if ( spec.zero ) *p++ = '0';
+	char tmp[16];
+	char * end = tmp + sizeof(tmp);
+	if ( spec.width > 0 )
+	{
+		char * s = FormatDecimal(end,(uint64)spec.width);
+		while ( s < end ) *p++ = *s++;
+	}
+	if ( spec.prec >= 0 )
+	{
+		*p++ = '.';
+		char * s = FormatDecimal(end,(uint64)spec.prec);
+		while ( s < end ) *p++ = *s++;
+	}
+	memcpy(p,spec.sizeText,spec.sizeTextLen);
+	p += spec.sizeTextLen;
+	*p++ = spec.conv;
+	*p = 0;
+}
+
+//=======================================================================
+
+int fastvsnprintf(char * buf,int bufSize,const char * fmt,va_list args)
+{
+	FastPrintfOut out;
+	out.buf = buf;
+	out.cap = bufSize-1;
+	out.len = 0;
+
+	const char * p = fmt;
+	for(;;)
+	{
+		// copy the literal run :
+		const char * pct = strchr(p,'%');
+		if ( ! pct )
+		{
+			out.Put(p,(int)strlen(p));
+			break;
+		}
+		out.Put(p,(int)(pct-p));
+		p = pct+1;
+
+		if ( *p == '%' )
+		{
+			out.Put('%');
+			p++;
+			continue;
+		}
+
+		FastPrintfSpec spec;
+		spec.left = spec.plus = spec.space = spec.alt = spec.zero = false;
+		spec.width = 0;
+		spec.prec = -1;
+		spec.size = eFPSize_Default;
+
+		// flags :
+		for(;;)
+		{
+			if ( *p == '-' ) spec.left = true;
+			else if ( *p == '+' ) spec.plus = true;
+			else if ( *p == ' ' ) spec.space = true;
+			else if ( *p == '#' ) spec.alt = true;
+			else if ( *p == '0' ) spec.zero = true;
+			else break;
+			p++;
+		}
+
+		// width :
+		if ( *p == '*' )
+		{
+			spec.width = va_arg(args,int);
+			if ( spec.width < 0 )
+			{
+				spec.left = true;
+				spec.width = -spec.width;
+			}
+			p++;
+		}
+		else
+		{
+			while ( *p >= '0' && *p <= '9' )
+				spec.width = spec.width*10 + (*p++ - '0');
+		}
+
+		// precision :
+		if ( *p == '.' )
+		{
+			p++;
+			if ( *p == '*' )
+			{
+				spec.prec = va_arg(args,int);
+				if ( spec.prec < 0 ) spec.prec = -1;
+				p++;
+			}
+			else
+			{
+				spec.prec = 0;
+				while ( *p >= '0' && *p <= '9' )
+					spec.prec = spec.prec*10 + (*p++ - '0');
+			}
+		}
+
+		// size :
+		spec.sizeText = p;
+		switch(*p)
+		{
+		case 'h':
+			if ( p[1] == 'h' ) { spec.size = eFPSize_Char; p += 2; }
+			else { spec.size = eFPSize_Short; p++; }
+			break;
+		case 'l':
+			if ( p[1] == 'l' ) { spec.size = eFPSize_64; p += 2; }
+			else { spec.size = eFPSize_Long; p++; }
+			break;
+		case 'q':
+		case 'j':
+			spec.size = eFPSize_64; p++;
+			break;
+		case 'z':
+		case 't':
+			spec.size = eFPSize_Ptr; p++;
+			break;
+		case 'L':
+			spec.size = eFPSize_LongDouble; p++;
+			break;
+		case 'w':
+			spec.size = eFPSize_Wide; p++;
+			break;
+		case 'I':
+			if ( p[1] == '6' && p[2] == '4' ) { spec.size = eFPSize_64; p += 3; }
+			else if ( p[1] == '3' && p[2] == '2' ) { spec.size = eFPSize_32; p += 3; }
+			else { spec.size = eFPSize_Ptr; p++; }
+			break;
+		default:
+			break;
+		}
+		spec.sizeTextLen = (int)(p - spec.sizeText);
+
+		spec.conv = *p;
+		if ( spec.conv == 0 )
+		{
+			// dangling % at the end ; print what we got
+			out.Put(pct,(int)(p - pct));
+			break;
+		}
+		p++;
+
+		char fallbackSpec[64];
+
+		switch(spec.conv)
+		{
+		case 'd':
+		case 'i':
+		{
+			int64 v;
+			switch(spec.size)
+			{
+			case eFPSize_Char:	v = (signed char) va_arg(args,int); break;
+			case eFPSize_Short:	v = (short) va_arg(args,int); break;
+			case eFPSize_Long:	v = va_arg(args,long); break;
+			case eFPSize_64:
+			case eFPSize_LongDouble:	v = va_arg(args,int64); break;
+			case eFPSize_Ptr:	v = va_arg(args,intptr_t); break;
+			default:			v = va_arg(args,int); break;
+			}
+			bool neg = v < 0;
+			uint64 mag = neg ? (uint64)0 - (uint64)v : (uint64)v;
+			EmitInteger(out,spec,mag,neg);
+			break;
+		}
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'o':
+		{
+			uint64 v;
+			switch(spec.size)
+			{
+			case eFPSize_Char:	v = (unsigned char) va_arg(args,unsigned int); break;
+			case eFPSize_Short:	v = (unsigned short) va_arg(args,unsigned int); break;
+			case eFPSize_Long:	v = va_arg(args,unsigned long); break;
+			case eFPSize_64:
+			case eFPSize_LongDouble:	v = va_arg(args,uint64); break;
+			case eFPSize_Ptr:	v = va_arg(args,size_t); break;
+			default:			v = va_arg(args,unsigned int); break;
+			}
+			EmitInteger(out,spec,v,false);
+			break;
+		}
+		case 'c':
+			if ( spec.size == eFPSize_Long || spec.size == eFPSize_Wide )
+			{
+				MakeFallbackSpec(fallbackSpec,spec);
+				EmitFallback(out,fallbackSpec,va_arg(args,int));
+			}
+			else
+			{
+				char c = (char) va_arg(args,int);
+				spec.zero = false;
+				EmitPadded(out,spec,NULL,0,0,&c,1);
+			}
+			break;
+		case 'C':
+			MakeFallbackSpec(fallbackSpec,spec);
+			EmitFallback(out,fallbackSpec,va_arg(args,int));
+			break;
+		case 's':
+			if ( spec.size == eFPSize_Long || spec.size == eFPSize_Wide )
+			{
+				MakeFallbackSpec(fallbackSpec,spec);
+				EmitFallback(out,fallbackSpec,va_arg(args,const wchar_t *));
+			}
+			else
+			{
+				const char * s = va_arg(args,const char *);
+				if ( ! s ) s = "(null)";
+				int len;
+				if ( spec.prec >= 0 )
+				{
+					// don't read past prec, the string may not be terminated :
+					const char * z = (const char *) memchr(s,0,spec.prec);
+					len = z ? (int)(z - s) : spec.prec;
+				}
+				else
+				{
+					len = (int)strlen(s);
+				}
+				spec.zero = false;
+				EmitPadded(out,spec,NULL,0,0,s,len);
+			}
+			break;
+		case 'S':
+			MakeFallbackSpec(fallbackSpec,spec);
+			EmitFallback(out,fallbackSpec,va_arg(args,const wchar_t *));
+			break;
+		case 'f':
+		case 'F':
+		case 'e':
+		case 'E':
+		case 'g':
+		case 'G':
+			if ( spec.size == eFPSize_LongDouble )
+			{
+				MakeFallbackSpec(fallbackSpec,spec);
+				EmitFallback(out,fallbackSpec,va_arg(args,long double));
+			}
+			else
+			{
+				double d = va_arg(args,double);
+				if ( ! EmitDouble(out,spec,d) )
+				{
+					MakeFallbackSpec(fallbackSpec,spec);
+					EmitFallback(out,fallbackSpec,d);
+				}
+			}
+			break;
+		case 'a':
+		case 'A':
+			MakeFallbackSpec(fallbackSpec,spec);
+			if ( spec.size == eFPSize_LongDouble )
+				EmitFallback(out,fallbackSpec,va_arg(args,long double));
+			else
+				EmitFallback(out,fallbackSpec,va_arg(args,double));
+			break;
+		case '%':
+			// "%5%" and friends
+			out.Put('%');
+			break;
+		case 'p':
+			MakeFallbackSpec(fallbackSpec,spec);
+			EmitFallback(out,fallbackSpec,va_arg(args,void *));
+			break;
+		case 'n':
+		{
+			void * ptr = va_arg(args,void *);
+			switch(spec.size)
+			{
+			case eFPSize_Char:	*((signed char *)ptr) = (signed char) out.len; break;
+			case eFPSize_Short:	*((short *)ptr) = (short) out.len; break;
+			case eFPSize_Long:	*((long *)ptr) = out.len; break;
+			case eFPSize_64:	*((int64 *)ptr) = out.len; break;
+			case eFPSize_Ptr:	*((intptr_t *)ptr) = out.len; break;
+			default:			*((int *)ptr) = out.len; break;
+			}
+			break;
+		}
+		default:
+			// not a conversion ; echo it
+			out.Put(pct,(int)(p - pct));
+			break;
+		}
+	}
+
+	if ( bufSize > 0 )
+		buf[ out.len < out.cap ? out.len : out.cap ] = 0;
+
+	return out.len;
+}
+
+int fastsnprintf(char * buf,int bufSize,const char * fmt,...)
+{
+	va_list args;
+	va_start(args,fmt);
+	int len = fastvsnprintf(buf,bufSize,fmt,args);
+	va_end(args);
+	return len;
+}
+
+int fastsprintf(char * buf,const char * fmt,...)
+{
+	va_list args;
+	va_start(args,fmt);
+	int len = fastvsnprintf(buf,0x7FFFFFFF,fmt,args);
+	va_end(args);
+	return len;
+}
+
+//=======================================================================
+// per-thread buffer
+//	starts inline in TLS ; the first time a line doesn't fit we move to the heap and keep it
+//	the heap buffer is also handed to a thread-exit hook (FLS on Windows , a pthread key
+//	elsewhere) so it's freed with the thread instead of leaking
+
+static CB_THREAD_LOCAL char s_tlsInline[1024];
+static CB_THREAD_LOCAL char * s_tlsHeap = NULL;
+static CB_THREAD_LOCAL int s_tlsHeapSize = 0;
+
+// runs on the exiting thread ; anything it prints after this goes back to the inline buffer
+#ifdef _WIN32
+static void WINAPI FastPrintf_FreeTLSHeap(void * ptr)
+#else
+static void FastPrintf_FreeTLSHeap(void * ptr)
+#endif
+{
+	if ( ptr == NULL )
+		return;
+	if ( ptr == s_tlsHeap )
+	{
+		s_tlsHeap = NULL;
+		s_tlsHeapSize = 0;
+	}
+	CBFREE(ptr);
+}
+
+#ifdef _WIN32
+
+static LONG volatile s_tlsHeapKey = (LONG) FLS_OUT_OF_INDEXES;
+
+static void FastPrintf_SetTLSHeapHook(char * ptr)
+{
+	if ( s_tlsHeapKey == (LONG) FLS_OUT_OF_INDEXES )
+	{
+		DWORD key = FlsAlloc(FastPrintf_FreeTLSHeap);
+		if ( key == FLS_OUT_OF_INDEXES )
+			return; // no hook ; it leaks like it used to
+		if ( InterlockedCompareExchange(&s_tlsHeapKey,(LONG)key,(LONG)FLS_OUT_OF_INDEXES) != (LONG)FLS_OUT_OF_INDEXES )
+			FlsFree(key); // someone else made it first
+	}
+	FlsSetValue((DWORD)s_tlsHeapKey,ptr);
+}
+
+#else
+
+static pthread_key_t	s_tlsHeapKey;
+static pthread_once_t	s_tlsHeapKeyOnce = PTHREAD_ONCE_INIT;
+static bool				s_tlsHeapKeyOk = false;
+
+static void FastPrintf_MakeTLSHeapKey()
+{
+	s_tlsHeapKeyOk = ( pthread_key_create(&s_tlsHeapKey,FastPrintf_FreeTLSHeap) == 0 );
+}
+
+static void FastPrintf_SetTLSHeapHook(char * ptr)
+{
+	pthread_once(&s_tlsHeapKeyOnce,FastPrintf_MakeTLSHeapKey);
+	if ( s_tlsHeapKeyOk )
+		pthread_setspecific(s_tlsHeapKey,ptr);
+}
+
+#endif
+
+const char * fastvsprintf_tls(int * pLen,const char * fmt,va_list args)
+{
+	char * buf = s_tlsHeap ? s_tlsHeap : s_tlsInline;
+	int size = s_tlsHeap ? s_tlsHeapSize : (int)sizeof(s_tlsInline);
+
+	va_list save;
+	va_copy(save,args);
+	int len = fastvsnprintf(buf,size,fmt,save);
+	va_end(save);
+
+	if ( len >= size )
+	{
+		int newSize = MAX(len+1,size*2);
+		if ( s_tlsHeap ) CBFREE(s_tlsHeap);
+		s_tlsHeap = (char *) CBALLOC(newSize);
+		s_tlsHeapSize = newSize;
+		FastPrintf_SetTLSHeapHook(s_tlsHeap);
+		buf = s_tlsHeap;
+
+		va_copy(save,args);
+		fastvsnprintf(buf,newSize,fmt,save);
+		va_end(save);
+	}
+
+	if ( pLen ) *pLen = len;
+	return buf;
+}
+
+int fastprintf(const char * fmt,...)
+{
+	va_list args;
+	va_start(args,fmt);
+	int len;
+	const char * s = fastvsprintf_tls(&len,fmt,args);
+	va_end(args);
+	fwrite(s,1,len,stdout);
+	return len;
+}
+
+int fastfprintf(FILE * into,const char * fmt,...)
+{
+	va_list args;
+	va_start(args,fmt);
+	int len;
+	const char * s = fastvsprintf_tls(&len,fmt,args);
+	va_end(args);
+	fwrite(s,1,len,into);
+	return len;
+}
+
+//=======================================================================
+// shortest round trip
+
+static int LayoutShortest(char * buf,bool neg,const char * digits,int n,int k,int maxFixedExp)
+{
+	char * p = buf;
+	if ( neg ) *p++ = '-';
+
+	int x = k-1;
+	if ( x < -4 || x >= maxFixedExp )
+	{
+		*p++ = digits[0];
+		if ( n > 1 )
+		{
+			*p++ = '.';
+			memcpy(p,digits+1,n-1);
+			p += n-1;
+		}
+		p += LayoutExponent(p,x,'e');
+	}
+	else if ( x >= 0 )
+	{
+		for(int i=0;i<=x;i++)
+			*p++ = ( i < n ) ? digits[i] : '0';
+		if ( n > x+1 )
+		{
+			*p++ = '.';
+			memcpy(p,digits+x+1,n-x-1);
+			p += n-x-1;
+		}
+	}
+	else
+	{
+		*p++ = '0';
+		*p++ = '.';
+		for(int i=0;i< -x-1;i++)
+			*p++ = '0';
+		memcpy(p,digits,n);
+		p += n;
+	}
+	*p = 0;
+	return (int)(p - buf);
+}
+
+static int SpecialShortest(char * buf,bool neg,bool isNan,bool isInf)
+{
+	const char * s = isNan ? "nan" : ( isInf ? ( neg ? "-inf" : "inf" ) : ( neg ? "-0" : "0" ) );
+	strcpy(buf,s);
+	return (int)strlen(s);
+}
+
+int fastprintf_shortest(char * buf,double d)
+{
+	FastPrintfDouble v = SplitDouble(d);
+	if ( v.isNan || v.isInf || v.isZero )
+		return SpecialShortest(buf,v.neg,v.isNan,v.isInf);
+
+	char digits[32];
+	int k;
+	int n = DigitsShortest(v.f,v.e,1ULL<<52,-1074,digits,&k);
+	return LayoutShortest(buf,v.neg,digits,n,k,17);
+}
+
+int fastprintf_shortest(char * buf,float fv)
+{
+	uint32 bits;
+	memcpy(&bits,&fv,sizeof(bits));
+	bool neg = ( bits >> 31 ) != 0;
+	int exp = (int)((bits >> 23) & 0xFF);
+	uint32 mant = bits & ((1U<<23)-1);
+	if ( exp == 0xFF || ( exp == 0 && mant == 0 ) )
+		return SpecialShortest(buf,neg,exp == 0xFF && mant != 0,exp == 0xFF && mant == 0);
+
+	uint64 f = ( exp == 0 ) ? mant : ( mant | (1U<<23) );
+	int e = ( exp == 0 ) ? -149 : exp - 150;
+
+	char digits[16];
+	int k;
+	int n = DigitsShortest(f,e,1ULL<<23,-149,digits,&k);
+	return LayoutShortest(buf,neg,digits,n,k,9);
+}
+
+//=======================================================================
+// test
+//	old MSVC CRTs (before VS2015) print inf/nan and %a their own way ; expect those to differ there
+
+static int s_testFailures = 0;
+
+// compares into bufSize bytes , so short buffers check truncation too
+static void FastPrintf_TestV(int bufSize,const char * fmt,va_list args)
+{
+	char fast[1024];
+	char crt[1024];
+	ASSERT( bufSize <= (int)sizeof(fast) );
+
+	va_list save;
+	va_copy(save,args);
+	int fastLen = fastvsnprintf(fast,bufSize,fmt,save);
+	va_end(save);
+
+	va_copy(save,args);
+	int crtLen = vsnprintf(crt,bufSize,fmt,save);
+	va_end(save);
+
+	if ( fastLen != crtLen || strcmp(fast,crt) != 0 )
+	{
+		s_testFailures++;
+		lprintf("FastPrintf_Test : \"%s\" into %d : fast [%s] (%d) , crt [%s] (%d)\n",fmt,bufSize,fast,fastLen,crt,crtLen);
+	}
+}
+
+static void FastPrintf_TestOne(const char * fmt,...)
+{
+	va_list args;
+	va_start(args,fmt);
+	FastPrintf_TestV(1024,fmt,args);
+	va_end(args);
+}
+
+static void FastPrintf_TestSized(int bufSize,const char * fmt,...)
+{
+	va_list args;
+	va_start(args,fmt);
+	FastPrintf_TestV(bufSize,fmt,args);
+	va_end(args);
+}
+
+// xorshift ; the test should be the same every run
+static uint64 FastPrintf_TestRand(uint64 * pState)
+{
+	uint64 x = *pState;
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*pState = x;
+	return x;
+}
+
+void FastPrintf_Test()
+{
+	s_testFailures = 0;
+
+	// ints & flags
+	FastPrintf_TestOne("hello %d %i %u %x %X %o|",-5,7,3000000000u,255,255,8);
+	FastPrintf_TestOne("%5d|%-5d|%05d|%+d|% d|%.3d|%8.3d|%-8.3d|%08.3d",42,42,42,42,42,42,42,42,42);
+	FastPrintf_TestOne("%#x %#X %#o %#o %.0d %.0x %#.0o",255,255,8,0,0,0,0);
+	FastPrintf_TestOne("%d %d %u",INT_MIN,INT_MAX,UINT_MAX);
+	FastPrintf_TestOne("%lld %llu",(long long)(-9223372036854775807LL-1),(unsigned long long)18446744073709551615ULL);
+	FastPrintf_TestOne("%hd %hhd %hu %hhu %ld",70000,300,70000,300,-5L);
+	FastPrintf_TestOne("%*d|%-*d|%.*d",6,1,6,2,4,3);
+	#ifdef _MSC_VER
+	FastPrintf_TestOne("%I64d %I64u %I32d %Id",(__int64)-1,(unsigned __int64)-1,7,(intptr_t)-3);
+	#endif
+
+	// strings & chars
+	FastPrintf_TestOne("%s|%10s|%-10s|%.2s|%*s|%-*.*s|","abc","abc","abc","abc",6,"x",6,2,"hello");
+	FastPrintf_TestOne("%c%c|%3c|%-3c|",'a','b','c','d');
+	FastPrintf_TestOne("%%|%s|%.0s|","","abc");
+
+	// floats
+	FastPrintf_TestOne("%f %e %g %E %G",3.14159,3.14159,3.14159,3.14159,3.14159);
+	FastPrintf_TestOne("%f %f %f %f %.0f %.0f %.0f %.0f",0.0,-0.0,1e300,1e-300,0.5,1.5,2.5,-0.5);
+	FastPrintf_TestOne("%g %g %g %g %g %g",100000.0,1000000.0,1e-4,1e-5,0.0001234567,123456789.0);
+	FastPrintf_TestOne("%#g %#.0f %#.0e",1.0,1.0,1.0);
+	FastPrintf_TestOne("%10.3f|%-10.3f|%010.3f|%+.2e|% .3g|%+010.2f",3.14159,3.14159,-3.14159,12345.678,0.00001234,-1.5);
+	FastPrintf_TestOne("%.20f %.17e %.17g %.30g",0.1,0.1,0.1,1e-310);
+	FastPrintf_TestOne("%.3f %.2f %.1f %.0e %.0g %g",0.0005,0.005,0.05,9.5,9.5,999999.5);
+	FastPrintf_TestOne("%f %e %g",(double)HUGE_VAL,-(double)HUGE_VAL,5e-324);
+
+	// random bit patterns through the exact float path
+	uint64 state = 0x9E3779B97F4A7C15ULL;
+	for LOOP(i,20000)
+	{
+		uint64 bits = FastPrintf_TestRand(&state);
+		double d;
+		memcpy(&d,&bits,sizeof(d));
+		if ( d != d )
+			continue;
+
+		int prec = (int)( FastPrintf_TestRand(&state) % 20 );
+		FastPrintf_TestOne("%.17g|%e|%.*g|%.*e",d,d,prec,d,prec,d);
+		if ( fabs(d) < 1e30 )
+			FastPrintf_TestOne("%.*f",prec,d);
+
+		// shortest has to read back exactly
+		char buf[32];
+		fastprintf_shortest(buf,d);
+		if ( strtod(buf,NULL) != d )
+		{
+			s_testFailures++;
+			lprintf("FastPrintf_Test : shortest %.17g -> %s\n",d,buf);
+		}
+	}
+
+	// truncation : the return is the length it wanted , the buffer is cut and terminated
+	FastPrintf_TestSized(8,"%d-%s",12345,"abcdef");
+	FastPrintf_TestSized(1,"%d",12345);
+	FastPrintf_TestSized(6,"%.3f|%e",3.14159,2.5);
+
+	lprintf("FastPrintf_Test : %d mismatches\n",s_testFailures);
+	if ( s_testFailures != 0 )
+		FAIL("FastPrintf_Test failed");
+}
+
+END_CB
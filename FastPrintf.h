@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Base.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+// old MSVC doesn't have va_copy ; va_list is just a pointer there
+#ifndef va_copy
+#define va_copy(d,s)	((d)=(s))
+#endif
+
+/**
+
+FastPrintf : printf-compatible formatter that never allocates
+
+drop-in for vsnprintf ; takes the same format strings (including the MSVC I64/I32/I sizes)
+	and gives the same output for everything that matters in logs
+
+ints are done with a two-digits-at-a-time table
+floats are done exactly (bignum digit generation), so %f/%e/%g round the same as the CRT
+	without going through the locale machinery
+
+things it doesn't do itself (%p,%a,wide chars,long double) are handed to snprintf one spec at a time,
+	so they still come out the way the CRT makes them
+
+fastvsnprintf returns the length it wanted to write (C99 style, not the old MSVC -1),
+	and always null terminates if bufSize > 0
+
+**/
+
+START_CB
+
+int fastvsnprintf(char * buf,int bufSize,const char * fmt,va_list args);
+int fastsnprintf(char * buf,int bufSize,const char * fmt,...);
+
+// no size check, same as sprintf :
+int fastsprintf(char * buf,const char * fmt,...);
+
+// fastvsprintf_tls : formats into a per-thread buffer that grows as needed and is reused
+//	the returned pointer is good until the next fastvsprintf_tls call on this thread
+const char * fastvsprintf_tls(int * pLen,const char * fmt,va_list args);
+
+int fastprintf(const char * fmt,...);
+int fastfprintf(FILE * into,const char * fmt,...);
+
+// shortest string that reads back to the exact same value :
+//	"0.1" , "1e+20" , "3.1415927"
+// buf should have room for 32 chars ; returns length
+int fastprintf_shortest(char * buf,double d);
+int fastprintf_shortest(char * buf,float f);
+
+// checks against the CRT's vsnprintf over a table of formats and random values ;
+//	logs every mismatch
+void FastPrintf_Test();
+
+END_CB
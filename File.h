@@ -325,6 +325,7 @@ class FileRC : public File, public RefCounted
 public:
 	static FileRCPtr Create(const char * name,const char * access);
 
+	// fixed size ; MemFile (MemFile.h) grows
 	static FileRCPtr CreateMemFile(void * buffer,int size,bool reading);
 	
 	static FileRCPtr CreateForWriteWithP4(const char * name);
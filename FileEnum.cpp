@@ -1,10 +1,69 @@
 #include "FileEnum.h"
 #include "FileUtil.h"
+#include "StrUtil.h"
+#include "Mem.h"
 #include "Log.h"
+
+#ifdef _WIN32
 #include "Win32Util.h"
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
 
 START_CB
 
+//=========================================================================================
+
+FileEnumOptions::FileEnumOptions() :
+	recurse(true),
+	wantDirs(false),
+	wantStat(false),
+	numThreads(0),
+	bufferBytes(256*1024)
+{
+}
+
+FileEnumEntry * FileEnumTable::Add(const char * dir,int dirLen,char sep,const char * name,int nameLen,bool isDir)
+{
+	// vector growth is capped per step ; these get huge , so double by hand
+	const int64 offset = pathChars.size();
+	const int64 need = offset + dirLen + 1 + nameLen + 1;
+	if ( need > (int64)pathChars.capacity() )
+		pathChars.reserve( check_value_cast<int>( MAX(need,(int64)pathChars.capacity()*2) ) );
+	if ( entries.size() == entries.capacity() )
+		entries.reserve( MAX(entries.size32()*2,1024) );
+
+	pathChars.resize( check_value_cast<int>(need) );
+	char * ptr = pathChars.data() + offset;
+	memcpy(ptr,dir,dirLen);
+	ptr += dirLen;
+	// no doubled separator when dir is a root like "/" or "c:\"
+	if ( dirLen > 0 && dir[dirLen-1] != sep )
+		*ptr++ = sep;
+	memcpy(ptr,name,nameLen);
+	ptr += nameLen;
+	*ptr++ = 0;
+	// unused byte if the separator was skipped :
+	pathChars.resize( check_value_cast<int>( ptr - pathChars.data() ) );
+
+	entries.push_back();
+	FileEnumEntry * e = &entries.back();
+	e->pathOffset = offset;
+	e->pathLen = (int)( ptr - 1 - (pathChars.data() + offset) );
+	e->isDir = isDir;
+	e->size = 0;
+	e->modTime = 0;
+	return e;
+}
+
 bool EnumFilesIfDir(const char * fileOrDir,bool recurse, 
 					cb::vector<cb::String> * pFiles,
 					cb::vector<cb::String> * pDirs)
@@ -24,6 +83,8 @@ bool EnumFilesIfDir(const char * fileOrDir,bool recurse,
 	}
 }
 
+#ifdef _WIN32
+
 bool EnumFiles(const char * baseDir,bool recurse, 
 				cb::vector<cb::String> * pFiles,
 				cb::vector<cb::String> * pDirs)
@@ -198,6 +259,430 @@ void MakeDirEnum(const char * dir,DirEnum * dirEnum)
 	return;
 }
 
+bool EnumFilesFast(const char * baseDir,FileEnumTable * pTable,const FileEnumOptions & options)
+{
+	pTable->clear();
+	if ( baseDir[0] == 0 )
+		return false;
+
+	cb::vector<cb::String> dirs;
+	dirs.push_back( cb::String(baseDir) );
+	bool first = true;
+
+	while( ! dirs.empty() )
+	{
+		cb::String curDir = dirs.back();
+		dirs.pop_back();
+
+		WIN32_FIND_DATA data;
+
+		cb::String findSpec = curDir;
+		if ( findSpec[findSpec.Length()-1] != '\\' )
+			findSpec += '\\';
+		findSpec += '*';
+		HANDLE handle = FindFirstFile(findSpec.CStr(),&data);
+		if ( handle == INVALID_HANDLE_VALUE )
+		{
+			if ( first )
+				return false;
+			continue;
+		}
+		first = false;
+
+		do
+		{
+			if ( data.dwFileAttributes & (FILE_ATTRIBUTE_REPARSE_POINT|FILE_ATTRIBUTE_TEMPORARY) )
+				continue;
+
+			if ( strsame(data.cFileName,".") ||
+				strsame(data.cFileName,"..") )
+			{
+				continue;
+			}
+
+			const bool isDir = ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+
+			if ( isDir && options.recurse )
+			{
+				cb::String fullName(curDir);
+				if ( fullName[fullName.Length()-1] != '\\' )
+					fullName += '\\';
+				fullName += data.cFileName;
+				dirs.push_back(fullName);
+			}
+
+			if ( isDir && ! options.wantDirs )
+				continue;
+
+			FileEnumEntry * e = pTable->Add(curDir.CStr(),curDir.Length(),'\\',data.cFileName,strlen32(data.cFileName),isDir);
+			if ( options.wantStat )
+			{
+				e->size = ( ((int64)data.nFileSizeHigh) << 32 ) | data.nFileSizeLow;
+				e->modTime = ( ((int64)data.ftLastWriteTime.dwHighDateTime) << 32 ) | data.ftLastWriteTime.dwLowDateTime;
+			}
+		}
+		while ( FindNextFile(handle,&data) );
+
+		FindClose(handle);
+	}
+
+	return true;
+}
+
+#else // _WIN32
+
+//=========================================================================================
+// posix
+
+#ifdef __linux__
+// the kernel's record ; glibc only wraps getdents64 since 2.30
+struct FileEnumDirent64
+{
+	uint64			d_ino;
+	int64			d_off;
+	unsigned short	d_reclen;
+	unsigned char	d_type;
+	char			d_name[1];
+};
+#endif
+
+struct FileEnumWorker
+{
+	FileEnumTable	table;
+	char *			buffer;		// getdents64
+	vector<String>	subdirs;	// found by the last ScanDir
+};
+
+static void FileEnum_AddEntry(int dirFd,const char * dir,int dirLen,const char * name,int type,
+							FileEnumWorker * w,const FileEnumOptions & options)
+{
+	if ( name[0] == '.' && ( name[1] == 0 || ( name[1] == '.' && name[2] == 0 ) ) )
+		return;
+
+	// d_type saves a stat per entry ; some file systems leave it DT_UNKNOWN
+	struct stat st;
+	bool haveStat = false;
+	if ( type == DT_UNKNOWN || ( options.wantStat && ( type == DT_REG || type == DT_DIR ) ) )
+	{
+		if ( fstatat(dirFd,name,&st,AT_SYMLINK_NOFOLLOW) != 0 )
+			return;
+		haveStat = true;
+		if ( S_ISDIR(st.st_mode) )
+			type = DT_DIR;
+		else if ( S_ISREG(st.st_mode) )
+			type = DT_REG;
+		else
+			return;
+	}
+
+	if ( type != DT_DIR && type != DT_REG )
+		return;
+	const bool isDir = ( type == DT_DIR );
+	const int nameLen = strlen32(name);
+
+	FileEnumEntry * e = NULL;
+	if ( ! isDir || options.wantDirs )
+	{
+		e = w->table.Add(dir,dirLen,'/',name,nameLen,isDir);
+		if ( haveStat )
+		{
+			e->size = st.st_size;
+			#ifdef __APPLE__
+			e->modTime = (int64)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+			#else
+			e->modTime = (int64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+			#endif
+		}
+	}
+
+	if ( isDir && options.recurse )
+	{
+		if ( e )
+		{
+			w->subdirs.push_back( String( w->table.pathChars.data() + e->pathOffset ) );
+		}
+		else
+		{
+			String path(dir);
+			if ( dirLen > 0 && dir[dirLen-1] != '/' )
+				path += '/';
+			path += name;
+			w->subdirs.push_back(path);
+		}
+	}
+}
+
+// one directory into w->table ; the subdirectories to do next go in w->subdirs
+static bool FileEnum_ScanDir(const char * dir,FileEnumWorker * w,const FileEnumOptions & options)
+{
+	int fd = open(dir,O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+	if ( fd < 0 )
+		return false;
+
+	const int dirLen = strlen32(dir);
+
+	#ifdef __linux__
+
+	for(;;)
+	{
+		long got = syscall(SYS_getdents64,fd,w->buffer,options.bufferBytes);
+		if ( got <= 0 )
+			break;
+
+		for(long pos=0;pos<got;)
+		{
+			const FileEnumDirent64 * d = (const FileEnumDirent64 *)(w->buffer + pos);
+			pos += d->d_reclen;
+			FileEnum_AddEntry(fd,dir,dirLen,d->d_name,d->d_type,w,options);
+		}
+	}
+
+	close(fd);
+
+	#else
+
+	DIR * dp = fdopendir(fd);
+	if ( ! dp )
+	{
+		close(fd);
+		return false;
+	}
+
+	struct dirent * d;
+	while ( (d = readdir(dp)) != NULL )
+		FileEnum_AddEntry(fd,dir,dirLen,d->d_name,d->d_type,w,options);
+
+	closedir(dp);
+
+	#endif
+
+	return true;
+}
+
+struct FileEnumShared
+{
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+	vector<String>			todo;
+	int						pending;	// in todo + being scanned
+	const FileEnumOptions *	options;
+};
+
+struct FileEnumThreadContext
+{
+	FileEnumShared *	shared;
+	FileEnumWorker *	worker;
+	pthread_t			thread;
+};
+
+static void * FileEnumThreadRoutine(void * param)
+{
+	FileEnumThreadContext * ctx = (FileEnumThreadContext *) param;
+	FileEnumShared * sh = ctx->shared;
+	FileEnumWorker * w = ctx->worker;
+
+	pthread_mutex_lock(&sh->lock);
+	for(;;)
+	{
+		// nothing to take but someone's still scanning ; they may add more
+		while ( sh->todo.empty() && sh->pending > 0 )
+			pthread_cond_wait(&sh->cond,&sh->lock);
+		if ( sh->todo.empty() )
+			break;
+
+		// back = most recently found = depth first , keeps the todo list short
+		String dir = sh->todo.back();
+		sh->todo.pop_back();
+		pthread_mutex_unlock(&sh->lock);
+
+		FileEnum_ScanDir(dir.CStr(),w,*sh->options);
+
+		pthread_mutex_lock(&sh->lock);
+		const vector<String> & subdirs = w->subdirs;
+		for LOOPVEC(i,subdirs)
+			sh->todo.push_back(subdirs[i]);
+		sh->pending += subdirs.size32() - 1;
+		if ( ! subdirs.empty() || sh->pending == 0 )
+			pthread_cond_broadcast(&sh->cond);
+		w->subdirs.clear();
+	}
+	pthread_mutex_unlock(&sh->lock);
+
+	return NULL;
+}
+
+bool EnumFilesFast(const char * baseDir,FileEnumTable * pTable,const FileEnumOptions & options)
+{
+	pTable->clear();
+	if ( baseDir[0] == 0 )
+		return false;
+
+	int numThreads = options.numThreads;
+	if ( numThreads <= 0 )
+		numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	numThreads = MAX(numThreads,1);
+	numThreads = MIN(numThreads,64);
+	if ( ! options.recurse )
+		numThreads = 1;
+
+	FileEnumOptions opts = options;
+	opts.bufferBytes = MAX(opts.bufferBytes,4096);
+
+	FileEnumWorker * workers = new FileEnumWorker[numThreads];
+	for LOOP(i,numThreads)
+		workers[i].buffer = (char *) CBALLOC(opts.bufferBytes);
+
+	// the root on this thread , so a bad dir fails before any threads start
+	bool ok = FileEnum_ScanDir(baseDir,&workers[0],opts);
+
+	if ( ok && ! workers[0].subdirs.empty() )
+	{
+		FileEnumShared sh;
+		pthread_mutex_init(&sh.lock,NULL);
+		pthread_cond_init(&sh.cond,NULL);
+		sh.todo.swap(workers[0].subdirs);
+		sh.pending = sh.todo.size32();
+		sh.options = &opts;
+
+		FileEnumThreadContext * contexts = new FileEnumThreadContext[numThreads];
+		for LOOP(i,numThreads)
+		{
+			contexts[i].shared = &sh;
+			contexts[i].worker = &workers[i];
+		}
+
+		// thread 0 is us :
+		int started = 1;
+		for(int i=1;i<numThreads;i++)
+		{
+			if ( pthread_create(&contexts[i].thread,NULL,FileEnumThreadRoutine,&contexts[i]) != 0 )
+				break;
+			started++;
+		}
+		FileEnumThreadRoutine(&contexts[0]);
+		for(int i=1;i<started;i++)
+			pthread_join(contexts[i].thread,NULL);
+
+		delete [] contexts;
+		pthread_cond_destroy(&sh.cond);
+		pthread_mutex_destroy(&sh.lock);
+	}
+
+	// merge :
+	int64 totalChars = 0;
+	int totalEntries = 0;
+	for LOOP(i,numThreads)
+	{
+		totalChars += workers[i].table.pathChars.size();
+		totalEntries += workers[i].table.entries.size32();
+	}
+
+	if ( totalEntries > 0 )
+	{
+		pTable->pathChars.resize( check_value_cast<int>(totalChars) );
+		pTable->entries.resize( totalEntries );
+
+		int64 charPos = 0;
+		int entryPos = 0;
+		for LOOP(i,numThreads)
+		{
+			const FileEnumTable & t = workers[i].table;
+			if ( t.entries.empty() )
+				continue;
+
+			memcpy(pTable->pathChars.data() + charPos,t.pathChars.data(),t.pathChars.size());
+			for LOOPVEC(j,t.entries)
+			{
+				FileEnumEntry & e = pTable->entries[entryPos++];
+				e = t.entries[j];
+				e.pathOffset += charPos;
+			}
+			charPos += t.pathChars.size();
+		}
+	}
+
+	for LOOP(i,numThreads)
+		CBFREE(workers[i].buffer);
+	delete [] workers;
+
+	return ok;
+}
+
+bool EnumFiles(const char * baseDir,bool recurse,
+				cb::vector<cb::String> * pFiles,
+				cb::vector<cb::String> * pDirs)
+{
+	if ( baseDir[0] == 0 )
+		return false;
+
+	FileEnumOptions options;
+	options.recurse = recurse;
+	options.wantDirs = ( pDirs != NULL );
+
+	// like the Windows walk , an unreadable dir is just empty
+	FileEnumTable table;
+	EnumFilesFast(baseDir,&table,options);
+
+	for LOOP(i,table.size32())
+	{
+		if ( table[i].isDir )
+			pDirs->push_back( cb::String(table.GetPath(i)) );
+		else if ( pFiles )
+			pFiles->push_back( cb::String(table.GetPath(i)) );
+	}
+
+	return true;
+}
+
+void MakeDirEnum(const char * dir,DirEnum * dirEnum)
+{
+	dirEnum->name = dir;
+
+	FileEnumOptions options;
+	options.recurse = false;
+	options.wantDirs = true;
+	options.wantStat = true;
+	options.numThreads = 1;
+
+	FileEnumTable table;
+	EnumFilesFast(dir,&table,options);
+
+	int numDirs = 0;
+	for LOOP(i,table.size32())
+		if ( table[i].isDir )
+			numDirs++;
+
+	dirEnum->files.reserve(table.size32() - numDirs);
+	dirEnum->dirs.resize(numDirs);
+
+	int dirIndex = 0;
+	for LOOP(i,table.size32())
+	{
+		if ( table[i].isDir )
+		{
+			MakeDirEnum( table.GetPath(i), &dirEnum->dirs[dirIndex++] );
+		}
+		else
+		{
+			dirEnum->files.push_back( cb::String(table.GetPath(i)) );
+			dirEnum->fileSizeCur += table[i].size;
+		}
+	}
+
+	dirEnum->fileSizeRecursed = dirEnum->fileSizeCur;
+	dirEnum->numFilesRecursed = dirEnum->files.size();
+	dirEnum->numDirsRecursed = dirEnum->dirs.size();
+
+	for LOOPVEC(i,dirEnum->dirs)
+	{
+		dirEnum->fileSizeRecursed += dirEnum->dirs[i].fileSizeRecursed;
+		dirEnum->numFilesRecursed += dirEnum->dirs[i].numFilesRecursed;
+		dirEnum->numDirsRecursed += dirEnum->dirs[i].numDirsRecursed;
+	}
+}
+
+#endif // _WIN32
+
 String SelectOneIfDir( const char * fmName )
 {
 	// take dir arg and pick random in dir :
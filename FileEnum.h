@@ -45,6 +45,62 @@ struct DirEnum
 
 void MakeDirEnum(const char * dir,DirEnum * dirEnum);
 
+/**
+
+EnumFilesFast : for trees with millions of files
+
+results go in a FileEnumTable : all the paths are packed in one char arena and the entries
+	just point into it , so there's no heap String per file
+	the order is not specified (and not stable run to run when threaded)
+
+on Linux directories are read with getdents64 into big buffers , and subdirectories are
+	fanned out to a pool of worker threads , each filling its own table that are merged at the end
+	the type comes from d_type , so nothing is stat'ed unless you ask for wantStat
+	(or the file system doesn't fill d_type)
+on Windows it's the FindFirstFile walk on this thread ; size and time come free with it
+
+like EnumFiles , symlinks (reparse points) are not followed or returned
+on posix only regular files and directories are returned ; devices , fifos , sockets are skipped
+
+**/
+
+struct FileEnumOptions
+{
+	bool	recurse;
+	bool	wantDirs;		// add entries for directories too
+	bool	wantStat;		// fill size and modTime
+	int		numThreads;		// 0 = one per core
+	int		bufferBytes;	// getdents64 buffer per thread
+
+	FileEnumOptions();
+};
+
+struct FileEnumEntry
+{
+	int64	pathOffset;		// in FileEnumTable::pathChars ; null terminated
+	int		pathLen;
+	bool	isDir;
+	int64	size;			// if wantStat
+	int64	modTime;		// if wantStat ; FILETIME on Windows , nanos since 1970 on posix
+};
+
+struct FileEnumTable
+{
+	vector<char>			pathChars;
+	vector<FileEnumEntry>	entries;
+
+	int size32() const { return entries.size32(); }
+	const FileEnumEntry & operator [] (int i) const { return entries[i]; }
+	const char * GetPath(int i) const { return pathChars.data() + entries[i].pathOffset; }
+
+	void clear() { pathChars.clear(); entries.clear(); }
+	// append a path made of dir + sep + name ; returns the new entry
+	FileEnumEntry * Add(const char * dir,int dirLen,char sep,const char * name,int nameLen,bool isDir);
+};
+
+// returns false if dir can't be read ; unreadable subdirs are skipped
+bool EnumFilesFast(const char * dir,FileEnumTable * pTable,const FileEnumOptions & options = FileEnumOptions());
+
 // SelectOneIfDir : nice way to munge an input file name arg for test apps
 //	if fmName is a file, it's returned
 //	if fmName is a dir, some file within the dir is returned
@@ -0,0 +1,508 @@
+#include "FileReadAhead.h"
+#include "Bswap.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Threading.h"
+
+#include <string.h>
+#include <stdio.h>
+
+START_CB
+
+//=========================================================================================
+
+FileStreamOptions::FileStreamOptions() :
+	bufferBytes(1<<20),
+	numBuffers(4)
+{
+}
+
+//=========================================================================================
+// the hand-off between the caller and the IO thread is two counting semaphores :
+//	"free" counts buffers the producer may fill , "ready" counts buffers the consumer may take
+//	both sides walk the ring in the same order , so the counts are all they need
+//
+// reader : the IO thread produces , the caller consumes
+// writer : the caller produces , the IO thread consumes
+
+struct FileStreamSlot
+{
+	uint8 *	data;
+	int		size;
+	bool	last;
+};
+
+struct FileStreamShared
+{
+	FileRCPtr			file;
+	bool				ownsFile;
+	int64				startPos;
+
+	int					bufferBytes;
+	int					numBuffers;
+	uint8 *				alloc;
+	FileStreamSlot *	slots;
+
+	ThreadSem			free;
+	ThreadSem			ready;
+	int					callerIndex;	// next slot the caller takes
+	bool				callerDone;		// reader : the last buffer has been handed back
+
+	ThreadHandle		thread;
+	bool volatile		quit;
+	bool volatile		failed;
+};
+
+static FileStreamShared * FileStream_Create(const FileRCPtr & file,bool ownsFile,const FileStreamOptions & options)
+{
+	FileStreamShared * sh = new FileStreamShared;
+	sh->file = file;
+	sh->ownsFile = ownsFile;
+	sh->startPos = file->Tell();
+
+	sh->bufferBytes = MAX(options.bufferBytes,4096);
+	sh->numBuffers = MAX(options.numBuffers,2);
+	sh->alloc = (uint8 *) CBALLOC( (size_t)sh->bufferBytes * sh->numBuffers );
+	sh->slots = new FileStreamSlot[sh->numBuffers];
+	for LOOP(i,sh->numBuffers)
+	{
+		sh->slots[i].data = sh->alloc + (size_t)i * sh->bufferBytes;
+		sh->slots[i].size = 0;
+		sh->slots[i].last = false;
+	}
+
+	sh->callerIndex = 0;
+	sh->callerDone = false;
+	sh->quit = false;
+	sh->failed = false;
+	return sh;
+}
+
+static void FileStream_Destroy(FileStreamShared * sh)
+{
+	ThreadSem_Destroy(&sh->free);
+	ThreadSem_Destroy(&sh->ready);
+	CBFREE(sh->alloc);
+	delete [] sh->slots;
+	delete sh;
+}
+
+//=========================================================================================
+// reader
+
+static CB_THREAD_ROUTINE(FileReadAheadThreadRoutine)
+{
+	FileStreamShared * sh = (FileStreamShared *) param;
+	FILE * fp = sh->file->Get();
+
+	for(int index=0;;index = (index+1) % sh->numBuffers)
+	{
+		// backpressure : wait for the caller to give a buffer back
+		ThreadSem_Wait(&sh->free);
+		if ( sh->quit )
+			break;
+
+		FileStreamSlot & slot = sh->slots[index];
+		slot.size = (int) fread(slot.data,1,sh->bufferBytes,fp);
+		slot.last = ( slot.size < sh->bufferBytes );
+		if ( slot.last && ferror(fp) )
+			sh->failed = true;
+
+		ThreadSem_Post(&sh->ready);
+
+		if ( slot.last )
+			break;
+	}
+
+	CB_THREAD_RETURN;
+}
+
+FileReadAhead::FileReadAhead() :
+	m_shared(NULL),
+	m_slot(-1),
+	m_current(NULL),
+	m_ptr(NULL),
+	m_end(NULL),
+	m_consumed(0),
+	m_eof(false)
+{
+}
+
+FileReadAhead::~FileReadAhead()
+{
+	Close();
+}
+
+bool FileReadAhead::Open(const char * name,const FileStreamOptions & options)
+{
+	Close();
+
+	FileRCPtr file = FileRC::Create(name,"rb");
+	if ( file == NULL || ! file->IsOpen() )
+		return false;
+
+	m_shared = FileStream_Create(file,true,options);
+	return Start();
+}
+
+bool FileReadAhead::Open(const FileRCPtr & file,const FileStreamOptions & options)
+{
+	Close();
+
+	if ( file == NULL || ! file->IsOpen() || ! file->IsReading() )
+		return false;
+
+	m_shared = FileStream_Create(file,false,options);
+	return Start();
+}
+
+bool FileReadAhead::Start()
+{
+	FileStreamShared * sh = m_shared;
+
+	// every buffer starts free for the IO thread to fill
+	ThreadSem_Init(&sh->free,sh->numBuffers,sh->numBuffers);
+	ThreadSem_Init(&sh->ready,0,sh->numBuffers);
+
+	if ( ! Thread_Start(&sh->thread,FileReadAheadThreadRoutine,sh) )
+	{
+		lprintf("FileReadAhead : couldn't start the IO thread\n");
+		FileStream_Destroy(sh);
+		m_shared = NULL;
+		return false;
+	}
+
+	m_slot = -1;
+	m_current = m_ptr = m_end = NULL;
+	m_consumed = 0;
+	m_eof = false;
+	return true;
+}
+
+void FileReadAhead::Close()
+{
+	if ( ! m_shared )
+		return;
+
+	FileStreamShared * sh = m_shared;
+
+	// wake the IO thread if it's waiting on a free buffer ; if it's in a read
+	//	it finishes that and then sees quit
+	sh->quit = true;
+	ThreadSem_Post(&sh->free);
+	Thread_Join(sh->thread);
+
+	if ( sh->failed )
+		lprintf("FileReadAhead : read error (%s)\n",sh->file->GetName());
+
+	// the thread read past what we consumed ; put the file back
+	if ( ! sh->ownsFile )
+		sh->file->Seek(sh->startPos + Tell());
+
+	FileStream_Destroy(sh);
+	m_shared = NULL;
+	m_slot = -1;
+	m_current = m_ptr = m_end = NULL;
+}
+
+bool FileReadAhead::NextBuffer(const uint8 ** pData,int * pSize)
+{
+	*pData = NULL;
+	*pSize = 0;
+
+	FileStreamShared * sh = m_shared;
+	if ( ! sh || sh->callerDone )
+		return false;
+
+	m_consumed += m_end - m_current;
+	m_current = m_ptr = m_end;
+
+	if ( m_slot >= 0 )
+	{
+		const bool wasLast = sh->slots[m_slot].last;
+		// give it back to the IO thread
+		ThreadSem_Post(&sh->free);
+		m_slot = -1;
+		if ( wasLast )
+		{
+			sh->callerDone = true;
+			return false;
+		}
+	}
+
+	ThreadSem_Wait(&sh->ready);
+	m_slot = sh->callerIndex;
+	sh->callerIndex = (sh->callerIndex + 1) % sh->numBuffers;
+
+	const FileStreamSlot & slot = sh->slots[m_slot];
+	m_current = m_ptr = slot.data;
+	m_end = slot.data + slot.size;
+
+	if ( slot.size == 0 )
+		return false;
+
+	*pData = slot.data;
+	*pSize = slot.size;
+	return true;
+}
+
+void FileReadAhead::Read(void * bits,int count)
+{
+	uint8 * into = (uint8 *) bits;
+
+	while ( count > 0 )
+	{
+		int avail = (int)( m_end - m_ptr );
+		if ( avail == 0 )
+		{
+			// NextBuffer hands back the whole buffer ; we walk it with m_ptr instead
+			const uint8 * data;
+			int size;
+			if ( ! NextBuffer(&data,&size) )
+				break;
+			continue;
+		}
+
+		int n = MIN(count,avail);
+		memcpy(into,m_ptr,n);
+		m_ptr += n;
+		into += n;
+		count -= n;
+	}
+
+	if ( count > 0 )
+	{
+		memset(into,0,count);
+		m_eof = true;
+	}
+}
+
+uint16 FileReadAhead::Get16()
+{
+	uint16 val;
+	Read(&val,sizeof(val));
+	return Bswap16(val);
+}
+
+uint32 FileReadAhead::Get32()
+{
+	uint32 val;
+	if ( m_end - m_ptr >= (ptrdiff_t)sizeof(val) )
+	{
+		memcpy(&val,m_ptr,sizeof(val));
+		m_ptr += sizeof(val);
+	}
+	else
+	{
+		Read(&val,sizeof(val));
+	}
+	return Bswap32(val);
+}
+
+uint64 FileReadAhead::Get64()
+{
+	uint64 val;
+	Read(&val,sizeof(val));
+	return Bswap64(val);
+}
+
+//=========================================================================================
+// writer
+
+static CB_THREAD_ROUTINE(FileWriteBehindThreadRoutine)
+{
+	FileStreamShared * sh = (FileStreamShared *) param;
+
+	for(int index=0;;index = (index+1) % sh->numBuffers)
+	{
+		ThreadSem_Wait(&sh->ready);
+
+		FileStreamSlot & slot = sh->slots[index];
+		if ( slot.size > 0 )
+		{
+			FILE * fp = sh->file->Get();
+			if ( fwrite(slot.data,1,slot.size,fp) != (size_t)slot.size )
+				sh->failed = true;
+		}
+		const bool last = slot.last;
+
+		ThreadSem_Post(&sh->free);
+
+		if ( last )
+			break;
+	}
+
+	CB_THREAD_RETURN;
+}
+
+FileWriteBehind::FileWriteBehind() :
+	m_shared(NULL),
+	m_slot(-1),
+	m_current(NULL),
+	m_ptr(NULL),
+	m_end(NULL),
+	m_submitted(0)
+{
+}
+
+FileWriteBehind::~FileWriteBehind()
+{
+	Close();
+}
+
+bool FileWriteBehind::Open(const char * name,const FileStreamOptions & options)
+{
+	Close();
+
+	FileRCPtr file = FileRC::Create(name,"wb");
+	if ( file == NULL || ! file->IsOpen() )
+		return false;
+
+	m_shared = FileStream_Create(file,true,options);
+	return Start();
+}
+
+bool FileWriteBehind::Open(const FileRCPtr & file,const FileStreamOptions & options)
+{
+	Close();
+
+	if ( file == NULL || ! file->IsOpen() || file->IsReading() )
+		return false;
+
+	m_shared = FileStream_Create(file,false,options);
+	return Start();
+}
+
+bool FileWriteBehind::Start()
+{
+	FileStreamShared * sh = m_shared;
+
+	// every buffer starts free for us to fill
+	ThreadSem_Init(&sh->free,sh->numBuffers,sh->numBuffers);
+	ThreadSem_Init(&sh->ready,0,sh->numBuffers);
+
+	if ( ! Thread_Start(&sh->thread,FileWriteBehindThreadRoutine,sh) )
+	{
+		lprintf("FileWriteBehind : couldn't start the IO thread\n");
+		FileStream_Destroy(sh);
+		m_shared = NULL;
+		return false;
+	}
+
+	m_submitted = 0;
+
+	ThreadSem_Wait(&sh->free);
+	m_slot = sh->callerIndex;
+	sh->callerIndex = (sh->callerIndex + 1) % sh->numBuffers;
+	m_current = m_ptr = sh->slots[m_slot].data;
+	m_end = m_current + sh->bufferBytes;
+	return true;
+}
+
+// hand the current buffer to the IO thread ; unless it's the last , take the next one
+void FileWriteBehind::Submit(bool last)
+{
+	FileStreamShared * sh = m_shared;
+	ASSERT( m_slot >= 0 );
+
+	FileStreamSlot & slot = sh->slots[m_slot];
+	slot.size = (int)( m_ptr - m_current );
+	slot.last = last;
+	m_submitted += slot.size;
+
+	ThreadSem_Post(&sh->ready);
+	m_slot = -1;
+	m_current = m_ptr = m_end = NULL;
+
+	if ( last )
+		return;
+
+	// backpressure : blocks while every buffer is queued for writing
+	ThreadSem_Wait(&sh->free);
+	m_slot = sh->callerIndex;
+	sh->callerIndex = (sh->callerIndex + 1) % sh->numBuffers;
+	m_current = m_ptr = sh->slots[m_slot].data;
+	m_end = m_current + sh->bufferBytes;
+}
+
+void FileWriteBehind::Write(const void * bits,int count)
+{
+	ASSERT( m_shared != NULL );
+	const uint8 * from = (const uint8 *) bits;
+
+	while ( count > 0 )
+	{
+		int n = MIN(count,(int)(m_end - m_ptr));
+		memcpy(m_ptr,from,n);
+		m_ptr += n;
+		from += n;
+		count -= n;
+
+		if ( m_ptr == m_end )
+			Submit(false);
+	}
+}
+
+void FileWriteBehind::Put16(const uint16 val)
+{
+	const uint16 out = Bswap16(val);
+	Write(&out,sizeof(out));
+}
+
+void FileWriteBehind::Put32(const uint32 val)
+{
+	const uint32 out = Bswap32(val);
+	if ( m_end - m_ptr >= (ptrdiff_t)sizeof(out) )
+	{
+		memcpy(m_ptr,&out,sizeof(out));
+		m_ptr += sizeof(out);
+	}
+	else
+	{
+		Write(&out,sizeof(out));
+	}
+}
+
+void FileWriteBehind::Put64(const uint64 val)
+{
+	const uint64 out = Bswap64(val);
+	Write(&out,sizeof(out));
+}
+
+void FileWriteBehind::Flush()
+{
+	FileStreamShared * sh = m_shared;
+	if ( ! sh )
+		return;
+
+	if ( m_ptr != m_current )
+		Submit(false);
+
+	// we hold one buffer ; when we can also take the other N-1 , the IO thread is idle
+	for LOOP(i,sh->numBuffers-1)
+		ThreadSem_Wait(&sh->free);
+	for LOOP(i,sh->numBuffers-1)
+		ThreadSem_Post(&sh->free);
+
+	sh->file->Flush();
+}
+
+void FileWriteBehind::Close()
+{
+	FileStreamShared * sh = m_shared;
+	if ( ! sh )
+		return;
+
+	Submit(true);
+	Thread_Join(sh->thread);
+
+	if ( sh->failed )
+		lprintf("FileWriteBehind : write error (%s)\n",sh->file->GetName());
+
+	sh->file->Flush();
+
+	FileStream_Destroy(sh);
+	m_shared = NULL;
+}
+
+END_CB
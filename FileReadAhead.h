@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Base.h"
+#include "File.h"
+
+/**
+
+FileReadAhead / FileWriteBehind : overlap file IO with whatever you're doing to the bytes
+
+a background thread does all the IO on a FileRC ; N buffers go round between it and you :
+
+FileReadAhead
+	the IO thread reads ahead into every free buffer , you consume them in order
+	NextBuffer hands you a filled buffer zero-copy ; it's yours until the next NextBuffer ,
+		then it goes back to the IO thread to be refilled
+	Read/Get8/Get32 etc. are on top of that for parsers that want a byte stream
+	backpressure is the buffer count : when all N are full the IO thread waits for you
+
+FileWriteBehind
+	Write copies into the current buffer ; when it's full it's handed to the IO thread
+		and you carry on in the next one
+	Write blocks only when all N buffers are still waiting to be written
+	Flush waits until everything is in the file
+
+while a stream is running it owns the FileRC ; don't touch the file yourself until Close
+	Open(FileRCPtr) starts from wherever the file is now
+	Close leaves the file positioned after the last byte you consumed (reader) or wrote (writer)
+
+Get/Put16/32/64 are big endian , like File
+
+**/
+
+START_CB
+
+//-------------------------------------------------------------------------------------------
+
+struct FileStreamOptions
+{
+	int		bufferBytes;	// per buffer
+	int		numBuffers;		// in flight ; 2 is plain double buffering
+
+	FileStreamOptions();
+};
+
+struct FileStreamShared;
+
+//-------------------------------------------------------------------------------------------
+
+class FileReadAhead
+{
+public:
+	FileReadAhead();
+	~FileReadAhead();
+
+	bool Open(const char * name,const FileStreamOptions & options = FileStreamOptions());
+	bool Open(const FileRCPtr & file,const FileStreamOptions & options = FileStreamOptions());
+	void Close();
+
+	bool IsOpen() const { return m_shared != NULL; }
+
+	// the next chunk of the file , in order ; false at the end
+	//	the previous buffer is given back , so pointers into it are dead
+	bool NextBuffer(const uint8 ** pData,int * pSize);
+
+	//----------------------------------------------------
+	// stream on top of NextBuffer
+
+	void Read(void * bits,int count);
+
+	uint8 Get8()
+	{
+		if ( m_ptr < m_end )
+			return *m_ptr++;
+		uint8 val;
+		Read(&val,1);
+		return val;
+	}
+
+	uint16 Get16();
+	uint32 Get32();
+	uint64 Get64();
+
+	// reading past the end gives zeros and sets IsEOF
+	bool IsEOF() const { return m_eof; }
+
+	// bytes consumed since Open
+	int64 Tell() const { return m_consumed + (m_ptr - m_current); }
+
+private:
+	bool Start();
+
+	FileStreamShared *	m_shared;
+	int					m_slot;		// the one we're holding , or -1
+	const uint8 *		m_current;
+	const uint8 *		m_ptr;
+	const uint8 *		m_end;
+	int64				m_consumed;	// before m_current
+	bool				m_eof;
+
+	FORBID_CLASS_STANDARDS(FileReadAhead);
+};
+
+//-------------------------------------------------------------------------------------------
+
+class FileWriteBehind
+{
+public:
+	FileWriteBehind();
+	~FileWriteBehind();
+
+	bool Open(const char * name,const FileStreamOptions & options = FileStreamOptions());
+	bool Open(const FileRCPtr & file,const FileStreamOptions & options = FileStreamOptions());
+	// writes everything out , stops the thread ; the FileRC is flushed but not closed
+	void Close();
+
+	bool IsOpen() const { return m_shared != NULL; }
+
+	void Write(const void * bits,int count);
+
+	void Put8(const uint8 val)
+	{
+		if ( m_ptr < m_end )
+			*m_ptr++ = val;
+		else
+			Write(&val,1);
+	}
+
+	void Put16(const uint16 val);
+	void Put32(const uint32 val);
+	void Put64(const uint64 val);
+
+	// hands off the partial buffer and waits until all of it is written
+	void Flush();
+
+	// bytes written since Open
+	int64 Tell() const { return m_submitted + (m_ptr - m_current); }
+
+private:
+	bool Start();
+	void Submit(bool last);
+
+	FileStreamShared *	m_shared;
+	int					m_slot;
+	uint8 *				m_current;
+	uint8 *				m_ptr;
+	uint8 *				m_end;
+	int64				m_submitted;
+
+	FORBID_CLASS_STANDARDS(FileWriteBehind);
+};
+
+END_CB
@@ -4,6 +4,16 @@
 #include <io.h>
 #include <errno.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+#endif
+
 #include "FileUtil.h"
 #include "Win32Util.h"
 #include "Log.h"
@@ -1206,6 +1216,57 @@ bool WriteWholeFile(FILE * fp,const void * buffer,int64 length)
 	return true;
 }
 
+bool WriteIOVecs(FILE * fp,FileIOVec * iov,int count)
+{
+	#ifndef _WIN32
+	int fd = fileno(fp);
+	if ( fd >= 0 )
+	{
+		// get out from under the FILE's buffer :
+		if ( fflush(fp) != 0 )
+			return false;
+
+		// writev can come back short ; advance through the iovecs and go again
+		const int c_maxIov = 64;
+		while ( count > 0 )
+		{
+			ssize_t wrote = writev(fd,iov,MIN(count,c_maxIov));
+			if ( wrote < 0 )
+			{
+				if ( errno == EINTR ) continue;
+				lprintf("WriteIOVecs : writev failed (%d)\n",errno);
+				return false;
+			}
+			while ( count > 0 && (size_t)wrote >= iov->iov_len )
+			{
+				wrote -= iov->iov_len;
+				iov++;
+				count--;
+			}
+			if ( count > 0 )
+			{
+				iov->iov_base = (char *)iov->iov_base + wrote;
+				iov->iov_len -= wrote;
+			}
+		}
+
+		// let the FILE pick up the new position :
+		fseek(fp,0,SEEK_CUR);
+		return true;
+	}
+	#endif
+
+	for LOOP(i,count)
+	{
+		if ( fwrite(iov[i].iov_base,1,iov[i].iov_len,fp) != iov[i].iov_len )
+		{
+			lprintf("WriteIOVecs : fwrite failed\n");
+			return false;
+		}
+	}
+	return true;
+}
+
 bool WriteWholeFile(const char *name,const void * buffer,int64 length)
 {
 	FILE * fp = fopen(name,"wb");
@@ -1247,35 +1308,6 @@ bool WriteWholeFile(File & file,const void * buffer,int64 length)
 
 //===============================================================
 
-void ReserveFileSpace(const char * name,int toReserve)
-{
-	HANDLE fh = CreateFile(name,GENERIC_WRITE,0,NULL,OPEN_ALWAYS,FILE_ATTRIBUTE_NORMAL,0);
-	if ( fh  == INVALID_HANDLE_VALUE )
-	{
-		return;
-	}
-	
-	int64 oldSize = GetFileSize64(fh);
-	
-	int64 newSize = oldSize + toReserve;
-	
-	int64 dwSet = SetFilePointer64(fh,newSize,FILE_BEGIN);
-	ASSERT_RELEASE( dwSet != INVALID_SET_FILE_POINTER );
-	
-	SetEndOfFile(fh);
-	
-	CloseHandle(fh);
-	
-	fh = CreateFile(name,GENERIC_WRITE,0,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
-	
-	dwSet = SetFilePointer64(fh,oldSize,FILE_BEGIN);
-	ASSERT_RELEASE( dwSet != INVALID_SET_FILE_POINTER );
-	
-	SetEndOfFile(fh);
-	
-	CloseHandle(fh);
-}
-
 int64 GetFileSize64(void * handle)
 {
 	LARGE_INTEGER lint;
@@ -1336,61 +1368,304 @@ int64 WriteFile64(void * hFile,void * buffer, int64 toRead)
     
 void AppendToFile(const char * onto,const char * from,bool andDelete)
 {
-	HANDLE fromFH = CreateFile(from,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
-	if ( fromFH == INVALID_HANDLE_VALUE )
+	int64 fromSize = GetFileLength(from);
+	if ( fromSize == CB_FILE_LENGTH_INVALID || fromSize <= 0 )
+		return; // that's fine
+	
+	if ( ! FileExists(onto) )
 	{
-		if ( GetLastError() == ERROR_FILE_NOT_FOUND )
-			return; // that's fine
-			 
-		LogLastError("AppendToFile CreateFile read failed");
+		// just rename it :		
+		MyMoveFile(from,onto);
 		return;
 	}
 	
-	int64 fromSize = GetFileSize64(fromFH);
+	lprintf("  appending %s onto %s , %lld bytes\n",from,onto,fromSize);
 
-	if ( fromSize <= 0 )
+	if ( ! AppendFile(onto,from) )
 	{
-		CloseHandle(fromFH);
+		LogLastError("AppendToFile failed");
 		return;
-	}	
+	}
+	
+	if ( andDelete )
+	{
+		if ( ! MyDeleteFile(from) )
+		{
+			LogLastError("AppendToFile DeleteFile failed");
+		}
+	}
+}
+
+//===============================================================
+// bulk copies
+
+#define BULK_COPY_CHUNK	(1<<20)
+
+#ifdef _WIN32
+
+bool CloneFile(const char * fm,const char * to)
+{
+	// FSCTL_DUPLICATE_EXTENTS_TO_FILE is ReFS only ; let the caller copy
+	return false;
+}
+
+bool MyCopyFile(const char * fm,const char * to)
+{
+	// CopyFile stays in the kernel and does SMB server-side copies & ODX offload
+	return !! ::CopyFileA(fm,to,FALSE);
+}
+
+bool AppendFile(const char * onto,const char * from)
+{
+	HANDLE fromFH = CreateFile(from,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN,0);
+	if ( fromFH == INVALID_HANDLE_VALUE )
+		return false;
 	
-	HANDLE ontoFH = CreateFile(onto,GENERIC_WRITE,0,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
-	if ( ontoFH  == INVALID_HANDLE_VALUE )
+	HANDLE ontoFH = CreateFile(onto,GENERIC_WRITE,0,NULL,OPEN_ALWAYS,FILE_ATTRIBUTE_NORMAL,0);
+	if ( ontoFH == INVALID_HANDLE_VALUE )
 	{
 		CloseHandle(fromFH);
+		return false;
+	}
+	
+	bool ok = ( SetFilePointer64(ontoFH,0,FILE_END) != INVALID_SET_FILE_POINTER_64 );
+	
+	void * buffer = CBALLOC(BULK_COPY_CHUNK);
+	
+	while ( ok )
+	{
+		int64 got = ReadFile64(fromFH,buffer,BULK_COPY_CHUNK);
+		if ( got <= 0 )
+			break;
+		ok = ( WriteFile64(ontoFH,buffer,got) == got );
+	}
+	
+	CBFREE(buffer);
+	CloseHandle(fromFH);
+	CloseHandle(ontoFH);
+	return ok;
+}
 
-		// just rename it :		
-		MyMoveFile(from,onto);
-		return;
+bool ReserveFileSpace(const char * name,int64 toReserve)
+{
+	HANDLE fh = CreateFile(name,GENERIC_WRITE,0,NULL,OPEN_ALWAYS,FILE_ATTRIBUTE_NORMAL,0);
+	if ( fh  == INVALID_HANDLE_VALUE )
+	{
+		return false;
 	}
 	
-	int64 dwSet = SetFilePointer64(ontoFH,0,FILE_END);
-	ASSERT_RELEASE( dwSet != INVALID_SET_FILE_POINTER_64 );
+	int64 oldSize = GetFileSize64(fh);
+	
+	int64 newSize = oldSize + toReserve;
+	
+	// grow to allocate the clusters , then pull the end back :
+	bool ok = SetFilePointer64(fh,newSize,FILE_BEGIN) != INVALID_SET_FILE_POINTER_64 &&
+			SetEndOfFile(fh) &&
+			SetFilePointer64(fh,oldSize,FILE_BEGIN) != INVALID_SET_FILE_POINTER_64 &&
+			SetEndOfFile(fh);
 	
-	lprintf("  appending %s onto %s , %d bytes\n",from,onto,fromSize);
+	CloseHandle(fh);
+	
+	return ok;
+}
 
-	cb::vector<char> buffer;
-	buffer.resize( check_value_cast<vecsize_t>(fromSize) );
+#else // _WIN32
+
+// copy from the current positions until EOF on fdFrom
+static bool CopyFD(int fdFrom,int fdTo)
+{
+	#ifdef __linux__
 	
-	int64 dwRead = ReadFile64(fromFH,buffer.data(),fromSize);
-	ASSERT_RELEASE( dwRead == fromSize );
+	// copy_file_range : in the kernel , and the fs can reflink or copy server side (NFS 4.2 , SMB)
+	//	EXDEV , EOPNOTSUPP etc. just mean this pair of files can't , so try the next way
+	for(;;)
+	{
+		ssize_t got = copy_file_range(fdFrom,NULL,fdTo,NULL,1<<30,0);
+		if ( got > 0 )
+			continue;
+		if ( got == 0 )
+			return true;
+		if ( errno == EINTR )
+			continue;
+		if ( errno != EXDEV && errno != ENOSYS && errno != EOPNOTSUPP && errno != EINVAL && errno != EBADF )
+			return false;
+		break;
+	}
 	
-	CloseHandle(fromFH);
+	// sendfile : still in the kernel , page cache to page cache
+	for(;;)
+	{
+		ssize_t got = sendfile(fdTo,fdFrom,NULL,1<<30);
+		if ( got > 0 )
+			continue;
+		if ( got == 0 )
+			return true;
+		if ( errno == EINTR )
+			continue;
+		if ( errno != ENOSYS && errno != EINVAL )
+			return false;
+		break;
+	}
 	
-	int64 dwWrote = WriteFile64(ontoFH,buffer.data(),fromSize);
-	ASSERT_RELEASE( dwWrote == fromSize );
+	#endif
 	
-	CloseHandle(ontoFH);
+	void * buffer = CBALLOC(BULK_COPY_CHUNK);
+	bool ok = true;
 	
-	if ( andDelete )
+	for(;;)
 	{
-		if ( ! MyDeleteFile(from) )
+		ssize_t got = read(fdFrom,buffer,BULK_COPY_CHUNK);
+		if ( got < 0 && errno == EINTR )
+			continue;
+		if ( got <= 0 )
 		{
-			LogLastError("AppendToFile DeleteFile failed");
+			ok = ( got == 0 );
+			break;
 		}
+		
+		const char * ptr = (const char *)buffer;
+		while ( got > 0 )
+		{
+			ssize_t put = write(fdTo,ptr,got);
+			if ( put < 0 && errno == EINTR )
+				continue;
+			if ( put <= 0 )
+			{
+				ok = false;
+				break;
+			}
+			ptr += put;
+			got -= put;
+		}
+		if ( ! ok )
+			break;
+	}
+	
+	CBFREE(buffer);
+	return ok;
+}
+
+static bool CloneFD(int fdFrom,int fdTo)
+{
+	#if defined(__linux__) && defined(FICLONE)
+	return ioctl(fdTo,FICLONE,fdFrom) == 0;
+	#else
+	return false;
+	#endif
+}
+
+static int OpenCopyDest(const char * to,int fdFrom)
+{
+	struct stat st;
+	if ( fstat(fdFrom,&st) != 0 )
+		return -1;
+	return open(to,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,st.st_mode & 0777);
+}
+
+bool CloneFile(const char * fm,const char * to)
+{
+	int fdFrom = open(fm,O_RDONLY|O_CLOEXEC);
+	if ( fdFrom < 0 )
+		return false;
+	
+	int fdTo = OpenCopyDest(to,fdFrom);
+	if ( fdTo < 0 )
+	{
+		close(fdFrom);
+		return false;
+	}
+	
+	bool ok = CloneFD(fdFrom,fdTo);
+	
+	close(fdFrom);
+	close(fdTo);
+	
+	if ( ! ok )
+		unlink(to);
+	
+	return ok;
+}
+
+bool MyCopyFile(const char * fm,const char * to)
+{
+	int fdFrom = open(fm,O_RDONLY|O_CLOEXEC);
+	if ( fdFrom < 0 )
+		return false;
+	
+	int fdTo = OpenCopyDest(to,fdFrom);
+	if ( fdTo < 0 )
+	{
+		close(fdFrom);
+		return false;
+	}
+	
+	bool ok = CloneFD(fdFrom,fdTo);
+	if ( ! ok )
+	{
+		#ifdef __linux__
+		// allocate it all up front so the copy lands contiguous ; failure is fine
+		struct stat st;
+		if ( fstat(fdFrom,&st) == 0 && st.st_size > 0 )
+			fallocate(fdTo,FALLOC_FL_KEEP_SIZE,0,st.st_size);
+		#endif
+	
+		ok = CopyFD(fdFrom,fdTo);
 	}
+	
+	close(fdFrom);
+	if ( close(fdTo) != 0 )
+		ok = false;
+	
+	return ok;
 }
 
+bool AppendFile(const char * onto,const char * from)
+{
+	int fdFrom = open(from,O_RDONLY|O_CLOEXEC);
+	if ( fdFrom < 0 )
+		return false;
+	
+	// not O_APPEND ; copy_file_range refuses it
+	int fdTo = open(onto,O_WRONLY|O_CREAT|O_CLOEXEC,0666);
+	if ( fdTo < 0 )
+	{
+		close(fdFrom);
+		return false;
+	}
+	
+	bool ok = ( lseek(fdTo,0,SEEK_END) >= 0 ) && CopyFD(fdFrom,fdTo);
+	
+	close(fdFrom);
+	if ( close(fdTo) != 0 )
+		ok = false;
+	
+	return ok;
+}
+
+bool ReserveFileSpace(const char * name,int64 toReserve)
+{
+	if ( toReserve <= 0 )
+		return true;
+
+	#ifdef __linux__
+	int fd = open(name,O_WRONLY|O_CREAT|O_CLOEXEC,0666);
+	if ( fd < 0 )
+		return false;
+	
+	struct stat st;
+	bool ok = fstat(fd,&st) == 0 &&
+			fallocate(fd,FALLOC_FL_KEEP_SIZE,st.st_size,toReserve) == 0;
+	
+	close(fd);
+	return ok;
+	#else
+	// posix_fallocate would change the size
+	return false;
+	#endif
+}
+
+#endif // _WIN32
+
 //-----------------------------------------------------------
 
 int64 GetFileLength(FILE *fp)
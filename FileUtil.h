@@ -18,6 +18,10 @@ typedef wchar_t wchar;
 
 #include <cwchar>
 
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
 
 START_CB
 
@@ -188,13 +192,47 @@ START_CB
 	bool WriteWholeFile(File & file,const void * buffer,int64 length);
 
 	extern void AppendToFile(const char * onto,const char * from,bool andDelete);
-	extern void ReserveFileSpace(const char * name,int toReserve);
+
+	// bulk copies that don't bring the bytes up to user space where the OS can avoid it
+	//	on Linux : FICLONE reflink , then copy_file_range , then sendfile , then a chunked read/write
+	//	on Windows : CopyFile does its own offload ; AppendFile is chunked
+	// they return false on failure and may leave a partial destination behind
+	// (MyCopyFile because windows.h #defines CopyFile)
+	
+	// CloneFile only succeeds if the file system can share the extents (btrfs , xfs , ...)
+	//	nothing is copied ; false means do a real copy
+	extern bool CloneFile(const char * fm,const char * to);
+	// MyCopyFile overwrites "to" ; clones if it can
+	extern bool MyCopyFile(const char * fm,const char * to);
+	// AppendFile creates "onto" if it doesn't exist
+	extern bool AppendFile(const char * onto,const char * from);
+
+	// allocate toReserve bytes past the current end without changing the file size
+	//	(fallocate KEEP_SIZE on Linux) ; creates the file if needed
+	extern bool ReserveFileSpace(const char * name,int64 toReserve);
 
 	//-----------------------------------------------------------
 	
 	int64 FRead (FILE *fp, void * buf, int64 count);
 	int64 FWrite(FILE *fp, const void * buf, int64 count);
 	extern int64 GetFileLength(FILE *fp);
+
+	// gather write : one piece per iovec , written in order at fp's position
+	//	posix : flushes fp , then writev on its descriptor , going again on short writes
+	//		(the iovecs are advanced over what was written , so they're consumed)
+	//	Windows , or a FILE with no descriptor (memory streams) : fwrite per piece
+	//	returns false (and logs) on a write error
+	#ifdef _WIN32
+	struct FileIOVec
+	{
+		void *	iov_base;
+		size_t	iov_len;
+	};
+	#else
+	typedef struct iovec FileIOVec;
+	#endif
+
+	bool WriteIOVecs(FILE * fp,FileIOVec * iov,int count);
 		
 	// for use with Windows HFILE :
 	#define INVALID_SET_FILE_POINTER_64	((int64)-1)
@@ -1,4 +1,5 @@
 #include "GoogleChart.h"
+#include "StringBuilder.h"
 #include "FloatUtil.h"
 #include "Log.h"
 
@@ -32,10 +33,8 @@ char simpleEncode(double value,double minValue,double maxValue)
 	return simpleEncoding[i];
 }
 
-// extendedEncode : two char encoding
-// Same as simple encoding, but for extended encoding.
-// "e:"
-cb::String extendedEncode(double value,double minValue,double maxValue)
+// fills two chars , no null
+static void extendedEncodeChars(char * str,double value,double minValue,double maxValue)
 {
 	// Scale the value to maxVal.
 	int scaledVal = cb::froundint( (float)( (value - minValue) * extendedEncodeMax / (maxValue - minValue) ) );
@@ -44,9 +43,17 @@ cb::String extendedEncode(double value,double minValue,double maxValue)
 	int top = scaledVal / EXTENDED_MAP_LENGTH;
 	int bottom = scaledVal - EXTENDED_MAP_LENGTH * top;
 
+	str[0] = EXTENDED_MAP[top];
+	str[1] = EXTENDED_MAP[bottom];
+}
+
+// extendedEncode : two char encoding
+// Same as simple encoding, but for extended encoding.
+// "e:"
+cb::String extendedEncode(double value,double minValue,double maxValue)
+{
 	char str[3];
-	str[0] = EXTENDED_MAP[top];;
-	str[1] = EXTENDED_MAP[bottom];;
+	extendedEncodeChars(str,value,minValue,maxValue);
 	str[2] = 0;
 	
 	return cb::String(str);
@@ -66,30 +73,27 @@ cb::String textEncode(double value,double minValue,double maxValue)
 	return cb::String(str);
 }
 
-static cb::String StringFV_E(const vector<double> & v,double lo,double hi)
+static void AppendFV_E(StringBuilder * pInto,const vector<double> & v,double lo,double hi)
 {
-	cb::String ret;
 	int s = v.size32();
 	for(int i=0;i<s;i++)
 	{
-		double f = v[i];
-		ret += GoogleChart::extendedEncode(f,lo,hi);
+		char str[2];
+		extendedEncodeChars(str,v[i],lo,hi);
+		pInto->Append(str,2);
 	}
-	return ret;
 }
 
-static cb::String StringFV_T(const vector<double> & v,double lo,double hi)
+static void AppendFV_T(StringBuilder * pInto,const vector<double> & v,double lo,double hi)
 {
-	cb::String ret;
 	int s = v.size32();
 	for(int i=0;i<s;i++)
 	{
 		if ( i > 0 )
-			ret += ",";
+			*pInto += ',';
 		double f = v[i];
-		ret += GoogleChart::textEncode(f,lo,hi);
+		*pInto += GoogleChart::textEncode(f,lo,hi);
 	}
-	return ret;
 }
 
 static const char * s_colors[] =
@@ -162,7 +166,7 @@ cb::String MakeXYPlot(const vector<PlotSeries> & series,
 	
 	if ( colors == NULL ) colors = s_colors, colors_count = s_colors_count;
 	
-	cb::String html;
+	StringBuilder html;
 	
 	int numSeries = series.size32();
 	String chco = GetChCo(numSeries,colors,colors_count);
@@ -227,9 +231,9 @@ cb::String MakeXYPlot(const vector<PlotSeries> & series,
 	{
 		// @@ I think using the float xMin/Max here is wrong
 		// it should use the ints too match what was given to chxr
-		html += StringFV_E(series[i].x,xMin,xMax);
+		AppendFV_E(&html,series[i].x,xMin,xMax);
 		html += ",";
-		html += StringFV_E(series[i].y,yMin,yMax);
+		AppendFV_E(&html,series[i].y,yMin,yMax);
 		if ( i != series.size32()-1 )
 			html += ",";
 	}
@@ -254,7 +258,7 @@ cb::String MakeXYPlot(const vector<PlotSeries> & series,
 		html += chm;
 	}
 	
-	return html;
+	return html.ToString();
 }
 
 
@@ -389,7 +393,7 @@ String MakeBarChart(const vector<GoogleChart::PlotSeries> & series,double minVal
 {
 	if ( colors == NULL ) colors = s_colors, colors_count = s_colors_count;
 	
-	String ret;
+	StringBuilder ret;
 
 	int numSeries = series.size();
 	int numValues = 0;
@@ -473,8 +477,9 @@ String MakeBarChart(const vector<GoogleChart::PlotSeries> & series,double minVal
 			for LOOPVEC(j,series[i].x)
 			{
 				double cur = series[i].x[j];
-				String s = GoogleChart::extendedEncode(cur,minVal,maxVal);
-				ret += s; //autoToString("%a",s);
+				char str[2];
+				extendedEncodeChars(str,cur,minVal,maxVal);
+				ret.Append(str,2);
 			}
 		}
 	}
@@ -491,7 +496,7 @@ String MakeBarChart(const vector<GoogleChart::PlotSeries> & series,double minVal
 				if ( j > 0 )
 					ret += (",");
 				double cur = series[i].x[j];
-				ret += StringPrintf("%.3f",cur);
+				ret.CatPrintf("%.3f",cur);
 			}
 		}
 	}
@@ -514,7 +519,7 @@ String MakeBarChart(const vector<GoogleChart::PlotSeries> & series,double minVal
 	}
 	*/
 			
-	return ret;
+	return ret.ToString();
 }
 
 struct FuckC
@@ -535,9 +540,9 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 	const vector<String> & labels2)
 {
 	
-	String html;
+	StringBuilder html;
 
-	html += autoToString("http://chart.apis.google.com/chart?cht=s&chs=800x360");
+	html += "http://chart.apis.google.com/chart?cht=s&chs=800x360";
 	
 	/*
 	html += "&chtt=";
@@ -592,9 +597,9 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 	//*
 	html += "&chd=e:";
 	
-	html += StringFV_E(series.x,(double)xMinI,(double)xMaxI);
+	AppendFV_E(&html,series.x,(double)xMinI,(double)xMaxI);
 	html += ",";
-	html += StringFV_E(series.y,(double)yMinI,(double)yMaxI);
+	AppendFV_E(&html,series.y,(double)yMinI,(double)yMaxI);
 	/**/
 
 	/*
@@ -603,16 +608,16 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 	chart_sizes.resize(series.y.size());
 	for LOOPVEC(i,chart_sizes)
 		chart_sizes[i] = 10.f;
-	html += StringFV_E(chart_sizes,0.f,100.f);
+	AppendFV_E(&html,chart_sizes,0.f,100.f);
 	/**/
 	
 	/*
 
 	html += "&chd=t:";
 	
-	html += StringFV_T(series.x,(double)xMinI,(double)xMaxI);
+	AppendFV_T(&html,series.x,(double)xMinI,(double)xMaxI);
 	html += "|";
-	html += StringFV_T(series.y,(double)yMinI,(double)yMaxI);
+	AppendFV_T(&html,series.y,(double)yMinI,(double)yMaxI);
 	/**/
 	
 	html += "&chdl=";
@@ -643,7 +648,7 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 		if ( s >= chm_shapes_count )
 		{
 			html += "|o,bbbbbb,0,";
-			html += autoToString("%d,",i);
+			html.CatPrintf("%d,",i);
 			html += "15";
 		}
 	}
@@ -661,10 +666,10 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 		
 		int si = s % chm_shapes_count;
 		char shape = chm_shapes[si];
-		html += autoToString("|%c,",shape);
+		html.CatPrintf("|%c,",shape);
 		html += colors[c];
 		html += ",0,";
-		html += autoToString("%d,",i);
+		html.CatPrintf("%d,",i);
 		html += "10";
 	}
 	
@@ -698,7 +703,7 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 			html += "|t";
 			html += fuckers[i].label;
 			html += ",000000,0,";
-			html += autoToString("%d,",fuckers[i].pi);
+			html.CatPrintf("%d,",fuckers[i].pi);
 			html += "10,,:5:0";
 		}
 
@@ -710,12 +715,12 @@ cb::String MakeScatterChart(const PlotSeries & series,double minX,double maxX,do
 	int nLabels = labels.size32();
 	for(int i=0;i<series.x.size32();i+=nLabels)
 	{
-		html += autoToString("|D,808080,0,%d:%d,1,-1",i,i+nLabels-1);
+		html.CatPrintf("|D,808080,0,%d:%d,1,-1",i,i+nLabels-1);
 	}
 	
 	#endif
 	
-	return html;
+	return html.ToString();
 }
 
 };
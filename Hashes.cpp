@@ -792,6 +792,17 @@ uint64 StrongHash64(const uint8 * bytes, int size)
 	return ret;
 }
 
+uint64 StrongHash64(const uint8 * bytes, int size, uint64 seed)
+{
+	uint32 pc = 0x5768B525 ^ (uint32)(seed>>32);
+	uint32 pb = 0x206F85B3 ^ (uint32)seed;
+	hashlittle2(bytes,size,&pc,&pb);
+
+	uint64 ret = ((uint64)pc<<32) | pb;
+	
+	return ret;
+}
+
 //===============================================================
 
 uint32 MurmurHash2( const void * key, int len, uint32 seed )
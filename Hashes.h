@@ -14,6 +14,8 @@ START_CB
 
 // The recommended File Hash :
 uint64 StrongHash64(const uint8 * bytes, int size);
+// different seeds give independent hashes ; two of them make a 128 bit hash
+uint64 StrongHash64(const uint8 * bytes, int size, uint64 seed);
 
 inline uint32 BitShuffle(uint32 state)
 {
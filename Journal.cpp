@@ -1,100 +1,595 @@
 #include "Journal.h"
-#include "File.h"
-#include <conio.h> // for getch
+#include "LZCodec.h"
+#include "crc.h"
+#include "vector.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Timer.h"
+#include "Threading.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h> // for MoveFile
+#ifdef _WIN32
+#include "Win32Util.h"
+#include <conio.h> // for getch
+#define journal_fseek	_fseeki64
+#define journal_ftell	_ftelli64
+#else
+#include <termios.h>
+#include <unistd.h>
+#define journal_fseek	fseeko
+#define journal_ftell	ftello
+#endif
 
 START_CB
 
+//=========================================================================================
+// file layout , all big endian :
+//	"CBJN" , blockBytes
+//	per block :
+//		raw length , compressed length (top bit = stored raw) , CRC of the raw bytes ,
+//		checkpoint count , that many offsets into the raw bytes , payload
+
+#define JOURNAL_MAGIC		0x43424A4EU		// "CBJN"
+#define JOURNAL_STORED_FLAG	0x80000000U
+#define JOURNAL_NUM_BLOCKS	4
+#define JOURNAL_MIN_BLOCK_BYTES	4096
+#define JOURNAL_MAX_BLOCK_BYTES	(64<<20)	// the loader refuses anything bigger , so don't save it
+
+static const uint32 c_check = 0xC0CAC01A;
+
+JournalOptions::JournalOptions() :
+	compress(true),
+	background(true),
+	blockBytes(256*1024),
+	flushMillis(1000)
+{
+}
+
+static void Journal_Put32(uint8 * ptr,uint32 val)
+{
+	ptr[0] = (uint8)(val>>24);
+	ptr[1] = (uint8)(val>>16);
+	ptr[2] = (uint8)(val>>8);
+	ptr[3] = (uint8)(val);
+}
+
+static uint32 Journal_Get32(const uint8 * ptr)
+{
+	return ((uint32)ptr[0]<<24) | ((uint32)ptr[1]<<16) | ((uint32)ptr[2]<<8) | (uint32)ptr[3];
+}
+
+//=========================================================================================
+// the caller fills blocks , the writer thread drains them ; same ring as FileWriteBehind
+
+struct JournalBlock
+{
+	uint8 *			data;
+	int				size;
+	vector<uint32>	checkpoints;
+	bool			last;
+	bool			flush;	// fflush after writing it
+};
+
+struct JournalCheckpoint
+{
+	int		block;
+	uint32	offset;
+};
+
+// s_checkpoints is in file order , (block,offset)
+static bool JournalCheckpoint_Before(const JournalCheckpoint & a,const JournalCheckpoint & b)
+{
+	return a.block < b.block || ( a.block == b.block && a.offset < b.offset );
+}
+
 static Journal::EMode s_mode = Journal::eNone;
-static const char * s_journalName = ".\\log\\journal";
-static const char * s_journalPrevName = ".\\log\\journal_prev";
-static File s_file;
+static const char * s_journalName = "log/journal";
+static const char * s_journalPrevName = "log/journal_prev";
+static FILE * s_fp = NULL;
+static JournalOptions s_options;
+static bool s_registeredExit = false;
 
-void Journal::StartSaving()
+// saving :
+static JournalBlock s_blocks[JOURNAL_NUM_BLOCKS];
+static int s_cur = -1;			// the block the caller is filling
+static int s_callerIndex = 0;
+static int s_numSaved = 0;		// checkpoints written
+static uint8 * s_scratch = NULL;	// compressed output ; writer side only
+static ThreadSem s_free;
+static ThreadSem s_ready;
+static ThreadHandle s_thread;
+static bool s_failed = false;
+static uint64 s_lastSubmitMillis = 0;
+
+// loading :
+static int s_blockBytes = 0;
+static vector<int64> s_blockOffsets;
+static vector<JournalCheckpoint> s_checkpoints;
+static uint8 * s_loadRaw = NULL;
+static uint8 * s_loadComp = NULL;
+static int s_loadBlock = -1;
+static int s_loadSize = 0;
+static int s_loadPos = 0;
+
+//=========================================================================================
+// saving
+
+static void Journal_WriteBlock(JournalBlock * block)
 {
-	try
+	if ( block->size == 0 && block->checkpoints.empty() )
+		return;
+
+	CRC crc;
+	crc.AddArray(block->data,block->size);
+
+	int compLen = 0;
+	if ( s_options.compress )
+		compLen = LZ_CompressBlock(block->data,block->size,s_scratch,block->size-1);
+	const bool stored = ( compLen == 0 );
+
+	uint8 header[16];
+	Journal_Put32(header+0,(uint32)block->size);
+	Journal_Put32(header+4, stored ? ( JOURNAL_STORED_FLAG | (uint32)block->size ) : (uint32)compLen );
+	Journal_Put32(header+8,crc.GetHash());
+	Journal_Put32(header+12,block->checkpoints.size32());
+
+	bool ok = fwrite(header,1,sizeof(header),s_fp) == sizeof(header);
+	for LOOPVEC(i,block->checkpoints)
 	{
-		s_mode = eSaving;
-		
-		// move old journal to prev :
-		DeleteFile(s_journalPrevName);
-		MoveFile(s_journalName,s_journalPrevName);
-	
-		// clear it :
-		s_file.Open(s_journalName,"wb");
-		s_file.Close();
+		uint8 offset[4];
+		Journal_Put32(offset,block->checkpoints[i]);
+		ok = ok && fwrite(offset,1,4,s_fp) == 4;
 	}
-	catch(...)
+
+	const uint8 * payload = stored ? block->data : s_scratch;
+	const int payloadLen = stored ? block->size : compLen;
+	ok = ok && fwrite(payload,1,payloadLen,s_fp) == (size_t)payloadLen;
+
+	if ( ok && block->flush )
+		ok = fflush(s_fp) == 0;
+
+	if ( ! ok )
+		s_failed = true;
+}
+
+static CB_THREAD_ROUTINE(JournalWriterThreadRoutine)
+{
+	for(int index=0;;index = (index+1) % JOURNAL_NUM_BLOCKS)
 	{
-		s_mode = eNone;
+		ThreadSem_Wait(&s_ready);
+
+		JournalBlock & block = s_blocks[index];
+		Journal_WriteBlock(&block);
+		const bool last = block.last;
+
+		ThreadSem_Post(&s_free);
+
+		if ( last )
+			break;
 	}
+
+	CB_THREAD_RETURN;
 }
 
-void Journal::StartLoading()
+static void Journal_TakeBlock()
 {
-	try
+	if ( s_options.background )
 	{
-		s_mode = eLoading;
-		s_file.Open(s_journalName,"rb");
+		ThreadSem_Wait(&s_free);
+		s_cur = s_callerIndex;
+		s_callerIndex = (s_callerIndex + 1) % JOURNAL_NUM_BLOCKS;
 	}
-	catch(...)
+	else
 	{
-		s_mode = eNone;
+		s_cur = 0;
 	}
+
+	JournalBlock & block = s_blocks[s_cur];
+	block.size = 0;
+	block.checkpoints.clear();
+	block.last = false;
+	block.flush = false;
 }
 
-Journal::EMode Journal::GetMode()
+// hand off the current block ; unless it's the last , take the next one
+static void Journal_SubmitBlock(bool last,bool flush = false)
 {
-	return s_mode;
+	JournalBlock & block = s_blocks[s_cur];
+	block.last = last;
+	block.flush = flush;
+	s_lastSubmitMillis = Timer::GetMillis64();
+
+	if ( s_options.background )
+		ThreadSem_Post(&s_ready);
+	else
+		Journal_WriteBlock(&block);
+
+	s_cur = -1;
+
+	if ( ! last )
+		Journal_TakeBlock();
 }
 
-void Journal::Read(void * bits,int size)
+// a crash is what the journal is for , and atexit doesn't run then ;
+//	so low rate input (keys , seeds) can't sit in a partial block for long :
+static void Journal_PeriodicFlush()
 {
-	ASSERT( s_mode == eLoading );
-	s_file.Read(bits,size);
-	
-		/*
-	try
+	if ( s_options.flushMillis <= 0 || s_blocks[s_cur].size == 0 )
+		return;
+	const uint64 now = Timer::GetMillis64();
+	if ( now - s_lastSubmitMillis >= (uint64)s_options.flushMillis )
+		Journal_SubmitBlock(false,true);
+}
+
+static void Journal_AtExit()
+{
+	Journal::Stop();
+}
+
+void Journal::StartSaving(const JournalOptions & options)
+{
+	Stop();
+
+	// move old journal to prev :
+	remove(s_journalPrevName);
+	rename(s_journalName,s_journalPrevName);
+
+	s_fp = fopen(s_journalName,"wb");
+	if ( ! s_fp )
 	{
-		// s_file should be already open
-		if ( s_file.Read(bits,size) != size )
-		{
-			// journal is over! stop reading
-			fprintf(stderr,"==============================================================\n");
-			fprintf(stderr,"Hit end of journal, no more reading!!\n");
-			fprintf(stderr,"==============================================================\n");
-			s_mode = eNone;
+		lprintf("Journal : couldn't open %s\n",s_journalName);
+		return;
+	}
+
+	s_options = options;
+	s_options.blockBytes = MAX(s_options.blockBytes,JOURNAL_MIN_BLOCK_BYTES);
+	s_options.blockBytes = MIN(s_options.blockBytes,JOURNAL_MAX_BLOCK_BYTES);
+
+	uint8 header[8];
+	Journal_Put32(header+0,JOURNAL_MAGIC);
+	Journal_Put32(header+4,(uint32)s_options.blockBytes);
+	fwrite(header,1,sizeof(header),s_fp);
 
-			memset(bits,0,size);
+	for LOOP(i,JOURNAL_NUM_BLOCKS)
+		s_blocks[i].data = (uint8 *) CBALLOC(s_options.blockBytes);
+	s_scratch = (uint8 *) CBALLOC(s_options.blockBytes);
+	s_callerIndex = 0;
+	s_numSaved = 0;
+	s_failed = false;
+
+	if ( s_options.background )
+	{
+		ThreadSem_Init(&s_free,JOURNAL_NUM_BLOCKS,JOURNAL_NUM_BLOCKS);
+		ThreadSem_Init(&s_ready,0,JOURNAL_NUM_BLOCKS);
+		if ( ! Thread_Start(&s_thread,JournalWriterThreadRoutine,NULL) )
+		{
+			ThreadSem_Destroy(&s_free);
+			ThreadSem_Destroy(&s_ready);
+			s_options.background = false;
 		}
 	}
-	catch(...)
+
+	Journal_TakeBlock();
+	s_lastSubmitMillis = Timer::GetMillis64();
+
+	s_mode = eSaving;
+
+	if ( ! s_registeredExit )
 	{
+		atexit(Journal_AtExit);
+		s_registeredExit = true;
 	}
-		*/
 }
 
 void Journal::Write(const void * bits,int size)
 {
 	ASSERT( s_mode == eSaving );
-	try
+	if ( s_mode != eSaving )
+		return;
+
+	const uint8 * from = (const uint8 *) bits;
+	while ( size > 0 )
 	{
-		File file(s_journalName,"ab");
-		file.Write(bits,size);
+		JournalBlock & block = s_blocks[s_cur];
+		if ( block.size == s_options.blockBytes )
+		{
+			Journal_SubmitBlock(false);
+			continue;
+		}
+
+		int n = MIN( size, s_options.blockBytes - block.size );
+		memcpy(block.data + block.size,from,n);
+		block.size += n;
+		from += n;
+		size -= n;
 	}
-	catch(...)
+
+	Journal_PeriodicFlush();
+}
+
+void Journal::Flush()
+{
+	if ( s_mode != eSaving )
+		return;
+
+	Journal_SubmitBlock(false);
+
+	if ( s_options.background )
 	{
+		// we hold one block ; once the other N-1 are free the thread has written everything
+		for LOOP(i,JOURNAL_NUM_BLOCKS-1)
+			ThreadSem_Wait(&s_free);
+		for LOOP(i,JOURNAL_NUM_BLOCKS-1)
+			ThreadSem_Post(&s_free);
 	}
+
+	fflush(s_fp);
 }
 
-void Journal::Checkpoint()
+//=========================================================================================
+// loading
+
+// read the block headers , skipping the data , to find the blocks and checkpoints
+static bool Journal_ScanBlocks()
 {
-	static const uint32 c_check = 0xC0CAC01A;
+	uint8 header[16];
+	if ( fread(header,1,8,s_fp) != 8 || Journal_Get32(header) != JOURNAL_MAGIC )
+		return false;
+
+	s_blockBytes = (int) Journal_Get32(header+4);
+	if ( s_blockBytes <= 0 || s_blockBytes > JOURNAL_MAX_BLOCK_BYTES )
+		return false;
+
+	journal_fseek(s_fp,0,SEEK_END);
+	const int64 fileSize = journal_ftell(s_fp);
+	journal_fseek(s_fp,8,SEEK_SET);
+
+	for(;;)
+	{
+		const int64 offset = journal_ftell(s_fp);
+		if ( fread(header,1,sizeof(header),s_fp) != sizeof(header) )
+			break;
+
+		const uint32 rawLen = Journal_Get32(header+0);
+		const uint32 compLen = Journal_Get32(header+4) & ~JOURNAL_STORED_FLAG;
+		const uint32 numCheckpoints = Journal_Get32(header+12);
+		if ( rawLen > (uint32)s_blockBytes || compLen > (uint32)s_blockBytes || numCheckpoints > rawLen )
+			break;
+
+		const int block = s_blockOffsets.size32();
+		for LOOP(i,(int)numCheckpoints)
+		{
+			uint8 buf[4];
+			if ( fread(buf,1,4,s_fp) != 4 )
+				break;
+			JournalCheckpoint cp;
+			cp.block = block;
+			cp.offset = Journal_Get32(buf);
+			s_checkpoints.push_back(cp);
+		}
+
+		// a block cut off at the end doesn't count :
+		if ( journal_fseek(s_fp,compLen,SEEK_CUR) != 0 || journal_ftell(s_fp) > fileSize )
+			break;
+
+		s_blockOffsets.push_back(offset);
+	}
+
+	// drop checkpoints in a partial last block
+	while ( ! s_checkpoints.empty() && s_checkpoints.back().block >= s_blockOffsets.size32() )
+		s_checkpoints.pop_back();
+
+	return true;
+}
+
+static bool Journal_LoadBlock(int block)
+{
+	s_loadBlock = block;
+	s_loadSize = 0;
+	s_loadPos = 0;
+
+	if ( block >= s_blockOffsets.size32() )
+		return false;
+
+	uint8 header[16];
+	if ( journal_fseek(s_fp,s_blockOffsets[block],SEEK_SET) != 0 ||
+		fread(header,1,sizeof(header),s_fp) != sizeof(header) )
+		return false;
+
+	const int rawLen = (int) Journal_Get32(header+0);
+	const uint32 compWord = Journal_Get32(header+4);
+	const bool stored = ( compWord & JOURNAL_STORED_FLAG ) != 0;
+	const int compLen = (int)( compWord & ~JOURNAL_STORED_FLAG );
+	const uint32 numCheckpoints = Journal_Get32(header+12);
+
+	if ( journal_fseek(s_fp,numCheckpoints*4,SEEK_CUR) != 0 )
+		return false;
+
+	bool ok;
+	if ( stored )
+	{
+		ok = ( compLen == rawLen ) && fread(s_loadRaw,1,rawLen,s_fp) == (size_t)rawLen;
+	}
+	else
+	{
+		ok = fread(s_loadComp,1,compLen,s_fp) == (size_t)compLen &&
+			LZ_DecompressBlock(s_loadComp,compLen,s_loadRaw,rawLen);
+	}
+
+	if ( ok )
+	{
+		CRC crc;
+		crc.AddArray(s_loadRaw,rawLen);
+		ok = ( crc.GetHash() == Journal_Get32(header+8) );
+	}
+
+	if ( ! ok )
+	{
+		lprintf("Journal : block %d is corrupt\n",block);
+		return false;
+	}
+
+	s_loadSize = rawLen;
+	return true;
+}
+
+void Journal::StartLoading()
+{
+	Stop();
+
+	s_fp = fopen(s_journalName,"rb");
+	if ( ! s_fp )
+	{
+		lprintf("Journal : couldn't open %s\n",s_journalName);
+		return;
+	}
+
+	s_blockOffsets.clear();
+	s_checkpoints.clear();
+	if ( ! Journal_ScanBlocks() )
+	{
+		lprintf("Journal : %s is not a journal\n",s_journalName);
+		fclose(s_fp);
+		s_fp = NULL;
+		return;
+	}
+
+	s_loadRaw = (uint8 *) CBALLOC(s_blockBytes);
+	s_loadComp = (uint8 *) CBALLOC(s_blockBytes);
+	Journal_LoadBlock(0);
+
+	s_mode = eLoading;
+}
+
+void Journal::Read(void * bits,int size)
+{
+	ASSERT( s_mode == eLoading );
+	if ( s_mode != eLoading )
+		return;
+
+	uint8 * into = (uint8 *) bits;
+	while ( size > 0 )
+	{
+		if ( s_loadPos == s_loadSize )
+		{
+			if ( ! Journal_LoadBlock(s_loadBlock+1) )
+				break;
+			continue;
+		}
+
+		int n = MIN( size, s_loadSize - s_loadPos );
+		memcpy(into,s_loadRaw + s_loadPos,n);
+		s_loadPos += n;
+		into += n;
+		size -= n;
+	}
+
+	if ( size > 0 )
+	{
+		// journal is over! stop reading
+		lprintf("==============================================================\n");
+		lprintf("Hit end of journal, no more reading!!\n");
+		lprintf("==============================================================\n");
+		memset(into,0,size);
+		Stop();
+	}
+}
+
+bool Journal::SeekToCheckpoint(int index)
+{
+	if ( s_mode != eLoading || index < 0 || index >= s_checkpoints.size32() )
+		return false;
+
+	const JournalCheckpoint & cp = s_checkpoints[index];
+	if ( ! Journal_LoadBlock(cp.block) )
+		return false;
+
+	s_loadPos = MIN( (int)cp.offset, s_loadSize );
+	return true;
+}
+
+//=========================================================================================
+
+void Journal::Stop()
+{
+	if ( s_mode == eSaving )
+	{
+		Journal_SubmitBlock(true);
+		if ( s_options.background )
+		{
+			Thread_Join(s_thread);
+			ThreadSem_Destroy(&s_free);
+			ThreadSem_Destroy(&s_ready);
+		}
+		if ( s_failed )
+			lprintf("Journal : write error (%s)\n",s_journalName);
+
+		for LOOP(i,JOURNAL_NUM_BLOCKS)
+		{
+			CBFREE(s_blocks[i].data);
+			s_blocks[i].data = NULL;
+		}
+		CBFREE(s_scratch);
+		s_scratch = NULL;
+	}
+	else if ( s_mode == eLoading )
+	{
+		CBFREE(s_loadRaw);
+		CBFREE(s_loadComp);
+		s_loadRaw = s_loadComp = NULL;
+	}
+
+	if ( s_fp )
+	{
+		fclose(s_fp);
+		s_fp = NULL;
+	}
+	s_mode = eNone;
+}
+
+Journal::EMode Journal::GetMode()
+{
+	return s_mode;
+}
+
+int Journal::Checkpoint()
+{
+	int index = -1;
+	if ( IsSaving() )
+	{
+		// the marker has to start in the block that lists it
+		if ( s_blocks[s_cur].size == s_options.blockBytes )
+			Journal_SubmitBlock(false);
+		s_blocks[s_cur].checkpoints.push_back( (uint32) s_blocks[s_cur].size );
+		index = s_numSaved++;
+	}
+	else if ( IsLoading() )
+	{
+		// position in the checkpoint list : the first at or after where we are
+		//	(binary search , so replaying K checkpoints isn't K^2)
+		JournalCheckpoint at;
+		at.block = s_loadBlock;
+		at.offset = (uint32) s_loadPos;
+		index = (int)( std::lower_bound(s_checkpoints.begin(),s_checkpoints.end(),at,JournalCheckpoint_Before) - s_checkpoints.begin() );
+	}
+
 	uint32 check = c_check;
 	IO(check);
 	ASSERT( check == c_check );
+	return index;
+}
+
+int Journal::GetNumCheckpoints()
+{
+	if ( IsSaving() )
+		return s_numSaved;
+	else if ( IsLoading() )
+		return s_checkpoints.size32();
+	return 0;
 }
 
 char Journal::getch()
@@ -107,7 +602,22 @@ char Journal::getch()
 	}
 	else
 	{
+		#ifdef _WIN32
 		char c = (char) ::getch();
+		#else
+		// no line buffering or echo for the one key
+		struct termios oldMode,rawMode;
+		const bool isTerm = ( tcgetattr(STDIN_FILENO,&oldMode) == 0 );
+		if ( isTerm )
+		{
+			rawMode = oldMode;
+			rawMode.c_lflag &= ~(ICANON|ECHO);
+			tcsetattr(STDIN_FILENO,TCSANOW,&rawMode);
+		}
+		char c = (char) getchar();
+		if ( isTerm )
+			tcsetattr(STDIN_FILENO,TCSANOW,&oldMode);
+		#endif
 		IO(c);
 		return c;
 	}
@@ -2,10 +2,38 @@
 
 #include "Base.h"
 
+/**
+
+Journal : record the nondeterministic inputs of a session (keys , times , random seeds) and
+	play them back for a repro
+
+the file is a run of blocks ; each block header has its length , its CRC , and the offsets of
+	the checkpoints that start in it
+Write just copies into the current block ; full blocks go to a background thread that
+	compresses (LZ_CompressBlock) and writes them , so recording costs a memcpy
+	call Flush if you need it on disk now ; Stop (or exit) writes the rest
+	a Write more than flushMillis after the last block went out sends the partial block too ,
+		so a crash loses at most about that much
+StartLoading scans the block headers (not the data) to build the checkpoint index ,
+	so SeekToCheckpoint can start replay from any checkpoint
+	a journal cut off by a crash loads up to its last whole block
+
+**/
+
 START_CB
 
 //-----------------------------------------------------------
 
+struct JournalOptions
+{
+	bool	compress;
+	bool	background;		// compress & write on a thread ; else on the calling thread as blocks fill
+	int		blockBytes;		// clamped to [4K,64M]
+	int		flushMillis;	// a partial block goes to disk (fflushed) this long after the last one ; 0 = only when full
+
+	JournalOptions();
+};
+
 namespace Journal
 {
 	enum EMode
@@ -15,21 +43,32 @@ namespace Journal
 		eLoading
 	};
 
-	void StartSaving();
+	void StartSaving(const JournalOptions & options = JournalOptions());
 	void StartLoading();
+	// writes out anything buffered and closes ; goes back to eNone
+	void Stop();
 
 	EMode GetMode();
 
 	void Read(void * bits,int size);
 	void Write(const void * bits,int size);
 
-	void Checkpoint();
+	// saving : everything written so far goes to disk
+	void Flush();
+
+	// writes (or checks) a marker ; returns the checkpoint's index
+	int Checkpoint();
+
+	// saving : checkpoints so far ; loading : checkpoints in the file
+	int GetNumCheckpoints();
+	// loading : the next Read is the marker of checkpoint "index"
+	bool SeekToCheckpoint(int index);
 
 	char getch();
 
 	inline bool IsSaving()  { return GetMode() == eSaving; }
 	inline bool IsLoading() { return GetMode() == eLoading; }
-	
+
 	template <typename T>
 	void IO(T & data)
 	{
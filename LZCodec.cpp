@@ -0,0 +1,1143 @@
+#include "LZCodec.h"
+#include "Bswap.h"
+#include "crc.h"
+#include "Mem.h"
+#include "Log.h"
+#include "Rand.h"
+#include "Threading.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+START_CB
+
+//=========================================================================================
+// block codec
+//
+// a block is a run of sequences :
+//	token : high nibble literal count , low nibble match length - 4
+//		15 in either means more length follows , in bytes that add up until one isn't 255
+//	the literals
+//	offset : 2 bytes little endian , back from the current output position
+//	(match length extension)
+// the last sequence is literals only and stops after them
+// the encoder never starts a match in the last LZ_MF_LIMIT bytes or runs one into the last
+//	LZ_LAST_LITERALS , so the decoder's 8-byte match copies have room
+
+#define LZ_MIN_MATCH		4
+#define LZ_HASH_BITS		12
+#define LZ_MAX_OFFSET		65535
+#define LZ_LAST_LITERALS	5
+#define LZ_MF_LIMIT			12
+#define LZ_SKIP_SHIFT		6	// after 64 misses step by 2 , after 128 by 3 ...
+
+static inline uint32 LZ_Read32(const uint8 * ptr)
+{
+	uint32 val;
+	memcpy(&val,ptr,sizeof(val));
+	return val;
+}
+
+static inline uint64 LZ_Read64(const uint8 * ptr)
+{
+	uint64 val;
+	memcpy(&val,ptr,sizeof(val));
+	return val;
+}
+
+// how many low bytes of a nonzero xor are zero = how many bytes matched
+static inline int LZ_MatchedBytes(const uint64 diff)
+{
+	#ifdef _MSC_VER
+	unsigned long bit;
+	_BitScanForward64(&bit,diff);
+	return (int)( bit >> 3 );
+	#else
+	return __builtin_ctzll(diff) >> 3;
+	#endif
+}
+
+static inline int LZ_Hash(const uint32 seq)
+{
+	return (int)( (seq * 2654435761U) >> (32 - LZ_HASH_BITS) );
+}
+
+// len is past the 15 in the token
+static inline uint8 * LZ_PutLength(uint8 * op,int len)
+{
+	while ( len >= 255 )
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (uint8) len;
+	return op;
+}
+
+// bytes a sequence with these lengths can take , at most
+static inline int LZ_SequenceBound(int litLen,int matchLen)
+{
+	return 1 + litLen/255 + 1 + litLen + 2 + matchLen/255 + 1;
+}
+
+int LZ_CompressBound(int rawLen)
+{
+	return rawLen + rawLen/255 + 16;
+}
+
+int LZ_CompressBlock(const uint8 * raw,int rawLen,uint8 * comp,int compCapacity)
+{
+	const uint8 * ip = raw;
+	const uint8 * anchor = raw;
+	const uint8 * const iend = raw + rawLen;
+	uint8 * op = comp;
+	uint8 * const oend = comp + compCapacity;
+
+	if ( rawLen > LZ_MF_LIMIT )
+	{
+		// positions from raw ; zero-init just makes the first lookups point at raw[0]
+		uint32 table[1<<LZ_HASH_BITS];
+		memset(table,0,sizeof(table));
+
+		const uint8 * const mflimit = iend - LZ_MF_LIMIT;
+		const uint8 * const matchlimit = iend - LZ_LAST_LITERALS;
+
+		ip++;
+
+		for(;;)
+		{
+			// look for a match , skipping faster the longer we go without one
+			const uint8 * ref = NULL;
+			int misses = 1<<LZ_SKIP_SHIFT;
+			while ( ip <= mflimit )
+			{
+				const uint32 seq = LZ_Read32(ip);
+				const int h = LZ_Hash(seq);
+				ref = raw + table[h];
+				table[h] = (uint32)( ip - raw );
+				if ( ip - ref <= LZ_MAX_OFFSET && LZ_Read32(ref) == seq )
+					break;
+				ip += misses++ >> LZ_SKIP_SHIFT;
+			}
+			if ( ip > mflimit )
+				break;
+
+			while ( ip > anchor && ref > raw && ip[-1] == ref[-1] )
+			{
+				ip--;
+				ref--;
+			}
+
+			const uint8 * mp = ip + LZ_MIN_MATCH;
+			const uint8 * rp = ref + LZ_MIN_MATCH;
+			while ( mp + 8 <= matchlimit )
+			{
+				const uint64 diff = LZ_Read64(mp) ^ LZ_Read64(rp);
+				if ( diff != 0 )
+				{
+					mp += LZ_MatchedBytes(diff);
+					goto matched;
+				}
+				mp += 8;
+				rp += 8;
+			}
+			while ( mp < matchlimit && *mp == *rp )
+			{
+				mp++;
+				rp++;
+			}
+			matched:
+
+			const int litLen = (int)( ip - anchor );
+			const int matchLen = (int)( mp - ip ) - LZ_MIN_MATCH;
+			const int offset = (int)( ip - ref );
+
+			if ( oend - op < LZ_SequenceBound(litLen,matchLen) )
+				return 0;
+
+			uint8 * token = op++;
+			if ( litLen >= 15 )
+			{
+				*token = 15<<4;
+				op = LZ_PutLength(op,litLen-15);
+			}
+			else
+			{
+				*token = (uint8)( litLen<<4 );
+			}
+
+			if ( oend - op >= litLen + 8 )
+			{
+				// 8 at a time , running over ; the offset goes on top
+				//	the read side stays inside raw since ip is at least LZ_MF_LIMIT from the end
+				uint8 * const end = op + litLen;
+				const uint8 * from = anchor;
+				do
+				{
+					memcpy(op,from,8);
+					op += 8;
+					from += 8;
+				} while ( op < end );
+				op = end;
+			}
+			else
+			{
+				memcpy(op,anchor,litLen);
+				op += litLen;
+			}
+
+			op[0] = (uint8)( offset & 0xFF );
+			op[1] = (uint8)( offset >> 8 );
+			op += 2;
+
+			if ( matchLen >= 15 )
+			{
+				*token |= 15;
+				op = LZ_PutLength(op,matchLen-15);
+			}
+			else
+			{
+				*token |= (uint8) matchLen;
+			}
+
+			ip = mp;
+			anchor = ip;
+			if ( ip > mflimit )
+				break;
+
+			// a match often repeats right after another ; put in a position the skip jumped over
+			table[ LZ_Hash(LZ_Read32(ip-2)) ] = (uint32)( ip - 2 - raw );
+		}
+	}
+
+	// last literals :
+	const int litLen = (int)( iend - anchor );
+	if ( oend - op < LZ_SequenceBound(litLen,0) - 2 )
+		return 0;
+
+	if ( litLen >= 15 )
+	{
+		*op++ = 15<<4;
+		op = LZ_PutLength(op,litLen-15);
+	}
+	else
+	{
+		*op++ = (uint8)( litLen<<4 );
+	}
+	memcpy(op,anchor,litLen);
+	op += litLen;
+
+	return (int)( op - comp );
+}
+
+bool LZ_DecompressBlock(const uint8 * comp,int compLen,uint8 * raw,int rawLen)
+{
+	const uint8 * ip = comp;
+	const uint8 * const iend = comp + compLen;
+	uint8 * op = raw;
+	uint8 * const oend = raw + rawLen;
+
+	for(;;)
+	{
+		if ( ip >= iend )
+			return false;
+
+		const int token = *ip++;
+
+		// the common case : short literals , short match , far from both ends
+		//	copy fixed sizes and let them run over ; the next sequence overwrites it
+		if ( token < (15<<4) && iend - ip >= 16 + 2 && oend - op >= 16 + 18 )
+		{
+			const int litLen = token >> 4;
+			memcpy(op,ip,16);
+			op += litLen;
+			ip += litLen;
+
+			const size_t offset = ip[0] | (ip[1]<<8);
+			const int matchLen = ( token & 15 ) + LZ_MIN_MATCH;
+			if ( matchLen < 15 + LZ_MIN_MATCH && offset >= 8 && offset <= (size_t)(op - raw) )
+			{
+				ip += 2;
+				const uint8 * ref = op - offset;
+				memcpy(op,ref,8);
+				memcpy(op+8,ref+8,8);
+				memcpy(op+16,ref+16,2);
+				op += matchLen;
+				continue;
+			}
+			// else : do the match the slow way ; step back so it re-reads the token
+			op -= litLen;
+			ip -= litLen;
+		}
+
+		size_t litLen = token >> 4;
+		if ( litLen == 15 )
+		{
+			int b;
+			do
+			{
+				if ( ip >= iend || litLen > (size_t)rawLen )
+					return false;
+				b = *ip++;
+				litLen += b;
+			} while ( b == 255 );
+		}
+
+		if ( (size_t)(iend - ip) < litLen || (size_t)(oend - op) < litLen )
+			return false;
+		memcpy(op,ip,litLen);
+		op += litLen;
+		ip += litLen;
+
+		if ( ip == iend )
+			return ( op == oend );
+
+		if ( iend - ip < 2 )
+			return false;
+		const size_t offset = ip[0] | (ip[1]<<8);
+		ip += 2;
+		if ( offset == 0 || offset > (size_t)(op - raw) )
+			return false;
+
+		size_t matchLen = token & 15;
+		if ( matchLen == 15 )
+		{
+			int b;
+			do
+			{
+				if ( ip >= iend || matchLen > (size_t)rawLen )
+					return false;
+				b = *ip++;
+				matchLen += b;
+			} while ( b == 255 );
+		}
+		matchLen += LZ_MIN_MATCH;
+
+		if ( (size_t)(oend - op) < matchLen )
+			return false;
+
+		const uint8 * ref = op - offset;
+		if ( offset >= 8 && (size_t)(oend - op) >= matchLen + 8 )
+		{
+			// 8 at a time , running up to 7 past the match ; what follows overwrites it
+			uint8 * const end = op + matchLen;
+			do
+			{
+				memcpy(op,ref,8);
+				op += 8;
+				ref += 8;
+			} while ( op < end );
+			op = end;
+		}
+		else
+		{
+			// overlapping (a run) or at the very end
+			while ( matchLen-- )
+				*op++ = *ref++;
+		}
+	}
+}
+
+//=========================================================================================
+// framing
+
+#define LZ_STREAM_MAGIC		0x43424C5AU		// "CBLZ"
+#define LZ_STORED_FLAG		0x80000000U
+#define LZ_MAX_BLOCK_BYTES	(16<<20)
+
+LZOptions::LZOptions() :
+	blockBytes(256*1024),
+	numThreads(0)
+{
+}
+
+struct LZBlockJob
+{
+	uint8 *		raw;
+	int			rawLen;
+	uint8 *		comp;
+	int			compLen;	// writer : out ; reader : in
+	bool		stored;
+	uint32		crc;		// writer : out ; reader : expected
+	bool		ok;
+};
+
+struct LZStreamShared
+{
+	FileRCPtr		file;
+	bool			reading;
+
+	int				blockBytes;
+	int				numThreads;
+	int				numBlocks;	// per batch
+	uint8 *			raw;		// numBlocks * blockBytes
+	uint8 *			comp;		// numBlocks * blockBytes ; a block that doesn't get smaller is stored
+	LZBlockJob *	jobs;
+
+	int				numJobs;
+	int				curJob;		// reader : the block being consumed
+	long volatile	nextJob;
+
+	// numThreads-1 workers live as long as the stream ; each batch posts "start" once per helper
+	ThreadHandle	workers[64];
+	int				numWorkers;
+	ThreadSem		start;
+	ThreadSem		done;
+	bool volatile	quit;
+};
+
+static CB_THREAD_ROUTINE(LZWorkerThreadRoutine);
+
+static int LZ_NumCores()
+{
+	#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+	#else
+	return (int) sysconf(_SC_NPROCESSORS_ONLN);
+	#endif
+}
+
+static LZStreamShared * LZStream_Create(const FileRCPtr & file,bool reading,int blockBytes,const LZOptions & options)
+{
+	LZStreamShared * sh = new LZStreamShared;
+	sh->file = file;
+	sh->reading = reading;
+
+	int numThreads = options.numThreads;
+	if ( numThreads <= 0 )
+		numThreads = LZ_NumCores();
+	numThreads = MAX(numThreads,1);
+	numThreads = MIN(numThreads,64);
+
+	sh->blockBytes = blockBytes;
+	sh->numThreads = numThreads;
+	sh->numBlocks = numThreads;
+	sh->raw = (uint8 *) CBALLOC( (size_t)blockBytes * sh->numBlocks );
+	sh->comp = (uint8 *) CBALLOC( (size_t)blockBytes * sh->numBlocks );
+	sh->jobs = new LZBlockJob[sh->numBlocks];
+	for LOOP(i,sh->numBlocks)
+	{
+		sh->jobs[i].raw = sh->raw + (size_t)i * blockBytes;
+		sh->jobs[i].comp = sh->comp + (size_t)i * blockBytes;
+	}
+	sh->numJobs = 0;
+	sh->curJob = 0;
+	sh->nextJob = 0;
+
+	sh->quit = false;
+	ThreadSem_Init(&sh->start,0,64);
+	ThreadSem_Init(&sh->done,0,64);
+	sh->numWorkers = 0;
+	for LOOP(i,numThreads-1)
+	{
+		if ( ! Thread_Start(&sh->workers[sh->numWorkers],LZWorkerThreadRoutine,sh) )
+			break; // fine , the rest run on the calling thread
+		sh->numWorkers++;
+	}
+	return sh;
+}
+
+static void LZStream_Destroy(LZStreamShared * sh)
+{
+	sh->quit = true;
+	for LOOP(i,sh->numWorkers)
+		ThreadSem_Post(&sh->start);
+	for LOOP(i,sh->numWorkers)
+		Thread_Join(sh->workers[i]);
+	ThreadSem_Destroy(&sh->start);
+	ThreadSem_Destroy(&sh->done);
+
+	CBFREE(sh->raw);
+	CBFREE(sh->comp);
+	delete [] sh->jobs;
+	delete sh;
+}
+
+static void LZ_RunJob(const LZStreamShared * sh,LZBlockJob * job)
+{
+	if ( sh->reading )
+	{
+		if ( ! job->stored )
+			job->ok = LZ_DecompressBlock(job->comp,job->compLen,job->raw,job->rawLen);
+		else
+			job->ok = true;
+
+		if ( job->ok )
+		{
+			CRC crc;
+			crc.AddArray(job->raw,job->rawLen);
+			job->ok = ( crc.GetHash() == job->crc );
+		}
+	}
+	else
+	{
+		CRC crc;
+		crc.AddArray(job->raw,job->rawLen);
+		job->crc = crc.GetHash();
+
+		// capacity one short of raw , so anything that doesn't shrink comes back 0
+		job->compLen = LZ_CompressBlock(job->raw,job->rawLen,job->comp,job->rawLen-1);
+		job->stored = ( job->compLen == 0 );
+		job->ok = true;
+	}
+}
+
+#ifdef _WIN32
+static long LZ_AtomicIncrement(long volatile * ptr) { return InterlockedIncrement(ptr); }
+#else
+static long LZ_AtomicIncrement(long volatile * ptr) { return __sync_add_and_fetch(ptr,1); }
+#endif
+
+// the blocks are independent ; threads pull them off a counter
+static void LZ_RunJobsHere(LZStreamShared * sh)
+{
+	for(;;)
+	{
+		const int index = (int) LZ_AtomicIncrement(&sh->nextJob) - 1;
+		if ( index >= sh->numJobs )
+			break;
+		LZ_RunJob(sh,&sh->jobs[index]);
+	}
+}
+
+static CB_THREAD_ROUTINE(LZWorkerThreadRoutine)
+{
+	LZStreamShared * sh = (LZStreamShared *) param;
+	for(;;)
+	{
+		ThreadSem_Wait(&sh->start);
+		if ( sh->quit )
+			break;
+		LZ_RunJobsHere(sh);
+		ThreadSem_Post(&sh->done);
+	}
+	CB_THREAD_RETURN;
+}
+
+// wakes only as many workers as there are blocks to spare , this thread helps
+//	the caller waits for every one it woke , so none is still in the counter when the next batch starts
+static void LZ_RunJobs(LZStreamShared * sh)
+{
+	sh->nextJob = 0;
+
+	const int numHelpers = MIN(sh->numWorkers,sh->numJobs-1);
+	for LOOP(i,numHelpers)
+		ThreadSem_Post(&sh->start);
+
+	LZ_RunJobsHere(sh);
+
+	for LOOP(i,numHelpers)
+		ThreadSem_Wait(&sh->done);
+}
+
+//=========================================================================================
+// writer
+
+LZWriteStream::LZWriteStream() :
+	m_shared(NULL),
+	m_begin(NULL),
+	m_ptr(NULL),
+	m_end(NULL),
+	m_flushed(0),
+	m_failed(false)
+{
+}
+
+LZWriteStream::~LZWriteStream()
+{
+	Close();
+}
+
+bool LZWriteStream::Open(const char * name,const LZOptions & options)
+{
+	Close();
+
+	FileRCPtr file = FileRC::Create(name,"wb");
+	if ( file == NULL || ! file->IsOpen() )
+		return false;
+
+	return Open(file,options);
+}
+
+bool LZWriteStream::Open(const FileRCPtr & file,const LZOptions & options)
+{
+	Close();
+
+	if ( file == NULL || ! file->IsOpen() || file->IsReading() )
+		return false;
+
+	int blockBytes = options.blockBytes;
+	blockBytes = MAX(blockBytes,4096);
+	blockBytes = MIN(blockBytes,LZ_MAX_BLOCK_BYTES);
+
+	m_shared = LZStream_Create(file,false,blockBytes,options);
+
+	file->Put32(LZ_STREAM_MAGIC);
+	file->Put32((uint32)blockBytes);
+
+	m_begin = m_ptr = m_shared->raw;
+	m_end = m_begin + (size_t)blockBytes * m_shared->numBlocks;
+	m_flushed = 0;
+	m_failed = false;
+	return true;
+}
+
+void LZWriteStream::FlushBatch()
+{
+	LZStreamShared * sh = m_shared;
+
+	const int len = (int)( m_ptr - m_begin );
+	if ( len == 0 )
+		return;
+
+	m_flushed += len;
+	m_ptr = m_begin;
+
+	// once a write has failed the file is garbage past that point , don't bother compressing
+	if ( m_failed )
+		return;
+
+	sh->numJobs = ( len + sh->blockBytes - 1 ) / sh->blockBytes;
+	for LOOP(i,sh->numJobs)
+		sh->jobs[i].rawLen = MIN( sh->blockBytes, len - i * sh->blockBytes );
+
+	LZ_RunJobs(sh);
+
+	FileRC * file = sh->file.GetPtr();
+	for LOOP(i,sh->numJobs)
+	{
+		const LZBlockJob & job = sh->jobs[i];
+		file->Put32((uint32)job.rawLen);
+		file->Put32( job.stored ? ( LZ_STORED_FLAG | (uint32)job.rawLen ) : (uint32)job.compLen );
+		file->Put32(job.crc);
+
+		const uint8 * payload = job.stored ? job.raw : job.comp;
+		const int payloadLen = job.stored ? job.rawLen : job.compLen;
+		if ( fwrite(payload,1,payloadLen,file->Get()) != (size_t)payloadLen )
+		{
+			m_failed = true;
+			break;
+		}
+	}
+
+	// the Put32s (and the stream header from Open) only show up in ferror
+	if ( ferror(file->Get()) )
+		m_failed = true;
+
+	if ( m_failed )
+		lprintf("LZWriteStream : write error (%s)\n",file->GetName());
+}
+
+bool LZWriteStream::Close()
+{
+	if ( ! m_shared )
+		return true;
+
+	FlushBatch();
+
+	FileRC * file = m_shared->file.GetPtr();
+	if ( ! m_failed )
+		file->Put32(0);
+	file->Flush();
+	if ( ! m_failed && ferror(file->Get()) )
+	{
+		lprintf("LZWriteStream : write error (%s)\n",file->GetName());
+		m_failed = true;
+	}
+
+	LZStream_Destroy(m_shared);
+	m_shared = NULL;
+	m_begin = m_ptr = m_end = NULL;
+	return ! m_failed;
+}
+
+void LZWriteStream::Write(const void * bits,int count)
+{
+	ASSERT( m_shared != NULL );
+	const uint8 * from = (const uint8 *) bits;
+
+	while ( count > 0 )
+	{
+		if ( m_ptr == m_end )
+			FlushBatch();
+
+		int n = MIN( count, (int)( m_end - m_ptr ) );
+		memcpy(m_ptr,from,n);
+		m_ptr += n;
+		from += n;
+		count -= n;
+	}
+}
+
+void LZWriteStream::Put16(const uint16 val)
+{
+	const uint16 swapped = Bswap16(val);
+	Write(&swapped,sizeof(swapped));
+}
+
+void LZWriteStream::Put32(const uint32 val)
+{
+	const uint32 swapped = Bswap32(val);
+	if ( m_end - m_ptr >= (ptrdiff_t)sizeof(swapped) )
+	{
+		memcpy(m_ptr,&swapped,sizeof(swapped));
+		m_ptr += sizeof(swapped);
+	}
+	else
+	{
+		Write(&swapped,sizeof(swapped));
+	}
+}
+
+void LZWriteStream::Put64(const uint64 val)
+{
+	const uint64 swapped = Bswap64(val);
+	Write(&swapped,sizeof(swapped));
+}
+
+//=========================================================================================
+// reader
+
+LZReadStream::LZReadStream() :
+	m_shared(NULL),
+	m_begin(NULL),
+	m_ptr(NULL),
+	m_end(NULL),
+	m_consumed(0),
+	m_eof(false),
+	m_corrupt(false),
+	m_sawEnd(false)
+{
+}
+
+LZReadStream::~LZReadStream()
+{
+	Close();
+}
+
+bool LZReadStream::Open(const char * name,const LZOptions & options)
+{
+	Close();
+
+	FileRCPtr file = FileRC::Create(name,"rb");
+	if ( file == NULL || ! file->IsOpen() )
+		return false;
+
+	return Open(file,options);
+}
+
+bool LZReadStream::Open(const FileRCPtr & file,const LZOptions & options)
+{
+	Close();
+
+	if ( file == NULL || ! file->IsOpen() || ! file->IsReading() )
+		return false;
+
+	const uint32 magic = file->Get32();
+	const uint32 blockBytes = file->Get32();
+	if ( magic != LZ_STREAM_MAGIC || blockBytes == 0 || blockBytes > LZ_MAX_BLOCK_BYTES )
+	{
+		lprintf("LZReadStream : not an LZ stream (%s)\n",file->GetName());
+		return false;
+	}
+
+	m_shared = LZStream_Create(file,true,(int)blockBytes,options);
+
+	m_begin = m_ptr = m_end = NULL;
+	m_consumed = 0;
+	m_eof = false;
+	m_corrupt = false;
+	m_sawEnd = false;
+	return true;
+}
+
+void LZReadStream::Close()
+{
+	if ( ! m_shared )
+		return;
+
+	LZStream_Destroy(m_shared);
+	m_shared = NULL;
+	m_begin = m_ptr = m_end = NULL;
+}
+
+// read the next batch of blocks and decode them ; false at the end or on a bad block
+bool LZReadStream::FillBatch()
+{
+	LZStreamShared * sh = m_shared;
+	if ( m_sawEnd || m_corrupt )
+		return false;
+
+	FileRC * file = sh->file.GetPtr();
+	FILE * fp = file->Get();
+
+	sh->numJobs = 0;
+	while ( sh->numJobs < sh->numBlocks )
+	{
+		const uint32 rawLen = file->Get32();
+		if ( rawLen == 0 || file->IsEOF() )
+		{
+			// a missing end mark is a truncated file
+			m_sawEnd = true;
+			if ( file->IsEOF() )
+				m_corrupt = true;
+			break;
+		}
+
+		const uint32 compWord = file->Get32();
+		const uint32 crc = file->Get32();
+		const bool stored = ( compWord & LZ_STORED_FLAG ) != 0;
+		const uint32 compLen = compWord & ~LZ_STORED_FLAG;
+
+		if ( rawLen > (uint32)sh->blockBytes || compLen > (uint32)sh->blockBytes || ( stored && compLen != rawLen ) )
+		{
+			m_corrupt = true;
+			break;
+		}
+
+		LZBlockJob & job = sh->jobs[sh->numJobs];
+		job.rawLen = (int) rawLen;
+		job.compLen = (int) compLen;
+		job.stored = stored;
+		job.crc = crc;
+
+		uint8 * into = stored ? job.raw : job.comp;
+		if ( fread(into,1,compLen,fp) != compLen )
+		{
+			m_corrupt = true;
+			break;
+		}
+
+		sh->numJobs++;
+	}
+
+	if ( sh->numJobs == 0 )
+		return false;
+
+	LZ_RunJobs(sh);
+
+	// only hand out the blocks before the first bad one
+	for LOOP(i,sh->numJobs)
+	{
+		if ( ! sh->jobs[i].ok )
+		{
+			sh->numJobs = i;
+			m_corrupt = true;
+			m_sawEnd = true;
+			break;
+		}
+	}
+
+	sh->curJob = -1;
+	return sh->numJobs > 0;
+}
+
+void LZReadStream::Read(void * bits,int count)
+{
+	uint8 * into = (uint8 *) bits;
+
+	while ( count > 0 && m_shared )
+	{
+		int avail = (int)( m_end - m_ptr );
+		if ( avail == 0 )
+		{
+			// step to the next decoded block
+			LZStreamShared * sh = m_shared;
+			m_consumed += m_end - m_begin;
+			m_begin = m_ptr = m_end;
+
+			if ( sh->curJob + 1 >= sh->numJobs && ! FillBatch() )
+				break;
+
+			sh->curJob++;
+			const LZBlockJob & job = sh->jobs[sh->curJob];
+			m_begin = m_ptr = job.raw;
+			m_end = job.raw + job.rawLen;
+			continue;
+		}
+
+		int n = MIN(count,avail);
+		memcpy(into,m_ptr,n);
+		m_ptr += n;
+		into += n;
+		count -= n;
+	}
+
+	if ( count > 0 )
+	{
+		memset(into,0,count);
+		m_eof = true;
+	}
+}
+
+uint16 LZReadStream::Get16()
+{
+	uint16 val;
+	Read(&val,sizeof(val));
+	return Bswap16(val);
+}
+
+uint32 LZReadStream::Get32()
+{
+	uint32 val;
+	if ( m_end - m_ptr >= (ptrdiff_t)sizeof(val) )
+	{
+		memcpy(&val,m_ptr,sizeof(val));
+		m_ptr += sizeof(val);
+	}
+	else
+	{
+		Read(&val,sizeof(val));
+	}
+	return Bswap32(val);
+}
+
+uint64 LZReadStream::Get64()
+{
+	uint64 val;
+	Read(&val,sizeof(val));
+	return Bswap64(val);
+}
+
+//=========================================================================================
+// test
+//	buffers are allocated at their exact size , so running it under a memory checker also
+//	catches any read or write outside them
+
+static int s_lzTestFailures = 0;
+
+static void LZTest_Fail(const char * what,int rawLen)
+{
+	s_lzTestFailures++;
+	lprintf("LZCodec_Test : %s (rawLen %d)\n",what,rawLen);
+}
+
+static void LZTest_FillRandom(uint8 * raw,int rawLen)
+{
+	for LOOP(i,rawLen)
+		raw[i] = (uint8) myrand32();
+}
+
+// words from a small vocabulary , long runs , and repeats from far back
+static void LZTest_FillCompressible(uint8 * raw,int rawLen)
+{
+	static const char * c_words[] = { "lz ", "block ", "stream ", "offset ", "match ", "literal ", "\n" };
+	int i = 0;
+	while ( i < rawLen )
+	{
+		int kind = irandmod(8);
+		if ( kind == 0 )
+		{
+			int run = irandranged(1,300);
+			run = MIN(run,rawLen-i);
+			memset(raw+i,(int)irandmod(256),run);
+			i += run;
+		}
+		else if ( kind == 1 && i > 1000 )
+		{
+			int back = irandranged(1,MIN(i,LZ_MAX_OFFSET+1000));
+			int len = irandranged(4,500);
+			len = MIN(len,rawLen-i);
+			for LOOP(j,len)
+			{
+				raw[i] = raw[i-back];
+				i++;
+			}
+		}
+		else
+		{
+			const char * w = c_words[ irandmod(ARRAY_SIZE(c_words)) ];
+			for(const char * p = w; *p && i < rawLen; p++)
+				raw[i++] = (uint8)*p;
+		}
+	}
+}
+
+static void LZTest_RoundTrip(const uint8 * raw,int rawLen,bool corrupt)
+{
+	int bound = LZ_CompressBound(rawLen);
+	uint8 * comp = (uint8 *) CBALLOC(bound);
+	uint8 * back = (uint8 *) CBALLOC(rawLen+1);
+
+	int compLen = LZ_CompressBlock(raw,rawLen,comp,bound);
+	if ( compLen <= 0 || compLen > bound )
+	{
+		LZTest_Fail("compress into CompressBound failed",rawLen);
+	}
+	else if ( ! LZ_DecompressBlock(comp,compLen,back,rawLen) || memcmp(raw,back,rawLen) != 0 )
+	{
+		LZTest_Fail("round trip mismatch",rawLen);
+	}
+	else
+	{
+		// the length has to be exact :
+		if ( rawLen > 0 && LZ_DecompressBlock(comp,compLen,back,rawLen-1) )
+			LZTest_Fail("decoded into a short buffer",rawLen);
+		if ( LZ_DecompressBlock(comp,compLen,back,rawLen+1) )
+			LZTest_Fail("decoded into a long buffer",rawLen);
+		if ( compLen > 1 && LZ_DecompressBlock(comp,compLen-1,back,rawLen) )
+			LZTest_Fail("decoded truncated input",rawLen);
+
+		if ( corrupt )
+		{
+			// garbage in may decode to something , but has to stay inside the buffers
+			uint8 * bad = (uint8 *) CBALLOC(compLen);
+			for LOOP(t,64)
+			{
+				memcpy(bad,comp,compLen);
+				int flips = irandranged(1,4);
+				for LOOP(f,flips)
+					bad[ irandmod(compLen) ] = (uint8) myrand32();
+				LZ_DecompressBlock(bad,compLen,back,rawLen);
+				LZ_DecompressBlock(bad,irandranged(0,compLen),back,rawLen);
+			}
+			CBFREE(bad);
+		}
+	}
+
+	// incompressible data into less room than it takes raw says "store it raw"
+	if ( rawLen > 16 )
+	{
+		int small = LZ_CompressBlock(raw,rawLen,comp,rawLen/2);
+		if ( small < 0 || small > rawLen/2 )
+			LZTest_Fail("overran a small compCapacity",rawLen);
+		else if ( small > 0 && ( ! LZ_DecompressBlock(comp,small,back,rawLen) || memcmp(raw,back,rawLen) != 0 ) )
+			LZTest_Fail("round trip through a small compCapacity",rawLen);
+	}
+
+	CBFREE(back);
+	CBFREE(comp);
+}
+
+// reads rawLen bytes back from stream , which should decode to raw unless corrupt
+static void LZTest_ReadStream(uint8 * stream,int streamLen,const uint8 * raw,int rawLen,bool corrupt)
+{
+	uint8 * back = (uint8 *) CBALLOC(rawLen);
+
+	LZReadStream r;
+	if ( ! r.Open(FileRC::CreateMemFile(stream,streamLen,true)) )
+	{
+		LZTest_Fail("stream didn't open",rawLen);
+	}
+	else
+	{
+		const uint32 len = r.Get32();
+		r.Read(back,rawLen);
+
+		if ( corrupt )
+		{
+			if ( ! r.IsCorrupt() )
+				LZTest_Fail("flipped payload byte not caught",rawLen);
+		}
+		else if ( len != (uint32)rawLen || memcmp(raw,back,rawLen) != 0 || r.IsCorrupt() )
+		{
+			LZTest_Fail("stream round trip mismatch",rawLen);
+		}
+		else
+		{
+			r.Get8();
+			if ( ! r.IsEOF() )
+				LZTest_Fail("stream didn't end",rawLen);
+		}
+	}
+
+	CBFREE(back);
+}
+
+static void LZTest_StreamRoundTrip()
+{
+	// small blocks and a few threads , so it takes several batches ; the random half gets stored raw
+	LZOptions options;
+	options.blockBytes = 4096;
+	options.numThreads = 3;
+
+	const int rawLen = 100000;
+	uint8 * raw = (uint8 *) CBALLOC(rawLen);
+	LZTest_FillCompressible(raw,rawLen/2);
+	LZTest_FillRandom(raw+rawLen/2,rawLen-rawLen/2);
+
+	// the mem file starts empty and grows as it's written
+	FileRCPtr out = FileRC::CreateMemFile(raw,0,false);
+	LZWriteStream w;
+	if ( ! w.Open(out,options) )
+	{
+		LZTest_Fail("stream didn't open for write",rawLen);
+		CBFREE(raw);
+		return;
+	}
+	w.Put32((uint32)rawLen);
+	w.Write(raw,rawLen);
+	if ( ! w.Close() )
+		LZTest_Fail("stream write failed",rawLen);
+
+	FILE * fp = out->Get();
+	const int streamLen = (int) ftell(fp);
+	uint8 * stream = (uint8 *) CBALLOC(streamLen);
+	rewind(fp);
+	if ( (int) fread(stream,1,streamLen,fp) != streamLen )
+	{
+		LZTest_Fail("couldn't read the stream back",rawLen);
+	}
+	else
+	{
+		LZTest_ReadStream(stream,streamLen,raw,rawLen,false);
+
+		// first payload byte : after the stream header and the first block header
+		stream[8+12] ^= 0x5A;
+		LZTest_ReadStream(stream,streamLen,raw,rawLen,true);
+	}
+
+	CBFREE(stream);
+	CBFREE(raw);
+}
+
+void LZCodec_Test()
+{
+	s_lzTestFailures = 0;
+	mysrand(47);
+
+	static const int c_sizes[] = { 0, 1, 4, 5, 11, 12, 13, 16, 17, 33, 100, 255, 256, 1000, 4096, 65535, 65536, 70000, 300000 };
+	for LOOP(s,ARRAY_SIZE(c_sizes))
+	{
+		const int rawLen = c_sizes[s];
+		uint8 * raw = (uint8 *) CBALLOC(rawLen+1);
+
+		LZTest_FillRandom(raw,rawLen);
+		LZTest_RoundTrip(raw,rawLen,true);
+
+		LZTest_FillCompressible(raw,rawLen);
+		LZTest_RoundTrip(raw,rawLen,true);
+
+		memset(raw,0,rawLen);
+		LZTest_RoundTrip(raw,rawLen,false);
+
+		CBFREE(raw);
+	}
+
+	// pure garbage
+	for LOOP(t,1000)
+	{
+		int compLen = irandranged(0,200);
+		int rawLen = irandranged(0,400);
+		uint8 * comp = (uint8 *) CBALLOC(compLen+1);
+		uint8 * raw = (uint8 *) CBALLOC(rawLen+1);
+		LZTest_FillRandom(comp,compLen);
+		LZ_DecompressBlock(comp,compLen,raw,rawLen);
+		CBFREE(raw);
+		CBFREE(comp);
+	}
+
+	LZTest_StreamRoundTrip();
+
+	lprintf("LZCodec_Test : %d failures\n",s_lzTestFailures);
+	if ( s_lzTestFailures != 0 )
+		FAIL("LZCodec_Test failed");
+}
+
+END_CB
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "Base.h"
+#include "File.h"
+
+/**
+
+LZCodec : small fast LZ77 , for when storing raw is wasteful but zlib is too slow
+
+the block codec is byte oriented LZ77 in the LZ4 style :
+	a sequence is a token byte (literal count , match length) , the literals , a 16 bit offset
+	the encoder takes the first match a 4-byte hash finds and skips faster through data that
+		doesn't match , so it runs near memcpy speed on incompressible data
+	the decoder checks every length and offset , so garbage in gives false , never a crash
+
+LZWriteStream / LZReadStream frame a stream of blocks onto a FileRC :
+	"CBLZ" , block size
+	per block : raw length , compressed length (top bit = stored raw) , CRC of the raw bytes , payload
+	a zero raw length ends the stream
+	blocks are independent , so each batch of blocks (one per thread) is compressed or
+		decompressed in parallel by workers the stream starts once ; the file IO stays on the calling thread
+
+Get/Put16/32/64 are big endian , like File
+
+**/
+
+START_CB
+
+//-------------------------------------------------------------------------------------------
+// single blocks , no framing
+
+// worst case compressed size for rawLen bytes
+int LZ_CompressBound(int rawLen);
+
+// returns the compressed length , or 0 if it didn't fit in compCapacity
+//	(if compCapacity < rawLen , 0 means "store it raw")
+int LZ_CompressBlock(const uint8 * raw,int rawLen,uint8 * comp,int compCapacity);
+
+// false if comp doesn't decode to exactly rawLen bytes
+bool LZ_DecompressBlock(const uint8 * comp,int compLen,uint8 * raw,int rawLen);
+
+// round trips random and compressible blocks , and feeds the decoder corrupted ones ;
+//	then a framed stream through a mem file , clean and with a flipped payload byte
+void LZCodec_Test();
+
+//-------------------------------------------------------------------------------------------
+// framed streams
+
+struct LZOptions
+{
+	int		blockBytes;		// raw bytes per block ; max 16M
+	int		numThreads;		// blocks in flight ; 0 = one per core
+
+	LZOptions();
+};
+
+struct LZStreamShared;
+
+class LZWriteStream
+{
+public:
+	LZWriteStream();
+	~LZWriteStream();
+
+	bool Open(const char * name,const LZOptions & options = LZOptions());
+	// writes start wherever the file is now
+	bool Open(const FileRCPtr & file,const LZOptions & options = LZOptions());
+	// compresses what's left and writes the end mark ; a borrowed FileRC is flushed , not closed
+	//	returns false if any write since Open failed
+	bool Close();
+
+	bool IsOpen() const { return m_shared != NULL; }
+	// a write failed ; sticky until the next Open , the rest of the stream is dropped
+	bool IsError() const { return m_failed; }
+
+	void Write(const void * bits,int count);
+
+	void Put8(const uint8 val)
+	{
+		if ( m_ptr < m_end )
+			*m_ptr++ = val;
+		else
+			Write(&val,1);
+	}
+
+	void Put16(const uint16 val);
+	void Put32(const uint32 val);
+	void Put64(const uint64 val);
+
+	// raw bytes written since Open
+	int64 Tell() const { return m_flushed + (m_ptr - m_begin); }
+
+private:
+	void FlushBatch();
+
+	LZStreamShared *	m_shared;
+	uint8 *				m_begin;
+	uint8 *				m_ptr;
+	uint8 *				m_end;
+	int64				m_flushed;
+	bool				m_failed;
+
+	FORBID_CLASS_STANDARDS(LZWriteStream);
+};
+
+class LZReadStream
+{
+public:
+	LZReadStream();
+	~LZReadStream();
+
+	// false if it can't be opened or doesn't start with an LZWriteStream header
+	bool Open(const char * name,const LZOptions & options = LZOptions());
+	bool Open(const FileRCPtr & file,const LZOptions & options = LZOptions());
+	void Close();
+
+	bool IsOpen() const { return m_shared != NULL; }
+
+	void Read(void * bits,int count);
+
+	uint8 Get8()
+	{
+		if ( m_ptr < m_end )
+			return *m_ptr++;
+		uint8 val;
+		Read(&val,1);
+		return val;
+	}
+
+	uint16 Get16();
+	uint32 Get32();
+	uint64 Get64();
+
+	// reading past the end gives zeros and sets IsEOF
+	bool IsEOF() const { return m_eof; }
+	// a block failed to decode or its CRC didn't match ; the stream stops there (IsEOF too)
+	bool IsCorrupt() const { return m_corrupt; }
+
+	// raw bytes consumed since Open
+	int64 Tell() const { return m_consumed + (m_ptr - m_begin); }
+
+private:
+	bool Start();
+	bool FillBatch();
+
+	LZStreamShared *	m_shared;
+	const uint8 *		m_begin;
+	const uint8 *		m_ptr;
+	const uint8 *		m_end;
+	int64				m_consumed;
+	bool				m_eof;
+	bool				m_corrupt;
+	bool				m_sawEnd;
+
+	FORBID_CLASS_STANDARDS(LZReadStream);
+};
+
+END_CB
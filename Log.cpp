@@ -3,6 +3,9 @@
 #include "FileUtil.h"
 #include "Log.h"
 #include "Win32Util.h"
+#include "FastPrintf.h"
+#include "LogBinary.h"
+#include "LogAsync.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -51,6 +54,10 @@ static bool s_inLog = false;
 
 static bool s_logIsAtEOL = true;
 
+// async file writer (LogAsync.cpp) is started when the log file opens :
+static bool s_logAsyncOn = false;
+static LogAsyncOptions s_logAsyncOptions;
+
 //--------------------------------------------------
 
 // LOG_PROTECTOR forbids recursions
@@ -286,16 +293,30 @@ static void LogOpen()
     s_logIsAtEOL = true;
     
     LogEndWrite();
+
+    if ( s_logAsyncOn )
+    {
+        // from here on the writer thread owns the file :
+        if ( s_logFile )
+        {
+            fclose(s_logFile);
+            s_logFile = NULL;
+        }
+        LogAsync_Start(s_logName,s_logAsyncOptions);
+    }
 }
 
 static void LogClose()
 {
     LogFlush();
+    LogAsync_Stop();
     s_logOpen = false;
 }
 
 FILE * GetLogFile()
 {
+	// with async on this is a second handle on the same file ; at least make it current
+	LogAsync_Sync();
 	if ( ! LogBeginWrite() )
 		return NULL;
 	return s_logFile;
@@ -303,6 +324,8 @@ FILE * GetLogFile()
 
 void LogFlush()
 {
+    LogAsync_Sync();
+
     if ( s_logFile )
     {
         fclose(s_logFile);
@@ -333,6 +356,33 @@ void LogSetCloseAfterEachWrite(bool b)
     s_logCloseAfterEachWrite = b;
 }
 
+void LogSetAsync(const LogAsyncOptions * options)
+{
+    // Stop writes out whatever it has :
+    LogAsync_Stop();
+
+    s_logAsyncOn = ( options != NULL );
+    if ( options )
+        s_logAsyncOptions = *options;
+
+    // if the file isn't open yet, LogOpen starts it
+    if ( s_logAsyncOn && s_logOpen && s_logName )
+    {
+        LogFlush();
+        LogAsync_Start(s_logName,s_logAsyncOptions);
+    }
+}
+
+bool LogGetAsync()
+{
+    return s_logAsyncOn;
+}
+
+int64 LogGetAsyncDroppedBytes()
+{
+    return LogAsync_GetDroppedBytes();
+}
+
 void LogSetState(uint32 newState) // SetState(0) disables all
 {
     const uint32 oldState = s_logState;
@@ -421,28 +471,109 @@ void lprintf_file_line(const char * file,const int line)
 
 void vsnprintfdynamic(cb::vector<char> * pBuf,const char * fmt,va_list args)
 {
-	pBuf->resize( 1024 + strlen32(fmt) );
+	// keep whatever size the caller's vector already has ; only grow when a line doesn't fit
+	if ( pBuf->size32() < 1024 )
+		pBuf->resize(1024);
+	
+	va_list save;
+	va_copy(save,args);
+	int wroteLen = fastvsnprintf(pBuf->data(),pBuf->size32(),fmt,save);
+	va_end(save);
 	
-	for(;;)
+	if ( wroteLen >= pBuf->size32() )
 	{
-		errno = 0;
-		int wroteLen = _vsnprintf(pBuf->data(),pBuf->size()-1,fmt,args);
-		if ( wroteLen < 0 || errno != 0 )
-		{
-			// overflow
-			pBuf->resize( 4096 + pBuf->size()*2 );
-		}
-		else
-		{
-			return;
-		}
+		// we know exactly how much we need :
+		pBuf->resize( wroteLen+1 );
+		fastvsnprintf(pBuf->data(),pBuf->size32(),fmt,args);
+	}
+}
+
+// sends a finished line to all the outputs :
+static void LogOutput(const char * buffer,int len)
+{
+    if ( (s_logState & CB_LOG_CALLBACK) && s_callback )
+    {
+        if ( ! s_callback(buffer) )
+            return; // bool return from callback means no other output
+    }
+
+    if ( (s_logState & CB_LOG_TO_FILE) && LogAsync_IsRunning() )
+    {
+        // just a copy ; the writer thread does the IO
+        LogAsync_Write(buffer,len);
+    }
+    else if ( s_logState & CB_LOG_TO_FILE )
+    {   
+        // normal writing to the log file
+        if ( ! LogBeginWrite() )
+        {
+            s_logName = NULL; // don't try again
+        }
+        else
+        {
+            fputs(buffer,s_logFile);
+            //fflush(s_logEchoFile); LogEndWrite does this
+        }
+    }
+    
+    if ( (s_logState & CB_LOG_ECHO) && s_logEchoFile )
+    {
+        fputs(buffer,s_logEchoFile);
+        fflush(s_logEchoFile);
+    }
+    
+    if ( s_logState & CB_LOG_TO_DEBUGGER )
+    {
+        OutputDebugString(buffer);
+    }
+    
+    LogEndWrite();
+}
+
+void LogWriteDeferred(const char * text,int tabs)
+{
+    if ( ! s_logState ) // all turned off
+        return;
+    LOG_PROTECTOR();
+
+    int textLen = (int) strlen(text);
+    if ( textLen == 0 )
+        return;
+
+    const char * buffer = text;
+    cb::vector<char> tabbed;
+    if ( ! s_logIsAtEOL )
+        tabs = 0;
+    if ( tabs > 0 )
+    {
+        tabbed.resize( tabs + textLen + 1 );
+        memset(tabbed.data(),'\t',tabs);
+        memcpy(tabbed.data()+tabs,text,textLen+1);
+        buffer = tabbed.data();
     }
+
+    char last = text[ textLen - 1 ];
+    s_logIsAtEOL = ( last == '\n' || last == '\r' );
+
+    LogOutput(buffer,tabs + textLen);
 }
 
 void rawlprintf(const char * fmt,...)
 {
     if ( ! s_logState ) // all turned off
         return;
+
+    if ( (s_logState & CB_LOG_BINARY) && LogBinaryIsOpen() )
+    {
+        // deferred : just record the args ; the LogBinary writer comes back through LogWriteDeferred
+        va_list arg;
+        va_start(arg,fmt);
+        bool taken = LogBinaryRecord(s_logTabs,fmt,arg);
+        va_end(arg);
+        if ( taken )
+            return;
+    }
+
     LOG_PROTECTOR();
 
     // use a static so we don't blow the stack :
@@ -450,6 +581,7 @@ void rawlprintf(const char * fmt,...)
     int bufsize = sizeof(s_buffer);
     char * buffer = s_buffer;
     cb::vector<char> overflow;
+    int len = 0;
     
     // fill buffer :
     {
@@ -460,26 +592,28 @@ void rawlprintf(const char * fmt,...)
         retry:
         buffer[0] = 0;
         char * ptr = buffer;
+        int tabs = 0;
         if ( s_logIsAtEOL )
         {
 			for(int t=0;t<s_logTabs;t++)
 			{
 				*ptr++ = '\t';
 			}
+			tabs = s_logTabs;
 		}
-		errno = 0;
-        int wroteLen = _vsnprintf(ptr,bufsize-1-s_logTabs,fmt,arg);
-        if ( wroteLen < 0 || errno )
+		va_list argCopy;
+		va_copy(argCopy,arg);
+        int wroteLen = fastvsnprintf(ptr,bufsize-tabs,fmt,argCopy);
+        va_end(argCopy);
+        if ( wroteLen >= bufsize-tabs )
         {
-			// overflow
-			overflow.resize( 4096 + bufsize*2 );
-			bufsize = overflow.size();
+			// overflow ; now we know the exact size
+			overflow.resize( wroteLen + tabs + 1 );
+			bufsize = overflow.size32();
 			buffer = overflow.data();
 			goto retry;
         }
-        //buffer[sizeof(buffer)-1] = 0;
-        
-        int len = (int)strlen(buffer);
+        len = tabs + wroteLen;
         if ( len == 0 )
             return;
         
@@ -492,40 +626,8 @@ void rawlprintf(const char * fmt,...)
         else
             s_logIsAtEOL = false; 
     }
-         
-        
-    if ( (s_logState & CB_LOG_CALLBACK) && s_callback )
-    {
-        if ( ! s_callback(buffer) )
-            return; // bool return from callback means no other output
-    }
 
-    if ( s_logState & CB_LOG_TO_FILE )
-    {   
-        // normal writing to the log file
-        if ( ! LogBeginWrite() )
-        {
-            s_logName = NULL; // don't try again
-        }
-        else
-        {
-            fputs(buffer,s_logFile);
-            //fflush(s_logEchoFile); LogEndWrite does this
-        }
-    }
-    
-    if ( (s_logState & CB_LOG_ECHO) && s_logEchoFile )
-    {
-        fputs(buffer,s_logEchoFile);
-        fflush(s_logEchoFile);
-    }
-    
-    if ( s_logState & CB_LOG_TO_DEBUGGER )
-    {
-        OutputDebugString(buffer);
-    }
-    
-    LogEndWrite();
+    LogOutput(buffer,len);
 }
 
 
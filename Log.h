@@ -64,6 +64,9 @@ START_CB
 #define CB_LOG_TO_DEBUGGER (1<<2)
 #define CB_LOG_FILE_LINE   (1<<3)
 #define CB_LOG_CALLBACK    (1<<4)
+// CB_LOG_BINARY only does anything once LogBinaryOpen is called (see LogBinary.h) :
+//	rawlprintf records the args and the writer thread formats them later
+#define CB_LOG_BINARY      (1<<5)
 
 #define CB_LOG_DEFAULT_STATE     (CB_LOG_TO_FILE|CB_LOG_ECHO|CB_LOG_TO_DEBUGGER)
 #define CB_LOG_DEFAULT_VERBOSITY	(1)
@@ -101,13 +104,50 @@ int LogPushTab();
 int LogPopTab();
 
 // "Flush" is actually a close & reopen to ensure the data is written
+//	with async on, it waits for the writer to catch up (and fsyncs)
 void LogFlush();
 // toggle CloseAfterEachWrite , good when you're debugging crashes
 void LogSetCloseAfterEachWrite(bool b);
 
+//-----------------------------------
+// async file writing :
+//	lines are copied into a buffer and a background thread does the file IO ,
+//	so lprintf never waits on the disk
+//	(only the file output ; echo/debugger/callback still happen in the caller)
+
+enum ELogFsync
+{
+	CB_LOG_FSYNC_NEVER,		// leave it to the OS
+	CB_LOG_FSYNC_BATCH,		// after every batch the writer puts out
+	CB_LOG_FSYNC_INTERVAL	// at most every fsyncMillis
+};
+
+struct LogAsyncOptions
+{
+	int			bufferBytes;	// starting size of each of the two buffers
+	int			maxBufferBytes;	// the fill buffer grows to this ; past it lines are dropped (and counted)
+	int			flushMillis;	// the writer wakes at least this often
+	ELogFsync	fsync;
+	int			fsyncMillis;	// for CB_LOG_FSYNC_INTERVAL
+	int64		rotateBytes;	// start a new file at this size (0 = never)
+	int			rotateSeconds;	// start a new file after this long (0 = never)
+	int			keepFiles;		// rotated files are kept as name.1 (newest) .. name.keepFiles
+
+	LogAsyncOptions();
+};
+
+// NULL turns async off (waits for everything to be written first)
+// CloseAfterEachWrite is ignored while async is on ; use the fsync policy
+void LogSetAsync(const LogAsyncOptions * options);
+bool LogGetAsync();
+// bytes thrown away because the writer fell behind by more than maxBufferBytes
+int64 LogGetAsyncDroppedBytes();
+
 // internal use only :
 void rawlprintf(const char * fmt,...);
 void lprintf_file_line(const char * file,const int line);
+// text that was already formatted somewhere else (LogBinary writer) ; tabs are from when it was logged
+void LogWriteDeferred(const char * text,int tabs);
 
 inline void eatargs(const char * fmt,...)
 {
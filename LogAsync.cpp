@@ -0,0 +1,442 @@
+#include "LogAsync.h"
+#include "Threading.h"
+#include "Timer.h"
+#include "Win32Util.h"
+#include "Mem.h"
+#include "Util.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <io.h>
+
+START_CB
+
+//=========================================================================================
+
+LogAsyncOptions::LogAsyncOptions() :
+	bufferBytes(256*1024),
+	maxBufferBytes(16*1024*1024),
+	flushMillis(50),
+	fsync(CB_LOG_FSYNC_INTERVAL),
+	fsyncMillis(1000),
+	rotateBytes(0),
+	rotateSeconds(0),
+	keepFiles(4)
+{
+}
+
+//=========================================================================================
+
+struct LogAsyncBuffer
+{
+	char *	data;
+	int		len;
+	int		cap;
+};
+
+struct LogAsyncState
+{
+	LogAsyncOptions	options;
+	char *			name;
+
+	// under lock :
+	CriticalSection	lock;
+	LogAsyncBuffer	fill;
+	int64			droppedBytes;
+	bool			kicked;
+
+	// writer only :
+	LogAsyncBuffer	drain;
+	FILE *			fp;
+	int64			fileBytes;
+	uint64			fileOpenedMillis;
+	uint64			lastFsyncMillis;
+
+	// Sync() bumps syncRequests under lock ; the writer reads it at the swap
+	//	and puts it in syncsDone once that batch is written (and fsynced)
+	uint32			syncRequests;
+	uint32 volatile	syncsDone;
+
+	HANDLE			thread;
+	HANDLE			wake;
+	HANDLE			batchDone;
+	bool volatile	quit;
+};
+
+static LogAsyncState * volatile s_async = NULL;
+
+// callers hold a use on s_async while they touch it , so Stop can't free it under them :
+//	bump s_asyncUsers , then load s_async ; Stop swaps s_async out , then waits for users to drain
+//	(both sides are full barriers , so either the caller sees NULL or Stop sees the caller)
+static LONG volatile s_asyncUsers = 0;
+
+struct LogAsyncUse
+{
+	LogAsyncState * st;
+
+	LogAsyncUse()
+	{
+		InterlockedIncrement(&s_asyncUsers);
+		st = LoadAcquire(&s_async);
+	}
+	~LogAsyncUse()
+	{
+		InterlockedDecrement(&s_asyncUsers);
+	}
+};
+
+//=========================================================================================
+
+static void LogAsyncOpenFile(LogAsyncState * st,const char * mode)
+{
+	st->fp = fopen(st->name,mode);
+	if ( ! st->fp )
+	{
+		fprintf(stderr,"ERROR : LogAsync failed to open log file %s\n",st->name);
+		st->fileBytes = 0;
+	}
+	else
+	{
+		fseek(st->fp,0,SEEK_END);
+		st->fileBytes = ftell(st->fp);
+	}
+	st->fileOpenedMillis = Timer::GetMillis64();
+}
+
+static void LogAsyncFsync(LogAsyncState * st)
+{
+	if ( ! st->fp )
+		return;
+	fflush(st->fp);
+	_commit(_fileno(st->fp));
+	st->lastFsyncMillis = Timer::GetMillis64();
+}
+
+// name.keep is dropped , name.k -> name.k+1 , name -> name.1 , start a fresh name
+static void LogAsyncRotate(LogAsyncState * st)
+{
+	if ( st->fp )
+	{
+		if ( st->options.fsync != CB_LOG_FSYNC_NEVER )
+			LogAsyncFsync(st);
+		fclose(st->fp);
+		st->fp = NULL;
+	}
+
+	int keep = st->options.keepFiles;
+	if ( keep <= 0 )
+	{
+		DeleteFile(st->name);
+	}
+	else
+	{
+		char from[_MAX_PATH];
+		char to[_MAX_PATH];
+
+		_snprintf(to,sizeof(to),"%s.%d",st->name,keep);
+		to[sizeof(to)-1] = 0;
+		DeleteFile(to);
+
+		for(int k=keep-1;k>=1;k--)
+		{
+			_snprintf(from,sizeof(from),"%s.%d",st->name,k);
+			from[sizeof(from)-1] = 0;
+			_snprintf(to,sizeof(to),"%s.%d",st->name,k+1);
+			to[sizeof(to)-1] = 0;
+			MoveFile(from,to);
+		}
+
+		_snprintf(to,sizeof(to),"%s.1",st->name);
+		to[sizeof(to)-1] = 0;
+		if ( ! MoveFile(st->name,to) )
+			DeleteFile(st->name);
+	}
+
+	LogAsyncOpenFile(st,"wb");
+}
+
+static bool LogAsyncNeedRotate(const LogAsyncState * st)
+{
+	if ( st->fileBytes == 0 )
+		return false;
+	if ( st->options.rotateBytes > 0 && st->fileBytes >= st->options.rotateBytes )
+		return true;
+	if ( st->options.rotateSeconds > 0 &&
+		Timer::GetMillis64() - st->fileOpenedMillis >= (uint64)st->options.rotateSeconds * 1000 )
+		return true;
+	return false;
+}
+
+static void LogAsyncWriteBatch(LogAsyncState * st,const char * ptr,int len)
+{
+	while ( len > 0 )
+	{
+		if ( LogAsyncNeedRotate(st) )
+			LogAsyncRotate(st);
+
+		int take = len;
+		if ( st->options.rotateBytes > 0 && st->fileBytes + take > st->options.rotateBytes )
+		{
+			// cut after the last whole line that fits :
+			int room = (int) ( st->options.rotateBytes - st->fileBytes );
+			take = 0;
+			for(int i=room-1;i>=0;i--)
+			{
+				if ( ptr[i] == '\n' )
+				{
+					take = i+1;
+					break;
+				}
+			}
+
+			if ( take == 0 )
+			{
+				if ( st->fileBytes > 0 )
+				{
+					// nothing fits ; start the next file
+					LogAsyncRotate(st);
+					continue;
+				}
+				// one line bigger than a whole file ; it has to be split
+				take = room;
+			}
+		}
+
+		if ( st->fp )
+			fwrite(ptr,1,take,st->fp);
+		st->fileBytes += take;
+		ptr += take;
+		len -= take;
+	}
+}
+
+static DWORD WINAPI LogAsyncThreadRoutine(LPVOID param)
+{
+	LogAsyncState * st = (LogAsyncState *) param;
+
+	for(;;)
+	{
+		bool quitting = st->quit;
+		if ( ! quitting )
+			WaitForSingleObject(st->wake,st->options.flushMillis);
+
+		uint32 syncs;
+		{
+			CB_SCOPE_CRITICAL_SECTION(st->lock);
+			Swap(st->fill,st->drain);
+			st->fill.len = 0;
+			st->kicked = false;
+			syncs = st->syncRequests;
+		}
+
+		bool wrote = ( st->drain.len > 0 );
+		if ( wrote )
+		{
+			LogAsyncWriteBatch(st,st->drain.data,st->drain.len);
+			st->drain.len = 0;
+			if ( st->fp )
+				fflush(st->fp);
+		}
+		else if ( LogAsyncNeedRotate(st) )
+		{
+			// time rotation happens even when nothing is being logged
+			LogAsyncRotate(st);
+		}
+
+		bool syncRequested = ( syncs != st->syncsDone );
+		switch ( st->options.fsync )
+		{
+		case CB_LOG_FSYNC_NEVER:
+			break;
+		case CB_LOG_FSYNC_BATCH:
+			if ( wrote || syncRequested )
+				LogAsyncFsync(st);
+			break;
+		case CB_LOG_FSYNC_INTERVAL:
+			if ( syncRequested ||
+				( wrote && Timer::GetMillis64() - st->lastFsyncMillis >= (uint64)st->options.fsyncMillis ) )
+				LogAsyncFsync(st);
+			break;
+		}
+
+		if ( syncRequested )
+		{
+			StoreRelease(&st->syncsDone,syncs);
+			SetEvent(st->batchDone);
+		}
+
+		if ( quitting )
+			break;
+	}
+
+	return 0;
+}
+
+//=========================================================================================
+
+bool LogAsync_Start(const char * fileName,const LogAsyncOptions & options)
+{
+	if ( s_async || fileName == NULL )
+		return false;
+
+	LogAsyncState * st = new LogAsyncState;
+	st->options = options;
+	st->options.bufferBytes = MAX(st->options.bufferBytes,4096);
+	st->options.maxBufferBytes = MAX(st->options.maxBufferBytes,st->options.bufferBytes);
+	st->options.flushMillis = MAX(st->options.flushMillis,1);
+
+	int nameLen = (int) strlen(fileName);
+	st->name = (char *) CBALLOC(nameLen+1);
+	memcpy(st->name,fileName,nameLen+1);
+
+	st->fill.cap = st->options.bufferBytes;
+	st->fill.data = (char *) CBALLOC(st->fill.cap);
+	st->fill.len = 0;
+	st->drain.cap = st->options.bufferBytes;
+	st->drain.data = (char *) CBALLOC(st->drain.cap);
+	st->drain.len = 0;
+	st->droppedBytes = 0;
+	st->kicked = false;
+	st->syncRequests = 0;
+	st->syncsDone = 0;
+	st->quit = false;
+
+	LogAsyncOpenFile(st,"ab");
+	st->lastFsyncMillis = st->fileOpenedMillis;
+
+	st->wake = CreateEvent(NULL,FALSE,FALSE,NULL);
+	st->batchDone = CreateEvent(NULL,FALSE,FALSE,NULL);
+	st->thread = CreateThread(NULL,0,LogAsyncThreadRoutine,st,0,NULL);
+	if ( st->thread == 0 )
+	{
+		fprintf(stderr,"ERROR : LogAsync CreateThread failed\n");
+		CloseHandle(st->wake);
+		CloseHandle(st->batchDone);
+		if ( st->fp ) fclose(st->fp);
+		CBFREE(st->fill.data);
+		CBFREE(st->drain.data);
+		CBFREE(st->name);
+		delete st;
+		return false;
+	}
+
+	InterlockedExchangePointer((PVOID volatile *)&s_async,st);
+	return true;
+}
+
+void LogAsync_Stop()
+{
+	LogAsyncState * st = (LogAsyncState *) InterlockedExchangePointer((PVOID volatile *)&s_async,NULL);
+	if ( ! st )
+		return;
+
+	// anyone who got st before the swap is still in a Write/Sync :
+	while ( LoadAcquire(&s_asyncUsers) != 0 )
+		Sleep(0);
+
+	st->quit = true;
+	SetEvent(st->wake);
+	WaitForSingleObject(st->thread,INFINITE);
+	CloseHandle(st->thread);
+	CloseHandle(st->wake);
+	CloseHandle(st->batchDone);
+
+	if ( st->fp )
+	{
+		if ( st->options.fsync != CB_LOG_FSYNC_NEVER )
+			LogAsyncFsync(st);
+		fclose(st->fp);
+	}
+
+	CBFREE(st->fill.data);
+	CBFREE(st->drain.data);
+	CBFREE(st->name);
+	delete st;
+}
+
+bool LogAsync_IsRunning()
+{
+	return s_async != NULL;
+}
+
+void LogAsync_Write(const char * text,int len)
+{
+	LogAsyncUse use;
+	LogAsyncState * st = use.st;
+	if ( ! st || len <= 0 )
+		return;
+
+	bool kick = false;
+	{
+		CB_SCOPE_CRITICAL_SECTION(st->lock);
+
+		LogAsyncBuffer & b = st->fill;
+		if ( b.len + len > b.cap )
+		{
+			// the writer is behind ; grow rather than wait , up to the limit
+			int newCap = b.cap;
+			while ( newCap < b.len + len && newCap < st->options.maxBufferBytes )
+				newCap = MIN(newCap*2,st->options.maxBufferBytes);
+
+			if ( b.len + len > newCap )
+			{
+				st->droppedBytes += len;
+				return;
+			}
+
+			char * newData = (char *) CBALLOC(newCap);
+			memcpy(newData,b.data,b.len);
+			CBFREE(b.data);
+			b.data = newData;
+			b.cap = newCap;
+		}
+
+		memcpy(b.data + b.len,text,len);
+		b.len += len;
+
+		// one wake per batch is enough :
+		if ( ! st->kicked && b.len >= st->options.bufferBytes/2 )
+		{
+			st->kicked = true;
+			kick = true;
+		}
+	}
+
+	if ( kick )
+		SetEvent(st->wake);
+}
+
+void LogAsync_Sync()
+{
+	LogAsyncUse use;
+	LogAsyncState * st = use.st;
+	if ( ! st )
+		return;
+
+	// everything appended before this is in the batch that sees the request :
+	uint32 request;
+	{
+		CB_SCOPE_CRITICAL_SECTION(st->lock);
+		request = ++st->syncRequests;
+	}
+
+	while ( (int32)( LoadAcquire(&st->syncsDone) - request ) < 0 )
+	{
+		SetEvent(st->wake);
+		WaitForSingleObject(st->batchDone,st->options.flushMillis);
+	}
+}
+
+int64 LogAsync_GetDroppedBytes()
+{
+	LogAsyncUse use;
+	LogAsyncState * st = use.st;
+	if ( ! st )
+		return 0;
+	CB_SCOPE_CRITICAL_SECTION(st->lock);
+	return st->droppedBytes;
+}
+
+//=========================================================================================
+
+END_CB
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Log.h"
+
+/**
+
+LogAsync : the background file writer behind LogSetAsync
+
+this is the internal side that Log.cpp talks to ; use LogSetAsync in Log.h
+
+two buffers : callers append to the fill buffer under a short lock ,
+	the writer thread swaps it for the empty one and writes it out without the lock
+
+the writer owns its own FILE , opened for append , and does the rotation :
+	name -> name.1 -> name.2 ... up to keepFiles , the oldest is deleted
+	files are only cut at line ends (unless a single line is bigger than rotateBytes)
+
+**/
+
+START_CB
+
+bool LogAsync_Start(const char * fileName,const LogAsyncOptions & options);
+// Stop writes everything that's buffered
+void LogAsync_Stop();
+bool LogAsync_IsRunning();
+
+// copy a line in ; never blocks on IO
+void LogAsync_Write(const char * text,int len);
+
+// wait until everything written so far is in the file (and fsynced if the policy says)
+void LogAsync_Sync();
+
+int64 LogAsync_GetDroppedBytes();
+
+END_CB
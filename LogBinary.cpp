@@ -0,0 +1,950 @@
+#include "LogBinary.h"
+#include "Log.h"
+#include "FastPrintf.h"
+#include "StringBuilder.h"
+#include "FileUtil.h"
+#include "Threading.h"
+#include "Timer.h"
+#include "vector.h"
+#include "hash_table.h"
+#include "Win32Util.h"
+#include "Mem.h"
+#include <string.h>
+
+START_CB
+
+//=========================================================================================
+
+/**
+
+LogBinary internals :
+
+ring records , all 8 aligned :
+
+	[ LogBinaryRecordHeader ][ payload ]
+
+kind_args payload is one 8 byte slot per arg (ints are sign extended) ,
+	except strings which are [ uint32 len ][ uint32 pad ][ chars + null , padded to 8 ]
+	a NULL string is len = c_nullString
+kind_text payload is just the text + null
+
+header.format is the LogBinaryFormat pointer in the ring and the format id in the raw file ;
+	the raw file also has kind_define records (id + format text) ahead of first use
+
+a LogBinaryFormat is the format string cut up into segments with one conversion each ,
+	so the writer can replay each segment with its own args through fastsnprintf
+
+format pointers are only trusted if they point at read-only image memory (string literals) ;
+	anything else is formatted right away on the calling thread
+
+**/
+
+enum ELogBinaryArg
+{
+	lba_none = 0,
+	lba_int32,
+	lba_int64,
+	lba_double,
+	lba_ptr,
+	lba_str
+};
+
+enum ELogBinaryKind
+{
+	kind_args = 1,
+	kind_text = 2,
+	kind_define = 3
+};
+
+struct LogBinaryRecordHeader
+{
+	uint32	bytes;	// whole record including header ; c_wrapMarker means skip to ring start
+	uint16	tabs;
+	uint16	kind;
+	uint64	tsc;
+	uint64	format;	// LogBinaryFormat * in the ring , id in the file
+};
+
+COMPILER_ASSERT( sizeof(LogBinaryRecordHeader) == 24 );
+
+static const uint32 c_wrapMarker = 0xFFFFFFFF;
+static const uint32 c_nullString = 0xFFFFFFFF;
+static const int c_maxArgs = 32;
+static const int c_writerPollMillis = 5;
+static const char c_rawFileMagic[8] = { 'C','B','L','O','G','B','I','N' };
+
+static inline uint32 LogBinaryAlign(uint32 x) { return (x + 7) & ~7U; }
+
+struct LogBinarySegment
+{
+	char *	text;		// literal text + at most one conversion , null terminated
+	int		numStars;
+	int		valueType;	// ELogBinaryArg
+};
+
+struct LogBinaryFormat
+{
+	const char *	fmt;
+	uint32			id;
+	int				numArgs;
+	uint8			argTypes[c_maxArgs];
+	// for lba_str : how many chars printf may look at ; c_noPrecision , c_starPrecision (the arg before) , or the number
+	int				argPrecision[c_maxArgs];
+	vector<LogBinarySegment>	segments;
+};
+
+static const int c_noPrecision = -1;
+static const int c_starPrecision = -2;
+
+//=========================================================================================
+// format parsing :
+
+// returns false if we can't defer this format
+static bool LogBinaryParse(LogBinaryFormat * f,const char * fmt)
+{
+	f->fmt = fmt;
+	f->numArgs = 0;
+	f->segments.clear();
+
+	const char * segStart = fmt;
+	const char * p = fmt;
+	while ( *p )
+	{
+		if ( *p != '%' )
+		{
+			p++;
+			continue;
+		}
+		p++;
+		if ( *p == '%' )
+		{
+			// stays in the literal text
+			p++;
+			continue;
+		}
+
+		while ( *p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'' )
+			p++;
+
+		int numStars = 0;
+		if ( *p == '*' ) { numStars++; p++; }
+		else
+		{
+			while ( *p >= '0' && *p <= '9' ) p++;
+			if ( *p == '$' ) return false; // positional
+		}
+		int precision = c_noPrecision;
+		if ( *p == '.' )
+		{
+			p++;
+			if ( *p == '*' ) { numStars++; p++; precision = c_starPrecision; }
+			else
+			{
+				// "%.s" is precision 0
+				precision = 0;
+				while ( *p >= '0' && *p <= '9' )
+				{
+					precision = MIN( precision*10 + (*p - '0'), 0x7FFFFFF );
+					p++;
+				}
+			}
+		}
+
+		// size : 0 = default , 8 = 64 bit
+		int intBytes = 4;
+		bool wide = false;
+		bool longDouble = false;
+		if ( p[0] == 'h' ) { p += ( p[1] == 'h' ) ? 2 : 1; }
+		else if ( p[0] == 'l' && p[1] == 'l' ) { intBytes = 8; p += 2; }
+		else if ( p[0] == 'l' ) { intBytes = sizeof(long); wide = true; p++; }
+		else if ( p[0] == 'q' || p[0] == 'j' ) { intBytes = 8; p++; }
+		else if ( p[0] == 'z' || p[0] == 't' ) { intBytes = sizeof(size_t); p++; }
+		else if ( p[0] == 'L' ) { intBytes = 8; longDouble = true; p++; }
+		else if ( p[0] == 'w' ) { wide = true; p++; }
+		else if ( p[0] == 'I' && p[1] == '6' && p[2] == '4' ) { intBytes = 8; p += 3; }
+		else if ( p[0] == 'I' && p[1] == '3' && p[2] == '2' ) { intBytes = 4; p += 3; }
+		else if ( p[0] == 'I' ) { intBytes = sizeof(size_t); p++; }
+
+		int valueType;
+		switch ( *p )
+		{
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+			valueType = ( intBytes == 8 ) ? lba_int64 : lba_int32;
+			break;
+		case 'c':
+			// %lc is a wint_t , still an int
+			valueType = lba_int32;
+			break;
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+			if ( longDouble ) return false;
+			valueType = lba_double;
+			break;
+		case 's':
+			if ( wide ) return false;
+			valueType = lba_str;
+			break;
+		case 'p':
+			valueType = lba_ptr;
+			break;
+		default:
+			// %n , %S , %C , garbage , end of string
+			return false;
+		}
+		p++;
+
+		if ( f->numArgs + numStars + 1 > c_maxArgs )
+			return false;
+		for LOOP(s,numStars)
+		{
+			f->argPrecision[f->numArgs] = c_noPrecision;
+			f->argTypes[f->numArgs++] = lba_int32;
+		}
+		f->argPrecision[f->numArgs] = precision;
+		f->argTypes[f->numArgs++] = (uint8) valueType;
+
+		LogBinarySegment seg;
+		seg.text = (char *) CBALLOC( p - segStart + 1 );
+		memcpy(seg.text,segStart,p - segStart);
+		seg.text[p - segStart] = 0;
+		seg.numStars = numStars;
+		seg.valueType = valueType;
+		f->segments.push_back(seg);
+
+		segStart = p;
+	}
+
+	if ( p != segStart )
+	{
+		LogBinarySegment seg;
+		seg.text = (char *) CBALLOC( p - segStart + 1 );
+		memcpy(seg.text,segStart,p - segStart + 1);
+		seg.numStars = 0;
+		seg.valueType = lba_none;
+		f->segments.push_back(seg);
+	}
+
+	return true;
+}
+
+static void LogBinaryFreeFormat(LogBinaryFormat * f)
+{
+	for LOOPVEC(i,f->segments)
+	{
+		CBFREE(f->segments[i].text);
+	}
+	delete f;
+}
+
+template <typename T>
+static void LogBinaryCatSegment(StringBuilder * into,const LogBinarySegment & seg,const int * stars,T value)
+{
+	switch ( seg.numStars )
+	{
+	case 0: into->rawCatPrintf(seg.text,value); break;
+	case 1: into->rawCatPrintf(seg.text,stars[0],value); break;
+	default: into->rawCatPrintf(seg.text,stars[0],stars[1],value); break;
+	}
+}
+
+// replay a kind_args payload :
+static void LogBinaryFormatArgs(const LogBinaryFormat * f,const char * payload,StringBuilder * into)
+{
+	const char * at = payload;
+	for LOOPVEC(i,f->segments)
+	{
+		const LogBinarySegment & seg = f->segments[i];
+
+		int stars[2];
+		for LOOP(s,seg.numStars)
+		{
+			stars[s] = (int) *((const int64 *)at);
+			at += 8;
+		}
+
+		switch ( seg.valueType )
+		{
+		case lba_none:
+			into->rawCatPrintf(seg.text);
+			break;
+		case lba_int32:
+			LogBinaryCatSegment(into,seg,stars,(int) *((const int64 *)at));
+			at += 8;
+			break;
+		case lba_int64:
+			LogBinaryCatSegment(into,seg,stars,*((const int64 *)at));
+			at += 8;
+			break;
+		case lba_double:
+			LogBinaryCatSegment(into,seg,stars,*((const double *)at));
+			at += 8;
+			break;
+		case lba_ptr:
+			LogBinaryCatSegment(into,seg,stars,(void *)(intptr_t) *((const uint64 *)at));
+			at += 8;
+			break;
+		case lba_str:
+		{
+			uint32 len = *((const uint32 *)at);
+			at += 8;
+			const char * str = NULL;
+			if ( len != c_nullString )
+			{
+				str = at;
+				at += LogBinaryAlign(len+1);
+			}
+			LogBinaryCatSegment(into,seg,stars,str);
+			break;
+		}
+		}
+	}
+}
+
+//=========================================================================================
+// literal check :
+
+// only read-only image pages are safe to hold a pointer to until the writer gets to it
+static bool LogBinaryIsStaticString(const char * ptr)
+{
+	MEMORY_BASIC_INFORMATION mbi = { 0 };
+	if ( VirtualQuery(ptr,&mbi,sizeof(mbi)) == 0 )
+		return false;
+	if ( mbi.Type != MEM_IMAGE )
+		return false;
+	return ( mbi.Protect & (PAGE_READONLY|PAGE_EXECUTE_READ) ) != 0;
+}
+
+//=========================================================================================
+// per-thread rings :
+
+static const int c_formatCacheSize = 64;
+
+struct LogBinaryRing
+{
+	// producer side :
+	uint32 volatile	head;
+	char			pad0[LF_CACHE_LINE_SIZE - 4];
+
+	// consumer side :
+	uint32 volatile	tail;
+	char			pad1[LF_CACHE_LINE_SIZE - 4];
+
+	char *			data;
+	uint32			size;
+	LogBinaryRing *	next;
+
+	// producer's cache of format pointer -> parse (NULL parse = can't defer)
+	const char *		cacheKey[c_formatCacheSize];
+	LogBinaryFormat *	cacheFormat[c_formatCacheSize];
+};
+
+typedef hash_table<intptr_t,LogBinaryFormat *,hash_table_ops_intptr_t> t_formatHash;
+
+static bool s_open = false;
+static CriticalSection * s_mutex = NULL;	// protects s_rings list and the format table
+static LogBinaryRing * s_rings = NULL;
+static uint32 s_ringSize = 0;
+static t_formatHash * s_formatHash = NULL;
+static vector<LogBinaryFormat *> * s_formats = NULL;
+
+static HANDLE s_thread = 0;
+static HANDLE s_event = 0;
+static volatile bool s_quit = false;
+static FILE * s_rawFile = NULL;
+
+static uint32 s_generation = 0;
+static CB_THREAD_LOCAL LogBinaryRing * s_myRing = NULL;
+static CB_THREAD_LOCAL uint32 s_myRingGeneration = 0;
+static CB_THREAD_LOCAL bool s_isWriterThread = false;
+
+static LogBinaryRing * LogBinaryGetMyRing()
+{
+	if ( s_myRing != NULL && s_myRingGeneration == s_generation )
+		return s_myRing;
+
+	LogBinaryRing * ring = (LogBinaryRing *) CBALLOC(sizeof(LogBinaryRing));
+	memset(ring,0,sizeof(LogBinaryRing));
+	ring->size = s_ringSize;
+	ring->data = (char *) CBALLOC(ring->size);
+
+	{
+		CB_SCOPE_CRITICAL_SECTION(*s_mutex);
+		ring->next = s_rings;
+		s_rings = ring;
+	}
+
+	s_myRing = ring;
+	s_myRingGeneration = s_generation;
+	return ring;
+}
+
+static LogBinaryFormat * LogBinaryLookupFormat(LogBinaryRing * ring,const char * fmt)
+{
+	int slot = (int)( ((uintptr_t)fmt >> 3) & (c_formatCacheSize-1) );
+	if ( ring->cacheKey[slot] == fmt )
+		return ring->cacheFormat[slot];
+
+	LogBinaryFormat * f = NULL;
+	if ( LogBinaryIsStaticString(fmt) )
+	{
+		CB_SCOPE_CRITICAL_SECTION(*s_mutex);
+
+		t_formatHash::entry_ptrc e = s_formatHash->find((intptr_t)fmt);
+		if ( e )
+		{
+			f = e->data();
+		}
+		else
+		{
+			f = new LogBinaryFormat;
+			if ( LogBinaryParse(f,fmt) )
+			{
+				f->id = s_formats->size32();
+				s_formats->push_back(f);
+			}
+			else
+			{
+				LogBinaryFreeFormat(f);
+				f = NULL;
+			}
+			s_formatHash->insert((intptr_t)fmt,f);
+		}
+	}
+
+	ring->cacheKey[slot] = fmt;
+	ring->cacheFormat[slot] = f;
+	return f;
+}
+
+// waits for bytes of contiguous room ; returns the write position
+static char * LogBinaryReserve(LogBinaryRing * ring,uint32 bytes)
+{
+	// if it's past half the ring, give the writer a kick :
+	SpinBackOff backoff;
+	for(;;)
+	{
+		uint32 head = ring->head;
+		uint32 used = head - LoadAcquire(&ring->tail);
+		uint32 freeBytes = ring->size - used;
+		uint32 pos = head & (ring->size-1);
+		uint32 toEnd = ring->size - pos;
+
+		if ( used + bytes > ring->size/2 )
+			SetEvent(s_event);
+
+		if ( bytes <= toEnd && bytes <= freeBytes )
+			return ring->data + pos;
+
+		if ( bytes > toEnd && freeBytes >= toEnd + bytes )
+		{
+			// skip the tail end of the ring ; toEnd is 8 aligned so the marker fits
+			*((uint32 *)(ring->data + pos)) = c_wrapMarker;
+			StoreRelease(&ring->head, head + toEnd);
+			return ring->data;
+		}
+
+		backoff.BackOffYield();
+	}
+}
+
+static void LogBinaryCommit(LogBinaryRing * ring,uint32 bytes)
+{
+	StoreRelease(&ring->head, ring->head + bytes);
+}
+
+static void LogBinaryRecordText(LogBinaryRing * ring,int tabs,uint64 tsc,const char * fmt,va_list args)
+{
+	// text can't be bigger than half the ring , or we could wait forever ; clip it
+	uint32 maxText = ring->size/2 - sizeof(LogBinaryRecordHeader) - 8;
+
+	va_list save;
+	va_copy(save,args);
+	uint32 len = (uint32) fastvsnprintf(NULL,0,fmt,save);
+	va_end(save);
+	len = MIN(len,maxText);
+
+	uint32 bytes = LogBinaryAlign( sizeof(LogBinaryRecordHeader) + len + 1 );
+	char * to = LogBinaryReserve(ring,bytes);
+
+	LogBinaryRecordHeader * header = (LogBinaryRecordHeader *) to;
+	header->bytes = bytes;
+	header->tabs = (uint16) tabs;
+	header->kind = kind_text;
+	header->tsc = tsc;
+	header->format = 0;
+	fastvsnprintf(to + sizeof(LogBinaryRecordHeader),len+1,fmt,args);
+
+	LogBinaryCommit(ring,bytes);
+}
+
+bool LogBinaryRecord(int tabs,const char * fmt,va_list args)
+{
+	if ( ! s_open || s_isWriterThread )
+		return false;
+
+	uint64 tsc = Timer::rdtsc();
+
+	LogBinaryRing * ring = LogBinaryGetMyRing();
+	LogBinaryFormat * f = LogBinaryLookupFormat(ring,fmt);
+	if ( f == NULL )
+	{
+		LogBinaryRecordText(ring,tabs,tsc,fmt,args);
+		return true;
+	}
+
+	// pull the args once , sizing as we go :
+	uint64 slots[c_maxArgs];
+	uint32 strLens[c_maxArgs];
+	uint32 bytes = sizeof(LogBinaryRecordHeader);
+
+	va_list save;
+	va_copy(save,args);
+	for LOOP(i,f->numArgs)
+	{
+		switch ( f->argTypes[i] )
+		{
+		case lba_int32: slots[i] = (uint64)(int64) va_arg(save,int); bytes += 8; break;
+		case lba_int64: slots[i] = (uint64) va_arg(save,int64); bytes += 8; break;
+		case lba_double: { double d = va_arg(save,double); memcpy(&slots[i],&d,8); bytes += 8; break; }
+		case lba_ptr: slots[i] = (uint64)(intptr_t) va_arg(save,void *); bytes += 8; break;
+		case lba_str:
+		{
+			const char * s = va_arg(save,const char *);
+			slots[i] = (uint64)(intptr_t) s;
+			bytes += 8;
+			if ( s == NULL )
+			{
+				strLens[i] = c_nullString;
+			}
+			else
+			{
+				// with a precision printf doesn't read past it , and the string needn't be terminated
+				int precision = f->argPrecision[i];
+				if ( precision == c_starPrecision )
+					precision = (int)(int64) slots[i-1]; // negative means none , like printf
+				if ( precision >= 0 )
+					strLens[i] = (uint32) strnlen(s,(size_t)precision);
+				else
+					strLens[i] = (uint32) strlen(s);
+				bytes += LogBinaryAlign(strLens[i]+1);
+			}
+			break;
+		}
+		}
+	}
+	va_end(save);
+
+	if ( bytes > ring->size/2 )
+	{
+		// giant strings ; just format it
+		LogBinaryRecordText(ring,tabs,tsc,fmt,args);
+		return true;
+	}
+
+	char * to = LogBinaryReserve(ring,bytes);
+
+	LogBinaryRecordHeader * header = (LogBinaryRecordHeader *) to;
+	header->bytes = bytes;
+	header->tabs = (uint16) tabs;
+	header->kind = kind_args;
+	header->tsc = tsc;
+	header->format = (uint64)(intptr_t) f;
+
+	char * at = to + sizeof(LogBinaryRecordHeader);
+	for LOOP(i,f->numArgs)
+	{
+		if ( f->argTypes[i] != lba_str )
+		{
+			memcpy(at,&slots[i],8);
+			at += 8;
+			continue;
+		}
+
+		uint32 len = strLens[i];
+		*((uint32 *)at) = len;
+		*((uint32 *)(at+4)) = 0;
+		at += 8;
+		if ( len != c_nullString )
+		{
+			// the source may stop at a precision with no null after it
+			memcpy(at,(const char *)(intptr_t)slots[i],len);
+			at[len] = 0;
+			at += LogBinaryAlign(len+1);
+		}
+	}
+	ASSERT( at == to + bytes );
+
+	LogBinaryCommit(ring,bytes);
+	return true;
+}
+
+//=========================================================================================
+// writer :
+
+struct LogBinaryCursor
+{
+	LogBinaryRing *	ring;
+	uint32			pos;
+	uint32			limit;
+};
+
+static const LogBinaryRecordHeader * LogBinaryPeek(LogBinaryCursor & c)
+{
+	while ( c.pos != c.limit )
+	{
+		uint32 at = c.pos & (c.ring->size-1);
+		const LogBinaryRecordHeader * h = (const LogBinaryRecordHeader *)(c.ring->data + at);
+		if ( h->bytes != c_wrapMarker )
+			return h;
+		c.pos += c.ring->size - at;
+	}
+	return NULL;
+}
+
+// writer thread state :
+static StringBuilder * s_text = NULL;
+static vector<char> * s_flat = NULL;
+static vector<uint8> * s_defined = NULL;
+
+static void LogBinaryWriteRaw(const LogBinaryRecordHeader * h)
+{
+	LogBinaryRecordHeader out = *h;
+
+	if ( h->kind == kind_args )
+	{
+		const LogBinaryFormat * f = (const LogBinaryFormat *)(intptr_t) h->format;
+		if ( s_defined->size32() <= (int)f->id )
+			s_defined->resize(f->id+1,0);
+		if ( ! (*s_defined)[f->id] )
+		{
+			(*s_defined)[f->id] = 1;
+
+			uint32 len = (uint32) strlen(f->fmt);
+			LogBinaryRecordHeader def = { 0 };
+			def.bytes = LogBinaryAlign( sizeof(def) + len + 1 );
+			def.kind = kind_define;
+			def.format = f->id;
+			fwrite(&def,sizeof(def),1,s_rawFile);
+			fwrite(f->fmt,1,len+1,s_rawFile);
+			static const char c_zeros[8] = { 0 };
+			fwrite(c_zeros,1,def.bytes - sizeof(def) - len - 1,s_rawFile);
+		}
+		out.format = f->id;
+	}
+
+	fwrite(&out,sizeof(out),1,s_rawFile);
+	fwrite(h+1,1,h->bytes - sizeof(out),s_rawFile);
+}
+
+static void LogBinaryWriteText(const LogBinaryRecordHeader * h)
+{
+	const char * payload = (const char *)(h+1);
+	if ( h->kind == kind_text )
+	{
+		LogWriteDeferred(payload,h->tabs);
+		return;
+	}
+
+	const LogBinaryFormat * f = (const LogBinaryFormat *)(intptr_t) h->format;
+	s_text->Clear();
+	LogBinaryFormatArgs(f,payload,s_text);
+
+	s_flat->resize( s_text->Length() + 1 );
+	s_text->CopyTo(s_flat->data());
+	LogWriteDeferred(s_flat->data(),h->tabs);
+}
+
+static void LogBinaryDrain()
+{
+	vector<LogBinaryCursor> cursors;
+	{
+		CB_SCOPE_CRITICAL_SECTION(*s_mutex);
+		for(LogBinaryRing * ring = s_rings; ring; ring = ring->next)
+		{
+			LogBinaryCursor c;
+			c.ring = ring;
+			c.pos = ring->tail;
+			c.limit = LoadAcquire(&ring->head);
+			if ( c.pos != c.limit )
+				cursors.push_back(c);
+		}
+	}
+
+	// merge by tsc :
+	for(;;)
+	{
+		int best = -1;
+		const LogBinaryRecordHeader * bestH = NULL;
+		for LOOPVEC(i,cursors)
+		{
+			const LogBinaryRecordHeader * h = LogBinaryPeek(cursors[i]);
+			if ( h && ( bestH == NULL || h->tsc < bestH->tsc ) )
+			{
+				best = i;
+				bestH = h;
+			}
+		}
+		if ( best < 0 )
+			break;
+
+		if ( s_rawFile )
+			LogBinaryWriteRaw(bestH);
+		else
+			LogBinaryWriteText(bestH);
+
+		LogBinaryCursor & c = cursors[best];
+		c.pos += bestH->bytes;
+		StoreRelease(&c.ring->tail, c.pos);
+	}
+
+	for LOOPVEC(i,cursors)
+	{
+		StoreRelease(&cursors[i].ring->tail, cursors[i].pos);
+	}
+
+	if ( s_rawFile )
+		fflush(s_rawFile);
+}
+
+static DWORD WINAPI LogBinaryThreadRoutine(LPVOID)
+{
+	s_isWriterThread = true;
+
+	while ( ! s_quit )
+	{
+		WaitForSingleObject(s_event,c_writerPollMillis);
+		LogBinaryDrain();
+	}
+
+	// one more to get anything that came in while we were quitting :
+	LogBinaryDrain();
+	return 0;
+}
+
+//=========================================================================================
+
+// everything LogBinaryOpen made , except the thread
+static void LogBinaryFreeState()
+{
+	CloseHandle(s_event);
+	s_event = 0;
+
+	LogBinaryRing * ring = s_rings;
+	while ( ring )
+	{
+		LogBinaryRing * next = ring->next;
+		CBFREE(ring->data);
+		CBFREE(ring);
+		ring = next;
+	}
+	s_rings = NULL;
+	s_generation++;
+
+	// formats that failed to parse are in the hash as NULL ; the rest are in s_formats
+	for(int i=0;i<s_formats->size32();i++)
+	{
+		LogBinaryFreeFormat( (*s_formats)[i] );
+	}
+	delete s_formats; s_formats = NULL;
+	delete s_formatHash; s_formatHash = NULL;
+	delete s_text; s_text = NULL;
+	delete s_flat; s_flat = NULL;
+	delete s_defined; s_defined = NULL;
+
+	if ( s_rawFile )
+	{
+		fclose(s_rawFile);
+		s_rawFile = NULL;
+	}
+
+	delete s_mutex;
+	s_mutex = NULL;
+}
+
+bool LogBinaryOpen(const char * rawFileName,int ringBytesPerThread)
+{
+	if ( s_open )
+		return true;
+
+	if ( rawFileName )
+	{
+		s_rawFile = fopen(rawFileName,"wb");
+		if ( ! s_rawFile )
+		{
+			lprintf("LogBinaryOpen : couldn't open %s\n",rawFileName);
+			return false;
+		}
+		uint32 version = 1;
+		fwrite(c_rawFileMagic,1,sizeof(c_rawFileMagic),s_rawFile);
+		fwrite(&version,sizeof(version),1,s_rawFile);
+		fwrite(&version,sizeof(version),1,s_rawFile); // pad to 16
+	}
+
+	uint32 size = 4096;
+	while ( size < (uint32)ringBytesPerThread )
+		size *= 2;
+
+	s_mutex = new CriticalSection();
+	s_rings = NULL;
+	s_ringSize = size;
+	s_formatHash = new t_formatHash();
+	s_formats = new vector<LogBinaryFormat *>();
+	s_text = new StringBuilder(1024);
+	s_flat = new vector<char>();
+	s_defined = new vector<uint8>();
+	s_generation++;
+	s_quit = false;
+
+	s_event = CreateEvent(NULL,FALSE,FALSE,NULL);
+	s_thread = CreateThread(NULL,0,LogBinaryThreadRoutine,NULL,0,NULL);
+	if ( s_thread == 0 )
+	{
+		lprintf("LogBinaryOpen : CreateThread failed\n");
+		LogBinaryFreeState();
+		return false;
+	}
+
+	s_open = true;
+	return true;
+}
+
+bool LogBinaryIsOpen()
+{
+	return s_open;
+}
+
+void LogBinarySync()
+{
+	if ( ! s_open || s_isWriterThread )
+		return;
+
+	vector<LogBinaryCursor> marks;
+	{
+		CB_SCOPE_CRITICAL_SECTION(*s_mutex);
+		for(LogBinaryRing * ring = s_rings; ring; ring = ring->next)
+		{
+			LogBinaryCursor c;
+			c.ring = ring;
+			c.pos = 0;
+			c.limit = LoadAcquire(&ring->head);
+			marks.push_back(c);
+		}
+	}
+
+	SetEvent(s_event);
+	for LOOPVEC(i,marks)
+	{
+		// tail can go past the mark , compare signed :
+		while ( (int32)( LoadAcquire(&marks[i].ring->tail) - marks[i].limit ) < 0 )
+		{
+			SetEvent(s_event);
+			ThreadSleep(1);
+		}
+	}
+}
+
+void LogBinaryClose()
+{
+	if ( ! s_open )
+		return;
+
+	s_open = false;
+
+	s_quit = true;
+	SetEvent(s_event);
+	WaitForSingleObject(s_thread,INFINITE);
+	CloseHandle(s_thread);
+	s_thread = 0;
+
+	LogBinaryFreeState();
+}
+
+//=========================================================================================
+
+bool LogBinaryDecode(const char * rawFileName,FILE * to)
+{
+	int64 length = 0;
+	char * buf = ReadWholeFile(rawFileName,&length);
+	if ( ! buf )
+		return false;
+
+	bool ok = ( length >= 16 && memcmp(buf,c_rawFileMagic,sizeof(c_rawFileMagic)) == 0 );
+
+	vector<LogBinaryFormat *> formats;
+	StringBuilder text(1024);
+	bool atEOL = true;
+
+	int64 pos = 16;
+	while ( ok && pos < length )
+	{
+		if ( pos + (int64)sizeof(LogBinaryRecordHeader) > length )
+		{
+			ok = false;
+			break;
+		}
+		const LogBinaryRecordHeader * h = (const LogBinaryRecordHeader *)(buf + pos);
+		if ( h->bytes < sizeof(LogBinaryRecordHeader) || pos + h->bytes > length )
+		{
+			ok = false;
+			break;
+		}
+		const char * payload = (const char *)(h+1);
+
+		text.Clear();
+		if ( h->kind == kind_define )
+		{
+			LogBinaryFormat * f = new LogBinaryFormat;
+			// the writer only defines formats that parsed :
+			LogBinaryParse(f,payload);
+			f->id = (uint32) h->format;
+			if ( formats.size32() <= (int)f->id )
+				formats.resize(f->id+1,NULL);
+			formats[f->id] = f;
+		}
+		else if ( h->kind == kind_text )
+		{
+			text.Append(payload);
+		}
+		else if ( h->kind == kind_args && h->format < (uint64)formats.size() && formats[(int)h->format] )
+		{
+			LogBinaryFormatArgs(formats[(int)h->format],payload,&text);
+		}
+		else
+		{
+			ok = false;
+			break;
+		}
+
+		if ( text.Length() > 0 )
+		{
+			if ( atEOL )
+			{
+				for LOOP(t,h->tabs)
+					fputc('\t',to);
+			}
+			// small pieces ; plain fwrite beats WriteText's writev here
+			for LOOP(c,text.GetNumChunks())
+			{
+				int len;
+				const char * chunk = text.GetChunk(c,&len);
+				fwrite(chunk,1,len,to);
+			}
+
+			char last = text.PopBack();
+			atEOL = ( last == '\n' || last == '\r' );
+		}
+
+		pos += h->bytes;
+	}
+
+	for LOOPVEC(i,formats)
+	{
+		if ( formats[i] )
+			LogBinaryFreeFormat(formats[i]);
+	}
+	CBFREE(buf);
+	return ok;
+}
+
+//=========================================================================================
+
+END_CB
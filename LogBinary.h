@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Base.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+/**
+
+LogBinary : deferred formatting for the log
+
+when LogBinary is open and CB_LOG_BINARY is in LogSetState , rawlprintf doesn't format :
+	it records the format string (by pointer, it has to be a literal) and the raw argument bytes
+	into a per-thread ring and returns
+	strings (%s) are copied , everything else is 8 bytes
+
+a writer thread drains the rings (in rdtsc order) and either :
+	formats them and sends them through the normal log outputs (file/echo/debugger/callback)
+	or , if you give it rawFileName , just dumps the records to that file
+		which you turn into text later with LogBinaryDecode
+
+formats it can't defer (non-literal format, %n, %S/%ls, long double, positional args)
+	get formatted on the calling thread and queued as text, so everything still comes out in order
+
+NOTE : the normal lprintf goes through autoprintf, which makes a String on the calling thread
+	and then calls rawlprintf("%s") ; that still works in binary mode but saves nothing
+	define DO_CB_LPRINTF_SIMPLE to make lprintf go straight to rawlprintf and get the win
+
+NOTE : anything still in the rings when you crash is lost ; LogBinarySync() if you care
+
+if a thread's ring is full, the logging thread waits for the writer (it does not drop)
+
+**/
+
+START_CB
+
+// rawFileName == NULL means format on the writer thread and write normally
+bool LogBinaryOpen(const char * rawFileName = NULL,int ringBytesPerThread = 256*1024);
+// Close drains everything ; call it after other threads are done logging
+void LogBinaryClose();
+bool LogBinaryIsOpen();
+
+// blocks until everything recorded before the call has gone out
+void LogBinarySync();
+
+// decode a raw file written in rawFileName mode :
+bool LogBinaryDecode(const char * rawFileName,FILE * to);
+
+// internal use only , from rawlprintf :
+//	returns false if it didn't take the message (rawlprintf should do it normally)
+bool LogBinaryRecord(int tabs,const char * fmt,va_list args);
+
+END_CB
@@ -0,0 +1,339 @@
+#include "MemFile.h"
+#include "File.h"
+#include "FileUtil.h"
+#include "Log.h"
+#include "Util.h"
+#include <string.h>
+
+START_CB
+
+// chunks double until they get this big :
+static const int c_maxChunkSize = 1024*1024;
+
+//=======================================================================
+
+MemFile::MemFile(int firstChunkSize) :
+	m_size(0),
+	m_readPos(0),
+	m_readChunk(0),
+	m_readOffset(0),
+	m_firstChunkSize(firstChunkSize),
+	m_nextChunkSize(firstChunkSize),
+	m_reading(false)
+{
+	ASSERT( firstChunkSize > 0 );
+}
+
+MemFile::~MemFile()
+{
+}
+
+void MemFile::Clear()
+{
+	m_chunks.clear();
+	m_size = 0;
+	m_readPos = 0;
+	m_readChunk = 0;
+	m_readOffset = 0;
+	m_nextChunkSize = m_firstChunkSize;
+}
+
+MemFile::Chunk & MemFile::Reserve(int need)
+{
+	if ( ! m_chunks.empty() )
+	{
+		Chunk & tail = m_chunks.back();
+		if ( tail.cap - tail.len >= need )
+			return tail;
+	}
+
+	Chunk c;
+	c.cap = MAX(need,m_nextChunkSize);
+	c.buf = Buffer::Create(c.cap);
+	c.start = m_size;
+	c.len = 0;
+	m_chunks.push_back(c);
+
+	m_nextChunkSize = MIN(m_nextChunkSize*2,c_maxChunkSize);
+
+	return m_chunks.back();
+}
+
+//=======================================================================
+
+void MemFile::Write(const void * bits,const int count)
+{
+	if ( count <= 0 )
+		return;
+
+	const char * ptr = (const char *) bits;
+	int len = count;
+
+	// fill the tail of the current chunk first, then at most one new one :
+	if ( ! m_chunks.empty() )
+	{
+		Chunk & tail = m_chunks.back();
+		int room = MIN(tail.cap - tail.len,len);
+		memcpy(tail.buf->m_data + tail.len,ptr,room);
+		tail.len += room;
+		m_size += room;
+		ptr += room;
+		len -= room;
+		if ( len == 0 )
+			return;
+	}
+
+	// (Reserve takes the new chunk's start from m_size)
+	Chunk & c = Reserve(len);
+	memcpy(c.buf->m_data + c.len,ptr,len);
+	c.len += len;
+	m_size += len;
+}
+
+void MemFile::AdoptBuffer(const BufferPtr & buf)
+{
+	if ( buf == NULL || buf->m_size <= 0 )
+		return;
+
+	Chunk c;
+	c.buf = buf;
+	c.start = m_size;
+	c.len = buf->m_size;
+	c.cap = buf->m_size;
+	m_chunks.push_back(c);
+
+	m_size += c.len;
+}
+
+int MemFile::Read(void * bits,const int count)
+{
+	char * to = (char *) bits;
+	int done = 0;
+
+	const int numChunks = m_chunks.size32();
+	while ( done < count && m_readChunk < numChunks )
+	{
+		const Chunk & c = m_chunks[m_readChunk];
+		int avail = c.len - m_readOffset;
+		if ( avail <= 0 )
+		{
+			// stay on the tail chunk ; it may get written to
+			if ( m_readChunk+1 >= numChunks )
+				break;
+			m_readChunk++;
+			m_readOffset = 0;
+			continue;
+		}
+
+		int n = MIN(avail,count - done);
+		memcpy(to + done,c.buf->m_data + m_readOffset,n);
+		m_readOffset += n;
+		done += n;
+	}
+
+	m_readPos += done;
+	return done;
+}
+
+void MemFile::Seek(int64 pos)
+{
+	pos = MAX(pos,0);
+	pos = MIN(pos,m_size);
+	m_readPos = pos;
+
+	if ( m_chunks.empty() )
+	{
+		m_readChunk = 0;
+		m_readOffset = 0;
+		return;
+	}
+
+	// last chunk that starts at or before pos :
+	int lo = 0;
+	int hi = m_chunks.size32() - 1;
+	while ( lo < hi )
+	{
+		int mid = (lo + hi + 1) >> 1;
+		if ( m_chunks[mid].start <= pos )
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	m_readChunk = lo;
+	m_readOffset = check_value_cast<int>( pos - m_chunks[lo].start );
+}
+
+//=======================================================================
+
+void MemFile::WriteCString(const char * str)
+{
+	int len = (int) strlen(str);
+	Put32( (uint32) len );
+	Write(str,len);
+}
+
+void MemFile::WriteString(const String & str)
+{
+	int len = str.Length();
+	Put32( (uint32) len );
+	Write(str.CStr(),len);
+}
+
+String MemFile::ReadString()
+{
+	String ret;
+	int len = (int) Get32();
+	if ( len <= 0 || len > GetRemaining() )
+		return ret;
+	char * ptr = ret.WriteableCStr(len+1);
+	Read(ptr,len);
+	ptr[len] = 0;
+	ret.Truncate(len);
+	return ret;
+}
+
+//=======================================================================
+
+const char * MemFile::GetChunk(int i,int * pLen) const
+{
+	const Chunk & c = m_chunks[i];
+	if ( i < m_readChunk )
+	{
+		*pLen = 0;
+		return c.buf->m_data + c.len;
+	}
+	else if ( i == m_readChunk )
+	{
+		*pLen = c.len - m_readOffset;
+		return c.buf->m_data + m_readOffset;
+	}
+	else
+	{
+		*pLen = c.len;
+		return c.buf->m_data;
+	}
+}
+
+void MemFile::GetIOVecs(vector<MemFileIOVec> * pInto) const
+{
+	pInto->clear();
+	for(int i=m_readChunk;i<m_chunks.size32();i++)
+	{
+		int len;
+		const char * data = GetChunk(i,&len);
+		if ( len == 0 )
+			continue;
+
+		MemFileIOVec iov;
+		iov.iov_base = (void *) data;
+		iov.iov_len = len;
+		pInto->push_back(iov);
+	}
+}
+
+void MemFile::CopyTo(void * to) const
+{
+	char * ptr = (char *) to;
+	for(int i=m_readChunk;i<m_chunks.size32();i++)
+	{
+		int len;
+		const char * data = GetChunk(i,&len);
+		memcpy(ptr,data,len);
+		ptr += len;
+	}
+}
+
+bool MemFile::WriteTo(FILE * fp) const
+{
+	// in batches off the stack ; each WriteIOVecs carries on at the file's position
+	const int c_batch = 64;
+	FileIOVec iov[c_batch];
+
+	int next = m_readChunk;
+	const int numChunks = m_chunks.size32();
+	while ( next < numChunks )
+	{
+		int count = 0;
+		while ( count < c_batch && next < numChunks )
+		{
+			int len;
+			const char * data = GetChunk(next,&len);
+			next++;
+			if ( len == 0 )
+				continue;
+			iov[count].iov_base = (void *) data;
+			iov[count].iov_len = len;
+			count++;
+		}
+
+		if ( ! WriteIOVecs(fp,iov,count) )
+			return false;
+	}
+	return true;
+}
+
+bool MemFile::WriteTo(File & file) const
+{
+	return WriteTo(file.Get());
+}
+
+//=======================================================================
+
+void MemFile::TakeBuffers(vector<BufferPtr> * pInto)
+{
+	pInto->clear();
+	for(int i=m_readChunk;i<m_chunks.size32();i++)
+	{
+		Chunk & c = m_chunks[i];
+		if ( i == m_readChunk && m_readOffset > 0 )
+		{
+			// can't hand out the middle of a Buffer ; copy what's left of it
+			int len = c.len - m_readOffset;
+			if ( len == 0 )
+				continue;
+			BufferPtr part = Buffer::Create(len);
+			memcpy(part->m_data,c.buf->m_data + m_readOffset,len);
+			pInto->push_back(part);
+			continue;
+		}
+		if ( c.len == 0 )
+			continue;
+
+		// the new [] block is still the whole cap , just report the used part :
+		c.buf->m_size = c.len;
+		pInto->push_back(c.buf);
+	}
+
+	Clear();
+}
+
+BufferPtr MemFile::TakeBuffer()
+{
+	const int64 remaining = GetRemaining();
+	BufferPtr ret;
+
+	if ( remaining == 0 )
+	{
+		Clear();
+		return Buffer::Create();
+	}
+
+	// all in one chunk from its start ?
+	const Chunk & first = m_chunks[m_readChunk];
+	if ( m_readOffset == 0 && first.len == remaining )
+	{
+		ret = first.buf;
+		ret->m_size = first.len;
+	}
+	else
+	{
+		ret = Buffer::Create( check_value_cast<int>(remaining) );
+		CopyTo(ret->m_data);
+	}
+
+	Clear();
+	return ret;
+}
+
+END_CB
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "Base.h"
+#include "SPtr.h"
+#include "Buffer.h"
+#include "String.h"
+#include "vector.h"
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+/**
+
+MemFile : a growable in-memory file in a list of chunks
+
+FileRC::CreateMemFile only works over a buffer you already have , so you have to know the
+	size up front ; MemFile just grows , and never moves what's already been written
+
+chunks start at firstChunkSize and double up to 1 MB ; each chunk is a Buffer , so
+	TakeBuffers hands them off with no copy
+
+Write always appends at the end ; Read has its own position (Tell/Seek) , so you can
+	write a bunch of objects and read them back , or use it as a queue
+
+AdoptBuffer adds someone else's Buffer as a chunk (shared , not copied) to be read from ;
+	it's never written into
+
+for the trip to disk : WriteTo gather-writes the unread chunks (writev on posix) ,
+	or GetIOVecs gives you the list to hand to writev yourself
+
+the Put/Get functions are big endian , like File
+
+NOT thread safe
+
+**/
+
+START_CB
+
+class File;
+
+#ifdef _WIN32
+struct MemFileIOVec
+{
+	void *	iov_base;
+	size_t	iov_len;
+};
+#else
+typedef struct iovec MemFileIOVec;
+#endif
+
+SPtrFwd(MemFile); // MemFilePtr
+
+class MemFile : public RefCounted
+{
+public:
+	explicit MemFile(int firstChunkSize = 4096);
+	~MemFile();
+
+	static MemFilePtr Create(int firstChunkSize = 4096)
+	{
+		return MemFilePtr( new MemFile(firstChunkSize) );
+	}
+
+	//----------------------------------------------------
+
+	void Write(const void * bits,const int count);
+
+	// returns the number of bytes read ; short at the end
+	int Read(void * bits,const int count);
+
+	// IO reads or writes depending on SetReading
+	void SetReading(bool reading) { m_reading = reading; }
+	bool IsReading() const { return m_reading; }
+
+	void IO(void * bits,const int count)
+	{
+		if ( m_reading )
+			Read(bits,count);
+		else
+			Write(bits,count);
+	}
+
+	template <typename T>
+	void IO(T & t)
+	{
+		IO(&t,sizeof(t));
+	}
+
+	// add buf as a chunk to read from ; shares it , doesn't copy
+	void AdoptBuffer(const BufferPtr & buf);
+
+	//----------------------------------------------------
+
+	// all the bytes , read or not
+	int64 GetSize() const { return m_size; }
+	// the read position
+	int64 Tell() const { return m_readPos; }
+	int64 GetRemaining() const { return m_size - m_readPos; }
+	bool IsEOF() const { return m_readPos >= m_size; }
+
+	// moves the read position ; clamped to [0,GetSize()]
+	void Seek(int64 pos);
+
+	// frees everything
+	void Clear();
+
+	//----------------------------------------------------
+
+	void  Put8(const uint8 val) { Write(&val,1); }
+	uint8 Get8() { uint8 val = 0; Read(&val,1); return val; }
+
+	void Put16(const uint16 val)
+	{
+		uint8 bytes[2] = { (uint8)(val>>8), (uint8)val };
+		Write(bytes,2);
+	}
+
+	uint16 Get16()
+	{
+		uint8 bytes[2] = { 0 };
+		Read(bytes,2);
+		return (uint16)( (bytes[0]<<8) | bytes[1] );
+	}
+
+	void Put32(const uint32 val)
+	{
+		uint8 bytes[4] = { (uint8)(val>>24), (uint8)(val>>16), (uint8)(val>>8), (uint8)val };
+		Write(bytes,4);
+	}
+
+	uint32 Get32()
+	{
+		uint8 bytes[4] = { 0 };
+		Read(bytes,4);
+		return ((uint32)bytes[0]<<24) | ((uint32)bytes[1]<<16) | ((uint32)bytes[2]<<8) | bytes[3];
+	}
+
+	void Put64(const uint64 val)
+	{
+		Put32((uint32)(val>>32));
+		Put32((uint32)val);
+	}
+
+	uint64 Get64()
+	{
+		uint64 v;
+		v  = ((uint64)Get32())<<32;
+		v |= Get32();
+		return v;
+	}
+
+	// same format as File::WriteString / ReadString
+	void WriteCString(const char * str);
+	void WriteString(const String & str);
+	String ReadString();
+
+	//----------------------------------------------------
+	// hand-off ; these all work on the unread bytes , [Tell(),GetSize())
+
+	int GetNumChunks() const { return m_chunks.size32(); }
+	const char * GetChunk(int i,int * pLen) const;
+
+	// one iovec per chunk ; valid until the next Write/Take/Clear
+	void GetIOVecs(vector<MemFileIOVec> * pInto) const;
+
+	// "to" must have room for GetRemaining()
+	void CopyTo(void * to) const;
+
+	// returns false if a write failed
+	bool WriteTo(FILE * fp) const;
+	bool WriteTo(File & file) const;
+
+	// gives you the chunks and clears ; each Buffer's size is its length
+	//	no copy , except for a chunk that's partly read already
+	void TakeBuffers(vector<BufferPtr> * pInto);
+
+	// one Buffer with all of it , and clears ; no copy if it's all in one chunk
+	BufferPtr TakeBuffer();
+
+	//----------------------------------------------------
+
+private:
+	FORBID_CLASS_STANDARDS(MemFile);
+
+	struct Chunk
+	{
+		BufferPtr	buf;
+		int64		start;	// file offset of data[0]
+		int			len;
+		int			cap;	// == len for adopted chunks , so we never write into them
+	};
+
+	// returns the tail chunk with at least "need" bytes free
+	Chunk & Reserve(int need);
+
+	vector<Chunk>	m_chunks;
+	int64			m_size;
+	int64			m_readPos;
+	int				m_readChunk;
+	int				m_readOffset;	// in m_chunks[m_readChunk]
+	int				m_firstChunkSize;
+	int				m_nextChunkSize;
+	bool			m_reading;
+};
+
+END_CB
@@ -1,6 +1,15 @@
 #include "MemMapFile.h"
 #include "FileUtil.h"
+#include "Mem.h"
+
+#ifdef _WIN32
 #include "Win32Util.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 START_CB
 
@@ -9,57 +18,178 @@ bool MemoryMappedFile::OpenReadWhole(const char *name)
 	Close();
 
 	m_memory = ReadWholeFile(name,&m_size);
+	m_fileSize = m_size;
 
 	return true;
 }
 
+#ifdef _WIN32
+
 bool MemoryMappedFile::OpenMapping(const char *name)
 {
 	Close();
 
-	m_hFile = CreateFile(name,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
-	if ( ! m_hFile ) return false;
+	HANDLE hFile = CreateFile(name,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,0);
+	if ( hFile == INVALID_HANDLE_VALUE ) return false;
+
+	int64 size = GetFileSize64(hFile);
+	CloseHandle(hFile);
+
+	if ( size <= 0 )
+		return false;
 
-	m_size = GetFileSize64(m_hFile);
-	
-	if ( m_size <= 0 )
+	// if m_size is small, switch to OpenReadWholeFile ?
+	if ( size < (128<<20) ) // 128 MB
+	{
+		return OpenReadWhole(name);
+	}
+
+	return OpenWindow(name,0,size,eMemMap_Read);
+}
+
+bool MemoryMappedFile::OpenWindow(const char * name,int64 offset,int64 length,EMemMapMode mode,bool populate)
+{
+	Close();
+
+	DWORD access = GENERIC_READ;
+	DWORD share = FILE_SHARE_READ;
+	DWORD disposition = OPEN_EXISTING;
+	if ( mode == eMemMap_ReadWrite )
+	{
+		access |= GENERIC_WRITE;
+		disposition = OPEN_ALWAYS;
+	}
+	else
+	{
+		// copy-on-write never writes the file , so other writers are fine
+		share |= FILE_SHARE_WRITE;
+	}
+
+	m_hFile = CreateFile(name,access,share,NULL,disposition,FILE_ATTRIBUTE_NORMAL,0);
+	if ( m_hFile == INVALID_HANDLE_VALUE )
 	{
-		CloseHandle(m_hFile);
 		m_hFile = 0;
 		return false;
 	}
 
-	// if m_size is small, switch to OpenReadWholeFile ?
-	if ( m_size < (128<<20) ) // 128 MB
+	m_fileSize = GetFileSize64(m_hFile);
+	m_mode = mode;
+
+	if ( ! MapWindow(offset,length,populate) )
 	{
-		CloseHandle(m_hFile);
-		m_hFile = 0;
-		return OpenReadWhole(name);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool MemoryMappedFile::MapWindow(int64 offset,int64 length,bool populate)
+{
+	if ( offset < 0 )
+		return false;
+	if ( length <= 0 )
+		length = m_fileSize - offset;
+	if ( length <= 0 )
+		return false;
+
+	int64 end = offset + length;
+	if ( end > m_fileSize && m_mode != eMemMap_ReadWrite )
+		return false;
+
+	DWORD protect = PAGE_READONLY;
+	DWORD viewAccess = FILE_MAP_READ;
+	if ( m_mode == eMemMap_ReadWrite )
+	{
+		protect = PAGE_READWRITE;
+		viewAccess = FILE_MAP_WRITE;
 	}
-	
-	m_hMapping = CreateFileMapping(m_hFile,NULL,PAGE_READONLY|SEC_COMMIT,(DWORD)(m_size>>32),(DWORD)(m_size),NULL);
+	else if ( m_mode == eMemMap_CopyOnWrite )
+	{
+		protect = PAGE_WRITECOPY;
+		viewAccess = FILE_MAP_COPY;
+	}
+
+	// sizing the mapping past the end grows the file (ReadWrite only) :
+	m_hMapping = CreateFileMapping(m_hFile,NULL,protect|SEC_COMMIT,(DWORD)(end>>32),(DWORD)(end),NULL);
 	if ( ! m_hMapping ) return false;
-	
-	m_memory = MapViewOfFile(m_hMapping,FILE_MAP_READ,0,0,check_value_cast<SIZE_T>(m_size));
-	if ( ! m_memory ) return false;
+	m_fileSize = MAX(m_fileSize,end);
+
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	int64 granularity = si.dwAllocationGranularity;
+	int64 aligned = offset - (offset % granularity);
+
+	m_mapSize = end - aligned;
+	m_mapBase = MapViewOfFile(m_hMapping,viewAccess,(DWORD)(aligned>>32),(DWORD)(aligned),check_value_cast<SIZE_T>(m_mapSize));
+	if ( ! m_mapBase )
+	{
+		CloseHandle(m_hMapping);
+		m_hMapping = 0;
+		m_mapSize = 0;
+		return false;
+	}
+
+	m_memory = (char *)m_mapBase + (offset - aligned);
+	m_size = length;
+	m_offset = offset;
+
+	if ( populate )
+	{
+		// no MAP_POPULATE ; fault it in by hand
+		const char volatile * ptr = (const char volatile *) m_mapBase;
+		for(int64 i=0;i<m_mapSize;i+=4096)
+			(void)ptr[i];
+	}
 
 	return true;
 }
 
-void MemoryMappedFile::Close()
+void MemoryMappedFile::UnmapWindow()
 {
+	if ( m_mapBase )
+		UnmapViewOfFile(m_mapBase);
 	if ( m_hMapping )
+		CloseHandle(m_hMapping);
+
+	m_hMapping = 0;
+	m_mapBase = 0;
+	m_mapSize = 0;
+	m_memory = 0;
+	m_size = 0;
+}
+
+bool MemoryMappedFile::Advise(EMemMapHint hint,int64 offset,int64 length)
+{
+	// @@ PrefetchVirtualMemory is Win8+ ; nothing to do on XP
+	return false;
+}
+
+bool MemoryMappedFile::Sync(bool wait)
+{
+	if ( ! m_mapBase )
+		return false;
+	if ( m_mode != eMemMap_ReadWrite )
+		return true;
+
+	if ( ! FlushViewOfFile(m_mapBase,0) )
+		return false;
+	if ( wait && ! FlushFileBuffers(m_hFile) )
+		return false;
+	return true;
+}
+
+void MemoryMappedFile::Close()
+{
+	if ( m_mapBase )
 	{
-		if ( m_memory )
-			UnmapViewOfFile(m_memory);
-		CloseHandle(m_hMapping); 
+		UnmapWindow();
 	}
 	else
 	{
 		if ( m_memory )
 			CBFREE( m_memory );
-	}	
-	
+	}
+
 	if ( m_hFile )
 		CloseHandle(m_hFile);
 
@@ -67,6 +197,181 @@ void MemoryMappedFile::Close()
 	m_hMapping = 0;
 	m_hFile = 0;
 	m_size = 0;
+	m_offset = 0;
+	m_fileSize = 0;
+}
+
+#else // _WIN32
+
+//=============================================================
+// posix
+
+bool MemoryMappedFile::OpenMapping(const char *name)
+{
+	return OpenWindow(name,0,0,eMemMap_Read);
+}
+
+bool MemoryMappedFile::OpenWindow(const char * name,int64 offset,int64 length,EMemMapMode mode,bool populate)
+{
+	Close();
+
+	int flags = ( mode == eMemMap_ReadWrite ) ? ( O_RDWR | O_CREAT ) : O_RDONLY;
+	m_fd = open(name,flags|O_CLOEXEC,0644);
+	if ( m_fd < 0 )
+		return false;
+
+	struct stat st;
+	if ( fstat(m_fd,&st) != 0 )
+	{
+		Close();
+		return false;
+	}
+
+	m_fileSize = st.st_size;
+	m_mode = mode;
+
+	if ( ! MapWindow(offset,length,populate) )
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool MemoryMappedFile::MapWindow(int64 offset,int64 length,bool populate)
+{
+	if ( offset < 0 )
+		return false;
+	if ( length <= 0 )
+		length = m_fileSize - offset;
+	if ( length <= 0 )
+		return false;
+
+	int64 end = offset + length;
+	if ( end > m_fileSize )
+	{
+		// pages past the end of the file SIGBUS when you touch them
+		if ( m_mode != eMemMap_ReadWrite || ftruncate(m_fd,end) != 0 )
+			return false;
+		m_fileSize = end;
+	}
+
+	int64 pageSize = sysconf(_SC_PAGESIZE);
+	int64 aligned = offset & ~(pageSize-1);
+
+	int prot = ( m_mode == eMemMap_Read ) ? PROT_READ : ( PROT_READ | PROT_WRITE );
+	int flags = ( m_mode == eMemMap_CopyOnWrite ) ? MAP_PRIVATE : MAP_SHARED;
+	#ifdef MAP_POPULATE
+	if ( populate )
+		flags |= MAP_POPULATE;
+	#endif
+
+	m_mapSize = end - aligned;
+	void * base = mmap(NULL,(size_t)m_mapSize,prot,flags,m_fd,(off_t)aligned);
+	if ( base == MAP_FAILED )
+	{
+		m_mapSize = 0;
+		return false;
+	}
+
+	m_mapBase = base;
+	m_memory = (char *)base + (offset - aligned);
+	m_size = length;
+	m_offset = offset;
+	return true;
+}
+
+void MemoryMappedFile::UnmapWindow()
+{
+	if ( m_mapBase )
+		munmap(m_mapBase,(size_t)m_mapSize);
+
+	m_mapBase = 0;
+	m_mapSize = 0;
+	m_memory = 0;
+	m_size = 0;
+}
+
+bool MemoryMappedFile::Advise(EMemMapHint hint,int64 offset,int64 length)
+{
+	if ( ! m_mapBase )
+		return false;
+
+	int advice;
+	switch(hint)
+	{
+	case eMemMapHint_Sequential:	advice = MADV_SEQUENTIAL; break;
+	case eMemMapHint_Random:		advice = MADV_RANDOM; break;
+	case eMemMapHint_WillNeed:		advice = MADV_WILLNEED; break;
+	case eMemMapHint_HugePage:
+		#ifdef MADV_HUGEPAGE
+		advice = MADV_HUGEPAGE; break;
+		#else
+		return false;
+		#endif
+	default:						advice = MADV_NORMAL; break;
+	}
+
+	if ( length <= 0 )
+		length = m_size - offset;
+	if ( offset < 0 || length <= 0 || offset + length > m_size )
+		return false;
+
+	// madvise wants a page aligned start ; the base is aligned , so round down to it
+	int64 pageSize = sysconf(_SC_PAGESIZE);
+	char * start = (char *)m_memory + offset;
+	char * alignedStart = (char *)m_mapBase + ( ( start - (char *)m_mapBase ) & ~(pageSize-1) );
+	size_t size = (size_t)( start + length - alignedStart );
+
+	return madvise(alignedStart,size,advice) == 0;
+}
+
+bool MemoryMappedFile::Sync(bool wait)
+{
+	if ( ! m_mapBase )
+		return false;
+	if ( m_mode != eMemMap_ReadWrite )
+		return true;
+
+	return msync(m_mapBase,(size_t)m_mapSize,wait ? MS_SYNC : MS_ASYNC) == 0;
+}
+
+void MemoryMappedFile::Close()
+{
+	if ( m_mapBase )
+	{
+		UnmapWindow();
+	}
+	else
+	{
+		if ( m_memory )
+			CBFREE( m_memory );
+	}
+
+	if ( m_fd >= 0 )
+		close(m_fd);
+
+	m_fd = -1;
+	m_memory = 0;
+	m_size = 0;
+	m_offset = 0;
+	m_fileSize = 0;
+}
+
+#endif // _WIN32
+
+bool MemoryMappedFile::MoveWindow(int64 offset,int64 length,bool populate)
+{
+	#ifdef _WIN32
+	if ( ! m_hFile )
+		return false;
+	#else
+	if ( m_fd < 0 )
+		return false;
+	#endif
+
+	UnmapWindow();
+	return MapWindow(offset,length,populate);
 }
 
 END_CB
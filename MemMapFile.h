@@ -2,25 +2,92 @@
 
 #include "Base.h"
 
+#ifdef _WIN32
 typedef void * HANDLE;
+#endif
 
 START_CB
 
 //-------------------------------------------------------------
 
+enum EMemMapMode
+{
+	eMemMap_Read,			// read only
+	eMemMap_ReadWrite,		// shared ; writes go to the file (and to everyone else mapping it)
+	eMemMap_CopyOnWrite		// private ; writes are only seen by this mapping and never reach the file
+};
+
+enum EMemMapHint
+{
+	eMemMapHint_Normal,
+	eMemMapHint_Sequential,	// read ahead aggressively , drop pages behind you
+	eMemMapHint_Random,		// don't read ahead
+	eMemMapHint_WillNeed,	// start reading it in now
+	eMemMapHint_HugePage	// back it with huge pages if the kernel can (fewer TLB misses)
+};
+
+/**
+
+MemoryMappedFile
+
+OpenMapping maps the whole file read only
+	on Windows files under 128 MB are just read into memory (OpenReadWhole) instead
+	on posix it always maps ; the bytes come straight from the page cache
+
+OpenWindow maps part of a file , at any offset (it doesn't need to be aligned ; m_memory
+	points at the byte you asked for) , so you can walk files bigger than address space
+	ReadWrite grows the file if the window goes past the end
+	populate prefaults the whole window up front (MAP_POPULATE) so you don't take the faults later
+
+Advise is madvise ; it's a no-op on Windows
+Sync flushes written pages of a ReadWrite mapping to the file ; wait = block until they're on disk
+
+**/
+
 struct MemoryMappedFile
 {
+	#ifdef _WIN32
 	HANDLE	m_hFile;
 	HANDLE	m_hMapping;
+	#else
+	int		m_fd;
+	#endif
 	void *	m_memory;
 	int64	m_size;
-	
+
+	// what's actually mapped , which starts on a page (allocation granularity) boundary :
+	void *	m_mapBase;
+	int64	m_mapSize;
+	int64	m_offset; // of m_memory in the file
+	int64	m_fileSize;
+	EMemMapMode	m_mode;
+
 	bool OpenMapping(const char * file);
 	bool OpenReadWhole(const char * file);
+
+	// length <= 0 means to the end of the file
+	bool OpenWindow(const char * file,int64 offset,int64 length,EMemMapMode mode = eMemMap_Read,bool populate = false);
+	// remap over the file that's already open
+	bool MoveWindow(int64 offset,int64 length,bool populate = false);
+
+	// offset is relative to m_memory ; length <= 0 means the rest of the window
+	bool Advise(EMemMapHint hint,int64 offset = 0,int64 length = 0);
+	bool Sync(bool wait = true);
+
 	void Close();
-	
-	MemoryMappedFile() : m_hFile(0),m_hMapping(0),m_memory(0),m_size(0) { }
+
+	MemoryMappedFile() :
+		#ifdef _WIN32
+		m_hFile(0),m_hMapping(0),
+		#else
+		m_fd(-1),
+		#endif
+		m_memory(0),m_size(0),m_mapBase(0),m_mapSize(0),m_offset(0),m_fileSize(0),m_mode(eMemMap_Read) { }
 	~MemoryMappedFile() { Close(); }
+
+private:
+	bool MapWindow(int64 offset,int64 length,bool populate);
+	void UnmapWindow();
 };
 
 END_CB
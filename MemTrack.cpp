@@ -12,6 +12,7 @@
 #include "Log.h"
 #include "Threading.h"
 #include "MemTrack.h"
+#include "Metrics.h"
 
 START_CB
 
@@ -50,6 +51,11 @@ struct MemTracker
 	~MemTracker() { }
 };
 
+// these mirror m_stats so they show up in Metrics dumps :
+static MetricCounter s_metricAllocs = METRIC_COUNTER_INIT("memtrack.allocs");
+static MetricCounter s_metricFrees = METRIC_COUNTER_INIT("memtrack.frees");
+static MetricSumGauge s_metricBytesOutstanding = METRIC_SUM_GAUGE_INIT("memtrack.bytes_outstanding");
+
 //static volatile bool s_memTrackEnabled = true;
 static MemTracker * volatile s_pTracker = NULL;
 static volatile bool s_memTrackEnabled = true;
@@ -167,6 +173,9 @@ void MemTrack_Add(void * handle, size_t size, EMemTrackType type)
 	
 	tracker->m_stats.numAllocs ++;
 	tracker->m_stats.bytesAlloced += size;
+	
+	s_metricAllocs.Add(1);
+	s_metricBytesOutstanding.Add((int64)size);
 }
 
 void MemTrack_Remove(void * handle)
@@ -188,6 +197,9 @@ void MemTrack_Remove(void * handle)
 		tracker->m_stats.numFrees ++;
 		tracker->m_stats.bytesFreed += data.size;
 		
+		s_metricFrees.Add(1);
+		s_metricBytesOutstanding.Add(-(int64)data.size);
+		
 		tracker->m_hash.erase( ep );
 	}
 }
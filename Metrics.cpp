@@ -0,0 +1,456 @@
+#include "Metrics.h"
+#include "Threading.h"
+#include "Timer.h"
+#include "Log.h"
+#include "StringBuilder.h"
+#include "FastPrintf.h"
+#include "Mem.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <malloc.h>
+#include <algorithm>
+
+START_CB
+
+//=========================================================================================
+
+/**
+
+Sharding is by thread , not by core : each thread takes the next shard round-robin the first
+	time it touches a metric , so up to METRIC_NUM_SHARDS threads never share a line
+	(past that they share , which is still correct since the add is atomic)
+
+the registry is a lock-free singly linked list of MetricInfo , pushed on first touch
+	it's never shrunk , so readers can walk it any time
+
+**/
+
+static MetricInfo * volatile s_metricsHead = NULL;
+static SimpleMutex s_metricsMutex = 0; // for GetX by name and the EWMA ticks
+
+static uint32 volatile s_nextShard = 0;
+static CB_THREAD_LOCAL int s_myShard = -1;
+
+static inline int Metrics_MyShard()
+{
+	int shard = s_myShard;
+	if ( shard < 0 )
+	{
+		shard = (int)( AtomicExchangeAdd(&s_nextShard,(uint32)1) % METRIC_NUM_SHARDS );
+		s_myShard = shard;
+	}
+	return shard;
+}
+
+static void Metrics_Register(MetricInfo * info)
+{
+	if ( ! AtomicCAS32(&info->registered,0,1) )
+		return;
+
+	for(;;)
+	{
+		MetricInfo * head = LoadAcquirePointer(&s_metricsHead);
+		info->next = head;
+		if ( AtomicCASPointer((void **)&s_metricsHead,head,info) )
+			break;
+	}
+}
+
+static int64 Metrics_SumShards(const MetricShard * shards)
+{
+	int64 sum = 0;
+	for LOOP(i,METRIC_NUM_SHARDS)
+	{
+		sum += LoadAcquire(&shards[i].value);
+	}
+	return sum;
+}
+
+//=========================================================================================
+
+void MetricCounter::Add(const int64 n)
+{
+	AtomicExchangeAdd(&shards[Metrics_MyShard()].value,n);
+	if ( ! info.registered )
+		Metrics_Register(&info);
+}
+
+int64 MetricCounter::Get() const
+{
+	return Metrics_SumShards(shards);
+}
+
+void MetricGauge::Set(const int64 v)
+{
+	StoreRelease(&value,v);
+	if ( ! info.registered )
+		Metrics_Register(&info);
+}
+
+void MetricGauge::Add(const int64 delta)
+{
+	AtomicExchangeAdd(&value,delta);
+	if ( ! info.registered )
+		Metrics_Register(&info);
+}
+
+int64 MetricGauge::Get() const
+{
+	return LoadAcquire(&value);
+}
+
+void MetricSumGauge::Add(const int64 delta)
+{
+	AtomicExchangeAdd(&shards[Metrics_MyShard()].value,delta);
+	if ( ! info.registered )
+		Metrics_Register(&info);
+}
+
+int64 MetricSumGauge::Get() const
+{
+	// single shards can be negative (freed on another thread) ; only the sum means anything
+	return Metrics_SumShards(shards);
+}
+
+void MetricRate::Mark(const int64 n)
+{
+	AtomicExchangeAdd(&shards[Metrics_MyShard()].value,n);
+	if ( ! info.registered )
+		Metrics_Register(&info);
+}
+
+int64 MetricRate::GetCount() const
+{
+	return Metrics_SumShards(shards);
+}
+
+//=========================================================================================
+
+#define METRIC_TICK_MILLIS	(5000)
+
+// call with s_metricsMutex held
+static void Metrics_TickRate(MetricRate * rate,const uint64 now)
+{
+	const int64 count = rate->GetCount();
+
+	if ( rate->lastTickMillis == 0 )
+	{
+		rate->lastTickMillis = now;
+		rate->lastCount = count;
+		return;
+	}
+
+	// alpha for a tick of T seconds and a window of M minutes is 1 - exp(-T/(60*M))
+	const double tickSeconds = METRIC_TICK_MILLIS / 1000.0;
+	const double alpha1  = 1.0 - exp( - tickSeconds / 60.0 );
+	const double alpha5  = 1.0 - exp( - tickSeconds / 300.0 );
+	const double alpha15 = 1.0 - exp( - tickSeconds / 900.0 );
+
+	// if nobody Snapshots for a while , the first tick gets all the counts and the rest get zero
+	while ( now - rate->lastTickMillis >= METRIC_TICK_MILLIS )
+	{
+		const double instant = (double)( count - rate->lastCount ) / tickSeconds;
+		rate->lastCount = count;
+		rate->lastTickMillis += METRIC_TICK_MILLIS;
+
+		rate->rate1  += alpha1  * ( instant - rate->rate1 );
+		rate->rate5  += alpha5  * ( instant - rate->rate5 );
+		rate->rate15 += alpha15 * ( instant - rate->rate15 );
+	}
+}
+
+struct MetricValue_NameLess
+{
+	bool operator () (const MetricValue & a,const MetricValue & b) const
+	{
+		return strcmp(a.name,b.name) < 0;
+	}
+};
+
+void Metrics_Snapshot(vector<MetricValue> * pInto)
+{
+	pInto->clear();
+
+	const uint64 now = Timer::GetMillis64();
+
+	SimpleLock(&s_metricsMutex);
+
+	for(MetricInfo * info = LoadAcquirePointer(&s_metricsHead); info != NULL; info = info->next)
+	{
+		MetricValue v;
+		v.name = info->name;
+		v.type = (EMetricType) info->type;
+		v.rate1 = v.rate5 = v.rate15 = 0.0;
+
+		switch(info->type)
+		{
+		case eMetric_Counter:
+			v.value = ((MetricCounter *)info)->Get();
+			break;
+		case eMetric_Gauge:
+			v.value = ((MetricGauge *)info)->Get();
+			break;
+		case eMetric_SumGauge:
+			v.type = eMetric_Gauge;
+			v.value = ((MetricSumGauge *)info)->Get();
+			break;
+		case eMetric_Rate:
+		{
+			MetricRate * rate = (MetricRate *)info;
+			Metrics_TickRate(rate,now);
+			v.value = rate->GetCount();
+			v.rate1 = rate->rate1;
+			v.rate5 = rate->rate5;
+			v.rate15 = rate->rate15;
+			break;
+		}
+		default:
+			ASSERT(false);
+			continue;
+		}
+
+		pInto->push_back(v);
+	}
+
+	SimpleUnlock(&s_metricsMutex);
+
+	std::sort(pInto->begin(),pInto->end(),MetricValue_NameLess());
+}
+
+//=========================================================================================
+
+template <typename T>
+static T * Metrics_FindOrMake(const char * name,const EMetricType type)
+{
+	SimpleLock(&s_metricsMutex);
+
+	for(MetricInfo * info = LoadAcquirePointer(&s_metricsHead); info != NULL; info = info->next)
+	{
+		if ( info->type == type && strcmp(info->name,name) == 0 )
+		{
+			SimpleUnlock(&s_metricsMutex);
+			return (T *) info;
+		}
+	}
+
+	// never freed ; the name is copied so the caller's string can go away
+	T * metric = (T *) _aligned_malloc(sizeof(T),64);
+	memset(metric,0,sizeof(T));
+	const size_t nameLen = strlen(name);
+	char * nameCopy = (char *) malloc(nameLen+1);
+	memcpy(nameCopy,name,nameLen+1);
+	metric->info.name = nameCopy;
+	metric->info.type = type;
+	Metrics_Register(&(metric->info));
+
+	SimpleUnlock(&s_metricsMutex);
+	return metric;
+}
+
+MetricCounter * Metrics_GetCounter(const char * name)
+{
+	return Metrics_FindOrMake<MetricCounter>(name,eMetric_Counter);
+}
+
+MetricGauge * Metrics_GetGauge(const char * name)
+{
+	return Metrics_FindOrMake<MetricGauge>(name,eMetric_Gauge);
+}
+
+MetricRate * Metrics_GetRate(const char * name)
+{
+	return Metrics_FindOrMake<MetricRate>(name,eMetric_Rate);
+}
+
+MetricSumGauge * Metrics_GetSumGauge(const char * name)
+{
+	return Metrics_FindOrMake<MetricSumGauge>(name,eMetric_SumGauge);
+}
+
+//=========================================================================================
+
+static void Metrics_Format(StringBuilder * sb,const vector<MetricValue> & values,const EMetricsFormat format)
+{
+	if ( format == eMetricsFormat_JSON )
+	{
+		sb->CatPrintf("{\"millis\":%I64u,\"metrics\":{",Timer::GetMillis64());
+		for LOOPVEC(i,values)
+		{
+			const MetricValue & v = values[i];
+			if ( i > 0 )
+				sb->Append(',');
+			sb->Append("\n");
+			sb->AppendJSONString(v.name);
+			switch(v.type)
+			{
+			case eMetric_Counter:
+				sb->CatPrintf(":{\"type\":\"counter\",\"value\":%I64d}",v.value);
+				break;
+			case eMetric_Gauge:
+				sb->CatPrintf(":{\"type\":\"gauge\",\"value\":%I64d}",v.value);
+				break;
+			case eMetric_Rate:
+				sb->CatPrintf(":{\"type\":\"rate\",\"count\":%I64d,\"m1\":",v.value);
+				sb->AppendJSONNumber(v.rate1);
+				sb->Append(",\"m5\":");
+				sb->AppendJSONNumber(v.rate5);
+				sb->Append(",\"m15\":");
+				sb->AppendJSONNumber(v.rate15);
+				sb->Append('}');
+				break;
+			}
+		}
+		sb->Append("\n}}\n");
+	}
+	else
+	{
+		for LOOPVEC(i,values)
+		{
+			const MetricValue & v = values[i];
+			switch(v.type)
+			{
+			case eMetric_Counter:
+			case eMetric_Gauge:
+				sb->CatPrintf("%-40s : %I64d\n",v.name,v.value);
+				break;
+			case eMetric_Rate:
+				sb->CatPrintf("%-40s : %I64d : %.3f %.3f %.3f /s\n",v.name,v.value,v.rate1,v.rate5,v.rate15);
+				break;
+			}
+		}
+	}
+}
+
+void Metrics_Log()
+{
+	vector<MetricValue> values;
+	Metrics_Snapshot(&values);
+
+	StringBuilder sb;
+	Metrics_Format(&sb,values,eMetricsFormat_Text);
+
+	lprintf("------ Metrics :\n");
+	lprintf("%s",sb.ToString().CStr());
+}
+
+bool Metrics_WriteFile(const char * fileName,EMetricsFormat format)
+{
+	vector<MetricValue> values;
+	Metrics_Snapshot(&values);
+
+	StringBuilder sb;
+	Metrics_Format(&sb,values,format);
+
+	char tempName[_MAX_PATH];
+	_snprintf(tempName,sizeof(tempName),"%s.tmp",fileName);
+	tempName[sizeof(tempName)-1] = 0;
+
+	FILE * fp = fopen(tempName,"wb");
+	if ( ! fp )
+		return false;
+	bool ok = sb.WriteText(fp);
+	ok = ( ferror(fp) == 0 ) && ok;
+	// fclose flushes what's left ; if that fails the temp is short , so don't rename it over
+	ok = ( fclose(fp) == 0 ) && ok;
+
+	if ( ! ok || ! MoveFileEx(tempName,fileName,MOVEFILE_REPLACE_EXISTING) )
+	{
+		DeleteFile(tempName);
+		return false;
+	}
+	return true;
+}
+
+//=========================================================================================
+
+struct MetricsDumpState
+{
+	int				periodMillis;
+	char *			fileName;
+	EMetricsFormat	format;
+	HANDLE			thread;
+	HANDLE			wake;
+	bool volatile	quit;
+};
+
+static MetricsDumpState * s_metricsDump = NULL;
+
+static DWORD WINAPI MetricsDumpThreadRoutine(LPVOID param)
+{
+	MetricsDumpState * st = (MetricsDumpState *) param;
+
+	while ( ! st->quit )
+	{
+		WaitForSingleObject(st->wake,st->periodMillis);
+		if ( st->quit )
+			break;
+
+		if ( st->fileName )
+		{
+			if ( ! Metrics_WriteFile(st->fileName,st->format) )
+				lprintf("Metrics : couldn't write %s\n",st->fileName);
+		}
+		else
+		{
+			Metrics_Log();
+		}
+	}
+
+	return 0;
+}
+
+bool Metrics_StartDump(int periodMillis,const char * fileName,EMetricsFormat format)
+{
+	if ( s_metricsDump )
+		return false;
+
+	MetricsDumpState * st = new MetricsDumpState;
+	st->periodMillis = MAX(periodMillis,10);
+	st->fileName = NULL;
+	if ( fileName )
+	{
+		const size_t len = strlen(fileName);
+		st->fileName = (char *) CBALLOC(len+1);
+		memcpy(st->fileName,fileName,len+1);
+	}
+	st->format = format;
+	st->quit = false;
+
+	st->wake = CreateEvent(NULL,FALSE,FALSE,NULL);
+	st->thread = CreateThread(NULL,0,MetricsDumpThreadRoutine,st,0,NULL);
+	if ( st->thread == 0 )
+	{
+		CloseHandle(st->wake);
+		if ( st->fileName )
+			CBFREE(st->fileName);
+		delete st;
+		return false;
+	}
+
+	s_metricsDump = st;
+	return true;
+}
+
+void Metrics_StopDump()
+{
+	MetricsDumpState * st = s_metricsDump;
+	if ( ! st )
+		return;
+	s_metricsDump = NULL;
+
+	st->quit = true;
+	SetEvent(st->wake);
+	WaitForSingleObject(st->thread,INFINITE);
+	CloseHandle(st->thread);
+	CloseHandle(st->wake);
+
+	if ( st->fileName )
+		CBFREE(st->fileName);
+	delete st;
+}
+
+//=========================================================================================
+
+END_CB
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Base.h"
+#include "vector.h"
+
+/**
+
+Metrics : named counters , gauges and rates for counting things at runtime
+	(cache hits , queue depths , bytes written , ...)
+
+metrics are plain structs that are statically initialized , so they work at cinit and
+	from inside allocators ; they put themselves in the registry the first time they're touched :
+
+	static MetricCounter s_hits = METRIC_COUNTER_INIT("mycache.hits");
+	s_hits.Add(1);
+
+MetricCounter : monotonic count , sharded so threads don't increment the same cache line
+MetricGauge : a single value you Set or Add to (queue depth)
+MetricSumGauge : a gauge that only moves by Add , sharded like a counter ; the value is the
+	sum of the +/- deltas , so a hot Add (bytes outstanding in an allocator) doesn't bounce a line
+MetricRate : a sharded count plus 1/5/15 minute EWMA rates (per second) , like load average
+	the EWMA's are advanced lazily (every 5 seconds of wall time) when you Snapshot
+
+Metrics_GetCounter/Gauge/Rate(name) find or make a metric by name at runtime ; those are never freed
+
+nothing here allocates or locks on the Add/Set/Mark path
+
+**/
+
+START_CB
+
+enum EMetricType
+{
+	eMetric_Counter,
+	eMetric_Gauge,
+	eMetric_Rate,
+	eMetric_SumGauge	// reported as eMetric_Gauge
+};
+
+// MetricInfo must be the first member of each metric
+struct MetricInfo
+{
+	const char *			name;
+	int32					type; // EMetricType
+	uint32 volatile			registered;
+	MetricInfo * volatile	next;
+};
+
+#define METRIC_NUM_SHARDS	(16)
+
+// one per cache line :
+struct DECL_ALIGN(64) MetricShard
+{
+	int64 volatile	value;
+	char			pad[64 - sizeof(int64)];
+};
+
+struct MetricCounter
+{
+	MetricInfo	info;
+	MetricShard	shards[METRIC_NUM_SHARDS];
+
+	void Add(const int64 n = 1);
+	int64 Get() const;
+};
+
+struct MetricGauge
+{
+	MetricInfo		info;
+	int64 volatile	value;
+
+	void Set(const int64 v);
+	void Add(const int64 delta);
+	int64 Get() const;
+};
+
+struct MetricSumGauge
+{
+	MetricInfo	info;
+	MetricShard	shards[METRIC_NUM_SHARDS];
+
+	void Add(const int64 delta);
+	int64 Get() const;
+};
+
+struct MetricRate
+{
+	MetricInfo	info;
+	MetricShard	shards[METRIC_NUM_SHARDS];
+
+	// EWMA state , only touched by Metrics_Snapshot under the registry lock :
+	int64		lastCount;
+	uint64		lastTickMillis;
+	double		rate1,rate5,rate15;
+
+	void Mark(const int64 n = 1);
+	int64 GetCount() const;
+};
+
+#define METRIC_COUNTER_INIT(name)	{ { name, cb::eMetric_Counter } }
+#define METRIC_GAUGE_INIT(name)		{ { name, cb::eMetric_Gauge } }
+#define METRIC_RATE_INIT(name)		{ { name, cb::eMetric_Rate } }
+#define METRIC_SUM_GAUGE_INIT(name)	{ { name, cb::eMetric_SumGauge } }
+
+// find-or-make by name ; takes the registry lock , so cache the pointer
+MetricCounter *	Metrics_GetCounter(const char * name);
+MetricGauge *	Metrics_GetGauge(const char * name);
+MetricRate *	Metrics_GetRate(const char * name);
+MetricSumGauge *	Metrics_GetSumGauge(const char * name);
+
+//-------------------------------------------------------------------------------------------
+
+struct MetricValue
+{
+	const char *	name;
+	EMetricType		type;
+	int64			value;	// count for counters & rates
+	double			rate1,rate5,rate15; // only for rates ; per second
+};
+
+// all registered metrics , sorted by name
+void Metrics_Snapshot(vector<MetricValue> * pInto);
+
+enum EMetricsFormat
+{
+	eMetricsFormat_Text,
+	eMetricsFormat_JSON
+};
+
+void Metrics_Log();
+// writes to a temp name and renames , so readers never see half a file
+bool Metrics_WriteFile(const char * fileName,EMetricsFormat format);
+
+// periodic dump on a background thread ; fileName == NULL means lprintf
+bool Metrics_StartDump(int periodMillis,const char * fileName = NULL,EMetricsFormat format = eMetricsFormat_Text);
+void Metrics_StopDump();
+
+END_CB
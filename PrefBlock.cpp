@@ -139,52 +139,61 @@ PrefBlock::PrefBlock(PrefBlock_Writer * pWriter) :
 
 // MakePrettyTabs is a post-process on prefs to
 //	beautify
-static String MakePrettyTabs(const String & fromS)
+//	walks the writer's chunks in place, so nothing gets flattened
+static void MakePrettyTabs(const StringBuilder & from,StringBuilder * pOut)
 {
-	String out;
-	const char * from = fromS.CStr();
+	StringBuilder & out = *pOut;
 	int tabs = 0;
-	for(;;)
+	for(int chunk=0;chunk<from.GetNumChunks();chunk++)
 	{
-		char c = *from++;
-		if ( c == 0 )
-			break;
-		if ( c == '{' )
-		{
-			tabs++;
-			out += c;
-		}
-		else if ( c == '}' )
+		int len;
+		const char * ptr = from.GetChunk(chunk,&len);
+		const char * end = ptr + len;
+		while ( ptr < end )
 		{
-			// remove last char if it's a tab
-			char t = out.PopBack();
-			if ( t != '\t' )
-				out += t;
-			tabs--;
-			out += c;
-		}
-		else if ( c == '\n' )
-		{
-			out += c;
-			// now output tabs
-			for(int i=0;i<tabs;i++)
+			// copy runs of plain chars in one go :
+			const char * run = ptr;
+			while ( ptr < end && *ptr != '{' && *ptr != '}' && *ptr != '\n' )
+				ptr++;
+			if ( ptr > run )
+				out.Append(run,(int)(ptr - run));
+			if ( ptr == end )
+				break;
+
+			char c = *ptr++;
+			if ( c == '{' )
 			{
-				out += '\t';
+				tabs++;
+				out += c;
+			}
+			else if ( c == '}' )
+			{
+				// remove last char if it's a tab
+				char t = out.PopBack();
+				if ( t != '\t' && t != 0 )
+					out += t;
+				tabs--;
+				out += c;
+			}
+			else // '\n'
+			{
+				out += c;
+				// now output tabs
+				for(int i=0;i<tabs;i++)
+				{
+					out += '\t';
+				}
 			}
-		}
-		else
-		{
-			out += c;
 		}
 	}
-	return out;
 }
 
 void PrefBlock::FinishWriting()
 {
 	if ( m_writeFile != NULL )
 	{
-		String pretty = MakePrettyTabs(m_pWriter->GetBuffer());
+		StringBuilder pretty(MAX(m_pWriter->GetBuffer().Length(),4096));
+		MakePrettyTabs(m_pWriter->GetBuffer(),&pretty);
 		pretty.WriteText(m_writeFile->Get());
 		m_writeFile = NULL;
 	}
@@ -4,6 +4,7 @@
 #include "Token.h"
 #include "File.h"
 #include "String.h"
+#include "StringBuilder.h"
 #include "MoreUtil.h"
 //#include "StrUtil.h"
 #include "vecsortedpair.h"
@@ -23,6 +24,12 @@ and call block.IO() from within there
 
 override the template ReadFromText/WriteToText to add new basic type IO
 
+WriteToText writes into a StringBuilder ; that's the one you specialize , and the one
+	PrefBlock_Writer calls. The String * version is kept for old callers : it writes into a
+	StringBuilder and appends the result , so it works for every type but costs a copy.
+	Old specializations written for String * still compile , but the writer won't call them ;
+	switch them to StringBuilder * (CatPrintf and Append are the same)
+
 -----------------------
 
 WARNING : All prefs should fill themselves with default values before
@@ -93,6 +100,7 @@ SEE ALSO "CommonPrefs.h"
 SPtrFwd(PrefFile);
 
 template <class T> void ReadFromText(T * pValue, const char * const text);
+template <class T> void WriteToText(const T & val, StringBuilder * pInto);
 template <class T> void WriteToText(const T & val, String * pInto);
 
 //-----------------------------------------------------------------
@@ -112,7 +120,7 @@ public:
 	~PrefBlock_Writer();
 
 	void Reset() { m_data.Clear(); }
-	const String & GetBuffer() const { return m_data; }
+	const StringBuilder & GetBuffer() const { return m_data; }
 
 	template <class T> void IO( const char * const name, T * pValue )
 	{
@@ -137,7 +145,7 @@ public:
 	}
 
 private:
-	String	m_data;
+	StringBuilder	m_data;
 };
 
 //-----------------------------------------------------------------
@@ -274,8 +282,9 @@ void ReadFromText(T * pValue, const char * const text)
 }
 
 template <class T>
-void WriteToText(const T & val, String * pInto)
+void WriteToText(const T & val, StringBuilder * pInto)
 {
+	// the sub-block is built in its own writer, then its chunks are appended to ours
 	PrefBlock_Writer writer;
 	PrefBlock block(&writer);
 	PrefIO( block, const_cast<T &>(val) );
@@ -284,6 +293,15 @@ void WriteToText(const T & val, String * pInto)
 	pInto->Append("}");
 }
 
+// old entry point ; appends , like it always did
+template <class T>
+void WriteToText(const T & val, String * pInto)
+{
+	StringBuilder sb;
+	WriteToText(val,&sb);
+	pInto->Append(sb.ToString());
+}
+
 //===============================================================================
 // ReadFromText / WriteToText implementations
 
@@ -294,7 +312,7 @@ inline void ReadFromText<char>(char * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<char>(const char & val, String * pInto)
+inline void WriteToText<char>(const char & val, StringBuilder * pInto)
 {
 	pInto->Append(val);
 }
@@ -305,7 +323,7 @@ template <> inline void ReadFromText<intlike_type>(intlike_type * pValue, const
 	*pValue = (intlike_type) atoi(text);	\
 }	\
 	\
-template <> inline void WriteToText<intlike_type>(const intlike_type & val, String * pInto)	\
+template <> inline void WriteToText<intlike_type>(const intlike_type & val, StringBuilder * pInto)	\
 {	\
 	pInto->CatPrintf("%d",val);	\
 }
@@ -320,7 +338,7 @@ template <> inline void ReadFromText<intlike_type>(intlike_type * pValue, const
 	*pValue = (intlike_type) strtoul(text,NULL,10);	\
 }	\
 	\
-template <> inline void WriteToText<intlike_type>(const intlike_type & val, String * pInto)	\
+template <> inline void WriteToText<intlike_type>(const intlike_type & val, StringBuilder * pInto)	\
 {	\
 	pInto->CatPrintf("%ul",val);	\
 }
@@ -338,7 +356,7 @@ inline void ReadFromText<bool>(bool * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<bool>(const bool & val, String * pInto)
+inline void WriteToText<bool>(const bool & val, StringBuilder * pInto)
 {
 	/*
 	char buffer[60];
@@ -358,7 +376,7 @@ inline void ReadFromText<float>(float * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<float>(const float & val, String * pInto)
+inline void WriteToText<float>(const float & val, StringBuilder * pInto)
 {
 	pInto->CatPrintf("%.6g",val);
 }
@@ -370,7 +388,7 @@ inline void ReadFromText<double>(double * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<double>(const double & val, String * pInto)
+inline void WriteToText<double>(const double & val, StringBuilder * pInto)
 {
 	pInto->CatPrintf("%.8g",val);
 }
@@ -384,7 +402,7 @@ inline void ReadFromText<String>(String * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<String>(const String & val, String * pInto)
+inline void WriteToText<String>(const String & val, StringBuilder * pInto)
 {
 	pInto->Append('\"');
 	pInto->Append(val);
@@ -398,7 +416,7 @@ inline void ReadFromTextULHex(uint32 * pValue, const char * const text)
 	*pValue = ul;
 }
 
-inline void WriteToTextULHex(const uint32 val, String * pInto)
+inline void WriteToTextULHex(const uint32 val, StringBuilder * pInto)
 {
 	pInto->CatPrintf("%08X",val);
 }
@@ -414,7 +432,7 @@ inline void ReadFromText<Token>(Token * pValue, const char * const text)
 }
 
 template <>
-inline void WriteToText<Token>(const Token & val, String * pInto)
+inline void WriteToText<Token>(const Token & val, StringBuilder * pInto)
 {
 	WriteToTextULHex(val.GetHash(),pInto);
 }
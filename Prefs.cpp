@@ -2,6 +2,7 @@
 #include "TokenHash.h"
 #include "FileUtil.h"
 #include "Log.h"
+#include "DirChangeWatcher.h"
 #include <time.h>
 
 START_CB
@@ -127,6 +128,39 @@ namespace PrefsMgr
 		return changes;
 	}
 	
+	bool ReloadChanged(const vector<DirChangeRecord> & changes)
+	{
+		// the watcher lost events ; fall back to checking mod times
+		for(int c=0;c < changes.size32(); c++)
+		{
+			if ( changes[c].action == DIR_CHANGE_ACTION_OVERFLOW )
+				return ReloadChanged();
+		}
+		
+		Init();
+		bool any = false;
+		for(t_hash::iterator it = g_pHash->begin();
+			it != g_pHash->end();
+			++it)
+		{
+			PrefsPtr pref = it->second;
+			for(int c=0;c < changes.size32(); c++)
+			{
+				const DirChangeRecord & rec = changes[c];
+				if ( rec.action == FILE_ACTION_REMOVED || rec.action == FILE_ACTION_RENAMED_OLD_NAME )
+					continue;
+				if ( DirChangePathsMatch(rec.path,pref->GetResourceName()) )
+				{
+					lprintf("Pref changed, reloading (%s)\n",pref->GetResourceName());
+					pref->Reload();
+					any = true;
+					break;
+				}
+			}
+		}
+		return any;
+	}
+	
 	void GetDirsToWatch(vector<String> * pInto)
 	{		
 		// find the dirs needed from the list of files with tweak vars :
@@ -11,6 +11,8 @@
 
 START_CB
 
+struct DirChangeRecord;
+
 /*
 
 Prefs is a tiny wrapper on RefCounted ; make Pref structs derive from Prefs
@@ -119,6 +121,8 @@ namespace PrefsMgr
 	void Flush();
 	void Shutdown();
 	bool ReloadChanged(); // returns if any changed
+	// just the prefs named in changes (from a DirChangeWatcher) ; no disk hits for the rest
+	bool ReloadChanged(const vector<DirChangeRecord> & changes);
 	void ReloadAll();
 	void SaveAll();
 
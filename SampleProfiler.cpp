@@ -0,0 +1,891 @@
+#include "SampleProfiler.h"
+#include "StackTrace.h"
+#include "StringBuilder.h"
+#include "Log.h"
+#include "Mem.h"
+#include "vector.h"
+#include "hash_table.h"
+#include "Hashes.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <algorithm>
+#endif
+
+START_CB
+
+SampleProfilerOptions::SampleProfilerOptions() :
+	hz(199), // not a multiple of common tick rates , so we don't sample in lockstep with them
+	bufferSamples(16*1024),
+	drainMillis(50),
+	perThreadTimers(true)
+{
+}
+
+#ifndef _WIN32
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id	_sigev_un._tid
+#endif
+
+//=========================================================================================
+// the ring : bounded MPSC queue with a sequence number per slot
+//	signal handlers claim slots with a CAS ; the drain thread is the only consumer
+//	a slot is free for position p when seq == p , and full when seq == p+1
+
+struct SampleSlot
+{
+	uint32 volatile			seq;
+	int32					depth;
+	instructionaddress_t	ips[SAMPLE_PROFILER_MAX_DEPTH];
+};
+
+struct SampleThread
+{
+	pid_t		tid;
+	pthread_t	thread;
+	size_t		stackLo;
+	size_t		stackHi;
+	timer_t		timer;
+	bool		hasTimer;
+};
+
+// initial-exec so that touching it in the signal handler can never allocate :
+static __thread SampleThread * s_myThread __attribute__((tls_model("initial-exec"))) = NULL;
+
+static SampleSlot *		s_ring = NULL;
+static uint32			s_ringMask = 0;
+static uint32 volatile	s_enqueuePos = 0;
+static uint32			s_dequeuePos = 0; // under s_tableLock
+static int64 volatile	s_dropped = 0;
+
+static int32 volatile	s_running = 0;
+static int32 volatile	s_inHandler = 0;
+static bool				s_handlerInstalled = false;
+
+static SampleProfilerOptions	s_options;
+
+// registered threads ; s_threadLock
+static pthread_mutex_t		s_threadLock = PTHREAD_MUTEX_INITIALIZER;
+static vector<SampleThread *>	s_threads;
+static pthread_key_t		s_threadKey;
+static pthread_once_t		s_threadKeyOnce = PTHREAD_ONCE_INIT;
+
+static pthread_t			s_drainThread;
+static bool volatile		s_drainQuit = false;
+
+//=========================================================================================
+// unique stacks with counts ; only touched by the drain & report side , under s_tableLock
+
+struct SampleStack
+{
+	int64	count;
+	int32	first; // into m_ips
+	int32	depth;
+};
+
+typedef hash_table<intptr_t,int,hash_table_ops_intptr_t> t_sampleHash;
+
+struct SampleTable
+{
+	vector<SampleStack>				m_stacks;
+	vector<instructionaddress_t>	m_ips;
+	t_sampleHash					m_hash;
+	int64							m_count;
+};
+
+static pthread_mutex_t	s_tableLock = PTHREAD_MUTEX_INITIALIZER;
+static SampleTable *	s_table = NULL;
+
+static void SampleTable_Add(SampleTable * table,const instructionaddress_t * ips,int depth)
+{
+	table->m_count++;
+
+	uint64 h = StrongHash64((const uint8 *)ips,depth*(int)sizeof(instructionaddress_t));
+	for(;;)
+	{
+		// 0 and 1 are the empty & deleted keys :
+		intptr_t key = (intptr_t) h;
+		if ( key == 0 || key == 1 )
+			key += 2;
+
+		t_sampleHash::entry_ptrc ep = table->m_hash.find(key);
+		if ( ! ep )
+		{
+			SampleStack st;
+			st.count = 1;
+			st.first = table->m_ips.size32();
+			st.depth = depth;
+			table->m_ips.insert(table->m_ips.end(),ips,ips+depth);
+			table->m_hash.insert(key,table->m_stacks.size32());
+			table->m_stacks.push_back(st);
+			return;
+		}
+
+		SampleStack & st = table->m_stacks[ep->data()];
+		if ( st.depth == depth &&
+			memcmp(table->m_ips.data() + st.first,ips,depth*sizeof(instructionaddress_t)) == 0 )
+		{
+			st.count++;
+			return;
+		}
+
+		// hash collision ; probe on
+		h = h * 0x9E3779B97F4A7C15ULL + 1;
+	}
+}
+
+// pull everything that's ready out of the ring ; s_tableLock must be held
+static void SampleProfiler_DrainLocked()
+{
+	if ( ! s_ring )
+		return;
+
+	for(;;)
+	{
+		SampleSlot * slot = &s_ring[s_dequeuePos & s_ringMask];
+		if ( __atomic_load_n(&slot->seq,__ATOMIC_ACQUIRE) != s_dequeuePos + 1 )
+			break;
+
+		if ( slot->depth > 0 )
+			SampleTable_Add(s_table,slot->ips,slot->depth);
+
+		__atomic_store_n(&slot->seq,s_dequeuePos + s_ringMask + 1,__ATOMIC_RELEASE);
+		s_dequeuePos++;
+	}
+}
+
+static void SampleProfiler_Drain()
+{
+	pthread_mutex_lock(&s_tableLock);
+	SampleProfiler_DrainLocked();
+	pthread_mutex_unlock(&s_tableLock);
+}
+
+//=========================================================================================
+// signal side ; nothing in here may lock , allocate , or touch anything but the ring
+
+static void SampleProfiler_GetRegisters(void * context,instructionaddress_t * pPC,const void ** pFP,size_t * pSP)
+{
+	const ucontext_t * uc = (const ucontext_t *) context;
+
+	#if defined(__x86_64__)
+	*pPC = (instructionaddress_t) uc->uc_mcontext.gregs[REG_RIP];
+	*pFP = (const void *) uc->uc_mcontext.gregs[REG_RBP];
+	*pSP = (size_t) uc->uc_mcontext.gregs[REG_RSP];
+	#elif defined(__aarch64__)
+	*pPC = (instructionaddress_t) uc->uc_mcontext.pc;
+	*pFP = (const void *) uc->uc_mcontext.regs[29];
+	*pSP = (size_t) uc->uc_mcontext.sp;
+	#else
+	// @@ other cpus : no unwind , every sample is dropped
+	(void)uc;
+	*pPC = 0;
+	*pFP = NULL;
+	*pSP = 0;
+	#endif
+}
+
+static SampleSlot * SampleRing_Claim(uint32 * pPos)
+{
+	uint32 pos = __atomic_load_n(&s_enqueuePos,__ATOMIC_RELAXED);
+	for(;;)
+	{
+		SampleSlot * slot = &s_ring[pos & s_ringMask];
+		uint32 seq = __atomic_load_n(&slot->seq,__ATOMIC_ACQUIRE);
+		int32 dif = (int32)( seq - pos );
+		if ( dif == 0 )
+		{
+			// on failure pos is reloaded for us
+			if ( __atomic_compare_exchange_n(&s_enqueuePos,&pos,pos+1,true,__ATOMIC_RELAXED,__ATOMIC_RELAXED) )
+			{
+				*pPos = pos;
+				return slot;
+			}
+		}
+		else if ( dif < 0 )
+		{
+			// drain is behind ; the slot still holds a sample from a lap ago
+			__atomic_add_fetch(&s_dropped,1,__ATOMIC_RELAXED);
+			return NULL;
+		}
+		else
+		{
+			pos = __atomic_load_n(&s_enqueuePos,__ATOMIC_RELAXED);
+		}
+	}
+}
+
+static void SampleProfiler_OnSignal(int sig,siginfo_t * info,void * context)
+{
+	(void)sig; (void)info;
+
+	__atomic_add_fetch(&s_inHandler,1,__ATOMIC_SEQ_CST);
+
+	if ( __atomic_load_n(&s_running,__ATOMIC_SEQ_CST) )
+	{
+		int savedErrno = errno;
+
+		instructionaddress_t pc;
+		const void * fp;
+		size_t sp;
+		SampleProfiler_GetRegisters(context,&pc,&fp,&sp);
+
+		uint32 pos;
+		SampleSlot * slot = ( pc != 0 ) ? SampleRing_Claim(&pos) : NULL;
+		if ( slot )
+		{
+			const SampleThread * me = s_myThread;
+			if ( me )
+			{
+				// frames are above the interrupted sp , so that's a tighter floor :
+				size_t lo = ( sp > me->stackLo && sp < me->stackHi ) ? sp : me->stackLo;
+				slot->depth = StackTrace_WalkFrames(slot->ips,SAMPLE_PROFILER_MAX_DEPTH,
+									pc,fp,(const void *)lo,(const void *)me->stackHi);
+			}
+			else
+			{
+				slot->ips[0] = pc;
+				slot->depth = 1;
+			}
+
+			__atomic_store_n(&slot->seq,pos+1,__ATOMIC_RELEASE);
+		}
+
+		errno = savedErrno;
+	}
+
+	__atomic_sub_fetch(&s_inHandler,1,__ATOMIC_SEQ_CST);
+}
+
+//=========================================================================================
+// timers
+
+static void SampleThread_Arm(SampleThread * st)
+{
+	if ( st->hasTimer )
+		return;
+
+	clockid_t clock;
+	if ( pthread_getcpuclockid(st->thread,&clock) != 0 )
+		return;
+
+	struct sigevent sev;
+	memset(&sev,0,sizeof(sev));
+	sev.sigev_notify = SIGEV_THREAD_ID;
+	sev.sigev_signo = SIGPROF;
+	sev.sigev_notify_thread_id = st->tid;
+
+	if ( timer_create(clock,&sev,&st->timer) != 0 )
+	{
+		lprintf("SampleProfiler : timer_create failed (%d)\n",errno);
+		return;
+	}
+
+	long periodNanos = 1000000000L / s_options.hz;
+	struct itimerspec its;
+	its.it_interval.tv_sec = periodNanos / 1000000000L;
+	its.it_interval.tv_nsec = periodNanos % 1000000000L;
+	its.it_value = its.it_interval;
+	timer_settime(st->timer,0,&its,NULL);
+
+	st->hasTimer = true;
+}
+
+static void SampleThread_Disarm(SampleThread * st)
+{
+	if ( ! st->hasTimer )
+		return;
+	timer_delete(st->timer);
+	st->hasTimer = false;
+}
+
+static void SampleProfiler_SetProcessTimer(int hz)
+{
+	struct itimerval itv;
+	memset(&itv,0,sizeof(itv));
+	if ( hz > 0 )
+	{
+		long periodMicros = MAX(1000000L / hz,1L);
+		itv.it_interval.tv_sec = periodMicros / 1000000L;
+		itv.it_interval.tv_usec = periodMicros % 1000000L;
+		itv.it_value = itv.it_interval;
+	}
+	setitimer(ITIMER_PROF,&itv,NULL);
+}
+
+//=========================================================================================
+// thread registry
+
+static void SampleThread_Unregister(SampleThread * st)
+{
+	pthread_mutex_lock(&s_threadLock);
+	SampleThread_Disarm(st);
+	for LOOPVEC(i,s_threads)
+	{
+		if ( s_threads[i] == st )
+		{
+			s_threads.erase_u(i);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&s_threadLock);
+}
+
+// runs at thread exit for threads that didn't unregister
+static void SampleThread_OnExit(void * param)
+{
+	SampleThread * st = (SampleThread *) param;
+	__atomic_store_n(&s_myThread,(SampleThread *)NULL,__ATOMIC_RELEASE);
+	SampleThread_Unregister(st);
+	delete st;
+}
+
+static void SampleProfiler_MakeThreadKey()
+{
+	pthread_key_create(&s_threadKey,SampleThread_OnExit);
+}
+
+void SampleProfiler_RegisterThread()
+{
+	if ( s_myThread )
+		return;
+
+	pthread_once(&s_threadKeyOnce,SampleProfiler_MakeThreadKey);
+
+	SampleThread * st = new SampleThread;
+	memset(st,0,sizeof(*st));
+	st->tid = (pid_t) syscall(SYS_gettid);
+	st->thread = pthread_self();
+
+	pthread_attr_t attr;
+	if ( pthread_getattr_np(st->thread,&attr) == 0 )
+	{
+		void * addr = NULL;
+		size_t size = 0;
+		if ( pthread_attr_getstack(&attr,&addr,&size) == 0 )
+		{
+			st->stackLo = (size_t) addr;
+			st->stackHi = (size_t) addr + size;
+		}
+		pthread_attr_destroy(&attr);
+	}
+
+	pthread_setspecific(s_threadKey,st);
+
+	pthread_mutex_lock(&s_threadLock);
+	s_threads.push_back(st);
+	if ( s_running && s_options.perThreadTimers )
+		SampleThread_Arm(st);
+	pthread_mutex_unlock(&s_threadLock);
+
+	// publish last : the handler can use it as soon as it's set
+	__atomic_store_n(&s_myThread,st,__ATOMIC_RELEASE);
+}
+
+void SampleProfiler_UnregisterThread()
+{
+	SampleThread * st = s_myThread;
+	if ( ! st )
+		return;
+
+	__atomic_store_n(&s_myThread,(SampleThread *)NULL,__ATOMIC_RELEASE);
+	pthread_setspecific(s_threadKey,NULL);
+	SampleThread_Unregister(st);
+	delete st;
+}
+
+//=========================================================================================
+
+static void * SampleProfiler_DrainThread(void *)
+{
+	while ( ! s_drainQuit )
+	{
+		struct timespec ts;
+		ts.tv_sec = s_options.drainMillis / 1000;
+		ts.tv_nsec = (s_options.drainMillis % 1000) * 1000000L;
+		nanosleep(&ts,NULL);
+
+		SampleProfiler_Drain();
+	}
+	return NULL;
+}
+
+// undoes the ring and table setup of a Start that failed ; nothing is armed , so no handler is using them
+static void SampleProfiler_FreeBuffers()
+{
+	pthread_mutex_lock(&s_tableLock);
+	CBFREE(s_ring);
+	s_ring = NULL;
+	delete s_table;
+	s_table = NULL;
+	pthread_mutex_unlock(&s_tableLock);
+}
+
+bool SampleProfiler_Start(const SampleProfilerOptions & options)
+{
+	if ( s_running )
+		return false;
+
+	s_options = options;
+	s_options.hz = MAX(s_options.hz,1);
+	s_options.drainMillis = MAX(s_options.drainMillis,1);
+
+	uint32 ringSize = 256;
+	while ( ringSize < (uint32)options.bufferSamples && ringSize < (1U<<24) )
+		ringSize *= 2;
+
+	pthread_mutex_lock(&s_tableLock);
+
+	// nothing can be in the handler between Stop and here , so the old ring can go
+	if ( s_ring && s_ringMask+1 != ringSize )
+	{
+		CBFREE(s_ring);
+		s_ring = NULL;
+	}
+	if ( ! s_ring )
+		s_ring = (SampleSlot *) CBALLOC(ringSize*sizeof(SampleSlot));
+	s_ringMask = ringSize-1;
+	for(uint32 i=0;i<ringSize;i++)
+		s_ring[i].seq = i;
+	s_enqueuePos = 0;
+	s_dequeuePos = 0;
+	s_dropped = 0;
+
+	delete s_table;
+	s_table = new SampleTable;
+	s_table->m_count = 0;
+
+	pthread_mutex_unlock(&s_tableLock);
+
+	bool installedNow = false;
+	struct sigaction oldAction;
+	if ( ! s_handlerInstalled )
+	{
+		// stays installed for good : a SIGPROF that was already pending when we Stop
+		//	must not hit the default action , which kills the process
+		struct sigaction sa;
+		memset(&sa,0,sizeof(sa));
+		sa.sa_sigaction = SampleProfiler_OnSignal;
+		sa.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+		if ( sigaction(SIGPROF,&sa,&oldAction) != 0 )
+		{
+			lprintf("SampleProfiler : sigaction failed (%d)\n",errno);
+			SampleProfiler_FreeBuffers();
+			return false;
+		}
+		s_handlerInstalled = true;
+		installedNow = true;
+	}
+
+	s_drainQuit = false;
+	if ( pthread_create(&s_drainThread,NULL,SampleProfiler_DrainThread,NULL) != 0 )
+	{
+		lprintf("SampleProfiler : couldn't start the drain thread\n");
+		// no timer was armed by this Start , so no SIGPROF of ours can be pending yet ;
+		//	a handler left by an earlier Start has to stay (see above)
+		if ( installedNow )
+		{
+			sigaction(SIGPROF,&oldAction,NULL);
+			s_handlerInstalled = false;
+		}
+		SampleProfiler_FreeBuffers();
+		return false;
+	}
+
+	SampleProfiler_RegisterThread();
+
+	__atomic_store_n(&s_running,1,__ATOMIC_SEQ_CST);
+
+	pthread_mutex_lock(&s_threadLock);
+	if ( s_options.perThreadTimers )
+	{
+		for LOOPVEC(i,s_threads)
+			SampleThread_Arm(s_threads[i]);
+	}
+	else
+	{
+		SampleProfiler_SetProcessTimer(s_options.hz);
+	}
+	pthread_mutex_unlock(&s_threadLock);
+
+	return true;
+}
+
+void SampleProfiler_Stop()
+{
+	if ( ! s_running )
+		return;
+
+	pthread_mutex_lock(&s_threadLock);
+	if ( s_options.perThreadTimers )
+	{
+		for LOOPVEC(i,s_threads)
+			SampleThread_Disarm(s_threads[i]);
+	}
+	else
+	{
+		SampleProfiler_SetProcessTimer(0);
+	}
+	pthread_mutex_unlock(&s_threadLock);
+
+	// after this no handler touches the ring ; wait out the ones already in it
+	__atomic_store_n(&s_running,0,__ATOMIC_SEQ_CST);
+	while ( __atomic_load_n(&s_inHandler,__ATOMIC_SEQ_CST) != 0 )
+		sched_yield();
+
+	s_drainQuit = true;
+	pthread_join(s_drainThread,NULL);
+
+	SampleProfiler_Drain();
+}
+
+bool SampleProfiler_IsRunning()
+{
+	return s_running != 0;
+}
+
+void SampleProfiler_Reset()
+{
+	pthread_mutex_lock(&s_tableLock);
+	if ( s_table )
+	{
+		// whatever is in the ring now belongs to the old samples too
+		SampleProfiler_DrainLocked();
+		delete s_table;
+		s_table = new SampleTable;
+		s_table->m_count = 0;
+	}
+	__atomic_store_n(&s_dropped,0,__ATOMIC_RELAXED);
+	pthread_mutex_unlock(&s_tableLock);
+}
+
+int64 SampleProfiler_GetSampleCount()
+{
+	pthread_mutex_lock(&s_tableLock);
+	SampleProfiler_DrainLocked();
+	int64 count = s_table ? s_table->m_count : 0;
+	pthread_mutex_unlock(&s_tableLock);
+	return count;
+}
+
+int64 SampleProfiler_GetDroppedCount()
+{
+	return __atomic_load_n(&s_dropped,__ATOMIC_RELAXED);
+}
+
+//=========================================================================================
+// reporting : resolve every address to a function once
+
+struct SampleFunc
+{
+	char *	name; // CBALLOC'd
+	int64	self;
+	int64	total;
+	int32	lastStack; // so recursion counts once per stack in total
+};
+
+struct SampleFuncs
+{
+	vector<SampleFunc>	m_funcs;
+	t_sampleHash		m_byStart; // function start -> m_funcs index
+	t_sampleHash		m_byAddress; // return address -> m_funcs index
+
+	~SampleFuncs()
+	{
+		for LOOPVEC(i,m_funcs)
+			CBFREE(m_funcs[i].name);
+	}
+};
+
+static char * SampleProfiler_CopyName(const char * str)
+{
+	int len = (int) strlen(str);
+	char * ret = (char *) CBALLOC(len+1);
+	memcpy(ret,str,len+1);
+	// collapsed stacks use ';' between frames and a space before the count
+	for(int i=0;i<len;i++)
+	{
+		if ( ret[i] == ';' || ret[i] == '\n' )
+			ret[i] = '_';
+	}
+	return ret;
+}
+
+static int SampleProfiler_Resolve(SampleFuncs * funcs,instructionaddress_t ip)
+{
+	// 0 and 1 are reserved keys ; no code lives there
+	t_sampleHash::entry_ptrc ep = funcs->m_byAddress.find((intptr_t)ip);
+	if ( ep )
+		return ep->data();
+
+	char buf[512];
+	intptr_t start = (intptr_t) ip;
+
+	Dl_info info;
+	if ( dladdr((void *)ip,&info) && info.dli_sname != NULL )
+	{
+		start = (intptr_t) info.dli_saddr;
+		int status = 0;
+		char * demangled = abi::__cxa_demangle(info.dli_sname,NULL,NULL,&status);
+		snprintf(buf,sizeof(buf),"%s",( status == 0 && demangled ) ? demangled : info.dli_sname);
+		free(demangled);
+	}
+	else if ( dladdr((void *)ip,&info) && info.dli_fname != NULL )
+	{
+		// no symbol (static function , stripped library) ; lump it in with its module
+		start = (intptr_t) info.dli_fbase;
+		const char * pFile = strrchr(info.dli_fname,'/');
+		pFile = pFile ? pFile+1 : info.dli_fname;
+		snprintf(buf,sizeof(buf),"[%s]",pFile);
+	}
+	else
+	{
+		snprintf(buf,sizeof(buf),"0x%llx",(unsigned long long)ip);
+	}
+	buf[sizeof(buf)-1] = 0;
+
+	if ( start == 0 || start == 1 )
+		start = (intptr_t) ip;
+
+	int index;
+	ep = funcs->m_byStart.find(start);
+	if ( ep )
+	{
+		index = ep->data();
+	}
+	else
+	{
+		SampleFunc f;
+		f.name = SampleProfiler_CopyName(buf);
+		f.self = 0;
+		f.total = 0;
+		f.lastStack = -1;
+		index = funcs->m_funcs.size32();
+		funcs->m_funcs.push_back(f);
+		funcs->m_byStart.insert(start,index);
+	}
+
+	funcs->m_byAddress.insert((intptr_t)ip,index);
+	return index;
+}
+
+// a copy of the table with every address turned into a function index
+//	s_tableLock must be held
+static void SampleProfiler_ResolveAll(SampleFuncs * funcs,vector<int> * pFrames)
+{
+	const SampleTable * table = s_table;
+	pFrames->resize(table->m_ips.size());
+
+	for LOOPVEC(s,table->m_stacks)
+	{
+		const SampleStack & st = table->m_stacks[s];
+		for LOOP(d,st.depth)
+		{
+			instructionaddress_t ip = table->m_ips[st.first + d];
+			// return addresses point after the call , which can be the next function :
+			if ( d > 0 )
+				ip -= 1;
+			int f = SampleProfiler_Resolve(funcs,ip);
+			(*pFrames)[st.first + d] = f;
+
+			SampleFunc & func = funcs->m_funcs[f];
+			if ( d == 0 )
+				func.self += st.count;
+			if ( func.lastStack != s )
+			{
+				func.total += st.count;
+				func.lastStack = s;
+			}
+		}
+	}
+}
+
+struct SampleFuncSelfGreater
+{
+	const vector<SampleFunc> * funcs;
+	bool operator () (int a,int b) const
+	{
+		const SampleFunc & fa = (*funcs)[a];
+		const SampleFunc & fb = (*funcs)[b];
+		if ( fa.self != fb.self )
+			return fa.self > fb.self;
+		return fa.total > fb.total;
+	}
+};
+
+static bool SampleProfiler_FormatFlat(StringBuilder * sb,int maxLines)
+{
+	pthread_mutex_lock(&s_tableLock);
+	SampleProfiler_DrainLocked();
+	if ( ! s_table || s_table->m_count == 0 )
+	{
+		pthread_mutex_unlock(&s_tableLock);
+		return false;
+	}
+
+	SampleFuncs funcs;
+	vector<int> frames;
+	SampleProfiler_ResolveAll(&funcs,&frames);
+	int64 count = s_table->m_count;
+
+	pthread_mutex_unlock(&s_tableLock);
+
+	vector<int> order;
+	order.resize(funcs.m_funcs.size());
+	for LOOPVEC(i,order)
+		order[i] = i;
+	SampleFuncSelfGreater greater = { &funcs.m_funcs };
+	std::sort(order.begin(),order.end(),greater);
+
+	int64 dropped = SampleProfiler_GetDroppedCount();
+	sb->CatPrintf("SampleProfiler : %I64d samples",count);
+	if ( dropped > 0 )
+		sb->CatPrintf(" (%I64d dropped)",dropped);
+	sb->Append("\n");
+	sb->Append("   self  self%   total total% : function\n");
+
+	int numLines = order.size32();
+	if ( maxLines > 0 )
+		numLines = MIN(numLines,maxLines);
+	double toPercent = 100.0 / count;
+	for LOOP(i,numLines)
+	{
+		const SampleFunc & f = funcs.m_funcs[order[i]];
+		sb->CatPrintf("%7I64d %5.1f%% %7I64d %5.1f%% : %s\n",
+			f.self,f.self*toPercent,f.total,f.total*toPercent,f.name);
+	}
+
+	return true;
+}
+
+void SampleProfiler_LogFlat(int maxLines)
+{
+	StringBuilder sb;
+	if ( ! SampleProfiler_FormatFlat(&sb,maxLines) )
+	{
+		lprintf("SampleProfiler : no samples\n");
+		return;
+	}
+	lprintf("%s",sb.ToString().CStr());
+}
+
+bool SampleProfiler_WriteFlat(const char * fileName,int maxLines)
+{
+	StringBuilder sb;
+	if ( ! SampleProfiler_FormatFlat(&sb,maxLines) )
+		sb.Append("SampleProfiler : no samples\n");
+	return sb.WriteTextFile(fileName);
+}
+
+// orders stacks by their function sequence , root first , so equal ones end up adjacent
+struct SampleStackLess
+{
+	const vector<SampleStack> * stacks;
+	const vector<int> * frames;
+	bool operator () (int a,int b) const
+	{
+		const SampleStack & sa = (*stacks)[a];
+		const SampleStack & sb = (*stacks)[b];
+		int da = sa.depth , db = sb.depth;
+		int n = MIN(da,db);
+		for LOOP(i,n)
+		{
+			int fa = (*frames)[sa.first + da-1-i];
+			int fb = (*frames)[sb.first + db-1-i];
+			if ( fa != fb )
+				return fa < fb;
+		}
+		return da < db;
+	}
+	bool Equal(int a,int b) const
+	{
+		return ! (*this)(a,b) && ! (*this)(b,a);
+	}
+};
+
+bool SampleProfiler_WriteCollapsed(const char * fileName)
+{
+	StringBuilder sb;
+
+	pthread_mutex_lock(&s_tableLock);
+	SampleProfiler_DrainLocked();
+	if ( s_table )
+	{
+		SampleFuncs funcs;
+		vector<int> frames;
+		SampleProfiler_ResolveAll(&funcs,&frames);
+
+		// different call sites in the same functions collapse to the same line ; merge them
+		const vector<SampleStack> & stacks = s_table->m_stacks;
+		vector<int> order;
+		order.resize(stacks.size());
+		for LOOPVEC(i,order)
+			order[i] = i;
+		SampleStackLess less = { &stacks, &frames };
+		std::sort(order.begin(),order.end(),less);
+
+		for(int i=0;i<order.size32();)
+		{
+			const SampleStack & st = stacks[order[i]];
+			int64 count = 0;
+			int j = i;
+			while ( j < order.size32() && less.Equal(order[i],order[j]) )
+			{
+				count += stacks[order[j]].count;
+				j++;
+			}
+
+			for(int d=st.depth-1;d>=0;d--)
+			{
+				sb.Append(funcs.m_funcs[frames[st.first + d]].name);
+				if ( d > 0 )
+					sb.Append(";");
+			}
+			sb.CatPrintf(" %I64d\n",count);
+
+			i = j;
+		}
+	}
+	pthread_mutex_unlock(&s_tableLock);
+
+	return sb.WriteTextFile(fileName);
+}
+
+#else // _WIN32
+
+//=========================================================================================
+// @@ no SIGPROF on Windows ; it would need a thread that suspends the others and
+//	reads their contexts , which nobody has written yet
+
+bool SampleProfiler_Start(const SampleProfilerOptions & options)
+{
+	lprintf("SampleProfiler : not supported on this platform\n");
+	return false;
+}
+
+void SampleProfiler_Stop() { }
+bool SampleProfiler_IsRunning() { return false; }
+void SampleProfiler_RegisterThread() { }
+void SampleProfiler_UnregisterThread() { }
+void SampleProfiler_Reset() { }
+int64 SampleProfiler_GetSampleCount() { return 0; }
+int64 SampleProfiler_GetDroppedCount() { return 0; }
+void SampleProfiler_LogFlat(int maxLines) { lprintf("SampleProfiler : not supported on this platform\n"); }
+bool SampleProfiler_WriteFlat(const char * fileName,int maxLines) { return false; }
+bool SampleProfiler_WriteCollapsed(const char * fileName) { return false; }
+
+#endif // _WIN32
+
+END_CB
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Base.h"
+
+/**
+
+SampleProfiler : statistical sampling profiler (posix only ; the calls are no-ops on Windows)
+
+finds hot spots in code nobody put PROFILE blocks in ; meant to be left on for long soak runs
+
+SIGPROF fires every 1/hz seconds of cpu time ; the handler walks the frame pointers of the
+	interrupted thread (StackTrace_WalkFrames) and pushes the stack into a lock-free ring
+	a drain thread folds the ring into a table of unique stacks with counts
+
+only registered threads get full stacks , because the unwinder needs the thread's stack bounds
+	and those can't be found from inside a signal handler
+	unregistered threads that catch a SIGPROF just record the interrupted pc
+
+build with -fno-omit-frame-pointer ; function names come from dladdr , so link with -rdynamic
+
+	SampleProfiler_Start();
+	... (worker threads call SampleProfiler_RegisterThread() when they start)
+	SampleProfiler_Stop();
+	SampleProfiler_LogFlat();
+	SampleProfiler_WriteCollapsed("prof.folded"); // -> flamegraph.pl prof.folded > prof.svg
+
+**/
+
+START_CB
+
+#define SAMPLE_PROFILER_MAX_DEPTH	(64)
+
+struct SampleProfilerOptions
+{
+	int		hz;				// samples per second of cpu time , per thread
+	int		bufferSamples;	// ring size ; rounded up to a power of 2
+	int		drainMillis;	// how often the drain thread empties the ring
+	// perThreadTimers : each registered thread gets its own timer on its own cpu clock ,
+	//	so every busy thread gets hz samples
+	//	otherwise one setitimer(ITIMER_PROF) for the process ; the kernel sends each
+	//	SIGPROF to whichever thread was running , so threads are sampled in proportion to cpu use
+	//	but the total rate is capped at hz
+	bool	perThreadTimers;
+
+	SampleProfilerOptions();
+};
+
+// Start registers the calling thread , clears any previous samples and arms the timers
+bool SampleProfiler_Start(const SampleProfilerOptions & options = SampleProfilerOptions());
+// Stop disarms the timers and drains the ring ; the samples stay around for reporting
+void SampleProfiler_Stop();
+bool SampleProfiler_IsRunning();
+
+// call on each thread you want stacks from ; ok before or after Start
+//	threads are unregistered automatically when they exit
+void SampleProfiler_RegisterThread();
+void SampleProfiler_UnregisterThread();
+
+// throw away the samples collected so far (keeps running if it was)
+void SampleProfiler_Reset();
+
+int64 SampleProfiler_GetSampleCount();
+// samples lost because the ring was full
+int64 SampleProfiler_GetDroppedCount();
+
+// flat : per function , self samples (it was the leaf) and total samples (anywhere on the stack)
+//	sorted by self ; maxLines <= 0 means all
+void SampleProfiler_LogFlat(int maxLines = 40);
+bool SampleProfiler_WriteFlat(const char * fileName,int maxLines = 0);
+
+// collapsed stacks : "root;caller;leaf count" per line , the input format of flamegraph.pl
+bool SampleProfiler_WriteCollapsed(const char * fileName);
+
+END_CB
@@ -9,6 +9,7 @@
 #include "Log.h"
 #include "MemTrack.h"
 #include "Threading.h"
+#include "Metrics.h"
 //#include "LF/LFSList.h"
 
 #include <stdlib.h> // for malloc
@@ -176,6 +177,16 @@ static bool InterlockedIsEmptySList(PSLIST_HEADER header)
 namespace SmallAllocator_Greedy
 {
 
+	// Metrics are static POD's that never allocate , so they're safe to use in here :
+	//	small allocs are counted in a plain thread local and flushed every c_metricFlushCount ,
+	//	so the fast path has no atomic ; the metric lags by up to that much per thread
+	static MetricCounter s_metricSmallAllocs = METRIC_COUNTER_INIT("smallalloc.small_allocs");
+	static const int c_metricFlushCount = 256;
+	static CB_THREAD_LOCAL int s_tlsSmallAllocs = 0;
+	static MetricCounter s_metricLargeAllocs = METRIC_COUNTER_INIT("smallalloc.large_allocs");
+	static MetricCounter s_metricExtends = METRIC_COUNTER_INIT("smallalloc.extends");
+	static MetricGauge s_metricChunkBytes = METRIC_GAUGE_INIT("smallalloc.chunk_bytes");
+
 // SList requires MEMORY_ALLOCATION_ALIGNMENT == 8
 
 	// 4 is the minimum size because each block is unioned with a pointer
@@ -479,6 +490,9 @@ namespace SmallAllocator_Greedy
 			#ifdef DO_STATS
 			stats_AllocatedBytes += c_SmallChunk_AllocSize;
 			#endif
+			
+			s_metricExtends.Add(1);
+			s_metricChunkBytes.Add(c_SmallChunk_AllocSize);
 
 			// add a hunk :
 			ChunkBlock * pNewHunk = (ChunkBlock *) _ChunkAlloc( c_SmallChunk_AllocSize );
@@ -700,6 +714,7 @@ namespace SmallAllocator_Greedy
 			void * ptr = _HeapAlloc(size);
 			
 			AutoMemTrack_Add(ptr,size,eMemTrack_Malloc);
+			s_metricLargeAllocs.Add(1);
 			
 			return ptr;
 		}
@@ -717,6 +732,11 @@ namespace SmallAllocator_Greedy
 			void * ptr = s_pAllocators[which].Allocate();
 
 			AutoMemTrack_Add(ptr,size,eMemTrack_Small);
+			if ( ++s_tlsSmallAllocs == c_metricFlushCount )
+			{
+				s_tlsSmallAllocs = 0;
+				s_metricSmallAllocs.Add(c_metricFlushCount);
+			}
 		
 			return ptr;
 		}
@@ -3,6 +3,13 @@
 #include "StackTrace.h"
 #include "Log.h"
 
+#ifndef _WIN32
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <string.h>
+#endif
+
 START_CB
 
 #ifdef CB_DO_STACK_TRACE
@@ -62,6 +69,8 @@ http://www.codeproject.com/KB/debug/extendedtrace.aspx
 
 **************************************************************************/
 
+#ifdef _WIN32
+
 #include <windows.h>
 #include <dbghelp.h>
 	
@@ -387,7 +396,113 @@ void StackTrace_Log(const StackTrace * trace)
 }
 
 
+#else // _WIN32
+
+//=================================================================
+// posix : glibc backtrace for Grab , dladdr for Log
+//	Log only sees exported symbols unless you link with -rdynamic
+
+void StackTrace_Init()
+{
+}
+
+void StackTrace_Shutdown()
+{
+}
+
+void StackTrace_Grab(StackTrace * trace,int skips)
+{
+	ZERO_PTR(trace);
+
+	// always skip self :
+	skips ++;
+
+	void * pointers[CB_STACK_TRACE_DEPTH + 8];
+	int maxCount = MIN(CB_STACK_TRACE_DEPTH + skips,(int)ARRAY_SIZE(pointers));
+	int count = backtrace(pointers,maxCount);
+
+	for(int i=skips;i<count;i++)
+	{
+		trace->ips[i - skips] = (instructionaddress_t) pointers[i];
+	}
+}
+
+void StackTrace_Log(const StackTrace * trace)
+{
+	for(int i=0; i< CB_STACK_TRACE_DEPTH; i++)
+	{
+		instructionaddress_t ip = trace->ips[i];
+		if( ip == 0 )
+			break;
+
+		Dl_info info;
+		if ( ! dladdr((void *)ip,&info) )
+		{
+			lprintf("unknown(%p)\n",(void *)ip);
+			continue;
+		}
+
+		const char * pModule = info.dli_fname ? info.dli_fname : "?";
+		if ( info.dli_sname == NULL )
+		{
+			lprintf("%s+0x%x\n",pModule,(uint32)(ip - (instructionaddress_t)info.dli_fbase));
+			continue;
+		}
+
+		int status = 0;
+		char * demangled = abi::__cxa_demangle(info.dli_sname,NULL,NULL,&status);
+		const char * pFunc = ( status == 0 && demangled ) ? demangled : info.dli_sname;
+
+		lprintf("%s : %s+0x%x\n",pModule,pFunc,(uint32)(ip - (instructionaddress_t)info.dli_saddr));
+
+		free(demangled);
+	}
+}
+
+#endif // _WIN32
 
 #endif // CB_DO_STACK_TRACE
 
+//=================================================================
+
+int StackTrace_WalkFrames(instructionaddress_t * pInto,int maxDepth,
+						instructionaddress_t pc,const void * fp,
+						const void * stackLo,const void * stackHi)
+{
+	if ( maxDepth <= 0 || pc == 0 )
+		return 0;
+
+	int depth = 0;
+	pInto[depth++] = pc;
+
+	const size_t lo = (size_t) stackLo;
+	const size_t hi = (size_t) stackHi;
+	if ( hi < lo + 2*sizeof(size_t) )
+		return depth;
+	size_t cur = (size_t) fp;
+
+	while ( depth < maxDepth )
+	{
+		// a frame record is { caller's fp , return address } (x64 push rbp , arm64 stp x29,x30)
+		//	it has to be aligned and entirely inside the stack :
+		if ( cur < lo || cur > hi - 2*sizeof(size_t) || ( cur & (sizeof(size_t)-1) ) != 0 )
+			break;
+
+		const size_t * frame = (const size_t *) cur;
+		size_t next = frame[0];
+		size_t ret  = frame[1];
+		if ( ret == 0 )
+			break;
+
+		pInto[depth++] = (instructionaddress_t) ret;
+
+		// stacks grow down , so the caller's frame must be higher ; this also stops cycles
+		if ( next <= cur )
+			break;
+		cur = next;
+	}
+
+	return depth;
+}
+
 END_CB
@@ -59,6 +59,18 @@ void StackTrace_Log(const StackTrace * trace) { }
 //-----------------------------------------------------------
 #endif // CB_DO_STACK_TRACE
 
+//-----------------------------------------------------------
+// StackTrace_WalkFrames : frame-pointer walk from a given pc/fp
+//	(eg. the registers out of a signal's ucontext)
+//	async-signal-safe : no locks , no allocation , and it never reads outside [stackLo,stackHi)
+//	stops at maxDepth or at the first frame that doesn't look right ; returns the depth
+//	pInto[0] is pc , the rest are return addresses
+// code without frame pointers (-fomit-frame-pointer) just gives you short stacks
+
+int StackTrace_WalkFrames(instructionaddress_t * pInto,int maxDepth,
+						instructionaddress_t pc,const void * fp,
+						const void * stackLo,const void * stackHi);
+
 struct StackTrace
 {
 	instructionaddress_t	ips[CB_STACK_TRACE_DEPTH];
@@ -1,4 +1,5 @@
 #include "StrUtil.h"
+#include "StrUtilSimd.h"
 #include "Log.h"
 
 #include <ctype.h>
@@ -286,15 +287,15 @@ int strtcmp(const char * p1,const char * p2)
 	}
 }	
 
-const char * stristr(const char * search_in,const char * search_for)
+const char * stristr_scalar(const char * search_in,const char * search_for)
 {
 	while ( *search_in )
 	{
-		if ( toupper(*search_in) == toupper(*search_for) )
+		if ( macro_tolower(*search_in) == macro_tolower(*search_for) )
 		{
 			const char * in_ptr = search_in + 1;
 			const char * for_ptr= search_for + 1;
-			while ( *for_ptr && toupper(*for_ptr) == toupper(*in_ptr) )
+			while ( *for_ptr && macro_tolower(*for_ptr) == macro_tolower(*in_ptr) )
 			{
 				for_ptr++; in_ptr++;
 			}
@@ -351,11 +352,11 @@ const char * strrstr(const char * search_in,const char * search_for)
 	return NULL;
 }
 
-const char * strichr(const char * search_in,const char search_for)
+const char * strichr_scalar(const char * search_in,const char search_for)
 {
 	while ( *search_in )
 	{
-		if ( toupper(*search_in) == toupper(search_for) )
+		if ( macro_tolower(*search_in) == macro_tolower(search_for) )
 		{
 			return search_in;
 		}
@@ -366,7 +367,7 @@ const char * strichr(const char * search_in,const char search_for)
 }
 
 // strchrset : find the first occurance of anything in search_set
-const char * strchrset(const char * search_in,const char * search_set)
+const char * strchrset_scalar(const char * search_in,const char * search_set)
 {
 	// set flags :
 	char mask[256] = { 0 };
@@ -387,7 +388,7 @@ const char * strchrset(const char * search_in,const char * search_set)
 }
 
 // strchr2 : find the first occurance of c1 or c2
-const char * strchr2(const char * ptr,char c1,char c2)
+const char * strchr2_scalar(const char * ptr,char c1,char c2)
 {	
 	while ( *ptr )
 	{
@@ -413,6 +414,29 @@ const char * strrchr2(const char * ptr,char c1,char c2)
 	return NULL;
 }
 
+// the public scanners go through StrUtilSimd, which picks SSE2/AVX2 kernels at runtime
+//	(and falls back to the _scalar loops above)
+
+const char * stristr(const char * search_in,const char * search_for)
+{
+	return stristr_simd(search_in,search_for);
+}
+
+const char * strichr(const char * search_in,const char search_for)
+{
+	return strichr_simd(search_in,search_for);
+}
+
+const char * strchrset(const char * search_in,const char * search_set)
+{
+	return strchrset_simd(search_in,search_set);
+}
+
+const char * strchr2(const char * ptr,char c1,char c2)
+{
+	return strchr2_simd(ptr,c1,c2);
+}
+
 // strchreol : find first eol char :
 const char * strchreol(const char * ptr)
 {
@@ -0,0 +1,683 @@
+#include "StrUtilSimd.h"
+#include "StrUtil.h"
+#include "Timer.h"
+#include "Rand.h"
+#include "Mem.h"
+#include "Log.h"
+
+#include <string.h>
+#include <emmintrin.h>	// SSE2
+#include <tmmintrin.h>	// SSSE3
+#include <immintrin.h>	// AVX2
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define STRSIMD_TARGET_SSSE3
+#define STRSIMD_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define STRSIMD_TARGET_SSSE3	__attribute__((target("ssse3")))
+#define STRSIMD_TARGET_AVX2		__attribute__((target("avx2")))
+#endif
+
+START_CB
+
+//=================================================================
+// cpu detection :
+
+static inline int StrSimd_BitScanForward(uint32 mask)
+{
+	ASSERT( mask != 0 );
+	#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index,mask);
+	return (int)index;
+	#else
+	return __builtin_ctz(mask);
+	#endif
+}
+
+static void StrSimd_CPUID(int info[4],int leaf,int subleaf)
+{
+	#ifdef _MSC_VER
+	__cpuidex(info,leaf,subleaf);
+	#else
+	__cpuid_count(leaf,subleaf,info[0],info[1],info[2],info[3]);
+	#endif
+}
+
+static EStrSimdLevel StrSimd_DetectLevel()
+{
+	int info[4] = { 0 };
+	StrSimd_CPUID(info,0,0);
+	int maxLeaf = info[0];
+
+	StrSimd_CPUID(info,1,0);
+	bool sse2  = ( info[3] & (1<<26) ) != 0;
+	bool ssse3 = ( info[2] & (1<<9) ) != 0;
+	bool osxsave = ( info[2] & (1<<27) ) != 0;
+	bool avx = ( info[2] & (1<<28) ) != 0;
+
+	if ( ! sse2 )
+		return eStrSimd_Scalar;
+	if ( ! ssse3 )
+		return eStrSimd_SSE2;
+
+	// AVX2 needs the cpu bit *and* the OS saving ymm state :
+	if ( maxLeaf >= 7 && osxsave && avx )
+	{
+		#ifdef _MSC_VER
+		uint64 xcr0 = _xgetbv(0);
+		#else
+		uint32 xlo,xhi;
+		__asm__ ( "xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0) );
+		uint64 xcr0 = ((uint64)xhi<<32) | xlo;
+		#endif
+
+		StrSimd_CPUID(info,7,0);
+		bool avx2 = ( info[1] & (1<<5) ) != 0;
+
+		if ( avx2 && (xcr0 & 6) == 6 )
+			return eStrSimd_AVX2;
+	}
+
+	return eStrSimd_SSSE3;
+}
+
+// detected by the static initializer , before any thread can be made , so the hot path is a plain load
+//	a caller from another file's static init before this runs sees zero = eStrSimd_Scalar , which is still right
+static const EStrSimdLevel s_cpuLevel = StrSimd_DetectLevel();
+static EStrSimdLevel s_level = s_cpuLevel;
+
+static inline EStrSimdLevel StrSimd_Level()
+{
+	return s_level;
+}
+
+EStrSimdLevel StrSimd_GetLevel()
+{
+	return StrSimd_Level();
+}
+
+EStrSimdLevel StrSimd_SetLevel(EStrSimdLevel level)
+{
+	s_level = MIN(level,s_cpuLevel);
+	return s_level;
+}
+
+//=================================================================
+// SSE2 helpers :
+
+// ASCII tolower on 16 bytes
+static inline __m128i StrSimd_FoldLower16(__m128i x)
+{
+	// bytes >= 0x80 are negative so the signed compares reject them :
+	__m128i isUpper = _mm_and_si128( _mm_cmpgt_epi8(x,_mm_set1_epi8('A'-1)), _mm_cmplt_epi8(x,_mm_set1_epi8('Z'+1)) );
+	return _mm_or_si128( x, _mm_and_si128(isUpper,_mm_set1_epi8(0x20)) );
+}
+
+STRSIMD_TARGET_AVX2 static inline __m256i StrSimd_FoldLower32(__m256i x)
+{
+	__m256i isUpper = _mm256_and_si256( _mm256_cmpgt_epi8(x,_mm256_set1_epi8('A'-1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z'+1),x) );
+	return _mm256_or_si256( x, _mm256_and_si256(isUpper,_mm256_set1_epi8(0x20)) );
+}
+
+// rest of the needle after the 2-byte prefilter hit :
+//	folds with macro_tolower , the same ASCII-only fold as StrSimd_FoldLower16/32 ; the locale's
+//	toupper could disagree with the prefilter on bytes >= 0x80
+static inline bool StrSimd_MatchRestI(const char * in,const char * for_ptr)
+{
+	while ( *for_ptr && macro_tolower(*for_ptr) == macro_tolower(*in) )
+	{
+		for_ptr++; in++;
+	}
+	return ( *for_ptr == 0 );
+}
+
+//=================================================================
+// strchr2 :
+
+static const char * strchr2_sse2(const char * ptr,char c1,char c2)
+{
+	const __m128i v1 = _mm_set1_epi8(c1);
+	const __m128i v2 = _mm_set1_epi8(c2);
+	const __m128i vz = _mm_setzero_si128();
+
+	// step back to alignment so we never read across a page :
+	int misalign = (int)( ((uintptr_t)ptr) & 15 );
+	const __m128i * block = (const __m128i *)(ptr - misalign);
+
+	__m128i x = _mm_load_si128(block);
+	uint32 mask = _mm_movemask_epi8( _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(x,v1), _mm_cmpeq_epi8(x,v2) ), _mm_cmpeq_epi8(x,vz) ) );
+	mask &= (0xFFFFU << misalign);
+
+	for(;;)
+	{
+		if ( mask )
+		{
+			const char * hit = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hit ) ? hit : NULL;
+		}
+
+		block++;
+		x = _mm_load_si128(block);
+		mask = _mm_movemask_epi8( _mm_or_si128( _mm_or_si128( _mm_cmpeq_epi8(x,v1), _mm_cmpeq_epi8(x,v2) ), _mm_cmpeq_epi8(x,vz) ) );
+	}
+}
+
+STRSIMD_TARGET_AVX2 static const char * strchr2_avx2(const char * ptr,char c1,char c2)
+{
+	const __m256i v1 = _mm256_set1_epi8(c1);
+	const __m256i v2 = _mm256_set1_epi8(c2);
+	const __m256i vz = _mm256_setzero_si256();
+
+	int misalign = (int)( ((uintptr_t)ptr) & 31 );
+	const __m256i * block = (const __m256i *)(ptr - misalign);
+
+	__m256i x = _mm256_load_si256(block);
+	uint32 mask = (uint32) _mm256_movemask_epi8( _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(x,v1), _mm256_cmpeq_epi8(x,v2) ), _mm256_cmpeq_epi8(x,vz) ) );
+	mask &= (0xFFFFFFFFU << misalign);
+
+	for(;;)
+	{
+		if ( mask )
+		{
+			const char * hit = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hit ) ? hit : NULL;
+		}
+
+		block++;
+		x = _mm256_load_si256(block);
+		mask = (uint32) _mm256_movemask_epi8( _mm256_or_si256( _mm256_or_si256( _mm256_cmpeq_epi8(x,v1), _mm256_cmpeq_epi8(x,v2) ), _mm256_cmpeq_epi8(x,vz) ) );
+	}
+}
+
+const char * strchr2_simd(const char * ptr,char c1,char c2)
+{
+	EStrSimdLevel level = StrSimd_Level();
+	if ( level >= eStrSimd_AVX2 )
+		return strchr2_avx2(ptr,c1,c2);
+	else if ( level >= eStrSimd_SSE2 )
+		return strchr2_sse2(ptr,c1,c2);
+	else
+		return strchr2_scalar(ptr,c1,c2);
+}
+
+//=================================================================
+// strichr :
+
+static const char * strichr_sse2(const char * ptr,char c)
+{
+	const __m128i vc = _mm_set1_epi8( (char) macro_tolower(c) );
+	const __m128i vz = _mm_setzero_si128();
+
+	int misalign = (int)( ((uintptr_t)ptr) & 15 );
+	const __m128i * block = (const __m128i *)(ptr - misalign);
+
+	__m128i x = _mm_load_si128(block);
+	uint32 mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8(StrSimd_FoldLower16(x),vc), _mm_cmpeq_epi8(x,vz) ) );
+	mask &= (0xFFFFU << misalign);
+
+	for(;;)
+	{
+		if ( mask )
+		{
+			const char * hit = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hit ) ? hit : NULL;
+		}
+
+		block++;
+		x = _mm_load_si128(block);
+		mask = _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8(StrSimd_FoldLower16(x),vc), _mm_cmpeq_epi8(x,vz) ) );
+	}
+}
+
+STRSIMD_TARGET_AVX2 static const char * strichr_avx2(const char * ptr,char c)
+{
+	const __m256i vc = _mm256_set1_epi8( (char) macro_tolower(c) );
+	const __m256i vz = _mm256_setzero_si256();
+
+	int misalign = (int)( ((uintptr_t)ptr) & 31 );
+	const __m256i * block = (const __m256i *)(ptr - misalign);
+
+	__m256i x = _mm256_load_si256(block);
+	uint32 mask = (uint32) _mm256_movemask_epi8( _mm256_or_si256( _mm256_cmpeq_epi8(StrSimd_FoldLower32(x),vc), _mm256_cmpeq_epi8(x,vz) ) );
+	mask &= (0xFFFFFFFFU << misalign);
+
+	for(;;)
+	{
+		if ( mask )
+		{
+			const char * hit = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hit ) ? hit : NULL;
+		}
+
+		block++;
+		x = _mm256_load_si256(block);
+		mask = (uint32) _mm256_movemask_epi8( _mm256_or_si256( _mm256_cmpeq_epi8(StrSimd_FoldLower32(x),vc), _mm256_cmpeq_epi8(x,vz) ) );
+	}
+}
+
+const char * strichr_simd(const char * search_in,const char search_for)
+{
+	// searching for the null is a "not found" in the scalar version :
+	if ( search_for == 0 )
+		return NULL;
+
+	EStrSimdLevel level = StrSimd_Level();
+	if ( level >= eStrSimd_AVX2 )
+		return strichr_avx2(search_in,search_for);
+	else if ( level >= eStrSimd_SSE2 )
+		return strichr_sse2(search_in,search_for);
+	else
+		return strichr_scalar(search_in,search_for);
+}
+
+//=================================================================
+// stristr :
+//	prefilter on the first two needle bytes (case folded) a whole block at a time
+//	then verify the rest of the needle with the scalar loop
+//	the pair can straddle blocks, so the top bit of the first-byte mask is carried into the next block
+
+static const char * stristr_sse2(const char * search_in,const char * search_for)
+{
+	const __m128i f0 = _mm_set1_epi8( (char) macro_tolower(search_for[0]) );
+	const __m128i f1 = _mm_set1_epi8( (char) macro_tolower(search_for[1]) );
+	const __m128i vz = _mm_setzero_si128();
+	const char * rest = search_for + 2;
+
+	int misalign = (int)( ((uintptr_t)search_in) & 15 );
+	const __m128i * block = (const __m128i *)(search_in - misalign);
+	uint32 startMask = (0xFFFFU << misalign);
+	uint32 carry = 0;
+
+	for(;;)
+	{
+		__m128i x = _mm_load_si128(block);
+		__m128i lx = StrSimd_FoldLower16(x);
+		uint32 m0 = _mm_movemask_epi8( _mm_cmpeq_epi8(lx,f0) ) & startMask;
+		uint32 m1 = _mm_movemask_epi8( _mm_cmpeq_epi8(lx,f1) );
+		uint32 mz = _mm_movemask_epi8( _mm_cmpeq_epi8(x,vz) ) & startMask;
+		startMask = 0xFFFFU;
+
+		const char * base = (const char *)block;
+
+		// pair straddling the previous block :
+		if ( carry && (m1 & 1) )
+		{
+			if ( StrSimd_MatchRestI(base+1,rest) )
+				return base-1;
+		}
+
+		uint32 cand = m0 & (m1 >> 1);
+		if ( mz )
+		{
+			// only candidates before the null :
+			int zpos = StrSimd_BitScanForward(mz);
+			cand &= (1U << zpos) - 1;
+		}
+
+		while ( cand )
+		{
+			int i = StrSimd_BitScanForward(cand);
+			if ( StrSimd_MatchRestI(base+i+2,rest) )
+				return base+i;
+			cand &= cand-1;
+		}
+
+		if ( mz )
+			return NULL;
+
+		carry = m0 & 0x8000;
+		block++;
+	}
+}
+
+STRSIMD_TARGET_AVX2 static const char * stristr_avx2(const char * search_in,const char * search_for)
+{
+	const __m256i f0 = _mm256_set1_epi8( (char) macro_tolower(search_for[0]) );
+	const __m256i f1 = _mm256_set1_epi8( (char) macro_tolower(search_for[1]) );
+	const __m256i vz = _mm256_setzero_si256();
+	const char * rest = search_for + 2;
+
+	int misalign = (int)( ((uintptr_t)search_in) & 31 );
+	const __m256i * block = (const __m256i *)(search_in - misalign);
+	uint32 startMask = (0xFFFFFFFFU << misalign);
+	uint32 carry = 0;
+
+	for(;;)
+	{
+		__m256i x = _mm256_load_si256(block);
+		__m256i lx = StrSimd_FoldLower32(x);
+		uint32 m0 = (uint32) _mm256_movemask_epi8( _mm256_cmpeq_epi8(lx,f0) ) & startMask;
+		uint32 m1 = (uint32) _mm256_movemask_epi8( _mm256_cmpeq_epi8(lx,f1) );
+		uint32 mz = (uint32) _mm256_movemask_epi8( _mm256_cmpeq_epi8(x,vz) ) & startMask;
+		startMask = 0xFFFFFFFFU;
+
+		const char * base = (const char *)block;
+
+		if ( carry && (m1 & 1) )
+		{
+			if ( StrSimd_MatchRestI(base+1,rest) )
+				return base-1;
+		}
+
+		uint32 cand = m0 & (m1 >> 1);
+		if ( mz )
+		{
+			int zpos = StrSimd_BitScanForward(mz);
+			cand &= (zpos == 0) ? 0 : (0xFFFFFFFFU >> (32 - zpos));
+		}
+
+		while ( cand )
+		{
+			int i = StrSimd_BitScanForward(cand);
+			if ( StrSimd_MatchRestI(base+i+2,rest) )
+				return base+i;
+			cand &= cand-1;
+		}
+
+		if ( mz )
+			return NULL;
+
+		carry = m0 & 0x80000000U;
+		block++;
+	}
+}
+
+const char * stristr_simd(const char * search_in,const char * search_for)
+{
+	// short needles, same answers as the scalar loop :
+	if ( search_for[0] == 0 )
+		return NULL;
+	if ( search_for[1] == 0 )
+		return strichr_simd(search_in,search_for[0]);
+
+	EStrSimdLevel level = StrSimd_Level();
+	if ( level >= eStrSimd_AVX2 )
+		return stristr_avx2(search_in,search_for);
+	else if ( level >= eStrSimd_SSE2 )
+		return stristr_sse2(search_in,search_for);
+	else
+		return stristr_scalar(search_in,search_for);
+}
+
+//=================================================================
+// strchrset :
+//	small sets just OR together cmpeq's
+//	bigger sets use a nibble bitmap : lo nibble selects a byte of bits, hi nibble selects the bit
+//		(two tables because there are 16 hi nibbles and only 8 bits)
+
+static const int c_strchrset_smallSet = 4;
+
+static const char * strchrset_sse2_small(const char * ptr,const char * search_set,int setLen)
+{
+	__m128i sets[c_strchrset_smallSet];
+	for LOOP(i,c_strchrset_smallSet)
+	{
+		// pad with the first char so unused slots are harmless :
+		sets[i] = _mm_set1_epi8( search_set[ (i < setLen) ? i : 0 ] );
+	}
+	const __m128i vz = _mm_setzero_si128();
+
+	int misalign = (int)( ((uintptr_t)ptr) & 15 );
+	const __m128i * block = (const __m128i *)(ptr - misalign);
+	uint32 startMask = (0xFFFFU << misalign);
+
+	for(;;)
+	{
+		__m128i x = _mm_load_si128(block);
+		__m128i hit = _mm_or_si128( _mm_cmpeq_epi8(x,sets[0]), _mm_cmpeq_epi8(x,sets[1]) );
+		hit = _mm_or_si128( hit, _mm_or_si128( _mm_cmpeq_epi8(x,sets[2]), _mm_cmpeq_epi8(x,sets[3]) ) );
+		hit = _mm_or_si128( hit, _mm_cmpeq_epi8(x,vz) );
+		uint32 mask = _mm_movemask_epi8(hit) & startMask;
+		startMask = 0xFFFFU;
+
+		if ( mask )
+		{
+			const char * hitPtr = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hitPtr ) ? hitPtr : NULL;
+		}
+
+		block++;
+	}
+}
+
+struct StrSimd_NibbleSet
+{
+	uint8	lo[16];	// for bytes 0x00-0x7F
+	uint8	hi[16];	// for bytes 0x80-0xFF
+};
+
+static void StrSimd_MakeNibbleSet(StrSimd_NibbleSet * pSet,const char * search_set)
+{
+	memset(pSet,0,sizeof(StrSimd_NibbleSet));
+	while( *search_set )
+	{
+		uint8 c = (uint8) *search_set++;
+		uint8 bit = (uint8)( 1 << ((c>>4)&7) );
+		if ( c & 0x80 )
+			pSet->hi[c&15] |= bit;
+		else
+			pSet->lo[c&15] |= bit;
+	}
+}
+
+STRSIMD_TARGET_SSSE3 static const char * strchrset_ssse3(const char * ptr,const StrSimd_NibbleSet & set)
+{
+	const __m128i tblLo = _mm_loadu_si128((const __m128i *)set.lo);
+	const __m128i tblHi = _mm_loadu_si128((const __m128i *)set.hi);
+	const __m128i bitOfNibble = _mm_setr_epi8(1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128);
+	const __m128i nibMask = _mm_set1_epi8(0x0F);
+	const __m128i vz = _mm_setzero_si128();
+
+	int misalign = (int)( ((uintptr_t)ptr) & 15 );
+	const __m128i * block = (const __m128i *)(ptr - misalign);
+	uint32 startMask = (0xFFFFU << misalign);
+
+	for(;;)
+	{
+		__m128i x = _mm_load_si128(block);
+		__m128i lo = _mm_and_si128(x,nibMask);
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(x,4),nibMask);
+
+		__m128i isHigh = _mm_cmplt_epi8(x,vz);
+		__m128i rowLo = _mm_shuffle_epi8(tblLo,lo);
+		__m128i rowHi = _mm_shuffle_epi8(tblHi,lo);
+		__m128i row = _mm_or_si128( _mm_and_si128(isHigh,rowHi), _mm_andnot_si128(isHigh,rowLo) );
+		__m128i bit = _mm_shuffle_epi8(bitOfNibble,hi);
+
+		__m128i miss = _mm_cmpeq_epi8( _mm_and_si128(row,bit), vz );
+		uint32 mask = ( (~_mm_movemask_epi8(miss) & 0xFFFF) | _mm_movemask_epi8(_mm_cmpeq_epi8(x,vz)) ) & startMask;
+		startMask = 0xFFFFU;
+
+		if ( mask )
+		{
+			const char * hitPtr = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hitPtr ) ? hitPtr : NULL;
+		}
+
+		block++;
+	}
+}
+
+STRSIMD_TARGET_AVX2 static const char * strchrset_avx2(const char * ptr,const StrSimd_NibbleSet & set)
+{
+	// vpshufb works per 128-bit lane, so the tables are duplicated into both lanes :
+	const __m256i tblLo = _mm256_broadcastsi128_si256( _mm_loadu_si128((const __m128i *)set.lo) );
+	const __m256i tblHi = _mm256_broadcastsi128_si256( _mm_loadu_si128((const __m128i *)set.hi) );
+	const __m256i bitOfNibble = _mm256_setr_epi8(1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128,
+												1,2,4,8,16,32,64,-128,1,2,4,8,16,32,64,-128);
+	const __m256i nibMask = _mm256_set1_epi8(0x0F);
+	const __m256i vz = _mm256_setzero_si256();
+
+	int misalign = (int)( ((uintptr_t)ptr) & 31 );
+	const __m256i * block = (const __m256i *)(ptr - misalign);
+	uint32 startMask = (0xFFFFFFFFU << misalign);
+
+	for(;;)
+	{
+		__m256i x = _mm256_load_si256(block);
+		__m256i lo = _mm256_and_si256(x,nibMask);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x,4),nibMask);
+
+		__m256i isHigh = _mm256_cmpgt_epi8(vz,x);
+		__m256i row = _mm256_blendv_epi8( _mm256_shuffle_epi8(tblLo,lo), _mm256_shuffle_epi8(tblHi,lo), isHigh );
+		__m256i bit = _mm256_shuffle_epi8(bitOfNibble,hi);
+
+		__m256i miss = _mm256_cmpeq_epi8( _mm256_and_si256(row,bit), vz );
+		uint32 mask = ( (~(uint32)_mm256_movemask_epi8(miss)) | (uint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x,vz)) ) & startMask;
+		startMask = 0xFFFFFFFFU;
+
+		if ( mask )
+		{
+			const char * hitPtr = ((const char *)block) + StrSimd_BitScanForward(mask);
+			return ( *hitPtr ) ? hitPtr : NULL;
+		}
+
+		block++;
+	}
+}
+
+const char * strchrset_simd(const char * search_in,const char * search_set)
+{
+	int setLen = strlen32(search_set);
+	if ( setLen == 0 )
+		return NULL;
+
+	EStrSimdLevel level = StrSimd_Level();
+
+	if ( level >= eStrSimd_SSSE3 && setLen > c_strchrset_smallSet )
+	{
+		StrSimd_NibbleSet set;
+		StrSimd_MakeNibbleSet(&set,search_set);
+
+		if ( level >= eStrSimd_AVX2 )
+			return strchrset_avx2(search_in,set);
+		else
+			return strchrset_ssse3(search_in,set);
+	}
+	else if ( level >= eStrSimd_SSE2 && setLen <= c_strchrset_smallSet )
+	{
+		return strchrset_sse2_small(search_in,search_set,setLen);
+	}
+	else
+	{
+		return strchrset_scalar(search_in,search_set);
+	}
+}
+
+//=================================================================
+// benchmark :
+
+static uint64 StrSimd_BenchMinTicks(const char * (*func)(const char *,const char *),
+									const char * text,const char * arg,const char ** pResult)
+{
+	uint64 best = (uint64)-1;
+	for LOOP(rep,5)
+	{
+		uint64 t1 = Timer::rdtsc();
+		*pResult = (*func)(text,arg);
+		uint64 t2 = Timer::rdtsc();
+		best = MIN(best,t2-t1);
+	}
+	return best;
+}
+
+// adapters so everything has the same signature :
+static const char * bench_stristr_scalar(const char * s,const char * a) { return stristr_scalar(s,a); }
+static const char * bench_stristr_simd(const char * s,const char * a) { return stristr_simd(s,a); }
+static const char * bench_strichr_scalar(const char * s,const char * a) { return strichr_scalar(s,a[0]); }
+static const char * bench_strichr_simd(const char * s,const char * a) { return strichr_simd(s,a[0]); }
+static const char * bench_strchrset_scalar(const char * s,const char * a) { return strchrset_scalar(s,a); }
+static const char * bench_strchrset_simd(const char * s,const char * a) { return strchrset_simd(s,a); }
+static const char * bench_strchr2_scalar(const char * s,const char * a) { return strchr2_scalar(s,a[0],a[1]); }
+static const char * bench_strchr2_simd(const char * s,const char * a) { return strchr2_simd(s,a[0],a[1]); }
+
+// count lines with strnextline ; the scalar one is the old strchreol+skipeols loop
+static const char * bench_lines_scalar(const char * s,const char * a)
+{
+	int count = 0;
+	while ( s && *s )
+	{
+		s = strchr2_scalar(s,'\r','\n');
+		if ( ! s ) break;
+		s = skipeols(s);
+		count++;
+	}
+	return (const char *)(intptr_t)count;
+}
+static const char * bench_lines_simd(const char * s,const char * a)
+{
+	int count = 0;
+	while ( s && *s )
+	{
+		s = strnextline(s);
+		if ( ! s ) break;
+		count++;
+	}
+	return (const char *)(intptr_t)count;
+}
+
+void StrUtil_Benchmark(int numBytes)
+{
+	// synthetic log : lines of lower case words, needles only at the very end
+	char * text = (char *) CBALLOC(numBytes+1);
+	int lineLen = 0;
+	for LOOP(i,numBytes)
+	{
+		char c;
+		if ( lineLen > 60 && irandmod(8) == 0 ) { c = '\n'; lineLen = 0; }
+		else if ( irandmod(6) == 0 ) { c = ' '; lineLen++; }
+		else { c = (char)('a' + irandmod(20)); lineLen++; } // 'a'-'t' only
+		text[i] = c;
+	}
+	const char * tail = "XyZZy=|";
+	int tailLen = strlen32(tail);
+	memcpy(text + numBytes - tailLen - 1,tail,tailLen);
+	text[numBytes-1] = '\n';
+	text[numBytes] = 0;
+
+	struct BenchCase
+	{
+		const char * name;
+		const char * (*scalar)(const char *,const char *);
+		const char * (*simd)(const char *,const char *);
+		const char * arg;
+	};
+
+	const BenchCase cases[] =
+	{
+		{ "stristr",		bench_stristr_scalar,	bench_stristr_simd,		"xyzzy" },
+		{ "strichr",		bench_strichr_scalar,	bench_strichr_simd,		"Z" },
+		{ "strchrset(2)",	bench_strchrset_scalar,	bench_strchrset_simd,	"=|" },
+		{ "strchrset(8)",	bench_strchrset_scalar,	bench_strchrset_simd,	"XYZ=|<>!" },
+		{ "strchr2",		bench_strchr2_scalar,	bench_strchr2_simd,		"=|" },
+		{ "strnextline",	bench_lines_scalar,		bench_lines_simd,		"" },
+	};
+
+	lprintf("StrUtil_Benchmark : %d bytes, simd level %d\n",numBytes,(int)StrSimd_GetLevel());
+
+	double secondsPerTick = Timer::GetSecondsPerTick();
+
+	for LOOP(i,(int)ARRAY_SIZE(cases))
+	{
+		const char * r1 = NULL;
+		const char * r2 = NULL;
+		uint64 t1 = StrSimd_BenchMinTicks(cases[i].scalar,text,cases[i].arg,&r1);
+		uint64 t2 = StrSimd_BenchMinTicks(cases[i].simd,text,cases[i].arg,&r2);
+
+		ASSERT_RELEASE( r1 == r2 );
+
+		double mb = numBytes / (1024.0*1024.0);
+		lprintf("  %-14s : scalar %8.1f MB/s , simd %8.1f MB/s , %5.2fX\n",
+			cases[i].name,
+			mb / (t1*secondsPerTick),
+			mb / (t2*secondsPerTick),
+			(double)t1 / (double)MAX(t2,(uint64)1) );
+	}
+
+	CBFREE(text);
+}
+
+END_CB
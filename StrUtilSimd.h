@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Base.h"
+
+/**
+
+StrUtilSimd : SSE2/SSSE3/AVX2 versions of the StrUtil scanners
+
+the regular StrUtil calls (stristr,strichr,strchrset,strchr2,strchreol,strnextline)
+	dispatch to these automatically ; you normally don't call anything here directly
+
+the kernels read whole aligned blocks around the null terminator,
+	which never crosses a page so it's safe, but it will make memory checkers grumpy
+
+case folding is ASCII only, same as toupper in the "C" locale
+
+**/
+
+START_CB
+
+enum EStrSimdLevel
+{
+	eStrSimd_Scalar = 0,
+	eStrSimd_SSE2   = 1,
+	eStrSimd_SSSE3  = 2,
+	eStrSimd_AVX2   = 3
+};
+
+// GetLevel is what the cpu supports (or what you forced with SetLevel)
+EStrSimdLevel StrSimd_GetLevel();
+// SetLevel can only lower the level, for testing & benchmarking ; returns the level actually set
+//	(not thread safe : call it when nothing else is using StrSimd)
+EStrSimdLevel StrSimd_SetLevel(EStrSimdLevel level);
+
+// the old byte loops, for reference & benchmarking :
+const char * stristr_scalar(const char * search_in,const char * search_for);
+const char * strichr_scalar(const char * search_in,const char search_for);
+const char * strchrset_scalar(const char * search_in,const char * search_set);
+const char * strchr2_scalar(const char * ptr,char c1,char c2);
+
+// dispatchers ; StrUtil calls these :
+const char * stristr_simd(const char * search_in,const char * search_for);
+const char * strichr_simd(const char * search_in,const char search_for);
+const char * strchrset_simd(const char * search_in,const char * search_set);
+const char * strchr2_simd(const char * ptr,char c1,char c2);
+
+// StrUtil_Benchmark : times scalar vs simd on a big synthetic log and lprintf's the results
+//	also checks that they all give the same answers
+void StrUtil_Benchmark(int numBytes = 16*1024*1024);
+
+END_CB
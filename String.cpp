@@ -5,6 +5,7 @@
 #include "FileUtil.h"
 #include "vector.h"
 #include "Log.h"
+#include "FastPrintf.h"
 
 #include <stdarg.h>
 #include <string.h>
@@ -553,30 +554,9 @@ void String::Insert(const int at, const char c )
 	
 String StringRawPrintfVA(const char *pFormat, va_list varargs)
 {
-	// try to print to a moderate size stack array first :
-
-	char stackBuf[1024];
-	int wroteLen = vsnprintf(stackBuf,sizeof(stackBuf)-1,pFormat,varargs);
-	if ( wroteLen >= 0 )
-	{
-		// tack it on :
-		//Set(stackBuf);
-		return String(stackBuf);
-	}
-	else
-	{
-		// very big string, make a dynamic alloc buffer :
-	
-		// could just work into my vec directly :
-		//String ret;
-		//vector<char> & vBuf = ret.Writeable();
-		vector<char> vBuf;
-		
-		vsnprintfdynamic(&vBuf,pFormat,varargs);
-		
-		// this is an unnecessary strcpy , but also does a tighten for us :
-		return String(vBuf.data());
-	}	
+	// format into the per-thread scratch buffer, then one copy into the String :
+	const char * str = fastvsprintf_tls(NULL,pFormat,varargs);
+	return String(str);
 }
 
 String rawStringPrintf(const char *pFormat, ...)
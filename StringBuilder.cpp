@@ -0,0 +1,274 @@
+#include "StringBuilder.h"
+#include "FastPrintf.h"
+#include "File.h"
+#include "FileUtil.h"
+#include "Log.h"
+#include "Mem.h"
+#include <string.h>
+
+START_CB
+
+// chunks double until they get this big :
+static const int c_maxChunkSize = 1024*1024;
+
+//=======================================================================
+
+StringBuilder::StringBuilder(int firstChunkSize) :
+	m_length(0),
+	m_nextChunkSize(firstChunkSize)
+{
+	ASSERT( firstChunkSize > 0 );
+}
+
+StringBuilder::~StringBuilder()
+{
+	for LOOPVEC(i,m_chunks)
+	{
+		CBFREE(m_chunks[i].data);
+	}
+}
+
+void StringBuilder::Clear()
+{
+	// keep the biggest chunk (the last) , free the rest :
+	if ( m_chunks.empty() )
+		return;
+
+	Chunk keep = m_chunks.back();
+	for(int i=0;i<m_chunks.size32()-1;i++)
+	{
+		CBFREE(m_chunks[i].data);
+	}
+	m_chunks.clear();
+	keep.len = 0;
+	m_chunks.push_back(keep);
+	m_length = 0;
+}
+
+StringBuilder::Chunk & StringBuilder::Reserve(int need)
+{
+	if ( ! m_chunks.empty() )
+	{
+		Chunk & tail = m_chunks.back();
+		if ( tail.cap - tail.len >= need )
+			return tail;
+	}
+
+	Chunk c;
+	c.cap = MAX(need,m_nextChunkSize);
+	c.data = (char *) CBALLOC(c.cap);
+	c.len = 0;
+	m_chunks.push_back(c);
+
+	m_nextChunkSize = MIN(m_nextChunkSize*2,c_maxChunkSize);
+
+	return m_chunks.back();
+}
+
+//=======================================================================
+
+void StringBuilder::Append(const char * const pStr,int len)
+{
+	if ( len <= 0 )
+		return;
+
+	const char * ptr = pStr;
+	m_length += len;
+
+	// fill the tail of the current chunk first, then at most one new one :
+	if ( ! m_chunks.empty() )
+	{
+		Chunk & tail = m_chunks.back();
+		int room = MIN(tail.cap - tail.len,len);
+		memcpy(tail.data + tail.len,ptr,room);
+		tail.len += room;
+		ptr += room;
+		len -= room;
+		if ( len == 0 )
+			return;
+	}
+
+	Chunk & c = Reserve(len);
+	memcpy(c.data + c.len,ptr,len);
+	c.len += len;
+}
+
+void StringBuilder::Append(const char * const pStr)
+{
+	Append(pStr,(int)strlen(pStr));
+}
+
+void StringBuilder::Append(const char c)
+{
+	Chunk & tail = Reserve(1);
+	tail.data[tail.len++] = c;
+	m_length++;
+}
+
+void StringBuilder::Append(const StringBuilder & other)
+{
+	ASSERT( &other != this );
+	for LOOPVEC(i,other.m_chunks)
+	{
+		Append(other.m_chunks[i].data,other.m_chunks[i].len);
+	}
+}
+
+char StringBuilder::PopBack()
+{
+	while ( ! m_chunks.empty() )
+	{
+		Chunk & tail = m_chunks.back();
+		if ( tail.len > 0 )
+		{
+			m_length--;
+			return tail.data[--tail.len];
+		}
+		if ( m_chunks.size32() == 1 )
+			break;
+		CBFREE(tail.data);
+		m_chunks.pop_back();
+	}
+	return 0;
+}
+
+void StringBuilder::CatPrintfVA( const char *format, va_list args )
+{
+	// try formatting into what's left of the tail chunk :
+	//	(+1 because fastvsnprintf wants room for its null)
+	Chunk * pTail = m_chunks.empty() ? &Reserve(64) : &m_chunks.back();
+	int room = pTail->cap - pTail->len;
+
+	va_list save;
+	va_copy(save,args);
+	int len = fastvsnprintf(pTail->data + pTail->len,room,format,save);
+	va_end(save);
+
+	if ( len >= room )
+	{
+		// now we know the size ; the partial output past tail.len is just ignored
+		pTail = &Reserve(len+1);
+		fastvsnprintf(pTail->data + pTail->len,len+1,format,args);
+	}
+
+	pTail->len += len;
+	m_length += len;
+}
+
+void StringBuilder::rawCatPrintf( const char *format, ... )
+{
+	va_list args;
+	va_start(args,format);
+	CatPrintfVA(format,args);
+	va_end(args);
+}
+
+//=======================================================================
+
+const char * StringBuilder::GetChunk(int i,int * pLen) const
+{
+	const Chunk & c = m_chunks[i];
+	*pLen = c.len;
+	return c.data;
+}
+
+void StringBuilder::CopyTo(char * to) const
+{
+	for LOOPVEC(i,m_chunks)
+	{
+		memcpy(to,m_chunks[i].data,m_chunks[i].len);
+		to += m_chunks[i].len;
+	}
+	*to = 0;
+}
+
+String StringBuilder::ToString() const
+{
+	String ret;
+	char * buf = ret.WriteableCStr(m_length+1);
+	CopyTo(buf);
+	ret.FixLength();
+	return ret;
+}
+
+bool StringBuilder::WriteText(FILE * fp) const
+{
+	// in batches off the stack ; each WriteIOVecs carries on at the file's position
+	const int c_batch = 64;
+	FileIOVec iov[c_batch];
+
+	int next = 0;
+	const int numChunks = m_chunks.size32();
+	while ( next < numChunks )
+	{
+		int count = 0;
+		while ( count < c_batch && next < numChunks )
+		{
+			iov[count].iov_base = m_chunks[next].data;
+			iov[count].iov_len = m_chunks[next].len;
+			next++;
+			count++;
+		}
+
+		if ( ! WriteIOVecs(fp,iov,count) )
+			return false;
+	}
+	return true;
+}
+
+bool StringBuilder::WriteText(File & file) const
+{
+	return WriteText(file.Get());
+}
+
+bool StringBuilder::WriteTextFile(const char * fileName) const
+{
+	FILE * fp = fopen(fileName,"wb");
+	if ( ! fp )
+	{
+		lprintf("StringBuilder : couldn't open %s\n",fileName);
+		return false;
+	}
+	bool ok = WriteText(fp);
+	ok = ( ferror(fp) == 0 ) && ok;
+	ok = ( fclose(fp) == 0 ) && ok;
+	return ok;
+}
+
+//=======================================================================
+
+void StringBuilder::AppendJSONString(const char * str)
+{
+	Append('"');
+	for(const char * ptr = str; *ptr; ptr++)
+	{
+		const char c = *ptr;
+		if ( c == '"' || c == '\\' )
+		{
+			Append('\\');
+			Append(c);
+		}
+		else if ( (unsigned char)c < 0x20 )
+		{
+			CatPrintf("\\u%04x",(int)(unsigned char)c);
+		}
+		else
+		{
+			Append(c);
+		}
+	}
+	Append('"');
+}
+
+void StringBuilder::AppendJSONNumber(const double d)
+{
+	char buf[32];
+	// d - d is nan for inf and nan :
+	if ( d == d && d - d == 0.0 )
+		fastprintf_shortest(buf,d);
+	else
+		strcpy(buf,"0");
+	Append(buf);
+}
+
+END_CB
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Base.h"
+#include "String.h"
+#include "vector.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+/**
+
+StringBuilder : append-only text in a list of chunks
+
+String += has to copy (COW break) and regrow, so building a big output a piece at a time
+	is quadratic-ish ; StringBuilder never moves what's already been written
+
+chunks start at firstChunkSize and double up to 1 MB
+
+CatPrintf formats straight into the tail chunk (through FastPrintf), no temp String
+
+WriteText hands the chunks to the file as-is (writev on posix), so you don't need
+	to flatten it ; ToString() flattens when you really need one String
+
+NOT thread safe , just like String
+
+**/
+
+START_CB
+
+class File;
+
+class StringBuilder
+{
+public:
+	explicit StringBuilder(int firstChunkSize = 4096);
+	~StringBuilder();
+
+	void Append(const char * const pStr);
+	void Append(const char * const pStr,int len);
+	void Append(const char c);
+	void Append(const String & str) { Append(str.CStr(),str.Length()); }
+	void Append(const StringBuilder & other);
+
+	void operator +=( const char * const pStr ) { Append(pStr); }
+	void operator +=( const String & str ) { Append(str); }
+	void operator +=( const StringBuilder & other ) { Append(other); }
+	void operator +=( const char c ) { Append(c); }
+
+	// removes and returns the last char (0 if empty)
+	char PopBack();
+
+	// CatPrintf() redirects to these :
+	void rawCatPrintf( const char *format, ... );
+	void CatPrintfVA( const char *format, va_list args );
+
+	int  Length() const { return m_length; }
+	bool IsEmpty() const { return m_length == 0; }
+
+	// Clear keeps the first chunk around for reuse
+	void Clear();
+
+	// chunk access for walking the text without flattening :
+	int GetNumChunks() const { return m_chunks.size32(); }
+	const char * GetChunk(int i,int * pLen) const;
+
+	String ToString() const;
+	// "to" must have room for Length()+1
+	void CopyTo(char * to) const;
+
+	// just writes the text, no delimiters (like String::WriteText)
+	//	false (and logs) if a write fails ; on posix it goes around stdio , so ferror won't see it
+	bool WriteText(FILE * fp) const;
+	bool WriteText(File & file) const;
+	// fopen "wb" , WriteText , close ; false (and logs) if any of it fails
+	bool WriteTextFile(const char * fileName) const;
+
+	// JSON bits for the writers that emit it :
+	// quoted and escaped ; control chars as \u00XX
+	void AppendJSONString(const char * str);
+	// shortest round-trip form ; inf/nan (which JSON doesn't have) come out as 0
+	void AppendJSONNumber(const double d);
+
+#define SPI_SAFEDECL void CatPrintf
+#define SPI_CALLRAW rawCatPrintf
+#define SPI_PREARG
+#define SPI_CALLARG fmt
+#define SPI_BADRETURN
+#include "safeprintf.inc"
+#undef SPI_SAFEDECL
+#undef SPI_CALLRAW
+#undef SPI_PREARG
+#undef SPI_CALLARG
+#undef SPI_BADRETURN
+
+private:
+	FORBID_CLASS_STANDARDS(StringBuilder);
+
+	struct Chunk
+	{
+		char *	data;
+		int		len;
+		int		cap;
+	};
+
+	// returns the tail chunk with at least "need" bytes free
+	Chunk & Reserve(int need);
+
+	vector<Chunk>	m_chunks;
+	int				m_length;
+	int				m_nextChunkSize;
+};
+
+END_CB
@@ -0,0 +1,254 @@
+#include "StringIntern.h"
+#include "Log.h"
+#include "Mem.h"
+
+#include <string.h>
+
+START_CB
+
+// chars are carved out of chunks this big ; strings bigger than a chunk get their own alloc
+static const int c_internChunkSize = 256*1024;
+
+//===========================================================================
+
+StringIntern::StringIntern(int initialStrings) :
+	m_count(0),
+	m_chunk(NULL),
+	m_chunkUsed(0),
+	m_chunkSize(0),
+	m_arenaBytes(0)
+{
+	ASSERT_RELEASE( initialStrings > 0 );
+
+	// table is at least 2X the count so probes stay short :
+	uint32 tableSize = 1024;
+	while ( tableSize < (uint32)initialStrings*2 )
+		tableSize *= 2;
+
+	m_table = MakeTable(tableSize);
+
+	for LOOP(i,c_maxEntryChunks)
+		m_entryChunks[i] = NULL;
+}
+
+StringIntern::~StringIntern()
+{
+	// big strings were allocated alone; find them by walking entries
+	//	(they're the ones that are exactly at the start of an allocation)
+	for(uint32 id=1;id<=m_count;id++)
+	{
+		const Entry & e = GetEntry(id);
+		if ( e.len+1 > c_internChunkSize/4 )
+			CBFREE( (void *) e.str );
+	}
+
+	// chunks are linked through their first pointer :
+	char * chunk = m_chunk;
+	while ( chunk )
+	{
+		char * next = *((char **)chunk);
+		CBFREE(chunk);
+		chunk = next;
+	}
+
+	Table * table = m_table;
+	while ( table )
+	{
+		Table * prev = table->prev;
+		CBFREE(table);
+		table = prev;
+	}
+
+	for LOOP(i,c_maxEntryChunks)
+	{
+		if ( m_entryChunks[i] )
+			CBFREE(m_entryChunks[i]);
+	}
+}
+
+/*static*/ StringIntern & StringIntern::Global()
+{
+	static SingletonThreadSafe<StringIntern> s_global = { 0 };
+	return *s_global.Get();
+}
+
+int StringIntern::GetCount() const
+{
+	return (int) LoadAcquire(&m_count);
+}
+
+//===========================================================================
+
+/*static*/ int StringIntern::EntryChunkIndex(uint32 id,uint32 * pOffset)
+{
+	// chunk k starts at c_entryChunk0*(2^k - 1) , so k is the top bit of id/c_entryChunk0 + 1
+	const uint32 v = id/c_entryChunk0 + 1;
+	#ifdef _MSC_VER
+	unsigned long k;
+	_BitScanReverse(&k,v);
+	#else
+	const int k = 31 - __builtin_clz(v);
+	#endif
+	*pOffset = id - c_entryChunk0*((1U<<k) - 1);
+	return (int) k;
+}
+
+/*static*/ StringIntern::Table * StringIntern::MakeTable(uint32 size)
+{
+	const size_t bytes = sizeof(Table) + (size-1)*sizeof(uint32);
+	Table * table = (Table *) CBALLOC(bytes);
+	memset(table,0,bytes);
+	table->mask = size-1;
+	table->prev = NULL;
+	return table;
+}
+
+// call under m_lock ; rehash into a table twice as big , then publish it
+void StringIntern::Grow()
+{
+	Table * old = m_table;
+	Table * table = MakeTable( (old->mask+1)*2 );
+
+	const uint32 count = m_count;
+	for(uint32 id=1;id<=count;id++)
+	{
+		uint32 slot = GetEntry(id).hash & table->mask;
+		while ( table->slots[slot] != c_invalidId )
+			slot = (slot+1) & table->mask;
+		table->slots[slot] = id;
+	}
+
+	// readers that already loaded old keep probing it ; it's complete up to now , so that's fine
+	table->prev = old;
+	StoreReleasePointer(&m_table,table);
+}
+
+char * StringIntern::ArenaAlloc(int size)
+{
+	// big strings get their own alloc so they don't waste the tail of a chunk :
+	if ( size > c_internChunkSize/4 )
+	{
+		m_arenaBytes += size;
+		return (char *) CBALLOC(size);
+	}
+
+	if ( m_chunk == NULL || m_chunkUsed + size > m_chunkSize )
+	{
+		char * chunk = (char *) CBALLOC(c_internChunkSize);
+		*((char **)chunk) = m_chunk;
+		m_chunk = chunk;
+		m_chunkUsed = sizeof(char *);
+		m_chunkSize = c_internChunkSize;
+		m_arenaBytes += c_internChunkSize;
+	}
+
+	char * ret = m_chunk + m_chunkUsed;
+	m_chunkUsed += size;
+	return ret;
+}
+
+// FindOrSlot : returns the id if found
+//	if not, returns c_invalidId and fills *pSlot with the empty slot where it would go
+uint32 StringIntern::FindOrSlot(const Table * table,const char * str,int len,uint32 hash,int * pSlot) const
+{
+	uint32 slot = hash & table->mask;
+
+	for(;;)
+	{
+		// Acquire pairs with the StoreRelease in Intern so the Entry is visible :
+		uint32 id = LoadAcquire(&table->slots[slot]);
+		if ( id == c_invalidId )
+		{
+			if ( pSlot ) *pSlot = (int) slot;
+			return c_invalidId;
+		}
+
+		const Entry & e = GetEntry(id);
+		if ( e.hash == hash && e.len == len && memcmp(e.str,str,len) == 0 )
+			return id;
+
+		// linear probe :
+		slot = (slot+1) & table->mask;
+	}
+}
+
+uint32 StringIntern::Find(const char * str) const
+{
+	return Find(str,(int)strlen(str));
+}
+
+uint32 StringIntern::Find(const char * str,int len) const
+{
+	uint32 hash = FNVHash(str,len);
+	return FindOrSlot(LoadAcquirePointer(&m_table),str,len,hash,NULL);
+}
+
+uint32 StringIntern::Intern(const char * str)
+{
+	return Intern(str,(int)strlen(str));
+}
+
+uint32 StringIntern::Intern(const char * str,int len)
+{
+	uint32 hash = FNVHash(str,len);
+
+	// fast path, no lock :
+	uint32 id = FindOrSlot(LoadAcquirePointer(&m_table),str,len,hash,NULL);
+	if ( id != c_invalidId )
+		return id;
+
+	CB_SCOPE_CRITICAL_SECTION(m_lock);
+
+	// look again under the lock; someone may have added it
+	//	(the table only changes under this lock , so a plain read of m_table is current)
+	int slot = 0;
+	id = FindOrSlot(m_table,str,len,hash,&slot);
+	if ( id != c_invalidId )
+		return id;
+
+	id = m_count+1;
+	ASSERT_RELEASE( id != 0 ); // 4G strings
+
+	// keep the load under 1/2 ; the slot moves with the rehash
+	if ( id > (m_table->mask+1)/2 )
+	{
+		Grow();
+		FindOrSlot(m_table,str,len,hash,&slot);
+	}
+
+	uint32 offset;
+	const int chunk = EntryChunkIndex(id,&offset);
+	if ( m_entryChunks[chunk] == NULL )
+	{
+		// published by the StoreRelease of the slot below , like the Entry
+		const uint32 chunkCount = c_entryChunk0 << chunk;
+		Entry * entries = CBALLOCARRAY(Entry,chunkCount);
+		memset(entries,0,chunkCount*sizeof(Entry));
+		m_entryChunks[chunk] = entries;
+	}
+
+	char * copy = ArenaAlloc(len+1);
+	memcpy(copy,str,len);
+	copy[len] = 0;
+
+	Entry & e = m_entryChunks[chunk][offset];
+	e.str = copy;
+	e.len = len;
+	e.hash = hash;
+	e.tokenHash = TokenHash(copy);
+
+	// publish : entry first, then the count and the slot
+	StoreRelease(&m_count,id);
+	StoreRelease(&m_table->slots[slot],id);
+
+	return id;
+}
+
+void StringIntern::LogStats() const
+{
+	int count = GetCount();
+	lprintf("StringIntern : %d strings, %d arena bytes, table %d/%d\n",
+		count,(int)m_arenaBytes,count,(int)(m_table->mask+1));
+}
+
+END_CB
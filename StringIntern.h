@@ -0,0 +1,188 @@
+#pragma once
+
+#include "Base.h"
+#include "Util.h"
+#include "Hashes.h"
+#include "hash_function.h"
+#include "token.h"
+#include "Threading.h"
+
+/**
+
+StringIntern : table of unique strings
+
+each distinct string is stored exactly once in an append-only arena
+and given a stable 32-bit id.  The id and the const char * are valid for the
+life of the StringIntern; nothing is ever removed.
+
+use InternedString instead of String when you have lots of repeats (paths, identifiers) :
+	equality is a single int compare and copies are free.
+
+Find() and GetString() are lock-free and can be called from any thread at any time.
+Intern() takes a lock only when the string is not already in the table.
+
+the table grows without bothering readers :
+	entries live in chunks that double in size and never move , so an id -> Entry stays valid
+	the hash table is rehashed into a new one 2X bigger under the lock , then published ;
+	old tables are kept (readers might still be probing them) and freed with the StringIntern ,
+	which costs at most as much again as the current table
+initialStrings just sizes the first table
+
+StringIntern is case SENSITIVE (unlike Token)
+	but it stores the TokenHash for each string so converting to a Token is free
+
+**/
+
+START_CB
+
+class StringIntern
+{
+public:
+
+	enum { c_invalidId = 0 };
+
+	explicit StringIntern(int initialStrings = 4096);
+	~StringIntern();
+
+	// Intern : find or add ; returns the id, never c_invalidId
+	uint32 Intern(const char * str);
+	uint32 Intern(const char * str,int len);
+
+	// Find : returns c_invalidId if not in the table
+	uint32 Find(const char * str) const;
+	uint32 Find(const char * str,int len) const;
+
+	// id -> string data :
+	const char * GetString(uint32 id) const	{ return GetEntry(id).str; }
+	int GetLength(uint32 id) const			{ return GetEntry(id).len; }
+	uint32 GetHash(uint32 id) const			{ return GetEntry(id).hash; }
+	Token GetToken(uint32 id) const			{ return Token( GetEntry(id).tokenHash ); }
+
+	int GetCount() const;
+
+	// memory used by string chars (not counting the tables) :
+	int64 GetArenaBytes() const { return m_arenaBytes; }
+
+	void LogStats() const;
+
+	// process-wide table used by InternedString :
+	static StringIntern & Global();
+
+private:
+	FORBID_CLASS_STANDARDS(StringIntern);
+
+	struct Entry
+	{
+		const char *	str;
+		int				len;
+		uint32			hash;
+		uint32			tokenHash;
+	};
+
+	// entry chunk k holds ids [c_entryChunk0*(2^k - 1) , c_entryChunk0*(2^(k+1) - 1))
+	enum { c_entryChunk0 = 1024, c_maxEntryChunks = 22 };
+
+	struct Table
+	{
+		uint32			mask;
+		Table *			prev;		// retired tables , freed in the destructor
+		uint32 volatile	slots[1];	// [mask+1] ; slot -> id , 0 = empty
+	};
+
+	static int EntryChunkIndex(uint32 id,uint32 * pOffset);
+
+	const Entry & GetEntry(uint32 id) const
+	{
+		ASSERT( id > 0 && id <= (uint32)GetCount() );
+		uint32 offset;
+		const int chunk = EntryChunkIndex(id,&offset);
+		return m_entryChunks[chunk][offset];
+	}
+
+	static Table * MakeTable(uint32 size);
+	uint32 FindOrSlot(const Table * table,const char * str,int len,uint32 hash,int * pSlot) const;
+	void Grow();
+	char * ArenaAlloc(int size);
+
+	Table * volatile	m_table;
+	Entry * volatile	m_entryChunks[c_maxEntryChunks];	// m_entryChunks[0][0] is unused (id 0)
+	uint32 volatile		m_count;	// last id handed out
+
+	// arena for the chars; only touched under m_lock :
+	CriticalSection		m_lock;
+	char *				m_chunk;
+	int					m_chunkUsed;
+	int					m_chunkSize;
+	int64				m_arenaBytes;
+};
+
+//===========================================================================
+
+/**
+
+InternedString : a 32-bit handle into StringIntern::Global()
+
+**/
+
+class InternedString
+{
+public:
+	InternedString() : m_id(StringIntern::c_invalidId) { }
+	explicit InternedString(const char * str) : m_id( StringIntern::Global().Intern(str) ) { }
+	explicit InternedString(const char * str,int len) : m_id( StringIntern::Global().Intern(str,len) ) { }
+
+	static InternedString FromId(uint32 id) { InternedString ret; ret.m_id = id; return ret; }
+
+	uint32 GetId() const { return m_id; }
+	bool IsValid() const { return m_id != StringIntern::c_invalidId; }
+
+	const char * CStr() const	{ return IsValid() ? StringIntern::Global().GetString(m_id) : ""; }
+	int Length() const			{ return IsValid() ? StringIntern::Global().GetLength(m_id) : 0; }
+	Token GetToken() const		{ return IsValid() ? StringIntern::Global().GetToken(m_id) : Token::Empty(); }
+
+	bool operator == (const InternedString & rhs) const { return m_id == rhs.m_id; }
+	// operator < is by id, NOT alphabetical :
+	bool operator <  (const InternedString & rhs) const { return m_id < rhs.m_id; }
+
+	MAKE_COMPARISONS_FROM_LESS_AND_EQUALS(InternedString)
+
+private:
+	uint32 m_id;
+};
+
+//===========================================================================
+// hash_table support :
+
+template <>
+inline hash_type hash_function<InternedString>(const InternedString & s)
+{
+	// ids are sequential so they need scrambling :
+	return Hash32( s.GetId() );
+}
+
+struct hash_table_ops_InternedString : public hash_table_key_equal<InternedString>
+{
+	// reserve id 0 (c_invalidId) for empty and ~0 for deleted :
+
+	void make_empty(hash_type & hash,InternedString & key)
+	{
+		key = InternedString::FromId(StringIntern::c_invalidId);
+	}
+
+	bool is_empty(const hash_type & hash,const InternedString & key)
+	{
+		return key.GetId() == StringIntern::c_invalidId;
+	}
+
+	void make_deleted(hash_type & hash,InternedString & key)
+	{
+		key = InternedString::FromId(0xFFFFFFFFUL);
+	}
+
+	bool is_deleted(const hash_type & hash,const InternedString & key)
+	{
+		return key.GetId() == 0xFFFFFFFFUL;
+	}
+};
+
+END_CB
@@ -1,6 +1,11 @@
 #include "ThreadLog.h"
+#include "FastPrintf.h"
+#include "Threading.h"
+#include "Timer.h"
 #include "vector.h"
 #include "Win32Util.h"
+#include "Mem.h"
+#include <string.h>
 
 START_CB
 
@@ -10,37 +15,79 @@ START_CB
 
 // thread log :
 
-Uses a vector, which we reserve on the main thread, which could grow from the worker thread
-Once the vector grows doesn't allocate, but does grab mutexes
+Each thread gets its own SPSC byte ring the first time it logs.
+The owning thread is the only producer , ThreadLogFlush is the only consumer.
 
-An alternative implementation could be done using nodes that are push/poped with the non-locking linked list method
-But that requires allocating the nodes somehow
-And can get out of order, which is bad
+Records are variable length :
+
+	[ uint32 len ][ uint32 pad ][ uint64 tsc ][ text + null , padded to 8 ]
+
+The text is formatted straight into the ring, so nothing is truncated and nothing is copied.
+If a record doesn't fit before the end of the ring, a wrap marker is left and it goes at the start.
+If it doesn't fit at all, it's dropped and counted ; ThreadLog never waits on the flusher.
+
+Flush takes the oldest record across all rings each step, so the output is in tsc order.
+
+Rings are registered under s_threadLogMutex (once per thread) and live until ThreadLogClose.
 
 **/
 
-// CB : this ThreadLogMessage is kind of stupid; I should just have a single vector<char> and push
-//  strings on to that, and then the flush can just grab strings by searching for the nulls
-struct ThreadLogMessage
+struct ThreadLogRecordHeader
 {
-    char buf[128];
+	uint32	len;	// text bytes including the null ; c_threadLogWrap means skip to the start
+	uint32	pad;
+	uint64	tsc;
 };
-CriticalSection * s_threadLogMutex = NULL;
-vector<ThreadLogMessage> s_threadLogQueue; // @TODO: replace this with a linked list so we don't depend on templates/
-bool s_threadLogInit = false;
 
-// s_unflushedCount is an optimization to make Flush a fast NOP when the queue is empty
-//volatile uint32 s_unflushedCount = 0;
+COMPILER_ASSERT( sizeof(ThreadLogRecordHeader) == 16 );
 
-void ThreadLogOpen()
+static const uint32 c_threadLogWrap = 0xFFFFFFFF;
+static const uint32 c_threadLogHeader = sizeof(ThreadLogRecordHeader);
+
+static inline uint32 ThreadLogAlign(uint32 x) { return (x + 7) & ~7U; }
+
+struct ThreadLogRing
+{
+	// producer side :
+	uint32 volatile	head;	// bytes written , monotonic (wraps at 2^32 , fine since size is pow2)
+	uint32 volatile	dropped;
+	char			pad0[LF_CACHE_LINE_SIZE - 8];
+
+	// consumer side :
+	uint32 volatile	tail;	// bytes consumed
+	uint32			droppedReported;
+	char			pad1[LF_CACHE_LINE_SIZE - 8];
+
+	char *			data;
+	uint32			size;
+	int				threadIndex;
+	ThreadLogRing *	next;
+};
+
+static CriticalSection * s_threadLogMutex = NULL;
+static ThreadLogRing * s_threadLogRings = NULL;
+static uint32 s_threadLogRingSize = 0;
+static bool s_threadLogInit = false;
+
+// the generation lets threads notice their ring is from a previous Open :
+static uint32 s_threadLogGeneration = 0;
+static CB_THREAD_LOCAL ThreadLogRing * s_myRing = NULL;
+static CB_THREAD_LOCAL uint32 s_myRingGeneration = 0;
+
+void ThreadLogOpen(int ringBytesPerThread)
 {
     if ( s_threadLogMutex )
         return;
-        
+
+    uint32 size = 1024;
+    while ( size < (uint32)ringBytesPerThread )
+		size *= 2;
+
     s_threadLogMutex = new CriticalSection();
-    s_threadLogQueue.reserve(128); // make it unlikely that we alloc
+    s_threadLogRings = NULL;
+    s_threadLogRingSize = size;
+    s_threadLogGeneration++;
     s_threadLogInit = true;
-    //s_unflushedCount = 0;
 }
 
 void ThreadLogClose()
@@ -49,34 +96,127 @@ void ThreadLogClose()
     {
         s_threadLogMutex->Lock();
         s_threadLogInit = false;
-        //s_unflushedCount = 0;
-        s_threadLogQueue.release();
+
+        ThreadLogRing * ring = s_threadLogRings;
+        while ( ring )
+        {
+			ThreadLogRing * next = ring->next;
+			CBFREE(ring->data);
+			CBFREE(ring);
+			ring = next;
+        }
+        s_threadLogRings = NULL;
+
         s_threadLogMutex->Unlock();
-        
+
         delete s_threadLogMutex;
         s_threadLogMutex = NULL;
     }
 }
 
+static ThreadLogRing * ThreadLogGetMyRing()
+{
+	if ( s_myRing != NULL && s_myRingGeneration == s_threadLogGeneration )
+		return s_myRing;
+
+	ThreadLogRing * ring = (ThreadLogRing *) CBALLOC(sizeof(ThreadLogRing));
+	memset(ring,0,sizeof(ThreadLogRing));
+	ring->size = s_threadLogRingSize;
+	ring->data = (char *) CBALLOC(ring->size);
+	ring->threadIndex = GetThreadIndex();
+
+	{
+		CB_SCOPE_CRITICAL_SECTION(*s_threadLogMutex);
+		ring->next = s_threadLogRings;
+		s_threadLogRings = ring;
+	}
+
+	s_myRing = ring;
+	s_myRingGeneration = s_threadLogGeneration;
+	return ring;
+}
+
 // called from thread to add logs :
 void ThreadLog(const char * fmt,...)
 {
     if ( ! s_threadLogInit )
         return;
-    
-    CB_SCOPE_CRITICAL_SECTION(*s_threadLogMutex);
 
-    //LockedAddXchg(&s_unflushedCount, 1);
+    uint64 tsc = Timer::rdtsc();
 
-    s_threadLogQueue.push_back();
+    ThreadLogRing * ring = ThreadLogGetMyRing();
 
-    char * ptr = s_threadLogQueue.back().buf;
-    int size = MEMBER_SIZE(ThreadLogMessage, buf);
+    uint32 head = ring->head; // we're the only writer
+    uint32 tail = LoadAcquire(&ring->tail);
+    uint32 freeBytes = ring->size - (head - tail);
+    uint32 pos = head & (ring->size-1);
+    uint32 toEnd = ring->size - pos;
+    uint32 room = MIN(freeBytes,toEnd);
 
     va_list arg;
     va_start(arg,fmt);
-    _vsnprintf(ptr,size-1,fmt,arg);
-    ptr[size-1] = 0;
+
+    // try to format in place :
+    //	(always on a copy ; arg may be needed again for the wrapped attempt)
+    int len;
+    va_list argCopy;
+    va_copy(argCopy,arg);
+    if ( room > c_threadLogHeader )
+		len = fastvsnprintf(ring->data + pos + c_threadLogHeader,room - c_threadLogHeader,fmt,argCopy);
+    else
+		len = fastvsnprintf(NULL,0,fmt,argCopy);
+    va_end(argCopy);
+
+    if ( (uint32)len + 1 > room - MIN(room,c_threadLogHeader) )
+    {
+		// doesn't fit before the end ; wrap to the start if there's room there
+		uint32 recBytes = ThreadLogAlign( c_threadLogHeader + len + 1 );
+		if ( freeBytes < toEnd + recBytes )
+		{
+			va_end(arg);
+			StoreRelease(&ring->dropped, ring->dropped + 1);
+			return;
+		}
+
+		// toEnd is a multiple of 8 so the marker always fits :
+		((ThreadLogRecordHeader *)(ring->data + pos))->len = c_threadLogWrap;
+		head += toEnd;
+		pos = 0;
+
+		fastvsnprintf(ring->data + c_threadLogHeader,len+1,fmt,arg);
+    }
+    va_end(arg);
+
+    ThreadLogRecordHeader * header = (ThreadLogRecordHeader *)(ring->data + pos);
+    header->len = len+1;
+    header->pad = 0;
+    header->tsc = tsc;
+
+    // publish ; Release pairs with the Acquire of head in Flush
+    StoreRelease(&ring->head, head + ThreadLogAlign( c_threadLogHeader + len + 1 ));
+}
+
+//=======================================================================
+
+struct ThreadLogCursor
+{
+	ThreadLogRing *	ring;
+	uint32			pos;	// == ring->tail , local copy
+	uint32			limit;	// head snapshot
+};
+
+// skips wrap markers ; returns the next record or NULL if this ring is done
+static const ThreadLogRecordHeader * ThreadLogPeek(ThreadLogCursor & c)
+{
+	while ( c.pos != c.limit )
+	{
+		uint32 at = c.pos & (c.ring->size-1);
+		const ThreadLogRecordHeader * h = (const ThreadLogRecordHeader *)(c.ring->data + at);
+		if ( h->len != c_threadLogWrap )
+			return h;
+		c.pos += c.ring->size - at;
+	}
+	return NULL;
 }
 
 // called from main thread to flush out logs :
@@ -85,27 +225,73 @@ void ThreadLogFlush()
 {
     if ( ! s_threadLogInit )
         return;
-    
-    // I want this to be a light NOP in the case of an empty queue
-    
-    // hmm just to test for zero
-    //   I don't have to do anything interlocked, eh?
-    //if ( s_unflushedCount == 0 )
-    //  return; 
-
-	/*
-    if ( LockedCmpXchg(&s_unflushedCount,0,0) == 0)
-        return;
-    */
-    
+
+    // the lock is only against other flushers and new rings registering ;
+    //	ThreadLog() itself never takes it
     CB_SCOPE_CRITICAL_SECTION(*s_threadLogMutex);
-    
-    for(int i=0;i<s_threadLogQueue.size32();i++)
+
+    vector<ThreadLogCursor> cursors;
+    for(ThreadLogRing * ring = s_threadLogRings; ring; ring = ring->next)
     {
-        lprintf( s_threadLogQueue[i].buf );
-    }   
-    s_threadLogQueue.clear();
-    //s_unflushedCount = 0;
+		ThreadLogCursor c;
+		c.ring = ring;
+		c.pos = ring->tail;
+		c.limit = LoadAcquire(&ring->head);
+		if ( c.pos != c.limit )
+			cursors.push_back(c);
+
+		uint32 dropped = LoadAcquire(&ring->dropped);
+		if ( dropped != ring->droppedReported )
+		{
+			lprintf("ThreadLog : thread %d dropped %d messages (ring full)\n",
+				ring->threadIndex,(int)(dropped - ring->droppedReported));
+			ring->droppedReported = dropped;
+		}
+    }
+
+    // merge by tsc :
+    for(;;)
+    {
+		int best = -1;
+		const ThreadLogRecordHeader * bestH = NULL;
+		for LOOPVEC(i,cursors)
+		{
+			const ThreadLogRecordHeader * h = ThreadLogPeek(cursors[i]);
+			if ( h && ( bestH == NULL || h->tsc < bestH->tsc ) )
+			{
+				best = i;
+				bestH = h;
+			}
+		}
+		if ( best < 0 )
+			break;
+
+		ThreadLogCursor & c = cursors[best];
+		lprintf("%s",(const char *)(bestH + 1));
+
+		c.pos += ThreadLogAlign( c_threadLogHeader + bestH->len );
+		// give the space back right away :
+		StoreRelease(&c.ring->tail, c.pos);
+    }
+
+    // wrap markers at the very end are consumed too :
+    for LOOPVEC(i,cursors)
+    {
+		StoreRelease(&cursors[i].ring->tail, cursors[i].pos);
+    }
+}
+
+int ThreadLogGetDroppedCount()
+{
+	if ( ! s_threadLogInit )
+		return 0;
+
+	CB_SCOPE_CRITICAL_SECTION(*s_threadLogMutex);
+
+	int count = 0;
+	for(ThreadLogRing * ring = s_threadLogRings; ring; ring = ring->next)
+		count += (int) LoadAcquire(&ring->dropped);
+	return count;
 }
 
 //=======================================================================
@@ -6,16 +6,25 @@ START_CB
 
 //---------------------------------------------------
 // thread log :
+//	each thread logs into its own ring, no locks on the logging side
+//	ThreadLogFlush merges all the rings in timestamp order
 
-void ThreadLogOpen();
+// ringBytesPerThread is rounded up to a power of 2
+void ThreadLogOpen(int ringBytesPerThread = 64*1024);
+// call Close only once the workers are done logging
 void ThreadLogClose();
 
 // called from thread to add logs :
 //  ThreadLog is just a raw printf, it doesn't get all the fancy junk printf gets
+//	if the thread's ring is full the message is dropped and counted (never blocks)
 void ThreadLog(const char * fmt,...);
 
 // called from main thread to flush out logs :
 //  they go out via printf with whatever cuent settings are
+//	and a line for any thread that dropped messages since the last flush
 void ThreadLogFlush();
 
+// total dropped since Open
+int ThreadLogGetDroppedCount();
+
 END_CB
@@ -1,4 +1,7 @@
 #include "Threading.h"
+
+#ifdef _WIN32
+
 #include <mmsystem.h>
 #include <intrin.h>
 
@@ -535,3 +538,80 @@ Atomic128 AtomicExchange128(Atomic128 volatile * pInto,Atomic128 newVal)
 //=====================================================================	
 
 END_CB
+
+#endif // _WIN32
+
+#ifndef _WIN32
+#include <errno.h>
+#endif
+
+START_CB
+
+//=====================================================================
+// ThreadSem / Thread_Start
+
+#ifdef _WIN32
+
+void ThreadSem_Init(ThreadSem * pSem,int count,int max)
+{
+	*pSem = CreateSemaphore(NULL,count,max,NULL);
+}
+void ThreadSem_Wait(ThreadSem * pSem)
+{
+	WaitForSingleObject(*pSem,INFINITE);
+}
+void ThreadSem_Post(ThreadSem * pSem)
+{
+	ReleaseSemaphore(*pSem,1,NULL);
+}
+void ThreadSem_Destroy(ThreadSem * pSem)
+{
+	CloseHandle(*pSem);
+}
+
+bool Thread_Start(ThreadHandle * pThread,ThreadRoutine routine,void * param)
+{
+	*pThread = CreateThread(NULL,0,routine,param,0,NULL);
+	return *pThread != NULL;
+}
+
+void Thread_Join(ThreadHandle thread)
+{
+	WaitForSingleObject(thread,INFINITE);
+	CloseHandle(thread);
+}
+
+#else
+
+void ThreadSem_Init(ThreadSem * pSem,int count,int max)
+{
+	sem_init(pSem,0,count);
+}
+void ThreadSem_Wait(ThreadSem * pSem)
+{
+	while ( sem_wait(pSem) != 0 && errno == EINTR )
+	{
+	}
+}
+void ThreadSem_Post(ThreadSem * pSem)
+{
+	sem_post(pSem);
+}
+void ThreadSem_Destroy(ThreadSem * pSem)
+{
+	sem_destroy(pSem);
+}
+
+bool Thread_Start(ThreadHandle * pThread,ThreadRoutine routine,void * param)
+{
+	return pthread_create(pThread,NULL,routine,param) == 0;
+}
+
+void Thread_Join(ThreadHandle thread)
+{
+	pthread_join(thread,NULL);
+}
+
+#endif
+
+END_CB
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Base.h"
+
+#ifdef _WIN32
+
 #include "Win32Util.h"
 
 #define WIN32_LEAN_AND_MEAN
@@ -1134,4 +1137,51 @@ END_CB
 //c:\devel\projects\oodle\Core\LFSList.h(41) : warning C4324: 'cb::LFSNode' : structure was padded due to __declspec(align())
 
 #endif
-//=======================================================================
\ No newline at end of file
+//=======================================================================
+
+#endif // _WIN32
+
+//=======================================================================
+// ThreadSem / Thread_Start : the one part of this header that also builds off Windows ,
+//	for the simple background workers (Journal , FileReadAhead , LZCodec)
+//
+//	write the routine as :
+//	static CB_THREAD_ROUTINE(MyRoutine) { ... use param ... CB_THREAD_RETURN; }
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+START_CB
+
+#ifdef _WIN32
+
+	typedef HANDLE					ThreadSem;
+	typedef HANDLE					ThreadHandle;
+	typedef LPTHREAD_START_ROUTINE	ThreadRoutine;
+
+	#define CB_THREAD_ROUTINE(name)	DWORD WINAPI name(LPVOID param)
+	#define CB_THREAD_RETURN		return 0
+
+#else
+
+	typedef sem_t					ThreadSem;
+	typedef pthread_t				ThreadHandle;
+	typedef void * (*ThreadRoutine)(void *);
+
+	#define CB_THREAD_ROUTINE(name)	void * name(void * param)
+	#define CB_THREAD_RETURN		return NULL
+
+#endif
+
+	void ThreadSem_Init(ThreadSem * pSem,int count,int max);
+	void ThreadSem_Wait(ThreadSem * pSem);	// retries on EINTR
+	void ThreadSem_Post(ThreadSem * pSem);
+	void ThreadSem_Destroy(ThreadSem * pSem);
+
+	// returns false if the thread couldn't be made ; Thread_Join closes the handle
+	bool Thread_Start(ThreadHandle * pThread,ThreadRoutine routine,void * param);
+	void Thread_Join(ThreadHandle thread);
+
+END_CB
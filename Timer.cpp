@@ -2,8 +2,19 @@
 #include "Log.h"
 #include "FloatUtil.h"
 //#include "Util.h"
+#ifdef _WIN32
 //#define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <intrin.h>
+#include <emmintrin.h>
+#else
+#include <time.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+#endif
 #include <math.h>
 #include "stl_basics.h"
 #include <algorithm>
@@ -29,6 +40,62 @@ namespace Timer
 	void ComputeMHZ();
 };
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__x86_64__) || defined(__i386__)
+#define CB_TIMER_X86
+#endif
+
+//---------------------------------------------------------------
+// cpuid feature checks ; done once , racing threads just do it twice
+
+static int s_tscFeatures = -1;
+
+#define TSC_FEATURE_INVARIANT	(1)
+#define TSC_FEATURE_RDTSCP		(2)
+
+static void TimerCpuid(uint32 leaf,uint32 regs[4])
+{
+	#ifdef _MSC_VER
+	__cpuid((int *)regs,(int)leaf);
+	#elif defined(CB_TIMER_X86)
+	__cpuid(leaf,regs[0],regs[1],regs[2],regs[3]);
+	#else
+	regs[0] = regs[1] = regs[2] = regs[3] = 0;
+	#endif
+}
+
+static int GetTSCFeatures()
+{
+	if ( s_tscFeatures < 0 )
+	{
+		int features = 0;
+		#ifdef CB_TIMER_X86
+		uint32 regs[4];
+		TimerCpuid(0x80000000,regs);
+		uint32 maxExtended = regs[0];
+		if ( maxExtended >= 0x80000001 )
+		{
+			TimerCpuid(0x80000001,regs);
+			if ( regs[3] & (1<<27) )
+				features |= TSC_FEATURE_RDTSCP;
+		}
+		if ( maxExtended >= 0x80000007 )
+		{
+			// "invariant TSC" : constant rate through P-, C- and T-states
+			TimerCpuid(0x80000007,regs);
+			if ( regs[3] & (1<<8) )
+				features |= TSC_FEATURE_INVARIANT;
+		}
+		#endif
+		s_tscFeatures = features;
+	}
+	return s_tscFeatures;
+}
+
+bool Timer::HasInvariantTSC()
+{
+	return ( GetTSCFeatures() & TSC_FEATURE_INVARIANT ) != 0;
+}
+
 //---------------------------------------------------------------
 
 void Timer::GetSample(Sample * ptr)
@@ -189,6 +256,8 @@ double Timer::GetSeconds()
 	return s_GetSeconds_lastSeconds;
 }
 		
+#ifdef _WIN32
+
 //---------------------------------------------------------------
 //	GetMillis uses the windows GetTickCount
 //	it's reliable, but only measures millisecond accuracy
@@ -229,6 +298,8 @@ uint64 Timer::RawQPC()
 	return qpc;
 }
 
+#endif // _WIN32
+
 uint64 Timer::QPC()
 {
 	static uint64 s_first = RawQPC();
@@ -236,6 +307,8 @@ uint64 Timer::QPC()
 	return (cur - s_first);
 }
 
+#ifdef _WIN32
+
 double Timer::GetSecondsPerQPC()
 {
 	if ( s_qpf == 0 )
@@ -247,6 +320,8 @@ double Timer::GetSecondsPerQPC()
 	return s_secondsPerQPC;
 }
 
+#endif // _WIN32
+
 double Timer::GetQPCSeconds()
 {
 	uint64 qpc = QPC();
@@ -259,6 +334,8 @@ double Timer::GetQPCSeconds()
 //	it's fast and always reliable when measured in clocks
 //	the tsc conversion to seconds does weird things on laptops with speedstep
 
+#ifdef _WIN32
+
 Timer::tsc_type	Timer::rdtsc()
 {
 	#ifdef CB_64
@@ -268,6 +345,37 @@ Timer::tsc_type	Timer::rdtsc()
 	// eax/edx returned
 	#endif
 }
+
+Timer::tsc_type	Timer::rdtscp(uint32 * pAux)
+{
+	if ( GetTSCFeatures() & TSC_FEATURE_RDTSCP )
+	{
+		unsigned int aux;
+		tsc_type tsc = __rdtscp(&aux);
+		if ( pAux ) *pAux = aux;
+		return tsc;
+	}
+	if ( pAux ) *pAux = 0;
+	_mm_lfence();
+	return __rdtsc();
+}
+
+Timer::tsc_type	Timer::rdtscSerializedBegin()
+{
+	_mm_lfence();
+	tsc_type tsc = __rdtsc();
+	_mm_lfence();
+	return tsc;
+}
+
+Timer::tsc_type	Timer::rdtscSerializedEnd()
+{
+	tsc_type tsc = rdtscp();
+	_mm_lfence();
+	return tsc;
+}
+
+#endif // _WIN32
 	
 int	Timer::GetMHZ()
 {
@@ -300,6 +408,8 @@ double Timer::rdtscSeconds()
 	return double(ticks) * GetSecondsPerTick();
 }
 
+#ifdef _WIN32
+
 #define TSC_PATH	"HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0"
 #define TSC_FILE	 "~MHz"
 
@@ -435,12 +545,180 @@ void Timer::ComputeMHZ()
 	//printf("@@ComputeMHZ}\n");
 }	
 
+#else // _WIN32
+
+//===============================================================
+// posix
+//
+// QPC and GetMillis are CLOCK_MONOTONIC (vdso , ~20 ns , never jumps)
+//
+// rdtsc is the hardware TSC when cpuid says it's invariant , calibrated against
+//	CLOCK_MONOTONIC_RAW (not slewed by ntp) ; otherwise (old cpus , VMs that hide the bit ,
+//	non-x86) every rdtsc flavor reads CLOCK_MONOTONIC_RAW in nanos , so a "tick" is a nano
+//	either way GetSecondsPerTick converts correctly
+
+static uint64 MonotonicNanos(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock,&ts);
+	return (uint64)ts.tv_sec * 1000000000ULL + (uint64)ts.tv_nsec;
+}
+
+static inline bool TimerUseTSC()
+{
+	return ( GetTSCFeatures() & TSC_FEATURE_INVARIANT ) != 0;
+}
+
+uint32 Timer::GetMillis32()
+{
+	return (uint32) GetMillis64();
+}
+
+uint64 Timer::GetMillis64()
+{
+	return MonotonicNanos(CLOCK_MONOTONIC) / 1000000ULL;
+}
+
+uint64 Timer::RawQPC()
+{
+	return MonotonicNanos(CLOCK_MONOTONIC);
+}
+
+double Timer::GetSecondsPerQPC()
+{
+	if ( s_qpf == 0 )
+	{
+		s_qpf = 1000000000ULL;
+		s_secondsPerQPC = 1.0 / double(s_qpf);
+	}
+	
+	return s_secondsPerQPC;
+}
+
+Timer::tsc_type	Timer::rdtsc()
+{
+	#ifdef CB_TIMER_X86
+	if ( TimerUseTSC() )
+		return __rdtsc();
+	#endif
+	return MonotonicNanos(CLOCK_MONOTONIC_RAW);
+}
+
+Timer::tsc_type	Timer::rdtscp(uint32 * pAux)
+{
+	if ( pAux ) *pAux = 0;
+	#ifdef CB_TIMER_X86
+	if ( TimerUseTSC() )
+	{
+		if ( GetTSCFeatures() & TSC_FEATURE_RDTSCP )
+		{
+			unsigned int aux;
+			tsc_type tsc = __rdtscp(&aux);
+			if ( pAux ) *pAux = aux;
+			return tsc;
+		}
+		_mm_lfence();
+		return __rdtsc();
+	}
+	#endif
+	return MonotonicNanos(CLOCK_MONOTONIC_RAW);
+}
+
+Timer::tsc_type	Timer::rdtscSerializedBegin()
+{
+	#ifdef CB_TIMER_X86
+	if ( TimerUseTSC() )
+	{
+		_mm_lfence();
+		tsc_type tsc = __rdtsc();
+		_mm_lfence();
+		return tsc;
+	}
+	#endif
+	return MonotonicNanos(CLOCK_MONOTONIC_RAW);
+}
+
+Timer::tsc_type	Timer::rdtscSerializedEnd()
+{
+	#ifdef CB_TIMER_X86
+	if ( TimerUseTSC() )
+	{
+		tsc_type tsc = rdtscp();
+		_mm_lfence();
+		return tsc;
+	}
+	#endif
+	return MonotonicNanos(CLOCK_MONOTONIC_RAW);
+}
+
+#ifdef CB_TIMER_X86
+
+// a (tsc,nanos) pair taken as close together as we can manage :
+//	the clock read is bracketed by two tsc reads ; keep the tightest of a few tries
+static void ReadTSCAndClock(uint64 * pTSC,uint64 * pNanos)
+{
+	uint64 best = (uint64)-1;
+	for(int tries=0;tries<8;tries++)
+	{
+		uint64 tsc1 = __rdtsc();
+		uint64 nanos = MonotonicNanos(CLOCK_MONOTONIC_RAW);
+		uint64 tsc2 = __rdtsc();
+		if ( tsc2 - tsc1 < best )
+		{
+			best = tsc2 - tsc1;
+			*pTSC = tsc1 + (tsc2 - tsc1)/2;
+			*pNanos = nanos;
+		}
+	}
+}
+
+#endif
+
+void Timer::ComputeMHZ()
+{
+	GetSecondsPerQPC();
+
+	double hz = 1000000000.0;
+
+	#ifdef CB_TIMER_X86
+	if ( TimerUseTSC() )
+	{
+		// five 10 millisecond windows , take the median
+		//	sleeping is fine since the tsc doesn't care about P-states
+		double rates[5];
+		for(int tries=0;tries<5;tries++)
+		{
+			uint64 tsc1,nanos1,tsc2,nanos2;
+			ReadTSCAndClock(&tsc1,&nanos1);
+			
+			struct timespec ts = { 0, 10*1000*1000 };
+			nanosleep(&ts,NULL);
+			
+			ReadTSCAndClock(&tsc2,&nanos2);
+			rates[tries] = double(tsc2 - tsc1) * 1000000000.0 / double(nanos2 - nanos1);
+		}
+		std::sort(rates,rates+5);
+		hz = rates[2];
+	}
+	#endif
+
+	s_mhz = froundint( (float) (hz/1000000.0) );
+	// keep the full calibrated rate , not rounded to the MHz :
+	s_secondsPerTick = 1.0 / hz;
+}
+
+#endif // _WIN32
+
 void Timer::LogInfo() // call at startup if you like
 {
 	// @@ should log SpeedStep info also
 	GetSeconds();
 	GetMHZ();
 	lprintf("Timer : TSC MHZ=%d , QPC MHZ = %.3f\n",s_mhz,(double)s_qpf/1000000.0);	
+	#ifndef _WIN32
+	if ( ! HasInvariantTSC() )
+		lprintf("Timer : no invariant TSC ; rdtsc is CLOCK_MONOTONIC_RAW nanos\n");
+	#endif
 }
 
 TimeScopeLog::~TimeScopeLog()
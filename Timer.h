@@ -68,7 +68,7 @@ namespace Timer
 	}
 	
 	//---------------------------------------------------------------
-	//	GetMillis uses the windows GetTickCount
+	//	GetMillis uses the windows GetTickCount (CLOCK_MONOTONIC on posix)
 	//	it's reliable, but only measures millisecond accuracy
 	//	millis wraps 32 bits ever 49 days
 	
@@ -79,9 +79,24 @@ namespace Timer
 	// tsc counts the number of clocks passed
 	//	it's fast and always reliable when measured in clocks
 	//	the tsc conversion to seconds does weird things on laptops with speedstep
+	//	(unless it's invariant ; all recent x86 are)
+	//
+	//	on posix the tsc is calibrated against CLOCK_MONOTONIC_RAW ; with no invariant tsc
+	//	all the rdtsc calls read CLOCK_MONOTONIC_RAW in nanos instead , and QPC is CLOCK_MONOTONIC
 		
 	tsc_type	rdtsc();
 	
+	// rdtscp waits for prior instructions to finish ; *pAux gets TSC_AUX (the cpu number)
+	tsc_type	rdtscp(uint32 * pAux = NULL);
+	
+	// for timing short runs of code :
+	//	Begin fences so nothing before it is still in flight and nothing after starts early
+	//	End waits for the timed code to finish and fences so nothing after runs ahead
+	tsc_type	rdtscSerializedBegin();
+	tsc_type	rdtscSerializedEnd();
+	
+	bool		HasInvariantTSC(); // constant rate through speedstep & sleep states
+	
 	uint64		RawQPC();
 	uint64		QPC(); // QPC starts at 0 so you don't have to worry about wraps
 	
@@ -0,0 +1,270 @@
+#include "../Benchmark.h"
+#include "../Log.h"
+#include "../vector.h"
+#include "../hash_table.h"
+#include "../StringIntern.h"
+#include "../LZCodec.h"
+#include "../crc.h"
+#include "../FastPrintf.h"
+#include "../Rand.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+/**
+
+the registered benchmark set ; built by the cblib_bench target (cmake -DCBLIB_BUILD_BENCHMARKS=ON)
+
+	cblib_bench [filter] [-csv file] [-json file]
+
+runs every benchmark whose name contains filter , logs them , and optionally writes CSV / JSON
+	so runs can be diffed
+
+these live in their own executable and not in the lib , because the CB_BENCHMARK registrars
+	would get dropped by the linker anyway
+
+**/
+
+USE_CB
+
+//=========================================================================================
+// shared inputs , made once so the benchmarks only time the work
+
+#define BENCH_NUM_KEYS		4096
+#define BENCH_BLOCK_BYTES	(64*1024)
+
+static vector<int> s_keys;
+static vector<String> s_strings;
+static vector<uint8> s_textBlock;	// compressible
+static vector<uint8> s_randBlock;	// not
+static vector<uint8> s_compBlock;	// s_textBlock compressed
+
+static void Bench_MakeInputs()
+{
+	if ( ! s_keys.empty() )
+		return;
+
+	mysrand(1);
+
+	s_keys.resize(BENCH_NUM_KEYS);
+	for LOOPVEC(i,s_keys)
+		s_keys[i] = (int)( myrand32() & 0x7FFFFFF );
+
+	s_strings.resize(BENCH_NUM_KEYS);
+	for LOOPVEC(i,s_strings)
+		s_strings[i].Printf("c:/src/cblib/module_%d/file_%d.cpp",(int)(i%61),(int)i);
+
+	// text-ish : words from a small vocabulary , like a log file
+	static const char * c_words[] = { "the ", "quick ", "brown ", "fox ", "jumps ", "over ", "lazy ", "dog ", "\n" };
+	s_textBlock.reserve(BENCH_BLOCK_BYTES);
+	while ( s_textBlock.size32() < BENCH_BLOCK_BYTES )
+	{
+		const char * w = c_words[ irandmod(ARRAY_SIZE(c_words)) ];
+		for(const char * p = w; *p && s_textBlock.size32() < BENCH_BLOCK_BYTES; p++)
+			s_textBlock.push_back((uint8)*p);
+	}
+
+	s_randBlock.resize(BENCH_BLOCK_BYTES);
+	for LOOPVEC(i,s_randBlock)
+		s_randBlock[i] = (uint8) myrand32();
+
+	s_compBlock.resize( LZ_CompressBound(BENCH_BLOCK_BYTES) );
+	int compLen = LZ_CompressBlock(s_textBlock.data(),BENCH_BLOCK_BYTES,s_compBlock.data(),s_compBlock.size32());
+	ASSERT_RELEASE( compLen > 0 );
+	s_compBlock.resize(compLen);
+}
+
+//=========================================================================================
+// containers
+
+CB_BENCHMARK(vector_push_find)
+{
+	for(int64 it=0;it<iterations;it++)
+	{
+		vector<int> v;
+		for LOOPVEC(i,s_keys)
+			v.push_back(s_keys[i]);
+
+		int found = 0;
+		for(int i=0;i<BENCH_NUM_KEYS;i+=64)
+			found += ( std::find(v.begin(),v.end(),s_keys[i]) != v.end() );
+		DoNotOptimize(found);
+	}
+}
+
+typedef hash_table<int,int,hash_table_ops_int> t_benchHash;
+
+CB_BENCHMARK(hash_table_insert)
+{
+	for(int64 it=0;it<iterations;it++)
+	{
+		t_benchHash h;
+		for LOOPVEC(i,s_keys)
+			h.insert(s_keys[i],i);
+		DoNotOptimize(h.size());
+	}
+}
+
+CB_BENCHMARK(hash_table_find)
+{
+	static t_benchHash s_hash;
+	if ( s_hash.size() == 0 )
+	{
+		for LOOPVEC(i,s_keys)
+			s_hash.insert(s_keys[i],i);
+	}
+
+	for(int64 it=0;it<iterations;it++)
+	{
+		int sum = 0;
+		for LOOPVEC(i,s_keys)
+		{
+			const t_benchHash::entry_type * e = s_hash.find(s_keys[i]);
+			sum += e ? e->data() : 0;
+		}
+		DoNotOptimize(sum);
+	}
+}
+
+//=========================================================================================
+// StringIntern
+
+CB_BENCHMARK(StringIntern_intern)
+{
+	for(int64 it=0;it<iterations;it++)
+	{
+		// starts small so growing is part of what's timed
+		StringIntern table(64);
+		for LOOPVEC(i,s_strings)
+			table.Intern(s_strings[i].CStr(),s_strings[i].Length());
+		DoNotOptimize(table.GetCount());
+	}
+}
+
+CB_BENCHMARK(StringIntern_find)
+{
+	static StringIntern * s_table = NULL;
+	if ( s_table == NULL )
+	{
+		s_table = new StringIntern(BENCH_NUM_KEYS);
+		for LOOPVEC(i,s_strings)
+			s_table->Intern(s_strings[i].CStr(),s_strings[i].Length());
+	}
+
+	for(int64 it=0;it<iterations;it++)
+	{
+		uint32 sum = 0;
+		for LOOPVEC(i,s_strings)
+			sum += s_table->Find(s_strings[i].CStr(),s_strings[i].Length());
+		DoNotOptimize(sum);
+	}
+}
+
+//=========================================================================================
+// kernels
+
+CB_BENCHMARK(LZ_compress_text)
+{
+	static vector<uint8> s_out;
+	s_out.resize( LZ_CompressBound(BENCH_BLOCK_BYTES) );
+
+	for(int64 it=0;it<iterations;it++)
+	{
+		int len = LZ_CompressBlock(s_textBlock.data(),BENCH_BLOCK_BYTES,s_out.data(),s_out.size32());
+		DoNotOptimize(len);
+	}
+}
+
+CB_BENCHMARK(LZ_compress_random)
+{
+	static vector<uint8> s_out;
+	s_out.resize( LZ_CompressBound(BENCH_BLOCK_BYTES) );
+
+	for(int64 it=0;it<iterations;it++)
+	{
+		int len = LZ_CompressBlock(s_randBlock.data(),BENCH_BLOCK_BYTES,s_out.data(),s_out.size32());
+		DoNotOptimize(len);
+	}
+}
+
+CB_BENCHMARK(LZ_decompress_text)
+{
+	static vector<uint8> s_out;
+	s_out.resize(BENCH_BLOCK_BYTES);
+
+	for(int64 it=0;it<iterations;it++)
+	{
+		bool ok = LZ_DecompressBlock(s_compBlock.data(),s_compBlock.size32(),s_out.data(),BENCH_BLOCK_BYTES);
+		DoNotOptimize(ok);
+		ClobberMemory();
+	}
+}
+
+CB_BENCHMARK(CRC_array)
+{
+	for(int64 it=0;it<iterations;it++)
+	{
+		CRC crc;
+		crc.AddArray(s_randBlock.data(),BENCH_BLOCK_BYTES);
+		DoNotOptimize(crc.GetHash());
+	}
+}
+
+CB_BENCHMARK(FastPrintf_mixed)
+{
+	char buf[256];
+	for(int64 it=0;it<iterations;it++)
+	{
+		int len = fastsnprintf(buf,sizeof(buf),"%s : %d of %5u , %08X , %.3f %g\n",
+			"bench",(int)it,(unsigned)(it*7),(unsigned)(it*0x9E3779B9U),it*0.125,it*1.5e-3);
+		DoNotOptimize(len);
+		ClobberMemory();
+	}
+}
+
+CB_BENCHMARK(FastPrintf_double)
+{
+	char buf[64];
+	double d = 3.14159265358979;
+	for(int64 it=0;it<iterations;it++)
+	{
+		int len = fastsnprintf(buf,sizeof(buf),"%.17g",d);
+		DoNotOptimize(len);
+		ClobberMemory();
+		d += 1.0/1024;
+	}
+}
+
+//=========================================================================================
+
+int main(int argc,char * argv[])
+{
+	const char * filter = NULL;
+	const char * csvName = NULL;
+	const char * jsonName = NULL;
+
+	for(int i=1;i<argc;i++)
+	{
+		if ( strcmp(argv[i],"-csv") == 0 && i+1 < argc )
+			csvName = argv[++i];
+		else if ( strcmp(argv[i],"-json") == 0 && i+1 < argc )
+			jsonName = argv[++i];
+		else
+			filter = argv[i];
+	}
+
+	Bench_MakeInputs();
+
+	vector<BenchmarkResult> results;
+	Benchmark_RunAll(&results,filter);
+	Benchmark_Log(results);
+
+	bool ok = true;
+	if ( csvName )
+		ok = Benchmark_WriteCSV(csvName,results) && ok;
+	if ( jsonName )
+		ok = Benchmark_WriteJSON(jsonName,results) && ok;
+
+	return ok ? 0 : 1;
+}
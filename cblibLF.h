@@ -4,6 +4,15 @@
 
 using namespace CBLIB_LF_NS;
 
+// contention counts go to Metrics ; only on the retry paths , so uncontended ops don't pay
+//	define CBLIB_LF_NO_METRICS for model-checker builds
+#ifndef CBLIB_LF_NO_METRICS
+#include "Metrics.h"
+#define LF_METRIC_COUNT(name)	do { static cb::MetricCounter s_lf_metric = METRIC_COUNTER_INIT(name); s_lf_metric.Add(1); } while(0)
+#else
+#define LF_METRIC_COUNT(name)
+#endif
+
 //=================================================================		
 
 // singly linked node with atomic next pointer
@@ -62,6 +71,7 @@ struct LF_OS_ALIGN_2POINTERS lf_mpmc_lifo
 			// else retry
 			// localHead was reloaded bycompare_exchange_strong
 			
+			LF_METRIC_COUNT("lf.mpmc_lifo.push_retries");
 			bo.yield($);
 		}
 	}
@@ -102,6 +112,7 @@ struct LF_OS_ALIGN_2POINTERS lf_mpmc_lifo
 			}
 			
 			// localHead was reloaded
+			LF_METRIC_COUNT("lf.mpmc_lifo.pop_retries");
 			bo.yield($);
 		}
 	}
@@ -129,6 +140,7 @@ struct LF_OS_ALIGN_2POINTERS lf_mpmc_lifo
 			}
 			
 			// localHead was reloaded
+			LF_METRIC_COUNT("lf.mpmc_lifo.swap_retries");
 			bo.yield($);
 		}
 	}
@@ -205,6 +217,8 @@ private:
 		if ( lifo == NULL )
 			return;
 		
+		LF_METRIC_COUNT("lf.mpsc_fifo.fetches");
+		
 		// I own lifo list now, so no need to use atomic ops on it :
 		lf_slist_node_nonatomic * node = (lf_slist_node_nonatomic *) lifo;
 		
@@ -116,11 +116,59 @@ void CRC::AddF(const float f)
 	AddL(FLOAT_AS_INT(f));
 }
 
+// slicing-by-8 tables : s_crcSlice[k][b] is crc_table stepped k more zero bytes
+//	built at static init ; anything that runs before that takes the byte loop
+static uint32 s_crcSlice[8][256];
+static bool s_crcSliceReady = false;
+
+struct CRCSliceInit
+{
+	CRCSliceInit()
+	{
+		for(int i=0;i<256;i++)
+			s_crcSlice[0][i] = crc_table[i];
+		for(int k=1;k<8;k++)
+		{
+			for(int i=0;i<256;i++)
+			{
+				uint32 c = s_crcSlice[k-1][i];
+				s_crcSlice[k][i] = crc_table[c & 0xFF] ^ (c >> 8);
+			}
+		}
+		s_crcSliceReady = true;
+	}
+};
+static CRCSliceInit s_crcSliceInit;
+
 void CRC::AddArray(const uint8 * buf,const int i_buflen)
 {
 	ASSERT( buf );
 	int buflen = i_buflen;
 
+	if ( s_crcSliceReady )
+	{
+		// 8 bytes per step ; same result as the byte loop (assumes little endian)
+		uint32 crc = m_crc;
+		while ( buflen >= 8 )
+		{
+			uint32 lo,hi;
+			memcpy(&lo,buf,4);
+			memcpy(&hi,buf+4,4);
+			lo ^= crc;
+			crc = s_crcSlice[7][ lo & 0xFF ] ^
+				s_crcSlice[6][ (lo>>8) & 0xFF ] ^
+				s_crcSlice[5][ (lo>>16) & 0xFF ] ^
+				s_crcSlice[4][ lo>>24 ] ^
+				s_crcSlice[3][ hi & 0xFF ] ^
+				s_crcSlice[2][ (hi>>8) & 0xFF ] ^
+				s_crcSlice[1][ (hi>>16) & 0xFF ] ^
+				s_crcSlice[0][ hi>>24 ];
+			buf += 8;
+			buflen -= 8;
+		}
+		m_crc = crc;
+	}
+
 	// do 1-byte steps first :
 	while( (buflen&0x3) != 0 )
 	{
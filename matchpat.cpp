@@ -9,8 +9,10 @@
 #include "matchpat.h"
 #include "Util.h"
 #include "FileUtil.h"
+#include "Hashes.h"
 #include "string.h"
 #include "ctype.h"
+#include <algorithm>
 
 //#pragma warning(disable : 4018) // signed/unsigned compare
 #pragma warning(disable : 4244) // conversion float/int/double
@@ -924,4 +926,594 @@ void strcpyKeepCase(
 	}
 }
 						
+//=========================================================================
+// PatternSet : patterns -> Thompson NFA -> DFA over byte classes
+
+struct PatternSet::Nfa
+{
+	struct Edge
+	{
+		int set;	// consumes any byte in this set
+		int to;
+		int next;	// next edge out of the same state
+	};
+	struct Eps
+	{
+		int to;
+		int next;
+	};
+	struct State
+	{
+		int firstEdge;
+		int firstEps;
+		int accept;	// pattern index or -1
+	};
+
+	vector<State>	states;
+	vector<Edge>	edges;
+	vector<Eps>		eps;
+	vector<uint8>	setBits;	// [set*256 + byte]
+	int				numSets;
+	int				anySet;
+	int				litSet[256];
+	bool			doUpr;
+
+	explicit Nfa(bool upr) : numSets(0), anySet(-1), doUpr(upr)
+	{
+		for LOOP(i,256) litSet[i] = -1;
+	}
+
+	int Lit(int c) const { return doUpr ? toupper(c) : c; }
+
+	int NewState()
+	{
+		State st = { -1, -1, -1 };
+		states.push_back(st);
+		return states.size32()-1;
+	}
+
+	void AddEdge(int from,int set,int to)
+	{
+		Edge e = { set, to, states[from].firstEdge };
+		edges.push_back(e);
+		states[from].firstEdge = edges.size32()-1;
+	}
+
+	void AddEps(int from,int to)
+	{
+		Eps e = { to, states[from].firstEps };
+		eps.push_back(e);
+		states[from].firstEps = eps.size32()-1;
+	}
+
+	int NewSet()
+	{
+		setBits.resize( setBits.size() + 256, (uint8)0 );
+		return numSets++;
+	}
+
+	uint8 * SetBits(int set) { return setBits.data() + set*256; }
+
+	// byte 0 is never consumed, the walk stops there
+	int AnySet()
+	{
+		if ( anySet < 0 )
+		{
+			anySet = NewSet();
+			uint8 * bits = SetBits(anySet);
+			for(int b=1;b<256;b++) bits[b] = 1;
+		}
+		return anySet;
+	}
+
+	// same compare as LIT() in MatchPatternSub
+	int LiteralSet(int c)
+	{
+		int key = Lit(c) & 0xFF;
+		if ( litSet[key] < 0 )
+		{
+			int set = NewSet();
+			uint8 * bits = SetBits(set);
+			for(int b=1;b<256;b++)
+				if ( Lit(b) == Lit(c) ) bits[b] = 1;
+			litSet[key] = set;
+		}
+		return litSet[key];
+	}
+};
+
+// Build : compiles pat starting at [i] from state "from"
+//	stops at the end or at an | or ) of the enclosing group
+//	returns the state we end in, or -1 if the pattern can't be a DFA (~ or {&})
+/*static*/ int PatternSet::BuildNfa(Nfa & nfa,const uint16 * pat,int & i,int from)
+{
+	for(;;)
+	{
+		patchar c = pat[i];
+		if ( c == 0 )
+			return from;
+
+		if ( c >= PBASE )
+		{
+			int type = c & PTYPE;
+			int nest = c & PMASK;
+
+			if ( type == POR || type == PDONEOR )
+				return from; // end of an alternative ; caller eats it
+
+			if ( type != POPENOR )
+				return -1; // {&}
+
+			i++;
+			int end = nfa.NewState();
+			for(;;)
+			{
+				int altEnd = BuildNfa(nfa,pat,i,from);
+				if ( altEnd < 0 )
+					return -1;
+				nfa.AddEps(altEnd,end);
+
+				if ( pat[i] == POR+nest ) { i++; continue; }
+				if ( pat[i] == PDONEOR+nest ) { i++; break; }
+				return -1;
+			}
+			from = end;
+			continue;
+		}
+
+		switch(c)
+		{
+		case WNOT:
+			return -1;
+
+		case WANY:
+		{
+			int loop = nfa.NewState();
+			nfa.AddEps(from,loop);
+			nfa.AddEdge(loop,nfa.AnySet(),loop);
+			from = loop;
+			i++;
+			break;
+		}
+
+		case WCHAR:
+		{
+			int to = nfa.NewState();
+			nfa.AddEdge(from,nfa.AnySet(),to);
+			from = to;
+			i++;
+			break;
+		}
+
+		case WBRA:
+		{
+			i++;
+			int set = nfa.NewSet();
+			uint8 * bits = nfa.SetBits(set);
+			if ( pat[i] != WKET && pat[i+1] == '-' )
+			{
+				// range :
+				int lo = pat[i];
+				int hi = pat[i+2];
+				// wild chars inside brackets do odd things in MatchPatternSub ; leave those to it
+				if ( lo >= 256 || hi >= 256 )
+					return -1;
+				for(int b=1;b<256;b++)
+					if ( nfa.Lit(b) >= nfa.Lit(lo) && nfa.Lit(b) <= nfa.Lit(hi) )
+						bits[b] = 1;
+			}
+			else
+			{
+				// list , walked the same way MatchPatternSub does :
+				int j = i;
+				while ( pat[j] != WKET && pat[j] != 0 )
+				{
+					if ( pat[j] >= 256 )
+						return -1;
+					for(int b=1;b<256;b++)
+						if ( nfa.Lit(b) == nfa.Lit(pat[j]) ) bits[b] = 1;
+					j++;
+					if ( pat[j] == ',' )
+					{
+						j++;
+						// "[a,]" makes MatchPatternSub run off the end of the list
+						if ( pat[j] == WKET )
+							return -1;
+					}
+				}
+			}
+			while ( pat[i] != WKET && pat[i] != 0 ) i++;
+			if ( pat[i] == 0 )
+				return -1;
+			i++;
+
+			int to = nfa.NewState();
+			nfa.AddEdge(from,set,to);
+			from = to;
+			break;
+		}
+
+		case WKET:
+			return -1;
+
+		default:
+		{
+			// raw character :
+			int to = nfa.NewState();
+			nfa.AddEdge(from,nfa.LiteralSet(c),to);
+			from = to;
+			i++;
+			break;
+		}
+		}
+	}
+}
+
+PatternSet::PatternSet(bool caseSensitive) :
+	m_caseSensitive(caseSensitive),
+	m_compiled(false),
+	m_numClasses(0),
+	m_numStates(0)
+{
+	memset(m_byteClass,0,sizeof(m_byteClass));
+}
+
+PatternSet::~PatternSet()
+{
+	for LOOPVEC(i,m_patterns)
+	{
+		FreePattern(m_patterns[i]);
+	}
+}
+
+int PatternSet::AddPattern(const char * str)
+{
+	pattern pat = MakePattern(str);
+	if ( ! pat )
+		return -1;
+
+	m_patterns.push_back(pat);
+	m_compiled = false;
+	return m_patterns.size32()-1;
+}
+
+int PatternSet::AddPattern(const pattern pat)
+{
+	int len = PatternLen(pat);
+	pattern copy = (pattern) malloc(sizeof(patchar)*(len+1));
+	if ( ! copy )
+		{ MakePatternError = "malloc"; return -1; }
+	memcpy(copy,pat,sizeof(patchar)*(len+1));
+
+	m_patterns.push_back(copy);
+	m_compiled = false;
+	return m_patterns.size32()-1;
+}
+
+void PatternSet::FreeDfa()
+{
+	m_compiled = false;
+	m_numStates = 0;
+	m_numClasses = 0;
+	m_transitions.clear();
+	m_acceptStart.clear();
+	m_acceptList.clear();
+	m_slowPatterns.clear();
+}
+
+bool PatternSet::SlowMatch(int patIndex,const char * str) const
+{
+	if ( m_caseSensitive )
+		return MatchPatternWithCase(str,m_patterns[patIndex]);
+	else
+		return MatchPatternNoCase(str,m_patterns[patIndex]);
+}
+
+// sorted int sets for the subset construction :
+static uint32 PatternSet_HashSet(const int * set,int count)
+{
+	return FNVHash( (const char *)set, count*sizeof(int) );
+}
+
+// PatternSet_Subsets : the dfa states as eps-closed , sorted sets of nfa states
+//	stored flat in one pool , found by hash
+struct PatternSet_Subsets
+{
+	enum { c_numBuckets = 4096 };
+
+	const PatternSet::Nfa &	nfa;
+	vector<int>		mark;
+	int				markGen;
+	vector<int>		stack;
+	vector<int>		pool;
+	vector<int>		start;	// [dfa state] -> offset in pool , plus one at the end
+	vector<int>		bucket;
+	vector<int>		chain;
+
+	explicit PatternSet_Subsets(const PatternSet::Nfa & _nfa) : nfa(_nfa), markGen(0)
+	{
+		mark.resize(nfa.states.size(),0);
+		bucket.resize(c_numBuckets,-1);
+		start.push_back(0);
+	}
+
+	int NumStates() const { return start.size32()-1; }
+	const int * SetBegin(int d) const { return pool.data() + start[d]; }
+	const int * SetEnd(int d) const { return pool.data() + start[d+1]; }
+
+	// closes "work" over eps , sorts it , finds or adds the dfa state
+	//	returns -1 for the empty (dead) set ; work is trashed
+	int CloseAndFind(vector<int> & work)
+	{
+		markGen++;
+		stack.clear();
+		for LOOPVEC(w,work)
+		{
+			if ( mark[work[w]] != markGen ) { mark[work[w]] = markGen; stack.push_back(work[w]); }
+		}
+		work.clear();
+		while ( ! stack.empty() )
+		{
+			int ns = stack.back();
+			stack.pop_back();
+			work.push_back(ns);
+			for(int e = nfa.states[ns].firstEps; e >= 0; e = nfa.eps[e].next)
+			{
+				int to = nfa.eps[e].to;
+				if ( mark[to] != markGen ) { mark[to] = markGen; stack.push_back(to); }
+			}
+		}
+
+		if ( work.empty() )
+			return -1;
+
+		std::sort(work.begin(),work.end());
+		uint32 h = PatternSet_HashSet(work.data(),work.size32()) & (c_numBuckets-1);
+
+		for(int d = bucket[h]; d >= 0; d = chain[d])
+		{
+			int len = start[d+1] - start[d];
+			if ( len == work.size32() && memcmp(pool.data()+start[d],work.data(),len*sizeof(int)) == 0 )
+				return d;
+		}
+
+		int d = NumStates();
+		for LOOPVEC(w,work) pool.push_back(work[w]);
+		start.push_back(pool.size32());
+		chain.push_back(bucket[h]);
+		bucket[h] = d;
+		return d;
+	}
+
+private:
+	FORBID_CLASS_STANDARDS(PatternSet_Subsets);
+};
+
+bool PatternSet::Compile(int maxStates)
+{
+	FreeDfa();
+
+	Nfa nfa(!m_caseSensitive);
+	int start = nfa.NewState();
+
+	for LOOPVEC(p,m_patterns)
+	{
+		int patStart = nfa.NewState();
+		int i = 0;
+		int end = BuildNfa(nfa,m_patterns[p],i,patStart);
+		if ( end < 0 || m_patterns[p][i] != 0 )
+		{
+			// can't DFA this one , leave patStart dangling
+			m_slowPatterns.push_back(p);
+			continue;
+		}
+		nfa.AddEps(start,patStart);
+		nfa.states[end].accept = p;
+	}
+
+	//-------------------------------------
+	// byte classes : bytes that every set treats the same share a class
+
+	int classRep[256];
+	m_numClasses = 0;
+	for(int b=0;b<256;b++)
+	{
+		int k;
+		for(k=0;k<m_numClasses;k++)
+		{
+			int r = classRep[k];
+			int s;
+			for(s=0;s<nfa.numSets;s++)
+			{
+				if ( nfa.setBits[s*256+b] != nfa.setBits[s*256+r] )
+					break;
+			}
+			if ( s == nfa.numSets )
+				break;
+		}
+		if ( k == m_numClasses )
+		{
+			classRep[k] = b;
+			m_numClasses++;
+		}
+		m_byteClass[b] = (uint8) k;
+	}
+
+	//-------------------------------------
+	// subset construction
+
+	PatternSet_Subsets subsets(nfa);
+	vector<int> work;
+
+	work.push_back(start);
+	int startDfa = subsets.CloseAndFind(work);
+	ASSERT( startDfa == 0 );
+
+	for(int d=0; d < subsets.NumStates(); d++)
+	{
+		if ( subsets.NumStates() > maxStates )
+		{
+			// blew up ; interpret everything
+			FreeDfa();
+			for LOOPVEC(p,m_patterns) m_slowPatterns.push_back(p);
+			return false;
+		}
+
+		const int * setBegin = subsets.SetBegin(d);
+		const int * setEnd = subsets.SetEnd(d);
+
+		// accepts :
+		m_acceptStart.push_back(m_acceptList.size32());
+		for(const int * k = setBegin; k < setEnd; k++)
+		{
+			int acc = nfa.states[ *k ].accept;
+			if ( acc >= 0 ) m_acceptList.push_back(acc);
+		}
+		std::sort(m_acceptList.begin()+m_acceptStart.back(),m_acceptList.end());
+
+		// transitions :
+		for(int c=0;c<m_numClasses;c++)
+		{
+			int rep = classRep[c];
+			work.clear();
+			if ( rep != 0 )
+			{
+				for(const int * k = setBegin; k < setEnd; k++)
+				{
+					for(int e = nfa.states[*k].firstEdge; e >= 0; e = nfa.edges[e].next)
+					{
+						if ( nfa.setBits[ nfa.edges[e].set*256 + rep ] )
+							work.push_back( nfa.edges[e].to );
+					}
+				}
+			}
+
+			// (CloseAndFind can grow the pool, so setBegin is refetched next d)
+			int to = subsets.CloseAndFind(work);
+			m_transitions.push_back(to);
+
+			setBegin = subsets.SetBegin(d);
+			setEnd = subsets.SetEnd(d);
+		}
+	}
+
+	m_numStates = subsets.NumStates();
+	m_acceptStart.push_back(m_acceptList.size32());
+	ASSERT( m_transitions.size32() == m_numStates*m_numClasses );
+
+	m_compiled = true;
+	return true;
+}
+
+int PatternSet::Walk(const char * str) const
+{
+	const uint8 * ptr = (const uint8 *) str;
+	const int * trans = m_transitions.data();
+	int nc = m_numClasses;
+	int state = 0;
+	while ( *ptr )
+	{
+		state = trans[ state*nc + m_byteClass[*ptr] ];
+		if ( state < 0 )
+			return -1;
+		ptr++;
+	}
+	return state;
+}
+
+bool PatternSet::MatchAny(const char * str) const
+{
+	if ( m_compiled )
+	{
+		int state = Walk(str);
+		if ( state >= 0 && m_acceptStart[state+1] > m_acceptStart[state] )
+			return true;
+
+		for LOOPVEC(i,m_slowPatterns)
+			if ( SlowMatch(m_slowPatterns[i],str) )
+				return true;
+		return false;
+	}
+
+	for LOOPVEC(p,m_patterns)
+		if ( SlowMatch(p,str) )
+			return true;
+	return false;
+}
+
+int PatternSet::MatchFirst(const char * str) const
+{
+	if ( ! m_compiled )
+	{
+		for LOOPVEC(p,m_patterns)
+			if ( SlowMatch(p,str) )
+				return p;
+		return -1;
+	}
+
+	int first = -1;
+	int state = Walk(str);
+	if ( state >= 0 && m_acceptStart[state+1] > m_acceptStart[state] )
+		first = m_acceptList[ m_acceptStart[state] ];
+
+	// slow patterns are in increasing order ; only need the ones before "first"
+	for LOOPVEC(i,m_slowPatterns)
+	{
+		int p = m_slowPatterns[i];
+		if ( first >= 0 && p > first )
+			break;
+		if ( SlowMatch(p,str) )
+			return p;
+	}
+
+	return first;
+}
+
+int PatternSet::MatchAll(const char * str,vector<int> * pMatches) const
+{
+	pMatches->clear();
+
+	if ( ! m_compiled )
+	{
+		for LOOPVEC(p,m_patterns)
+			if ( SlowMatch(p,str) )
+				pMatches->push_back(p);
+		return pMatches->size32();
+	}
+
+	int state = Walk(str);
+	if ( state >= 0 )
+	{
+		for(int k=m_acceptStart[state];k<m_acceptStart[state+1];k++)
+			pMatches->push_back( m_acceptList[k] );
+	}
+
+	bool added = false;
+	for LOOPVEC(i,m_slowPatterns)
+	{
+		if ( SlowMatch(m_slowPatterns[i],str) )
+		{
+			pMatches->push_back(m_slowPatterns[i]);
+			added = true;
+		}
+	}
+	if ( added )
+		std::sort(pMatches->begin(),pMatches->end());
+
+	return pMatches->size32();
+}
+
+int PatternSet::MatchFirstBatch(const char * const * strs,int count,int * pFirstMatch) const
+{
+	int numMatched = 0;
+	for LOOP(i,count)
+	{
+		pFirstMatch[i] = MatchFirst(strs[i]);
+		if ( pFirstMatch[i] >= 0 )
+			numMatched++;
+	}
+	return numMatched;
+}
+
+
 END_CB
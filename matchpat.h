@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Base.h"
+#include "vector.h"
 #include <string.h>
 
 START_CB
@@ -35,6 +36,91 @@ void GetNonWildPrefix(wchar_t * to, const wchar_t * fm);
 
 //---------------------------------------------------------
 
+/**
+
+PatternSet : compiled matcher for one or many patterns
+
+MatchPattern interprets the pattern with backtracking for every string
+PatternSet compiles all its patterns into one DFA with a byte-class table,
+	so each candidate string is one table walk no matter how many patterns there are
+
+case folding is done when building the byte classes, so NoCase costs nothing at match time
+
+~ (not) and {&} (and) don't map to a DFA ; patterns using them are kept
+	and run through MatchPatternSub on the side
+if the DFA would blow up past maxStates, Compile() gives up and everything runs the slow way
+
+usage :
+
+	PatternSet set(false);
+	set.AddPattern("*.cpp");
+	set.AddPattern("*.(h|inl)");
+	set.Compile();
+	for each file
+		if ( set.MatchAny(file) ) ..
+
+**/
+
+class PatternSet
+{
+public:
+	explicit PatternSet(bool caseSensitive = false);
+	~PatternSet();
+
+	// returns the index of the pattern (0,1,2..) or -1 on error (see MakePatternError)
+	int AddPattern(const char * str);
+	// pat is copied, you still own it :
+	int AddPattern(const pattern pat);
+
+	int GetNumPatterns() const { return m_patterns.size32(); }
+
+	// Compile after all Adds ; returns false if it had to fall back to interpreting
+	bool Compile(int maxStates = 16384);
+
+	bool IsCompiled() const { return m_compiled; }
+	int GetNumDfaStates() const { return m_numStates; }
+	int GetNumByteClasses() const { return m_numClasses; }
+
+	// matching :
+	bool MatchAny(const char * str) const;
+	// lowest matching pattern index or -1 :
+	int  MatchFirst(const char * str) const;
+	// fills indices of all matching patterns , returns count
+	int  MatchAll(const char * str,vector<int> * pMatches) const;
+
+	// batch : pFirstMatch[i] = MatchFirst(strs[i])
+	//	returns the number of strings that matched anything
+	int  MatchFirstBatch(const char * const * strs,int count,int * pFirstMatch) const;
+
+	// internal :
+	struct Nfa;
+
+private:
+	FORBID_CLASS_STANDARDS(PatternSet);
+
+	static int BuildNfa(Nfa & nfa,const uint16 * pat,int & i,int from);
+
+	// returns the dfa state after consuming str, or -1 if it died
+	int Walk(const char * str) const;
+	bool SlowMatch(int patIndex,const char * str) const;
+	void FreeDfa();
+
+	bool				m_caseSensitive;
+	bool				m_compiled;
+	vector<pattern>		m_patterns;
+	vector<int>			m_slowPatterns;	// indices that the DFA doesn't cover
+
+	// DFA :
+	uint8				m_byteClass[256];
+	int					m_numClasses;
+	int					m_numStates;
+	vector<int>			m_transitions;	// [state*m_numClasses + class] -> state , -1 = dead
+	vector<int>			m_acceptStart;	// [state] -> index in m_acceptList ; size m_numStates+1
+	vector<int>			m_acceptList;	// sorted pattern indices
+};
+
+//---------------------------------------------------------
+
 // strcpy "putString" to "into"
 //  but change its case to match the case in src
 // putString should be mixed case , the way you want it to be if src is mixed case
@@ -5,6 +5,10 @@
 #include "Vector_s.h"
 #include "Log.h"
 #include "File.h"
+#include "Threading.h"
+#include "Win32Util.h"
+#include "StringBuilder.h"
+#include "FastPrintf.h"
 
 #define PROFILE_RECORDS
 //#define PROFILE_NODES
@@ -22,6 +26,35 @@ either one or both can be enabled
 
 total times for each index are always tracked
 
+THREADS :
+
+each thread has its own ProfilerThreadData (node tree, counters, records) in TLS ,
+	made the first time it Pushes and linked on a global list that is never shrunk
+Push/Pop only ever touch the calling thread's data , so there are no locks on the hot path
+the only locks are in Index() (name registration , once per PROFILE site) ,
+	registering a new thread , and Report
+
+Reset just bumps a generation ; each thread clears itself at its next Push ,
+	and Report skips threads that haven't caught up
+
+Report shows the merged view (all threads summed) and then each thread
+	Report reads other threads' counters while they run , so it's a snapshot , not exact
+
+TIMELINE :
+
+StartTimeline bumps a capture generation ; each thread allocates its event buffer at its first
+	Push in the new capture , and never grows it , so the hot path is a few stores
+the open Begin events are kept on a little stack so a Pop knows its start time (Pop only gets the delta)
+	and room is always kept for the End of every open Begin , so the events always nest
+a Pop whose Begin wasn't recorded (capture started inside it , or dropped) records nothing
+a thread only reallocates its buffer when it sees a new generation , and StartTimeline takes m_lock
+	to make one , so WriteChromeTrace (which holds m_lock) can read the buffers of the capture it started with
+
+HISTOGRAMS :
+
+when SetHistograms is on , each thread's ProfilerCounter gets a ProfileHistogram , made at its first Pop
+	only the owning thread writes it (so no atomics) ; Report and GetHistogram merge the threads
+
 **/
 
 /*****************
@@ -92,6 +125,7 @@ START_CB
 namespace Profiler
 {
 	bool g_enabled = false;
+	bool g_timeline = false;
 }
 
 namespace
@@ -107,10 +141,11 @@ namespace
 		const char *	m_name;
 		uint64			m_time;
 		int				m_count;
+		int				m_index; // set by GatherEntries so Report can find the histogram after sorting
 		String			m_string; // only used by ReadRecords
 
-		ProfilerEntry(const char * name) : m_name(name), m_time(0), m_count(0) { }
-		ProfilerEntry() : m_name(NULL), m_time(0), m_count(0) { }
+		ProfilerEntry(const char * name) : m_name(name), m_time(0), m_count(0), m_index(0) { }
+		ProfilerEntry() : m_name(NULL), m_time(0), m_count(0), m_index(0) { }
 
 		void Reset()
 		{
@@ -213,7 +248,8 @@ namespace
 			// We didn't find it, so add it
 			ProfileNode * node = new ProfileNode( name,index, this );
 			node->m_sibling = m_child;
-			m_child = node;
+			// Report may be walking this tree from another thread :
+			StoreReleasePointer(&m_child,node);
 			return node;
 		}
 		
@@ -229,6 +265,146 @@ namespace
 		}
 	};
 
+	/*
+	 ProfilerCounter is the per-thread half of ProfilerEntry
+	 they live in fixed-size blocks so a block never moves once Report can see it
+	 */
+	struct ProfilerCounter
+	{
+		uint64	m_time;
+		int		m_count;
+		Profiler::ProfileHistogram *	m_histogram; // NULL unless histograms were on
+	};
+
+	static bool s_histograms = false;
+
+	#define PROFILER_COUNTER_BLOCK_SHIFT	(8)
+	#define PROFILER_COUNTER_BLOCK_SIZE		(1<<PROFILER_COUNTER_BLOCK_SHIFT)
+	#define PROFILER_COUNTER_NUM_BLOCKS		(256)
+	#define PROFILER_MAX_ENTRIES			(PROFILER_COUNTER_BLOCK_SIZE*PROFILER_COUNTER_NUM_BLOCKS)
+
+	enum ETimelineEvent
+	{
+		eTimeline_Begin,
+		eTimeline_End,
+		eTimeline_Counter
+	};
+
+	struct TimelineEvent
+	{
+		uint64	m_time;
+		double	m_value;	// only for counters
+		int32	m_index;
+		int32	m_type;		// ETimelineEvent
+	};
+
+	#define PROFILER_TIMELINE_MAX_DEPTH	(256)
+
+	/*
+	 ProfilerThreadData is everything Push/Pop touch
+	 only the owning thread writes it ; Report reads it from outside
+	 */
+	struct ProfilerThreadData
+	{
+		ProfilerThreadData() : m_root("root",-1,NULL)
+		{
+			m_next = NULL;
+			m_threadIndex = GetThreadIndex();
+			m_name[0] = 0;
+			m_generation = 0;
+			m_curNode = &m_root;
+			m_inspectNode = &m_root;
+			for LOOP(b,PROFILER_COUNTER_NUM_BLOCKS)
+			{
+				m_counterBlocks[b] = NULL;
+			}
+
+			m_timeline = NULL;
+			m_timelineCapacity = 0;
+			m_timelineCount = 0;
+			m_timelineGeneration = 0;
+			m_timelineDepth = 0;
+			m_timelineDropDepth = 0;
+			m_timelineDropped = 0;
+
+			#ifdef PROFILE_RECORDS
+			m_records.reserve(1024);
+			#endif
+		}
+
+		// only call from the owning thread (or with the owner stopped)
+		void Reset(const uint32 generation)
+		{
+			m_root.Reset();
+			m_curNode = &m_root;
+
+			for LOOP(b,PROFILER_COUNTER_NUM_BLOCKS)
+			{
+				ProfilerCounter * block = m_counterBlocks[b];
+				if ( block == NULL )
+					continue;
+				for LOOP(i,PROFILER_COUNTER_BLOCK_SIZE)
+				{
+					block[i].m_time = 0;
+					block[i].m_count = 0;
+					if ( block[i].m_histogram )
+						block[i].m_histogram->Clear();
+				}
+			}
+
+			StoreRelease(&m_generation,generation);
+		}
+
+		ProfilerCounter * GetCounter(const int index)
+		{
+			ASSERT( index > 0 && index < PROFILER_MAX_ENTRIES );
+			ProfilerCounter * block = m_counterBlocks[index>>PROFILER_COUNTER_BLOCK_SHIFT];
+			if ( block == NULL )
+			{
+				block = new ProfilerCounter[PROFILER_COUNTER_BLOCK_SIZE];
+				memset(block,0,PROFILER_COUNTER_BLOCK_SIZE*sizeof(ProfilerCounter));
+				StoreReleasePointer(&m_counterBlocks[index>>PROFILER_COUNTER_BLOCK_SHIFT],block);
+			}
+			return block + (index & (PROFILER_COUNTER_BLOCK_SIZE-1));
+		}
+
+		// from any thread ; returns false if this thread has never counted index
+		bool ReadCounter(const int index,ProfilerCounter * pInto) const
+		{
+			const ProfilerCounter * block = LoadAcquirePointer(&m_counterBlocks[index>>PROFILER_COUNTER_BLOCK_SHIFT]);
+			if ( block == NULL )
+				return false;
+			*pInto = block[index & (PROFILER_COUNTER_BLOCK_SIZE-1)];
+			pInto->m_histogram = LoadAcquirePointer(&block[index & (PROFILER_COUNTER_BLOCK_SIZE-1)].m_histogram);
+			return true;
+		}
+
+		//-------------------------------------
+
+		ProfilerThreadData *	m_next;
+		int						m_threadIndex;
+		char					m_name[32];
+		uint32 volatile			m_generation;
+
+		ProfileNode *			m_inspectNode;
+		ProfileNode *			m_curNode;
+		ProfileNode				m_root;
+
+		ProfilerCounter * volatile	m_counterBlocks[PROFILER_COUNTER_NUM_BLOCKS];
+
+		vector< Profiler::ProfileRecord > m_records;
+
+		// timeline capture ; only the owner writes these , WriteChromeTrace reads up to m_timelineCount
+		TimelineEvent *			m_timeline;
+		int						m_timelineCapacity;
+		int volatile			m_timelineCount;
+		uint32 volatile			m_timelineGeneration;
+		int						m_timelineOpen[PROFILER_TIMELINE_MAX_DEPTH]; // event slots of open Begins
+		int						m_timelineDepth;
+		int						m_timelineDropDepth; // open Begins that weren't recorded
+		int volatile			m_timelineDropped;
+	};
+
 	struct ProfilerData
 	{
 	public:
@@ -239,18 +415,18 @@ namespace
 			return inst;
 		}
 
-		ProfilerData() : m_root("root",-1,NULL)
+		ProfilerData()
 		{
 			m_requestEnabled = false;
 
 			m_secondsSinceStart = Profiler::GetSeconds();
 
-			m_inspectNode = &m_root;
 			m_showNodes = true;
-
-			#ifdef PROFILE_RECORDS
-			m_records.reserve(1024);
-			#endif
+			m_threads = NULL;
+			m_generation = 0;
+			m_timelineGeneration = 0;
+			m_timelineCapacity = 0;
+			m_timelineStartTime = 0;
 
 			m_entries.reserve(32);
 			m_entries.resize(1); // slot 0 is unused
@@ -258,12 +434,9 @@ namespace
 			Reset();
 		}
 
+		// threads clear their own data when they see the new generation
 		void Reset()
 		{
-			m_root.Reset();
-
-			m_curNode = &m_root;
-
 			#ifdef DEBUG_MEMORY
 			MemorySystem::GetStatistics(&m_lastResetMemoryStats);
 			#endif
@@ -272,13 +445,7 @@ namespace
 			m_secondsSinceReset = 0.0;
 			m_framesSinceReset = 0;
 			
-			//m_stack.clear();
-
-			const int n = m_entries.size32();
-			for(int i=0;i<n;i++)
-			{
-				m_entries[i].Reset();
-			}
+			StoreRelease(&m_generation,m_generation+1);
 		}
 
 		//-------------------------------------
@@ -290,21 +457,134 @@ namespace
 		bool					m_showNodes;
 		bool					m_requestEnabled;
 
-		ProfileNode *			m_inspectNode;
-		ProfileNode *			m_curNode;
-		ProfileNode				m_root;
+		uint32 volatile			m_generation;
 
-		charptr_int_map			m_nameMap;
-		vector< ProfilerEntry > m_entries;
-		//vector_s< int , 256 >	m_stack;
+		uint32 volatile			m_timelineGeneration;
+		int						m_timelineCapacity;
+		uint64					m_timelineStartTime;
 
-		vector< Profiler::ProfileRecord > m_records;
+		// m_lock protects m_nameMap , m_entries , and the m_threads list
+		CriticalSection			m_lock;
+		charptr_int_map			m_nameMap;
+		vector< ProfilerEntry > m_entries; // names ; the counts are only used by ReadRecords
+		ProfilerThreadData *	m_threads;
 
 	#ifdef DEBUG_MEMORY
 		MemorySystem::Statistics	m_lastResetMemoryStats;
 	#endif
 	};
 
+	static CB_THREAD_LOCAL ProfilerThreadData * s_myThreadData = NULL;
+	
+	static ProfilerThreadData * MakeMyThreadData()
+	{
+		ProfilerData & data = ProfilerData::Instance();
+
+		// never freed ; Report may still be reading it after the thread exits
+		ProfilerThreadData * td = new ProfilerThreadData;
+		td->m_generation = data.m_generation;
+		
+		{
+			CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+			td->m_next = data.m_threads;
+			data.m_threads = td;
+		}
+
+		s_myThreadData = td;
+		return td;
+	}
+
+	static ProfilerThreadData * GetMyThreadData()
+	{
+		ProfilerThreadData * td = s_myThreadData;
+		if ( td == NULL )
+			td = MakeMyThreadData();
+		return td;
+	}
+	
+	static bool IsCurrent(const ProfilerThreadData * td)
+	{
+		return LoadAcquire(&td->m_generation) == ProfilerData::Instance().m_generation;
+	}
+
+	// get td's buffer ready for the current capture ; false if there's no capture
+	static bool TimelineSetup(ProfilerThreadData * td)
+	{
+		ProfilerData & data = ProfilerData::Instance();
+		const uint32 generation = LoadAcquire(&data.m_timelineGeneration);
+		if ( td->m_timelineGeneration == generation )
+			return td->m_timeline != NULL;
+		
+		if ( td->m_timelineCapacity != data.m_timelineCapacity )
+		{
+			delete [] td->m_timeline;
+			td->m_timelineCapacity = data.m_timelineCapacity;
+			td->m_timeline = new TimelineEvent[td->m_timelineCapacity];
+		}
+		
+		td->m_timelineDepth = 0;
+		td->m_timelineDropDepth = 0;
+		td->m_timelineDropped = 0;
+		StoreRelease(&td->m_timelineCount,0);
+		StoreRelease(&td->m_timelineGeneration,generation);
+		return true;
+	}
+	
+	static void TimelinePush(ProfilerThreadData * td,const int index,const uint64 time)
+	{
+		if ( ! TimelineSetup(td) )
+			return;
+		
+		const int count = td->m_timelineCount;
+		
+		// keep room for the End of everything that's open , including this one :
+		if ( td->m_timelineDropDepth > 0 ||
+			td->m_timelineDepth == PROFILER_TIMELINE_MAX_DEPTH ||
+			count + td->m_timelineDepth + 2 > td->m_timelineCapacity )
+		{
+			td->m_timelineDropDepth++;
+			td->m_timelineDropped++;
+			return;
+		}
+		
+		TimelineEvent & ev = td->m_timeline[count];
+		ev.m_time = time;
+		ev.m_value = 0.0;
+		ev.m_index = index;
+		ev.m_type = eTimeline_Begin;
+		
+		td->m_timelineOpen[ td->m_timelineDepth++ ] = count;
+		StoreRelease(&td->m_timelineCount,count+1);
+	}
+	
+	static void TimelinePop(ProfilerThreadData * td,const int index,const uint64 delta)
+	{
+		// a capture started inside this block :
+		if ( td->m_timelineGeneration != ProfilerData::Instance().m_timelineGeneration )
+			return;
+		
+		if ( td->m_timelineDropDepth > 0 )
+		{
+			td->m_timelineDropDepth--;
+			return;
+		}
+		
+		ASSERT( td->m_timelineDepth > 0 );
+		const TimelineEvent & begin = td->m_timeline[ td->m_timelineOpen[ --td->m_timelineDepth ] ];
+		ASSERT( begin.m_index == index );
+		
+		const int count = td->m_timelineCount;
+		ASSERT( count < td->m_timelineCapacity );
+		
+		TimelineEvent & ev = td->m_timeline[count];
+		ev.m_time = begin.m_time + delta;
+		ev.m_value = 0.0;
+		ev.m_index = index;
+		ev.m_type = eTimeline_End;
+		
+		StoreRelease(&td->m_timelineCount,count+1);
+	}
+
 } // file-only namespace
 
 //! default is "Disabled"
@@ -323,7 +603,10 @@ int Profiler::Index(const char * const name)
 {
 	// have to do this even when we're disabled, or we'll screw up the indexing for the future;
 	//  this should only be done in local statics, though, so it doesn't affect our cost
-	charptr_int_map & map = ProfilerData::Instance().m_nameMap;
+	ProfilerData & data = ProfilerData::Instance();
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
+	charptr_int_map & map = data.m_nameMap;
 	const charptr_int_map::const_iterator it = map.find(name);
 	if ( it != map.end() )
 	{
@@ -331,39 +614,52 @@ int Profiler::Index(const char * const name)
 	}
 	else
 	{
-		const int index = ProfilerData::Instance().m_entries.size32();
+		const int index = data.m_entries.size32();
 		ASSERT( index > 0 );
-		ProfilerData::Instance().m_entries.push_back( ProfilerEntry(name) );
+		ASSERT( index < PROFILER_MAX_ENTRIES );
+		data.m_entries.push_back( ProfilerEntry(name) );
 		map.insert( charptr_int_pair(name,index) );
 		ASSERT( map.find(name) != map.end() );
 		return index;
 	}
 }
 
+void Profiler::SetThreadName(const char * name)
+{
+	ProfilerThreadData * td = GetMyThreadData();
+	strncpy(td->m_name,name,sizeof(td->m_name));
+	td->m_name[sizeof(td->m_name)-1] = 0;
+}
+
 //! Push & Pop timer blocks
 void Profiler::Push(const int index,const char * const name,uint64 time)
 {
 	ASSERT( g_enabled );
 
-	ProfilerData & data = ProfilerData::Instance();
+	ProfilerThreadData * td = GetMyThreadData();
+	
+	// pick up a Reset from another thread :
+	const uint32 generation = ProfilerData::Instance().m_generation;
+	if ( td->m_generation != generation )
+		td->Reset(generation);
 
 	ASSERT( index > 0 );
 	#ifdef PROFILE_RECORDS
-	data.m_records.push_back( ProfileRecord(index,time) );
+	td->m_records.push_back( ProfileRecord(index,time) );
 	#endif	
 
+	if ( g_timeline )
+		TimelinePush(td,index,time);
+
 	#ifdef PROFILE_NODES
 	// match strings by pointer !! requires merging of constant strings !!
-	if ( name != data.m_curNode->m_name )
+	if ( name != td->m_curNode->m_name )
 	{
-		data.m_curNode = data.m_curNode->GetChild(name,index);
+		td->m_curNode = td->m_curNode->GetChild(name,index);
 	}
 
-	data.m_curNode->Enter();
+	td->m_curNode->Enter();
 	#endif
-
-	// m_stack is a vector_s , so no allocation is possible	
-	//ProfilerData::Instance().m_stack.push_back(index);
 }
 
 void Profiler::Pop(int index, const uint64 delta)
@@ -371,41 +667,54 @@ void Profiler::Pop(int index, const uint64 delta)
 	//ASSERT( g_enabled );
 	ASSERT( index > 0 );
 
-	ProfilerData & data = ProfilerData::Instance();
+	// Push made it :
+	ProfilerThreadData * td = s_myThreadData;
+	ASSERT( td != NULL );
 
 	#ifdef PROFILE_RECORDS
-	data.m_records.push_back( ProfileRecord(- index,delta) );
+	td->m_records.push_back( ProfileRecord(- index,delta) );
 	#endif
 	
 	#ifdef PROFILE_NODES
-	if ( data.m_curNode && data.m_curNode->m_index == index )
+	if ( td->m_curNode && td->m_curNode->m_index == index )
 	{
-		if ( data.m_curNode->Leave(delta) )
+		if ( td->m_curNode->Leave(delta) )
 		{
-			data.m_curNode = data.m_curNode->m_parent;
-			ASSERT( data.m_curNode != NULL );
+			td->m_curNode = td->m_curNode->m_parent;
+			ASSERT( td->m_curNode != NULL );
 		}
 	}
 	#endif
 	
-	data.m_entries[index].Increment(delta);
-		
-	/*
-	// this can happen due to enable toggles while the stack is active
-	if ( ! data.m_stack.empty() )
+	ProfilerCounter * counter = td->GetCounter(index);
+	counter->m_time += delta;
+	counter->m_count ++;
+	
+	if ( s_histograms )
 	{
-		int top = data.m_stack.back();
-		data.m_stack.pop_back();
-
-		data.m_entries[top].Increment(delta);
+		ProfileHistogram * histogram = counter->m_histogram;
+		if ( histogram == NULL )
+		{
+			histogram = new ProfileHistogram;
+			StoreReleasePointer(&counter->m_histogram,histogram);
+		}
+		histogram->Add(delta);
 	}
-	*/
+	
+	// not checking g_timeline so blocks open at StopTimeline still get their End :
+	if ( td->m_timelineDepth + td->m_timelineDropDepth > 0 )
+		TimelinePop(td,index,delta);
 }
 
 void Profiler::Reset()
 {
 	ProfilerData & data = ProfilerData::Instance();
 	data.Reset();
+	
+	// the calling thread can reset right away ; the others do it at their next Push
+	ProfilerThreadData * td = s_myThreadData;
+	if ( td )
+		td->Reset(data.m_generation);
 }
 
 void Profiler::Frame()
@@ -434,11 +743,12 @@ void Profiler::ViewAscend()
 {
 	#ifdef PROFILE_NODES
 	ProfilerData & data = ProfilerData::Instance();
+	ProfilerThreadData * td = GetMyThreadData();
 	if ( data.m_showNodes )
 	{
-		if ( data.m_inspectNode->m_parent )
+		if ( td->m_inspectNode->m_parent )
 		{
-			data.m_inspectNode = data.m_inspectNode->m_parent;
+			td->m_inspectNode = td->m_inspectNode->m_parent;
 		}
 	}
 	#endif
@@ -448,9 +758,10 @@ void Profiler::ViewDescend(int which)
 {
 	#ifdef PROFILE_NODES
 	ProfilerData & data = ProfilerData::Instance();
+	ProfilerThreadData * td = GetMyThreadData();
 	if ( data.m_showNodes )
 	{	
-		ProfileNode * child = data.m_inspectNode->m_child;
+		ProfileNode * child = td->m_inspectNode->m_child;
 
 		ASSERT( which >= 0 );
 		if ( which < 0 )
@@ -462,7 +773,7 @@ void Profiler::ViewDescend(int which)
 				return;
 			if ( which == 0 )
 			{
-				data.m_inspectNode = child;
+				td->m_inspectNode = child;
 				return;
 			}
 			child = child->m_sibling;
@@ -499,10 +810,85 @@ static void	AddNodes(vecsorted< vector_s< ProfileNode, NUM_ENTRIES_TO_SHOW >, co
 	AddNodes(result, node->m_child);
 }
 
+/** Sum the children of "from" into the children of "to" , matching by name ;
+	used to make the all-threads tree for Report */
+static void	MergeNodes(ProfileNode * to, const ProfileNode * from)
+{
+	const ProfileNode * child = LoadAcquirePointer(&from->m_child);
+	while ( child != NULL )
+	{
+		ProfileNode * into = to->GetChild(child->m_name,child->m_index);
+		into->m_time += child->m_time;
+		into->m_count += child->m_count;
+		MergeNodes(into,child);
+		child = child->m_sibling;
+	}
+}
+
+static void	DeleteNodeChildren(ProfileNode * node)
+{
+	ProfileNode * child = node->m_child;
+	while ( child != NULL )
+	{
+		ProfileNode * next = child->m_sibling;
+		DeleteNodeChildren(child);
+		delete child;
+		s_numNodes--;
+		child = next;
+	}
+	node->m_child = NULL;
+}
+
+/** Fill "entries" with the names from data.m_entries and the counts of one thread ,
+	or of all current threads if td is NULL ; call with data.m_lock held
+	histograms (by index) are filled too if it's not NULL */
+static void GatherEntries(vector< ProfilerEntry > * entries, vector< Profiler::ProfileHistogram > * histograms, const ProfilerThreadData * td)
+{
+	ProfilerData & data = ProfilerData::Instance();
+	
+	const int n = data.m_entries.size32();
+	entries->resize(n);
+	for(int i=0;i<n;i++)
+	{
+		(*entries)[i].m_name = data.m_entries[i].m_name;
+		(*entries)[i].m_index = i;
+		(*entries)[i].Reset();
+	}
+	
+	if ( histograms )
+	{
+		histograms->resize(n);
+		for(int i=0;i<n;i++)
+		{
+			(*histograms)[i].Clear();
+		}
+	}
+
+	for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+	{
+		if ( td != NULL && t != td )
+			continue;
+		if ( ! IsCurrent(t) )
+			continue;
+		
+		for(int i=1;i<n;i++)
+		{
+			ProfilerCounter c;
+			if ( t->ReadCounter(i,&c) )
+			{
+				(*entries)[i].m_time += c.m_time;
+				(*entries)[i].m_count += c.m_count;
+				if ( histograms && c.m_histogram )
+					(*histograms)[i].Accumulate(*c.m_histogram);
+			}
+		}
+	}
+}
+
 namespace Profiler
 {
-	void ReportNodes(const ProfileNode * pNode,bool recurse);
-	void ReportEntries(bool dumpAll);
+	void ReportNodes(const ProfileNode * pNode,const ProfileNode * pRoot,bool recurse);
+	void ReportEntries(const vector< ProfilerEntry > & entries,const vector< ProfileHistogram > * histograms,bool dumpAll);
 };
 
 void Profiler::SetReportNodes(bool enable)
@@ -513,6 +899,14 @@ bool Profiler::GetReportNodes()
 {	
 	return ProfilerData::Instance().m_showNodes;
 }
+
+static void ReportThreadHeader(const ProfilerThreadData * td)
+{
+	if ( td->m_name[0] )
+		lprintf("------ thread %d (%s)\n",td->m_threadIndex,td->m_name);
+	else
+		lprintf("------ thread %d\n",td->m_threadIndex);
+}
 	
 //! Spew it out to a report
 void Profiler::Report(bool dumpAll /* = false */)
@@ -542,22 +936,79 @@ void Profiler::Report(bool dumpAll /* = false */)
 		data.m_secondsSinceReset,data.m_framesSinceReset,
 		double(frames)/secondsSinceReset, secondsSinceReset*1000.0/double(frames) );
 
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
+	int numThreads = 0;
+	for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+	{
+		if ( IsCurrent(t) )
+			numThreads++;
+	}
+
 	#ifdef PROFILE_NODES
 	if ( data.m_showNodes )
 	{
 		if ( dumpAll )
 		{
-			ReportNodes(&data.m_root,true);
+			if ( numThreads > 1 )
+			{
+				lprintf("------ all threads\n");
+				
+				ProfileNode merged("root",-1,NULL);
+				for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+				{
+					if ( IsCurrent(t) )
+						MergeNodes(&merged,&t->m_root);
+				}
+				// merged time can be more than wall time ,
+				//	so the root's time is the sum of its children instead of the elapsed time :
+				for(const ProfileNode * child = merged.m_child; child != NULL; child = child->m_sibling)
+					merged.m_time += child->m_time;
+				ReportNodes(&merged,NULL,true);
+				DeleteNodeChildren(&merged);
+				s_numNodes--;
+			}
+			
+			for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+			{
+				if ( ! IsCurrent(t) )
+					continue;
+				if ( numThreads > 1 )
+					ReportThreadHeader(t);
+				ReportNodes(&t->m_root,&t->m_root,true);
+			}
 		}
 		else
 		{
-			ReportNodes(data.m_inspectNode,false);
+			// the HUD view walks the calling thread's tree :
+			ProfilerThreadData * td = s_myThreadData;
+			if ( td != NULL )
+				ReportNodes(td->m_inspectNode,&td->m_root,false);
 		}
 	}
 	else
 	#endif
 	{
-		ReportEntries(dumpAll);
+		vector< ProfilerEntry > entries;
+		vector< ProfileHistogram > histogramStorage;
+		vector< ProfileHistogram > * histograms = s_histograms ? &histogramStorage : NULL;
+		
+		if ( numThreads > 1 )
+			lprintf("------ all threads\n");
+		GatherEntries(&entries,histograms,NULL);
+		ReportEntries(entries,histograms,dumpAll);
+		
+		if ( numThreads > 1 )
+		{
+			for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+			{
+				if ( ! IsCurrent(t) )
+					continue;
+				ReportThreadHeader(t);
+				GatherEntries(&entries,histograms,t);
+				ReportEntries(entries,histograms,dumpAll);
+			}
+		}
 	}
 	
 	//MemorySystem::LogAllAllocations("Profiler Report",data.m_secondsLastReset);
@@ -577,7 +1028,7 @@ void Profiler::Report(bool dumpAll /* = false */)
 }
 
 
-void Profiler::ReportNodes(const ProfileNode * pNodeToShow,bool recurse)
+void Profiler::ReportNodes(const ProfileNode * pNodeToShow,const ProfileNode * pRoot,bool recurse)
 {
 	// sort and only show the top 20 or so
 	ProfilerData & data = ProfilerData::Instance();
@@ -589,7 +1040,7 @@ void Profiler::ReportNodes(const ProfileNode * pNodeToShow,bool recurse)
 		return;
 	
 	double secondsParent;
-	if ( pNodeToShow == &(data.m_root) )
+	if ( pNodeToShow == pRoot )
 	{
 		secondsParent = secondsSinceReset;
 	}
@@ -615,11 +1066,11 @@ void Profiler::ReportNodes(const ProfileNode * pNodeToShow,bool recurse)
 
 	//vecsorted< vector_s< ProfileNode, NUM_ENTRIES_TO_SHOW >, compare_ProfileNode_by_seconds > entries;
 	//vector_s< ProfileNode *, NUM_ENTRIES_TO_SHOW > entries;
-	vector< ProfileNode * > entries;
+	vector< const ProfileNode * > entries;
 	entries.reserve(32);
 
 	// Use entries in the currently selected branch.
-	ProfileNode * child = pNodeToShow->m_child;
+	const ProfileNode * child = LoadAcquirePointer(&pNodeToShow->m_child);
 	while( child != NULL )
 	{
 		// Sorting fucks up the HUD descent, because it indexes by the normal indexing order
@@ -667,7 +1118,7 @@ void Profiler::ReportNodes(const ProfileNode * pNodeToShow,bool recurse)
 		{
 			if ( entry.m_child != NULL )
 			{
-				ReportNodes(&entry,true);	
+				ReportNodes(&entry,pRoot,true);	
 			}
 		}
 	}
@@ -692,22 +1143,16 @@ void Profiler::ReportNodes(const ProfileNode * pNodeToShow,bool recurse)
 		LogPopTab();
 }
 
-void Profiler::ReportEntries(bool dumpAll)
+void Profiler::ReportEntries(const vector< ProfilerEntry > & allEntries,const vector< ProfileHistogram > * histograms,bool dumpAll)
 {
 	// sort and only show the top 20 or so
 
 	ProfilerData & data = ProfilerData::Instance();
-	/*
-	if ( ! data.m_stack.empty() )
-	{
-		lprintf("Report on non-empty stack will not be fully accurate!!\n");
-	}
-	*/
 	
 	const double secondsSinceReset = data.m_secondsSinceReset;
 	const int frames = data.m_framesSinceReset;
 	
-	const int n = data.m_entries.size32();
+	const int n = allEntries.size32();
 	if ( n == 0 || frames == 0 )
 	{
 		lprintf("Nothing to report!!\n");
@@ -722,7 +1167,7 @@ void Profiler::ReportEntries(bool dumpAll)
 
 	if ( dumpAll )
 	{
-		entries_v.assignv(data.m_entries);
+		entries_v.assignv(allEntries);
 		std::sort( entries_v.begin(), entries_v.end(), compare_ProfilerEntry_by_seconds() );
 		pEntries = entries_v.data();
 		numEntries = n;
@@ -731,7 +1176,7 @@ void Profiler::ReportEntries(bool dumpAll)
 	{
 		for(int i=0;i<n;i++)
 		{
-			const ProfilerEntry & entry = data.m_entries[i];
+			const ProfilerEntry & entry = allEntries[i];
 			if ( entries_s.size() < NUM_ENTRIES_TO_SHOW )
 			{
 				entries_s.insert(entry);
@@ -746,7 +1191,10 @@ void Profiler::ReportEntries(bool dumpAll)
 		numEntries = entries_s.size32();
 	}
 
-	lprintf("%-40s : percent : millis: kclocks : counts\n","name");
+	if ( histograms )
+		lprintf("%-40s : percent : millis: kclocks : counts :   p50   :   p90   :   p99   :  p999   :   max   (micros)\n","name");
+	else
+		lprintf("%-40s : percent : millis: kclocks : counts\n","name");
 
 	for(int i=0;i<numEntries;i++)
 	{
@@ -759,12 +1207,30 @@ void Profiler::ReportEntries(bool dumpAll)
 		double kclocksPerCount = ( entry.m_time ) / ( 1000.0 * entry.m_count );
 		double countsPerFrame = entry.m_count / double(frames);
 
-		lprintf("%-40s : %-5.1f %% : %-5.2f : %-7.1f : %5.1f\n",
-			entry.m_name,
-			percent,
-			millisPerFrame,
-			kclocksPerCount,
-			countsPerFrame);
+		if ( histograms )
+		{
+			const ProfileHistogram & h = (*histograms)[entry.m_index];
+			lprintf("%-40s : %-5.1f %% : %-5.2f : %-7.1f : %5.1f : %7.1f : %7.1f : %7.1f : %7.1f : %7.1f\n",
+				entry.m_name,
+				percent,
+				millisPerFrame,
+				kclocksPerCount,
+				countsPerFrame,
+				TimeToSeconds( h.GetPercentile(0.5) ) * 1000000.0,
+				TimeToSeconds( h.GetPercentile(0.9) ) * 1000000.0,
+				TimeToSeconds( h.GetPercentile(0.99) ) * 1000000.0,
+				TimeToSeconds( h.GetPercentile(0.999) ) * 1000000.0,
+				TimeToSeconds( h.GetMax() ) * 1000000.0);
+		}
+		else
+		{
+			lprintf("%-40s : %-5.1f %% : %-5.2f : %-7.1f : %5.1f\n",
+				entry.m_name,
+				percent,
+				millisPerFrame,
+				kclocksPerCount,
+				countsPerFrame);
+		}
 	}
 }
 
@@ -774,13 +1240,23 @@ void Profiler::GetEntry(const int index, uint64 * pTime, int* pCount)
 	ASSERT( pCount );
 
 	ProfilerData & data = ProfilerData::Instance();
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
 
 	ASSERT( 0 <= index );
 	ASSERT( index < data.m_entries.size32() );
 
-	const ProfilerEntry& entry = data.m_entries[index];
-	*pTime = entry.m_time;
-	*pCount = entry.m_count;
+	// sum of all threads :
+	*pTime = 0;
+	*pCount = 0;
+	for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+	{
+		ProfilerCounter c;
+		if ( IsCurrent(t) && t->ReadCounter(index,&c) )
+		{
+			*pTime += c.m_time;
+			*pCount += c.m_count;
+		}
+	}
 }
 
 void Profiler::WriteRecords(const char * fileName)
@@ -790,9 +1266,13 @@ void Profiler::WriteRecords(const char * fileName)
 		return;
 	
 	ProfilerData & data = ProfilerData::Instance();
+	ProfilerThreadData * td = GetMyThreadData();
 
 	// write entry names :
 	
+	{
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
 	f.Put32( data.m_entries.size32() );
 	
 	for(int i=0; i< data.m_entries.size32(); i++)
@@ -802,12 +1282,13 @@ void Profiler::WriteRecords(const char * fileName)
 		else
 			f.WriteCString( "" ); 
 	}
+	}
 	
-	f.Put32( data.m_records.size32() );
+	f.Put32( td->m_records.size32() );
 	
-	if ( ! data.m_records.empty() )
+	if ( ! td->m_records.empty() )
 	{
-		f.Write( data.m_records.data(), data.m_records.size_bytes() );
+		f.Write( td->m_records.data(), td->m_records.size_bytes() );
 	}
 	
 	f.Close();
@@ -820,9 +1301,13 @@ void Profiler::ReadRecords( const char * fileName)
 		return;
 		
 	ProfilerData & data = ProfilerData::Instance();
+	ProfilerThreadData * td = GetMyThreadData();
 
 	// read entry names :
 	
+	{
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
 	uint32 numEntries = f.Get32();
 	data.m_entries.resize(numEntries);
 	
@@ -831,28 +1316,313 @@ void Profiler::ReadRecords( const char * fileName)
 		data.m_entries[i].m_string = f.ReadString();
 		data.m_entries[i].m_name = data.m_entries[i].m_string.CStr(); 
 	}
+	}
 	
 	uint32 numRecords = f.Get32();
-	data.m_records.resize(numRecords);
+	td->m_records.resize(numRecords);
 	
-	f.Read( data.m_records.data(), data.m_records.size_bytes() );
+	f.Read( td->m_records.data(), td->m_records.size_bytes() );
 	
 	f.Close();
 }
 	
 const Profiler::ProfileRecord * Profiler::GetRecords(int * pCount)
+{
+	ProfilerThreadData * td = GetMyThreadData();
+	*pCount = td->m_records.size32();
+	return td->m_records.data();
+}
+
+//-------------------------------------------------------------------------------------------
+
+static int HistogramTopBit(const uint64 x)
+{
+	unsigned long index;
+	const uint32 hi = (uint32)(x >> 32);
+	if ( hi )
+	{
+		_BitScanReverse(&index,hi);
+		return (int)index + 32;
+	}
+	_BitScanReverse(&index,(uint32)x);
+	return (int)index;
+}
+
+static int HistogramBucket(const uint64 time)
+{
+	typedef Profiler::ProfileHistogram H;
+	const uint64 sub = 1 << H::c_subBits;
+	if ( time < sub )
+		return (int)time;
+	if ( time >> H::c_maxBits )
+		return H::c_numBuckets - 1;
+	// time>>shift is in [sub,2*sub) :
+	const int shift = HistogramTopBit(time) - H::c_subBits;
+	return ((shift+1) << H::c_subBits) + (int)((time >> shift) - sub);
+}
+
+static uint64 HistogramBucketLow(const int bucket)
+{
+	typedef Profiler::ProfileHistogram H;
+	const int sub = 1 << H::c_subBits;
+	if ( bucket < sub )
+		return bucket;
+	const int shift = (bucket >> H::c_subBits) - 1;
+	return ((uint64)(sub + (bucket & (sub-1)))) << shift;
+}
+
+static uint64 HistogramBucketWidth(const int bucket)
+{
+	typedef Profiler::ProfileHistogram H;
+	if ( bucket < (1 << H::c_subBits) )
+		return 1;
+	return ((uint64)1) << ((bucket >> H::c_subBits) - 1);
+}
+
+void Profiler::ProfileHistogram::Clear()
+{
+	m_count = 0;
+	m_max = 0;
+	memset(m_buckets,0,sizeof(m_buckets));
+}
+
+void Profiler::ProfileHistogram::Add(const uint64 time)
+{
+	m_buckets[ HistogramBucket(time) ] ++;
+	m_count ++;
+	if ( time > m_max )
+		m_max = time;
+}
+
+void Profiler::ProfileHistogram::Accumulate(const ProfileHistogram & other)
+{
+	for LOOP(b,c_numBuckets)
+	{
+		m_buckets[b] += other.m_buckets[b];
+	}
+	m_count += other.m_count;
+	m_max = MAX(m_max,other.m_max);
+}
+
+void Profiler::ProfileHistogram::Subtract(const ProfileHistogram & earlier)
+{
+	m_count = 0;
+	int top = -1;
+	for LOOP(b,c_numBuckets)
+	{
+		// clamp ; "earlier" can be from before a Reset
+		m_buckets[b] = ( m_buckets[b] > earlier.m_buckets[b] ) ? m_buckets[b] - earlier.m_buckets[b] : 0;
+		m_count += m_buckets[b];
+		if ( m_buckets[b] )
+			top = b;
+	}
+	
+	// the exact max might have been in "earlier" ; the bucket bounds it
+	if ( top < 0 )
+		m_max = 0;
+	else
+		m_max = MIN(m_max,HistogramBucketLow(top) + HistogramBucketWidth(top) - 1);
+}
+
+uint64 Profiler::ProfileHistogram::GetPercentile(const double fraction) const
+{
+	if ( m_count == 0 )
+		return 0;
+	
+	uint64 target = (uint64)( fraction * (double)m_count + 0.5 );
+	target = MAX(target,(uint64)1);
+	target = MIN(target,m_count);
+	
+	uint64 sum = 0;
+	for LOOP(b,c_numBuckets)
+	{
+		sum += m_buckets[b];
+		if ( sum >= target )
+		{
+			const uint64 mid = HistogramBucketLow(b) + HistogramBucketWidth(b)/2;
+			return MIN(mid,m_max);
+		}
+	}
+	return m_max;
+}
+
+void Profiler::SetHistograms(const bool yesNo)
+{
+	s_histograms = yesNo;
+}
+
+bool Profiler::GetHistograms()
+{
+	return s_histograms;
+}
+
+bool Profiler::GetHistogram(const int index, ProfileHistogram * pInto)
+{
+	ASSERT( pInto );
+	pInto->Clear();
+
+	ProfilerData & data = ProfilerData::Instance();
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
+	ASSERT( 0 < index && index < data.m_entries.size32() );
+	
+	bool any = false;
+	for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+	{
+		ProfilerCounter c;
+		if ( IsCurrent(t) && t->ReadCounter(index,&c) && c.m_histogram )
+		{
+			pInto->Accumulate(*c.m_histogram);
+			any = true;
+		}
+	}
+	return any;
+}
+
+//-------------------------------------------------------------------------------------------
+
+void Profiler::StartTimeline(const int maxEventsPerThread)
 {
 	ProfilerData & data = ProfilerData::Instance();
-	*pCount = data.m_records.size32();
-	return data.m_records.data();
+	// WriteChromeTrace holds m_lock ; a new generation would make threads free the buffers it's reading
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
+	data.m_timelineCapacity = MAX(maxEventsPerThread,16);
+	data.m_timelineStartTime = GetTimer();
+	// threads set up their buffers at their next Push :
+	StoreRelease(&data.m_timelineGeneration,data.m_timelineGeneration+1);
+	g_timeline = true;
+}
+
+void Profiler::StopTimeline()
+{
+	g_timeline = false;
+}
+
+void Profiler::TimelineCounter(const int index,const double value)
+{
+	ProfilerThreadData * td = GetMyThreadData();
+	if ( ! TimelineSetup(td) )
+		return;
+	
+	const int count = td->m_timelineCount;
+	if ( count + td->m_timelineDepth + 1 > td->m_timelineCapacity )
+	{
+		td->m_timelineDropped++;
+		return;
+	}
+	
+	TimelineEvent & ev = td->m_timeline[count];
+	ev.m_time = GetTimer();
+	ev.m_value = value;
+	ev.m_index = index;
+	ev.m_type = eTimeline_Counter;
+	
+	StoreRelease(&td->m_timelineCount,count+1);
+}
+
+bool Profiler::WriteChromeTrace(const char * fileName)
+{
+	File f;
+	if ( ! f.Open(fileName,"wb") )
+		return false;
+	
+	ProfilerData & data = ProfilerData::Instance();
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
+	
+	const uint32 generation = data.m_timelineGeneration;
+	const double microsPerTick = TimeToSeconds(1) * 1000000.0;
+	const char * const prefix = ",\n";
+	
+	StringBuilder sb(256*1024);
+	sb.Append("{\"traceEvents\":[\n");
+	
+	bool first = true;
+	bool ok = true;
+	int dropped = 0;
+	
+	for(const ProfilerThreadData * t = data.m_threads; t != NULL; t = t->m_next)
+	{
+		if ( LoadAcquire(&t->m_timelineGeneration) != generation || t->m_timeline == NULL )
+			continue;
+			
+		const int tid = t->m_threadIndex;
+		
+		if ( ! first )
+			sb.Append(prefix);
+		first = false;
+		
+		sb.CatPrintf("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",tid);
+		if ( t->m_name[0] )
+		{
+			sb.AppendJSONString(t->m_name);
+		}
+		else
+		{
+			sb.CatPrintf("\"thread %d\"",tid);
+		}
+		sb.Append("}}");
+		
+		const int count = LoadAcquire(&t->m_timelineCount);
+		dropped += t->m_timelineDropped;
+		
+		for(int i=0;i<count;i++)
+		{
+			const TimelineEvent & ev = t->m_timeline[i];
+			
+			// signed , threads' TSC's can be a little behind the start :
+			const double ts = (double)(int64)(ev.m_time - data.m_timelineStartTime) * microsPerTick;
+			const char * name = data.m_entries[ev.m_index].m_name;
+			
+			sb.Append(prefix);
+			sb.Append("{\"name\":");
+			sb.AppendJSONString(name ? name : "");
+			
+			switch(ev.m_type)
+			{
+			case eTimeline_Begin:
+				sb.CatPrintf(",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",ts,tid);
+				break;
+			case eTimeline_End:
+				sb.CatPrintf(",\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",ts,tid);
+				break;
+			case eTimeline_Counter:
+				sb.CatPrintf(",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":",ts,tid);
+				sb.AppendJSONNumber(ev.m_value);
+				sb.Append("}}");
+				break;
+			default:
+				ASSERT(false);
+				break;
+			}
+			
+			// don't hold a whole capture in memory :
+			if ( sb.Length() >= 1024*1024 )
+			{
+				ok = sb.WriteText(f) && ok;
+				sb.Clear();
+			}
+		}
+	}
+	
+	sb.CatPrintf("\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"droppedEvents\":%d}\n}\n",dropped);
+	ok = sb.WriteText(f) && ok;
+	
+	f.Close();
+	
+	if ( dropped > 0 )
+		lprintf("Profiler::WriteChromeTrace : %d events dropped (buffers full)\n",dropped);
+	
+	return ok;
 }
 
 const char * Profiler::GetEntryName(int index)
 {
 	ProfilerData & data = ProfilerData::Instance();
+	CB_SCOPE_CRITICAL_SECTION(data.m_lock);
 	if ( index < 0 || index >= data.m_entries.size() )
 		return NULL; 
 	return data.m_entries[index].m_name;
 }
 
-END_CB
\ No newline at end of file
+END_CB
@@ -25,6 +25,12 @@ Basically a "frame" is one processing block, then Profiler will count things as
 For example if you're processing database records, you call Profiler::Frame() for each record and the report will then
 	give you information in terms of how long per record.
 
+-------------------------------------
+
+PROFILE can be used from any thread ; each thread counts into its own data , with no locks.
+Report shows the sum of all threads and then each thread on its own.
+Frame/Reset/Report/SetEnabled should all be called from one thread (your main loop).
+
 *******************/
 
 // @@ toggle here : ; uses QPC if you don't want TSC
@@ -67,6 +73,9 @@ namespace Profiler
 	void Pop( const int index,const uint64 delta);
 	int Index(const char * const name);
 
+	//! optional label for the calling thread in Report
+	void SetThreadName(const char * name);
+
 	//! clear the counts
 	void Reset();
 
@@ -82,6 +91,7 @@ namespace Profiler
 	
 	//-------------------------------------------------------------------------------------------
 	
+	//! records are per-thread ; these read & write the calling thread's
 	void WriteRecords(const char * fileName);
 	void ReadRecords( const char * fileName);
 	
@@ -143,10 +153,69 @@ namespace Profiler
 	#pragma pack(pop)
 	COMPILER_ASSERT( sizeof(ProfileRecord) == 12 );
 	
-	const ProfileRecord * GetRecords(int * pCount);
+	const ProfileRecord * GetRecords(int * pCount); // calling thread's
 	const char * GetEntryName(int index);
 	
 	//-------------------------------------------------------------------------------------------
+	// Latency histograms :
+	//	log-linear buckets (like HdrHistogram) : exact below 32 ticks , then 32 buckets per power of 2 ,
+	//	so any percentile is within about 3% ; times over 2^40 ticks go in the top bucket
+	
+	class ProfileHistogram
+	{
+	public:
+		enum { c_subBits = 5, c_maxBits = 40 };
+		enum { c_numBuckets = (c_maxBits - c_subBits + 1) << c_subBits };
+		
+		ProfileHistogram() { Clear(); }
+		
+		void Clear();
+		void Add(const uint64 time);
+		
+		//! this += other (eg. to merge threads)
+		void Accumulate(const ProfileHistogram & other);
+		//! this -= earlier ; turns a later snapshot into the diff from an earlier one
+		void Subtract(const ProfileHistogram & earlier);
+		
+		uint64 GetCount() const { return m_count; }
+		//! fraction in [0,1] , eg. 0.99 for p99 ; returns a time in GetTimer() units (mid-bucket)
+		uint64 GetPercentile(const double fraction) const;
+		uint64 GetMax() const { return m_max; }
+		
+	private:
+		uint64	m_count;
+		uint64	m_max;
+		uint32	m_buckets[c_numBuckets];
+	};
+	
+	//! histograms are off by default ; they cost one ProfileHistogram per entry per thread
+	//	when on , Report adds p50/p90/p99/p999/max columns to the entry view
+	void SetHistograms(const bool yesNo);
+	bool GetHistograms();
+	
+	//! all threads merged , since the last Reset ; false if there is none for this index
+	//	copy it into your own ProfileHistogram to keep a snapshot , then Subtract to diff
+	bool GetHistogram(const int index, ProfileHistogram * pInto);
+
+	//-------------------------------------------------------------------------------------------
+	// Timeline capture :
+	//	while a capture is on , each Push/Pop (when enabled) also goes into a buffer for that thread
+	//	the buffer is allocated once per thread per capture ; when it's full further events are dropped
+	//	WriteChromeTrace writes Chrome Trace Event JSON (loads in chrome://tracing or ui.perfetto.dev)
+
+	void StartTimeline(const int maxEventsPerThread = 256*1024);
+	void StopTimeline();
+	
+	extern bool g_timeline; // like g_enabled , for the PROFILE_COUNTER check
+
+	//! a value that's graphed over time in the trace ; use the PROFILE_COUNTER macro
+	void TimelineCounter(const int index,const double value);
+
+	//! call after StopTimeline ; a StartTimeline on another thread waits until it's done
+	//	returns false if the file couldn't be opened or written
+	bool WriteChromeTrace(const char * fileName);
+
+	//-------------------------------------------------------------------------------------------
 	
 
 };
@@ -163,6 +232,9 @@ cb::Profiler::AutoTimer profile_of_##Name(s_index_##Name,_Stringize(Name))
 static int s_index_##Name = cb::Profiler::Index(_Stringize(Name)); \
 cb::Profiler::AutoTimer profile_of_##Name(s_index_##Name,_Stringize(Name))
 
+#define PROFILE_COUNTER(Name,value) \
+do { static int s_counter_##Name = cb::Profiler::Index(_Stringize(Name)); \
+if ( cb::Profiler::g_timeline ) cb::Profiler::TimelineCounter(s_counter_##Name,(double)(value)); } while(0)
 
 #else //}{
 
@@ -170,4 +242,6 @@ cb::Profiler::AutoTimer profile_of_##Name(s_index_##Name,_Stringize(Name))
 
 #define PROFILE_FN(Name)
 
+#define PROFILE_COUNTER(Name,value)
+
 #endif //} FINAL
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Base.h"
+#include "FastPrintf.h"
 #include <stdio.h>
 
 /****
@@ -243,7 +244,7 @@ inline const char * checkarg(const char *fmt_base,const char *fmt,const t_arg &
 //=============================================================================================
 
 #define SPI_SAFEDECL int safeprintf
-#define SPI_CALLRAW return printf
+#define SPI_CALLRAW return fastprintf
 #define SPI_PREARG
 #define SPI_CALLARG fmt
 #define SPI_BADRETURN return 0;
@@ -255,7 +256,7 @@ inline const char * checkarg(const char *fmt_base,const char *fmt,const t_arg &
 #undef SPI_BADRETURN
 
 #define SPI_SAFEDECL int safesprintf
-#define SPI_CALLRAW return sprintf
+#define SPI_CALLRAW return fastsprintf
 #define SPI_PREARG char * into,
 #define SPI_CALLARG into,fmt
 #define SPI_BADRETURN return 0;
@@ -267,7 +268,7 @@ inline const char * checkarg(const char *fmt_base,const char *fmt,const t_arg &
 #undef SPI_BADRETURN
 
 #define SPI_SAFEDECL int safefprintf
-#define SPI_CALLRAW return fprintf
+#define SPI_CALLRAW return fastfprintf
 #define SPI_PREARG FILE * into,
 #define SPI_CALLARG into,fmt
 #define SPI_BADRETURN return 0;
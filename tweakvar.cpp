@@ -5,6 +5,7 @@
 #include "FileUtil.h"
 #include "Log.h"
 #include "MoreUtil.h"
+#include "DirChangeWatcher.h"
 
 /*************
 
@@ -233,6 +234,50 @@ bool TweakVarSingleton::CheckChanges()
 	return anyChanged;	
 }
 
+bool TweakVarSingleton::CheckChanges(const vector<DirChangeRecord> & changes)
+{
+	TweakVarSingletonImpl * pimpl = (TweakVarSingletonImpl *)this;
+
+	// the watcher lost events ; can't trust the list , go poll
+	for(int c=0;c < changes.size32(); c++)
+	{
+		if ( changes[c].action == DIR_CHANGE_ACTION_OVERFLOW )
+			return CheckChanges();
+	}
+
+	bool anyChanged = false;
+
+	for(int i=0;i < pimpl->m_tweakFiles.size32(); i++)
+	{
+		TweakableFile * TF = &(pimpl->m_tweakFiles[i]);
+
+		// registered since the last check (modtime still 0) : the watcher has nothing for it ,
+		//	so parse it now if it exists , same as the polling CheckChanges would
+		bool touched = ( TF->m_lastModTime == 0 && FileModTime(TF->m_name.CStr()) != 0 );
+		for(int c=0;! touched && c < changes.size32(); c++)
+		{
+			const DirChangeRecord & rec = changes[c];
+			if ( rec.action == FILE_ACTION_REMOVED || rec.action == FILE_ACTION_RENAMED_OLD_NAME )
+				continue;
+			if ( DirChangePathsMatch(rec.path,TF->m_name.CStr()) )
+			{
+				touched = true;
+				break;
+			}
+		}
+		if ( ! touched )
+			continue;
+
+		TF->m_lastModTime = FileModTime(TF->m_name.CStr());
+
+		ParseChangedFile(TF);
+
+		anyChanged = true;
+	}
+
+	return anyChanged;
+}
+
 // StartDirWatcher is optional
 //	it starts a DirChangeWatcher to make CheckChanges more efficient
 //	the DirChangeWatcher is automatically queried when you CheckChanges
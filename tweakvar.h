@@ -9,6 +9,8 @@
 
 START_CB
 
+struct DirChangeRecord;
+
 /*************
 
 	TweakVar ; this is the variables in your C file = editable in line
@@ -35,7 +37,10 @@ CheckChanges is polling.  You can either call it periodically, like :
 
 	DO_ONCE_EVERY( TweakVar_CheckChanges(), 1.0 );
 
-or you could use a DirChangeWatcher to only check changes when you see a disk touch.
+or you could use a DirChangeWatcher to only check changes when you see a disk touch :
+	watch TweakVar_GetDirsToWatch , and hand what GetDirChanges gives you to
+	TweakVar_CheckChanges(changes) ; it only reparses the files in there , without touching the disk
+	for the others
 
 CheckChanges intentionally reparses all files at startup.  This lets your app see
 changes that occured while it was not running - it makes the source code like a "pref".
@@ -87,6 +92,8 @@ public:
 	
 	// CheckChanges looks for modtime changes on the tweaker-registered files
 	bool CheckChanges();
+	// event driven : reparse just the files in changes (from a DirChangeWatcher)
+	bool CheckChanges(const vector<DirChangeRecord> & changes);
 
 	void LogAll();
 	bool SetFromText( const char * varname, const char * value );
@@ -138,7 +145,9 @@ public:
 	
 	virtual void GetAsText(String * pInto)
 	{
-		WriteToText(*m_ptr,pInto);
+		StringBuilder sb(64);
+		WriteToText(*m_ptr,&sb);
+		pInto->Append(sb.ToString());
 	}	
 	
 	virtual const char * GetName()
@@ -177,6 +186,7 @@ public:
 
 // bool says if any files changed : (not necessarilly any vars really changed)
 static inline bool TweakVar_CheckChanges() { return NS_CB::TweakVarSingleton::The()->CheckChanges(); }
+static inline bool TweakVar_CheckChanges(const vector<NS_CB::DirChangeRecord> & changes) { return NS_CB::TweakVarSingleton::The()->CheckChanges(changes); }
 
 // TweakVar_CheckChanges does hit disk for modtimes
 //	so you could probably run it once very few seconds or something
@@ -203,6 +213,7 @@ static inline bool TweakVar_SetFromText(const char * var, const char * val) { re
 
 // bool says if any files changed : (not necessarilly any vars really changed)
 static inline bool TweakVar_CheckChanges() { return false; }
+static inline bool TweakVar_CheckChanges(const vector<NS_CB::DirChangeRecord> & changes) { return false; }
 static inline void TweakVar_GetDirsToWatch(vector<String> * pInto) { }
 static inline void TweakVar_Shutdown() { }
 